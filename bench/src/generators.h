@@ -0,0 +1,229 @@
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+/*** HDF5-related utilities ***/
+
+enum class Layout { CONTIGUOUS, CHUNKED, DEFLATE };
+
+inline const char* layout_name(Layout layout) {
+    switch (layout) {
+        case Layout::CONTIGUOUS: return "contiguous";
+        case Layout::CHUNKED: return "chunked";
+        default: return "deflate";
+    }
+}
+
+inline H5::DSetCreatPropList create_plist(const std::vector<hsize_t>& dims, Layout layout) {
+    H5::DSetCreatPropList cplist;
+    if (layout == Layout::CONTIGUOUS) {
+        return cplist;
+    }
+
+    // Aiming for chunks of roughly 100000 elements, filling the fastest-changing dimensions first.
+    std::vector<hsize_t> chunks(dims.size());
+    hsize_t remaining = 100000;
+    for (size_t i = dims.size(); i > 0; --i) {
+        auto d = dims[i - 1];
+        if (d == 0) {
+            return cplist; // can't chunk empty datasets.
+        }
+        chunks[i - 1] = std::max(static_cast<hsize_t>(1), std::min(d, remaining));
+        remaining = std::max(static_cast<hsize_t>(1), remaining / chunks[i - 1]);
+    }
+
+    cplist.setChunk(chunks.size(), chunks.data());
+    if (layout == Layout::DEFLATE) {
+        cplist.setDeflate(6);
+    }
+    return cplist;
+}
+
+inline void add_string_attribute(const H5::H5Object& handle, const std::string& name, const std::string& value) {
+    H5::StrType stype(0, H5T_VARIABLE);
+    auto ahandle = handle.createAttribute(name, stype, H5S_SCALAR);
+    ahandle.write(stype, value);
+}
+
+inline H5::Group operation_opener(const H5::Group& parent, const std::string& name, const std::string& operation) {
+    auto ghandle = parent.createGroup(name);
+    add_string_attribute(ghandle, "delayed_type", "operation");
+    add_string_attribute(ghandle, "delayed_operation", operation);
+    return ghandle;
+}
+
+inline H5::Group array_opener(const H5::Group& parent, const std::string& name, const std::string& array) {
+    auto ghandle = parent.createGroup(name);
+    add_string_attribute(ghandle, "delayed_type", "array");
+    add_string_attribute(ghandle, "delayed_array", array);
+    return ghandle;
+}
+
+inline H5::Group list_opener(const H5::Group& parent, const std::string& name, uint32_t length) {
+    auto ghandle = parent.createGroup(name);
+    auto ahandle = ghandle.createAttribute("length", H5::PredType::NATIVE_UINT32, H5S_SCALAR);
+    ahandle.write(H5::PredType::NATIVE_UINT32, &length);
+    return ghandle;
+}
+
+template<typename T>
+H5::DataSet add_vector(const H5::Group& handle, const std::string& name, const std::vector<T>& values, const H5::DataType& dtype, Layout layout = Layout::CONTIGUOUS) {
+    std::vector<hsize_t> dims { values.size() };
+    H5::DataSpace dspace(1, dims.data());
+    auto dhandle = handle.createDataSet(name, dtype, dspace, create_plist(dims, layout));
+    dhandle.write(values.data(), ritsuko::hdf5::as_numeric_datatype<T>());
+    return dhandle;
+}
+
+template<typename T>
+H5::DataSet add_scalar(const H5::Group& handle, const std::string& name, T value, const H5::DataType& dtype) {
+    auto dhandle = handle.createDataSet(name, dtype, H5S_SCALAR);
+    dhandle.write(&value, ritsuko::hdf5::as_numeric_datatype<T>());
+    return dhandle;
+}
+
+inline void add_string_scalar(const H5::Group& handle, const std::string& name, const std::string& value) {
+    H5::StrType stype(0, H5T_VARIABLE);
+    auto dhandle = handle.createDataSet(name, stype, H5S_SCALAR);
+    dhandle.write(value, stype);
+}
+
+/*** Array generators ***/
+
+inline void add_dense_float(const H5::Group& parent, const std::string& name, hsize_t nrow, hsize_t ncol, Layout layout) {
+    auto ghandle = array_opener(parent, name, "dense array");
+    std::vector<hsize_t> dims { ncol, nrow }; // native = 0, i.e., column-major.
+    H5::DataSpace dspace(2, dims.data());
+    auto dhandle = ghandle.createDataSet("data", H5::PredType::NATIVE_FLOAT, dspace, create_plist(dims, layout));
+
+    std::vector<float> buffer(nrow);
+    for (hsize_t c = 0; c < ncol; ++c) {
+        std::fill(buffer.begin(), buffer.end(), static_cast<float>(c));
+        hsize_t start[2] { c, 0 }, count[2] { 1, nrow };
+        H5::DataSpace fspace = dhandle.getSpace();
+        fspace.selectHyperslab(H5S_SELECT_SET, count, start);
+        H5::DataSpace mspace(1, &nrow);
+        dhandle.write(buffer.data(), H5::PredType::NATIVE_FLOAT, mspace, fspace);
+    }
+
+    add_string_attribute(dhandle, "type", "FLOAT");
+    add_scalar<int8_t>(ghandle, "native", 0, H5::PredType::NATIVE_INT8);
+}
+
+inline void add_dense_string(const H5::Group& parent, const std::string& name, hsize_t nrow, hsize_t ncol, Layout layout) {
+    auto ghandle = array_opener(parent, name, "dense array");
+    std::vector<hsize_t> dims { ncol, nrow };
+    H5::DataSpace dspace(2, dims.data());
+    constexpr size_t len = 8;
+    H5::StrType stype(0, len);
+    auto dhandle = ghandle.createDataSet("data", stype, dspace, create_plist(dims, layout));
+
+    std::vector<char> buffer(nrow * len);
+    for (hsize_t c = 0; c < ncol; ++c) {
+        for (hsize_t r = 0; r < nrow; ++r) {
+            auto str = std::to_string((r + c) % 100000000);
+            std::fill_n(buffer.data() + r * len, len, '\0');
+            std::copy(str.begin(), str.end(), buffer.data() + r * len);
+        }
+        hsize_t start[2] { c, 0 }, count[2] { 1, nrow };
+        H5::DataSpace fspace = dhandle.getSpace();
+        fspace.selectHyperslab(H5S_SELECT_SET, count, start);
+        H5::DataSpace mspace(1, &nrow);
+        dhandle.write(buffer.data(), stype, mspace, fspace);
+    }
+
+    add_string_attribute(dhandle, "type", "STRING");
+    add_scalar<int8_t>(ghandle, "native", 0, H5::PredType::NATIVE_INT8);
+}
+
+struct SparseParameters {
+    uint64_t nrow = 1000;
+    uint64_t ncol = 1000;
+    double density = 0.01;
+    bool by_column = true;
+    H5::PredType index_type = H5::PredType::NATIVE_UINT32;
+    Layout layout = Layout::CONTIGUOUS;
+};
+
+inline void add_sparse_matrix(const H5::Group& parent, const std::string& name, const SparseParameters& params, std::mt19937_64& rng) {
+    auto ghandle = array_opener(parent, name, "sparse matrix");
+    uint64_t primary = (params.by_column ? params.ncol : params.nrow);
+    uint64_t secondary = (params.by_column ? params.nrow : params.ncol);
+
+    // Using geometric skips to sample positions along the secondary dimension.
+    std::vector<uint64_t> indices, indptr { 0 };
+    std::uniform_real_distribution<double> unif(0, 1);
+    double log_miss = std::log1p(-std::min(params.density, 0.999999));
+    for (uint64_t p = 0; p < primary; ++p) {
+        uint64_t s = 0;
+        while (true) {
+            s += static_cast<uint64_t>(std::floor(std::log(1 - unif(rng)) / log_miss));
+            if (s >= secondary) {
+                break;
+            }
+            indices.push_back(s);
+            ++s;
+        }
+        indptr.push_back(indices.size());
+    }
+
+    std::vector<float> data(indices.size(), 1);
+    auto dhandle = add_vector(ghandle, "data", data, H5::PredType::NATIVE_FLOAT, params.layout);
+    add_string_attribute(dhandle, "type", "FLOAT");
+    add_vector<uint64_t>(ghandle, "shape", { params.nrow, params.ncol }, H5::PredType::NATIVE_UINT64);
+    add_vector(ghandle, "indices", indices, params.index_type, params.layout);
+    add_vector(ghandle, "indptr", indptr, H5::PredType::NATIVE_UINT64, params.layout);
+    add_scalar<int8_t>(ghandle, "by_column", params.by_column, H5::PredType::NATIVE_INT8);
+}
+
+/*** Operation generators ***/
+
+inline void add_unary_chain(const H5::Group& parent, const std::string& name, size_t depth) {
+    if (depth == 0) {
+        add_dense_float(parent, name, 100, 100, Layout::CONTIGUOUS);
+        return;
+    }
+    auto ghandle = operation_opener(parent, name, "unary arithmetic");
+    add_string_scalar(ghandle, "method", "+");
+    add_string_scalar(ghandle, "side", "right");
+    auto vhandle = add_scalar<double>(ghandle, "value", 1, H5::PredType::NATIVE_DOUBLE);
+    add_string_attribute(vhandle, "type", "FLOAT");
+    add_unary_chain(ghandle, "seed", depth - 1);
+}
+
+inline void add_wide_combine(const H5::Group& parent, const std::string& name, size_t num_seeds, std::mt19937_64& rng) {
+    auto ghandle = operation_opener(parent, name, "combine");
+    add_scalar<uint32_t>(ghandle, "along", 1, H5::PredType::NATIVE_UINT32);
+    auto lhandle = list_opener(ghandle, "seeds", num_seeds);
+
+    SparseParameters params;
+    params.nrow = 1000;
+    params.ncol = 10;
+    params.density = 0.05;
+    for (size_t s = 0; s < num_seeds; ++s) {
+        add_sparse_matrix(lhandle, std::to_string(s), params, rng);
+    }
+}
+
+inline void add_big_subset(const H5::Group& parent, const std::string& name, uint64_t extent, uint64_t length, std::mt19937_64& rng) {
+    auto ghandle = operation_opener(parent, name, "subset");
+    add_dense_float(ghandle, "seed", extent, 10, Layout::CHUNKED);
+    auto lhandle = list_opener(ghandle, "index", 2);
+
+    std::vector<uint32_t> indices(length);
+    for (auto& i : indices) {
+        i = rng() % extent;
+    }
+    add_vector(lhandle, "0", indices, H5::PredType::NATIVE_UINT32, Layout::CHUNKED);
+}
+
+#endif
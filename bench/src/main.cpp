@@ -0,0 +1,510 @@
+#include "chihaya/chihaya.hpp"
+#include "generators.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIHAYA_BENCH_POSIX 1
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#endif
+
+/*
+ * Benchmarks for chihaya::validate() on synthetic files.
+ * Each scenario generates its own file, validates it once with a Profiler to count the elements and bytes read,
+ * and then validates it several more times to measure the wall time.
+ * Results are printed to stdout as one JSON object per line.
+ * On POSIX systems, each scenario is generated and validated in separate processes so that the peak RSS is specific to the validation.
+ * With --no-fork, the reported peak RSS also includes the file generation and any earlier scenarios.
+ * With --access, the timings are repeated for each of the requested file access configurations (see the file-related fields of chihaya::Options).
+ * Each configuration is timed in its own child process (unless --no-fork is used), and the file is dropped from the OS page cache before every repeat where possible (reported as "cold"),
+ * so that configurations are not flattered by the reads of earlier ones.
+ * The peak RSS is reported for each configuration, as sampled at the end of its runs;
+ * with --no-fork, this is a running maximum that also includes all previous configurations.
+ */
+
+struct Access {
+    std::string name;
+    std::function<void(chihaya::Options&)> configure;
+};
+
+static std::vector<Access> create_access() {
+    return std::vector<Access>{
+        { "default", [](chihaya::Options&) -> void {} },
+        { "metadata_cache", [](chihaya::Options& opts) -> void { opts.metadata_cache_size = 64000000; } },
+        { "page_buffer", [](chihaya::Options& opts) -> void { opts.page_buffer_size = 16777216; } },
+        { "sieve_buffer", [](chihaya::Options& opts) -> void { opts.sieve_buffer_size = 4194304; } },
+        { "core_driver", [](chihaya::Options& opts) -> void { opts.core_driver = true; } },
+        { "combined", [](chihaya::Options& opts) -> void {
+            opts.metadata_cache_size = 64000000;
+            opts.page_buffer_size = 16777216;
+            opts.sieve_buffer_size = 4194304;
+        } }
+    };
+}
+
+struct Settings {
+    std::string dir = ".";
+    std::string filter;
+    int repeats = 3;
+    int num_threads = 1;
+    double scale = 1;
+    bool keep = false;
+    bool fork = true;
+    bool list = false;
+    std::vector<Access> access;
+};
+
+struct Scenario {
+    std::string name;
+    std::function<void(const H5::Group&, std::mt19937_64&)> generate;
+    bool paged = false; // whether to create the file with the paged file space strategy.
+};
+
+static uint64_t scaled(uint64_t x, const Settings& settings) {
+    return std::max(static_cast<uint64_t>(1), static_cast<uint64_t>(x * settings.scale));
+}
+
+static std::vector<Scenario> create_scenarios(const Settings& settings) {
+    std::vector<Scenario> output;
+
+    for (auto layout : { Layout::CONTIGUOUS, Layout::CHUNKED }) {
+        output.push_back(Scenario{ std::string("dense_float_") + layout_name(layout), [=](const H5::Group& handle, std::mt19937_64&) -> void {
+            add_dense_float(handle, "bench", 5000, scaled(1000, settings), layout);
+        }});
+    }
+
+    for (auto layout : { Layout::CONTIGUOUS, Layout::CHUNKED, Layout::DEFLATE }) {
+        output.push_back(Scenario{ std::string("dense_string_") + layout_name(layout), [=](const H5::Group& handle, std::mt19937_64&) -> void {
+            add_dense_string(handle, "bench", 1000, scaled(1000, settings), layout);
+        }});
+    }
+
+    struct IndexType {
+        const char* name;
+        H5::PredType type;
+    };
+    std::vector<IndexType> index_types { { "u16", H5::PredType::NATIVE_UINT16 }, { "u32", H5::PredType::NATIVE_UINT32 }, { "u64", H5::PredType::NATIVE_UINT64 } };
+
+    for (bool by_column : { true, false }) {
+        for (const auto& itype : index_types) {
+            for (auto layout : { Layout::CONTIGUOUS, Layout::CHUNKED, Layout::DEFLATE }) {
+                SparseParameters params;
+                params.nrow = 20000;
+                params.ncol = scaled(5000, settings);
+                params.density = 0.02;
+                params.by_column = by_column;
+                params.index_type = itype.type;
+                params.layout = layout;
+                if (!by_column) {
+                    std::swap(params.nrow, params.ncol);
+                }
+
+                std::string name = std::string("sparse_") + (by_column ? "csc" : "csr") + "_" + itype.name + "_" + layout_name(layout);
+                output.push_back(Scenario{ name, [=](const H5::Group& handle, std::mt19937_64& rng) -> void {
+                    add_sparse_matrix(handle, "bench", params, rng);
+                }});
+            }
+        }
+    }
+
+    for (double density : { 0.001, 0.01, 0.1 }) {
+        SparseParameters params;
+        params.nrow = 20000;
+        params.ncol = scaled(2000, settings);
+        params.density = density;
+        std::ostringstream name;
+        name << "sparse_density_" << density;
+        output.push_back(Scenario{ name.str(), [=](const H5::Group& handle, std::mt19937_64& rng) -> void {
+            add_sparse_matrix(handle, "bench", params, rng);
+        }});
+    }
+
+    for (size_t depth : { 100, 1000 }) {
+        output.push_back(Scenario{ "unary_chain_" + std::to_string(depth), [=](const H5::Group& handle, std::mt19937_64&) -> void {
+            add_unary_chain(handle, "bench", depth);
+        }});
+    }
+
+    // Deep trees are dominated by metadata reads, which page buffering can only aggregate for paged files.
+    output.push_back(Scenario{ "unary_chain_paged_" + std::to_string(scaled(5000, settings)), [=](const H5::Group& handle, std::mt19937_64&) -> void {
+        add_unary_chain(handle, "bench", scaled(5000, settings));
+    }, true });
+
+    output.push_back(Scenario{ "combine_wide", [=](const H5::Group& handle, std::mt19937_64& rng) -> void {
+        add_wide_combine(handle, "bench", scaled(2000, settings), rng);
+    }});
+
+    output.push_back(Scenario{ "subset_big", [=](const H5::Group& handle, std::mt19937_64& rng) -> void {
+        add_big_subset(handle, "bench", 100000, scaled(10000000, settings), rng);
+    }});
+
+    return output;
+}
+
+static long peak_rss_kb() {
+#ifdef CHIHAYA_BENCH_POSIX
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS.
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+static std::string escape(const std::string& x) {
+    std::string output;
+    for (char c : x) {
+        if (c == '"' || c == '\\') {
+            output += '\\';
+            output += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            output += ' ';
+        } else {
+            output += c;
+        }
+    }
+    return output;
+}
+
+static std::string scenario_path(const Scenario& scenario, const Settings& settings) {
+    return settings.dir + "/bench_" + scenario.name + ".h5";
+}
+
+static std::string error_line(const Scenario& scenario, const std::exception& e) {
+    return "{\"scenario\":\"" + scenario.name + "\",\"error\":\"" + escape(e.what()) + "\"}";
+}
+
+// Generates the file for a scenario, returning the time spent in seconds.
+static double generate_scenario(const Scenario& scenario, const std::string& path) {
+    auto gstart = std::chrono::steady_clock::now();
+    {
+        H5::FileCreatPropList fcpl;
+        if (scenario.paged) {
+            H5Pset_file_space_strategy(fcpl.getId(), H5F_FSPACE_STRATEGY_PAGE, false, 1);
+            H5Pset_file_space_page_size(fcpl.getId(), 65536);
+        }
+        H5::H5File fhandle(path, H5F_ACC_TRUNC, fcpl);
+        std::mt19937_64 rng(1234567);
+        scenario.generate(fhandle, rng);
+        add_string_attribute(fhandle.openGroup("bench"), "delayed_version", "1.1");
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - gstart).count();
+}
+
+// Drops the file from the OS page cache, returning whether this was possible on this system.
+static bool evict_file([[maybe_unused]] const std::string& path) {
+#if defined(CHIHAYA_BENCH_POSIX) && defined(POSIX_FADV_DONTNEED)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool okay = ::fdatasync(fd) == 0 && ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0; // dirty pages are not dropped, hence the sync.
+    ::close(fd);
+    return okay;
+#else
+    return false;
+#endif
+}
+
+// Best and median times for a configuration, along with the peak RSS at the end of its runs.
+struct Timing {
+    double best = 0;
+    double median = 0;
+    long peak_rss_kb = -1;
+};
+
+#ifdef CHIHAYA_BENCH_POSIX
+// Runs 'fun' in a child process and returns its timing, so that no process state is shared with other measurements.
+template<class Function_>
+Timing time_in_child(Function_ fun) {
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        throw std::runtime_error("failed to create a pipe for the child process");
+    }
+
+    std::cout << std::flush;
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        bool success = false;
+        try {
+            auto timing = fun();
+            double buffer[3] = { timing.best, timing.median, static_cast<double>(timing.peak_rss_kb) };
+            success = ::write(fds[1], buffer, sizeof(buffer)) == static_cast<ssize_t>(sizeof(buffer));
+        } catch (...) {}
+        ::close(fds[1]);
+        std::_Exit(success ? 0 : 1);
+    }
+
+    ::close(fds[1]);
+    double buffer[3];
+    size_t received = 0;
+    while (pid >= 0 && received < sizeof(buffer)) {
+        auto n = ::read(fds[0], reinterpret_cast<char*>(buffer) + received, sizeof(buffer) - received);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    ::close(fds[0]);
+
+    int status = 0;
+    bool exited = pid >= 0 && waitpid(pid, &status, 0) >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!exited || received < sizeof(buffer)) {
+        throw std::runtime_error("failed to time the access configuration in a child process");
+    }
+    Timing output;
+    output.best = buffer[0];
+    output.median = buffer[1];
+    output.peak_rss_kb = buffer[2];
+    return output;
+}
+#endif
+
+// Validates the previously generated file for a scenario.
+static std::string measure_scenario(const Scenario& scenario, const Settings& settings, const std::string& path, double generation) {
+    std::ostringstream out;
+    out << "{\"scenario\":\"" << scenario.name << "\"";
+    try {
+        // Initial run with profiling to count elements and bytes.
+        chihaya::Profiler prof;
+        {
+            chihaya::Options opts;
+            opts.num_threads = settings.num_threads;
+            prof.attach(opts);
+            chihaya::validate(path, "bench", opts);
+        }
+
+        uint64_t elements = 0, bytes = 0, datasets = 0;
+        for (const auto& e : prof.entries()) {
+            elements += e.statistics.elements_read;
+            bytes += e.statistics.bytes_read;
+            datasets += e.statistics.datasets_opened;
+        }
+
+        auto time_access = [&](const Access* access, bool cold) -> Timing {
+            std::vector<double> timings;
+            for (int r = 0; r < std::max(settings.repeats, 1); ++r) {
+                if (cold) {
+                    evict_file(path);
+                }
+                chihaya::Options opts;
+                opts.num_threads = settings.num_threads;
+                if (access) {
+                    access->configure(opts);
+                }
+                auto start = std::chrono::steady_clock::now();
+                chihaya::validate(path, "bench", opts);
+                timings.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(timings.begin(), timings.end());
+            Timing output;
+            output.best = timings.front();
+            output.median = timings[timings.size() / 2];
+            output.peak_rss_kb = peak_rss_kb();
+            return output;
+        };
+
+        // Sampled before the access configurations, so that the peak RSS only reflects the default configuration.
+        auto timed = time_access(nullptr, false);
+        double best = timed.best;
+        double median = timed.median;
+
+        out << ",\"threads\":" << settings.num_threads;
+        out << ",\"nodes\":" << prof.entries().size();
+        out << ",\"datasets\":" << datasets;
+        out << ",\"elements\":" << elements;
+        out << ",\"bytes\":" << bytes;
+        out << ",\"generation_seconds\":" << generation;
+        out << ",\"best_seconds\":" << best;
+        out << ",\"median_seconds\":" << median;
+        out << ",\"elements_per_second\":" << (best > 0 ? elements / best : 0);
+        out << ",\"mb_per_second\":" << (best > 0 ? bytes / best / 1e6 : 0);
+        out << ",\"peak_rss_kb\":" << timed.peak_rss_kb;
+
+        if (!settings.access.empty()) {
+            bool cold = evict_file(path);
+            out << ",\"access\":{\"cold\":" << (cold ? "true" : "false");
+            for (const auto& access : settings.access) {
+                auto fun = [&]() -> Timing { return time_access(&access, cold); };
+#ifdef CHIHAYA_BENCH_POSIX
+                auto current = (settings.fork ? time_in_child(fun) : fun());
+#else
+                auto current = fun();
+#endif
+                out << ",\"" << access.name << "\":{\"best_seconds\":" << current.best << ",\"median_seconds\":" << current.median << ",\"peak_rss_kb\":" << current.peak_rss_kb << "}";
+            }
+            out << "}";
+        }
+
+    } catch (std::exception& e) {
+        out << ",\"error\":\"" << escape(e.what()) << "\"";
+    }
+
+    out << "}";
+    return out.str();
+}
+
+// Runs a scenario in the current process.
+static std::string run_scenario(const Scenario& scenario, const Settings& settings) {
+    auto path = scenario_path(scenario, settings);
+    std::string line;
+    try {
+        double generation = generate_scenario(scenario, path);
+        line = measure_scenario(scenario, settings, path, generation);
+    } catch (std::exception& e) {
+        line = error_line(scenario, e);
+    }
+    if (!settings.keep) {
+        std::remove(path.c_str());
+    }
+    return line;
+}
+
+#ifdef CHIHAYA_BENCH_POSIX
+// Runs 'fun' in a child process, returning whether it exited successfully.
+template<class Function_>
+bool run_in_child(Function_ fun) {
+    std::cout << std::flush;
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        bool success = fun();
+        std::cout << std::flush;
+        std::_Exit(success ? 0 : 1);
+    }
+    int status = 0;
+    return pid >= 0 && waitpid(pid, &status, 0) >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Generation and validation run in separate child processes, so that the peak RSS of the latter is not inflated by the generator's buffers.
+static bool fork_scenario(const Scenario& scenario, const Settings& settings) {
+    auto path = scenario_path(scenario, settings);
+    auto gstart = std::chrono::steady_clock::now();
+    bool success = run_in_child([&]() -> bool {
+        try {
+            generate_scenario(scenario, path);
+            return true;
+        } catch (std::exception& e) {
+            std::cout << error_line(scenario, e) << std::endl;
+            return false;
+        }
+    });
+    double generation = std::chrono::duration<double>(std::chrono::steady_clock::now() - gstart).count();
+
+    if (success) {
+        success = run_in_child([&]() -> bool {
+            auto line = measure_scenario(scenario, settings, path, generation);
+            std::cout << line << std::endl;
+            return line.find("\"error\"") == std::string::npos;
+        });
+    }
+
+    if (!settings.keep) {
+        std::remove(path.c_str());
+    }
+    return success;
+}
+#endif
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--list] [--filter SUBSTRING] [--repeats N] [--threads N] [--scale X] [--dir PATH] [--keep] [--no-fork] [--access NAME,...|all]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--list") {
+            settings.list = true;
+        } else if (arg == "--filter") {
+            settings.filter = next();
+        } else if (arg == "--repeats") {
+            settings.repeats = std::stoi(next());
+        } else if (arg == "--threads") {
+            settings.num_threads = std::stoi(next());
+        } else if (arg == "--scale") {
+            settings.scale = std::stod(next());
+        } else if (arg == "--dir") {
+            settings.dir = next();
+        } else if (arg == "--keep") {
+            settings.keep = true;
+        } else if (arg == "--no-fork") {
+            settings.fork = false;
+        } else if (arg == "--access") {
+            auto available = create_access();
+            std::stringstream requested(next());
+            std::string name;
+            while (std::getline(requested, name, ',')) {
+                bool found = false;
+                for (const auto& a : available) {
+                    if (name == "all" || a.name == name) {
+                        settings.access.push_back(a);
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    usage(argv[0]);
+                    return 1;
+                }
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    H5::Exception::dontPrint();
+    auto scenarios = create_scenarios(settings);
+    bool failed = false;
+
+    for (const auto& scenario : scenarios) {
+        if (!settings.filter.empty() && scenario.name.find(settings.filter) == std::string::npos) {
+            continue;
+        }
+        if (settings.list) {
+            std::cout << scenario.name << std::endl;
+            continue;
+        }
+
+#ifdef CHIHAYA_BENCH_POSIX
+        if (settings.fork) {
+            if (!fork_scenario(scenario, settings)) {
+                failed = true;
+            }
+            continue;
+        }
+#endif
+
+        auto line = run_scenario(scenario, settings);
+        std::cout << line << std::endl;
+        failed = failed || line.find("\"error\"") != std::string::npos;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include "chihaya/realize.hpp"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <limits>
+
+/*
+ * Benchmarks for the unary math kernels used by chihaya::realize.
+ * For each method, this compares a plain loop over the standard library function to the kernel used during realization,
+ * which is vectorized where possible and falls back to the scalar code otherwise.
+ * Results are printed to stdout as one JSON object per line.
+ */
+
+struct Method {
+    const char* name;
+    chihaya::realize::UnaryMethod method;
+    double parameter;
+    double (*libm)(double);
+    double lower, upper; // range of the simulated inputs.
+};
+
+static double libm_round(double x) {
+    return std::nearbyint(x);
+}
+
+static double libm_sign(double x) {
+    return (x > 0) - (x < 0);
+}
+
+static double libm_log(double x) {
+    return std::log(x);
+}
+
+static double libm_abs(double x) {
+    return std::abs(x);
+}
+
+static double libm_signif(double x) {
+    return chihaya::realize::internal::apply<chihaya::realize::UnaryMethod::SIGNIF>(x, 3);
+}
+
+template<class Function_>
+static double best_time(int repeats, Function_ fun) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fun();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t n = 10000000;
+    int repeats = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            n = std::stoull(argv[++i]);
+        } else if (arg == "--repeats" && i + 1 < argc) {
+            repeats = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--size N] [--repeats N]" << std::endl;
+            return 1;
+        }
+    }
+
+    typedef chihaya::realize::UnaryMethod UM;
+    std::vector<Method> methods {
+        { "abs", UM::ABS, 0, libm_abs, -50, 50 },
+        { "sign", UM::SIGN, 0, libm_sign, -50, 50 },
+        { "sqrt", UM::SQRT, 0, std::sqrt, 0.001, 50 },
+        { "ceiling", UM::CEILING, 0, std::ceil, -50, 50 },
+        { "floor", UM::FLOOR, 0, std::floor, -50, 50 },
+        { "trunc", UM::TRUNC, 0, std::trunc, -50, 50 },
+        { "round", UM::ROUND, 0, libm_round, -50, 50 },
+        { "signif", UM::SIGNIF, 3, libm_signif, -50, 50 },
+        { "exp", UM::EXP, 0, std::exp, -50, 50 },
+        { "expm1", UM::EXPM1, 0, std::expm1, -1, 1 },
+        { "log", UM::LOG, 1, libm_log, 0.001, 50 },
+        { "log1p", UM::LOG1P, 0, std::log1p, 0.001, 50 },
+        { "sin", UM::SIN, 0, std::sin, -50, 50 },
+        { "cos", UM::COS, 0, std::cos, -50, 50 },
+        { "tan", UM::TAN, 0, std::tan, -50, 50 },
+        { "asin", UM::ASIN, 0, std::asin, -1, 1 },
+        { "acos", UM::ACOS, 0, std::acos, -1, 1 },
+        { "atan", UM::ATAN, 0, std::atan, -50, 50 },
+        { "sinh", UM::SINH, 0, std::sinh, -50, 50 },
+        { "cosh", UM::COSH, 0, std::cosh, -50, 50 },
+        { "tanh", UM::TANH, 0, std::tanh, -50, 50 },
+        { "asinh", UM::ASINH, 0, std::asinh, -50, 50 },
+        { "acosh", UM::ACOSH, 0, std::acosh, 1, 50 },
+        { "atanh", UM::ATANH, 0, std::atanh, -1, 1 }
+    };
+
+    std::mt19937_64 rng(1234567);
+    std::vector<double> input(n), expected(n), observed(n);
+
+    for (const auto& m : methods) {
+        // Values within the domain of each method, with some missing values sprinkled throughout.
+        std::uniform_real_distribution<double> dist(m.lower, m.upper);
+        for (size_t i = 0; i < n; ++i) {
+            input[i] = (i % 1000 == 0 ? chihaya::realize::missing_value() : dist(rng));
+        }
+
+        double libm_seconds = best_time(repeats, [&]() -> void {
+            for (size_t i = 0; i < n; ++i) {
+                double x = input[i];
+                expected[i] = (std::isnan(x) ? x : m.libm(x));
+            }
+        });
+
+        double kernel_seconds = best_time(repeats, [&]() -> void {
+            std::copy(input.begin(), input.end(), observed.begin());
+            chihaya::realize::internal::dispatch(m.method, [&](auto tag) -> void {
+                constexpr UM method_ = decltype(tag)::value;
+                chihaya::realize::internal::apply_all<method_>(observed.data(), n, m.parameter);
+            });
+        });
+
+        double max_error = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double e = expected[i], o = observed[i];
+            if (!std::isnan(e) && e != o) {
+                max_error = std::max(max_error, std::abs(e - o) / std::max(std::abs(e), std::numeric_limits<double>::min()));
+            }
+        }
+
+        std::cout << "{\"method\":\"" << m.name << "\"";
+        std::cout << ",\"elements\":" << n;
+        std::cout << ",\"libm_seconds\":" << libm_seconds;
+        std::cout << ",\"kernel_seconds\":" << kernel_seconds;
+        std::cout << ",\"speedup\":" << (kernel_seconds > 0 ? libm_seconds / kernel_seconds : 0);
+        std::cout << ",\"max_relative_error\":" << max_error;
+        std::cout << "}" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,509 @@
+#ifndef CHIHAYA_BATCH_HPP
+#define CHIHAYA_BATCH_HPP
+
+#include "H5Cpp.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "utils_public.hpp"
+#include "utils_parallel.hpp"
+#include "utils_file.hpp"
+#include "validate.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIHAYA_BATCH_FORK 1
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <cerrno>
+#endif
+
+/**
+ * @file batch.hpp
+ * @brief Validate many groups across many files.
+ */
+
+namespace chihaya {
+
+/**
+ * @namespace chihaya::batch
+ * @brief Namespace for batch validation.
+ */
+namespace batch {
+
+/**
+ * @brief Group to be validated.
+ */
+struct Target {
+    /**
+     * @cond
+     */
+    Target() = default;
+
+    Target(std::string path, std::string name) : path(std::move(path)), name(std::move(name)) {}
+    /**
+     * @endcond
+     */
+
+    /**
+     * Path to the HDF5 file.
+     */
+    std::string path;
+
+    /**
+     * Name of the group inside the file.
+     */
+    std::string name;
+};
+
+/**
+ * @brief Result of validating a single target.
+ */
+struct Result {
+    /**
+     * Whether the validation was successful.
+     */
+    bool success = false;
+
+    /**
+     * Details of the array, only meaningful if `success = true`.
+     */
+    ArrayDetails details;
+
+    /**
+     * Error message, only meaningful if `success = false`.
+     */
+    std::string error;
+
+    /**
+     * Wall time spent validating this target, in seconds.
+     * This does not include the time spent opening the file.
+     */
+    double seconds = 0;
+};
+
+/**
+ * @brief Results for all targets.
+ */
+struct Results {
+    /**
+     * Result for each target, in the same order as the input targets.
+     */
+    std::vector<Result> results;
+
+    /**
+     * Number of targets that failed validation.
+     */
+    size_t num_failed = 0;
+
+    /**
+     * Number of unique files that were opened.
+     */
+    size_t num_files = 0;
+
+    /**
+     * Total wall time for the batch, in seconds.
+     */
+    double seconds = 0;
+
+    /**
+     * Sum of the per-target wall times, in seconds.
+     */
+    double validation_seconds = 0;
+};
+
+/**
+ * How targets should be processed in parallel.
+ *
+ * - `AUTO` uses `THREADS` if the HDF5 library was built with thread-safety, and `PROCESSES` otherwise.
+ * - `THREADS` uses multiple threads in the current process.
+ *   If the HDF5 library was built with thread-safety, each file is validated without the global HDF5 lock,
+ *   which is only taken by reads that need several HDF5 calls to be performed together (e.g., fetching raw chunks).
+ *   Otherwise, each file is validated while holding the global lock, which is only released during CPU-bound checks;
+ *   this is safe but gives little speedup when validation is dominated by I/O, in which case `PROCESSES` should be used instead.
+ * - `PROCESSES` forks worker processes that each validate a subset of the files.
+ *   This allows HDF5 calls to run in parallel, at the cost of the process creation and the loss of any side-effects of custom validation functions and callbacks.
+ *   It falls back to `THREADS` on systems without `fork()`.
+ */
+enum class Mode { AUTO, THREADS, PROCESSES };
+
+/**
+ * @brief Options for batch validation.
+ */
+struct Options {
+    /**
+     * Number of workers (threads or processes) to use.
+     */
+    int num_workers = 1;
+
+    /**
+     * How targets should be processed in parallel.
+     */
+    Mode mode = Mode::AUTO;
+
+    /**
+     * Validation options, copied for each worker.
+     * This may contain custom registries, `num_threads` for parallelization within each target, etc.
+     */
+    ::chihaya::Options validation;
+};
+
+/**
+ * @cond
+ */
+namespace internal {
+
+// Targets are grouped by file so that each file only needs to be opened once.
+struct FileGroup {
+    std::string path;
+    std::vector<size_t> targets;
+};
+
+inline std::vector<FileGroup> group_by_file(const std::vector<Target>& targets) {
+    std::map<std::string, size_t> mapping;
+    std::vector<FileGroup> output;
+    for (size_t t = 0, end = targets.size(); t < end; ++t) {
+        const auto& path = targets[t].path;
+        auto it = mapping.find(path);
+        if (it == mapping.end()) {
+            mapping[path] = output.size();
+            output.emplace_back();
+            output.back().path = path;
+            output.back().targets.push_back(t);
+        } else {
+            output[it->second].targets.push_back(t);
+        }
+    }
+    return output;
+}
+
+template<class Function_>
+double time_seconds(Function_ fun) {
+    auto start = std::chrono::steady_clock::now();
+    fun();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Assumes that the caller holds the global HDF5 lock, unless the HDF5 library is thread-safe.
+inline void validate_file(const FileGroup& group, const std::vector<Target>& targets, ::chihaya::Options& options, std::vector<Result>& results) {
+    H5::H5File fhandle;
+    try {
+        internal_file::open_file(fhandle, group.path, options);
+    } catch (H5::Exception& e) {
+        for (auto t : group.targets) {
+            results[t].error = "failed to open '" + group.path + "'; " + e.getDetailMsg();
+        }
+        return;
+    } catch (std::exception& e) {
+        for (auto t : group.targets) {
+            results[t].error = "failed to open '" + group.path + "'; " + std::string(e.what());
+        }
+        return;
+    }
+
+    for (auto t : group.targets) {
+        auto& current = results[t];
+        current.seconds = time_seconds([&]() -> void {
+            try {
+                auto ghandle = fhandle.openGroup(targets[t].name);
+                current.details = ::chihaya::validate(ghandle, options);
+                current.success = true;
+            } catch (H5::Exception& e) {
+                current.error = e.getDetailMsg();
+            } catch (std::exception& e) {
+                current.error = e.what();
+            }
+        });
+    }
+}
+
+inline void validate_threads(const std::vector<FileGroup>& groups, const std::vector<Target>& targets, const Options& options, std::vector<Result>& results) {
+    size_t num_workers = std::min(static_cast<size_t>(std::max(options.num_workers, 1)), groups.size());
+    std::atomic<size_t> next(0);
+
+    // Using parallelize() for its error handling, though validate_file() shouldn't throw.
+    internal_parallel::parallelize(num_workers, [&](size_t) -> void {
+        auto copy = options.validation;
+        while (true) {
+            size_t g = next++;
+            if (g >= groups.size()) {
+                break;
+            }
+#ifdef H5_HAVE_THREADSAFE
+            // HDF5 serializes its own calls, and our multi-call reads take the lock themselves.
+            validate_file(groups[g], targets, copy, results);
+#else
+            internal_parallel::Hdf5Lock lock;
+            validate_file(groups[g], targets, copy, results);
+#endif
+        }
+    });
+}
+
+#ifdef CHIHAYA_BATCH_FORK
+/*
+ * Results are sent from each worker process to the parent via a pipe, using a simple binary format.
+ * Each record contains the target index, success flag, seconds, type, number of dimensions, dimensions, error length and error message.
+ */
+template<typename Type_>
+void serialize(std::string& buffer, Type_ value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(Type_));
+}
+
+inline void serialize(std::string& buffer, size_t index, const Result& result) {
+    serialize<uint64_t>(buffer, index);
+    serialize<uint8_t>(buffer, result.success);
+    serialize<double>(buffer, result.seconds);
+    serialize<int32_t>(buffer, result.details.type);
+    serialize<uint64_t>(buffer, result.details.dimensions.size());
+    for (auto d : result.details.dimensions) {
+        serialize<uint64_t>(buffer, d);
+    }
+    serialize<uint64_t>(buffer, result.error.size());
+    buffer += result.error;
+}
+
+class Deserializer {
+public:
+    Deserializer(const std::string& buffer) : buffer(buffer) {}
+
+    bool finished() const {
+        return position >= buffer.size();
+    }
+
+    template<typename Type_>
+    Type_ get() {
+        if (position + sizeof(Type_) > buffer.size()) {
+            throw std::runtime_error("truncated results from worker process");
+        }
+        Type_ output;
+        std::memcpy(&output, buffer.data() + position, sizeof(Type_));
+        position += sizeof(Type_);
+        return output;
+    }
+
+    std::string get_string(size_t n) {
+        if (position + n > buffer.size()) {
+            throw std::runtime_error("truncated results from worker process");
+        }
+        std::string output(buffer.data() + position, n);
+        position += n;
+        return output;
+    }
+
+private:
+    const std::string& buffer;
+    size_t position = 0;
+};
+
+inline void write_all(int fd, const std::string& buffer) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        auto n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        written += n;
+    }
+}
+
+inline void validate_processes(const std::vector<FileGroup>& groups, const std::vector<Target>& targets, const Options& options, std::vector<Result>& results) {
+    size_t num_workers = std::min(static_cast<size_t>(std::max(options.num_workers, 1)), groups.size());
+
+    // Assigning files to workers, largest first, to balance the number of targets per worker.
+    std::vector<size_t> order(groups.size());
+    for (size_t g = 0; g < order.size(); ++g) {
+        order[g] = g;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right) -> bool {
+        return groups[left].targets.size() > groups[right].targets.size();
+    });
+    std::vector<std::vector<size_t> > assignments(num_workers);
+    std::vector<size_t> load(num_workers);
+    for (auto g : order) {
+        auto chosen = std::min_element(load.begin(), load.end()) - load.begin();
+        assignments[chosen].push_back(g);
+        load[chosen] += groups[g].targets.size();
+    }
+
+    std::vector<pid_t> pids(num_workers, -1);
+    std::vector<int> fds(num_workers, -1);
+    for (size_t w = 0; w < num_workers; ++w) {
+        int pipefd[2];
+        if (::pipe(pipefd) != 0) {
+            continue;
+        }
+
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::close(pipefd[0]);
+            auto copy = options.validation;
+            for (auto g : assignments[w]) {
+                const auto& group = groups[g];
+                validate_file(group, targets, copy, results);
+
+                // Flushing after each file to avoid accumulating all results in memory.
+                std::string buffer;
+                for (auto t : group.targets) {
+                    serialize(buffer, t, results[t]);
+                }
+                write_all(pipefd[1], buffer);
+            }
+            ::close(pipefd[1]);
+            ::_exit(0); // skip any cleanup of HDF5 or static objects from the parent.
+        }
+
+        ::close(pipefd[1]);
+        if (pid < 0) {
+            ::close(pipefd[0]);
+            continue;
+        }
+        pids[w] = pid;
+        fds[w] = pipefd[0];
+    }
+
+    // Reading from all pipes concurrently so that no worker blocks on a full pipe.
+    std::vector<std::string> buffers(num_workers);
+    std::vector<struct pollfd> polled;
+    std::vector<size_t> owners;
+    for (size_t w = 0; w < num_workers; ++w) {
+        if (fds[w] >= 0) {
+            struct pollfd current;
+            current.fd = fds[w];
+            current.events = POLLIN;
+            current.revents = 0;
+            polled.push_back(current);
+            owners.push_back(w);
+        }
+    }
+
+    char chunk[65536];
+    while (!polled.empty()) {
+        if (::poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (size_t i = polled.size(); i > 0; --i) {
+            auto& current = polled[i - 1];
+            if (current.revents == 0) {
+                continue;
+            }
+            auto n = ::read(current.fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                buffers[owners[i - 1]].append(chunk, n);
+            } else if (n == 0 || errno != EINTR) {
+                ::close(current.fd);
+                polled.erase(polled.begin() + (i - 1));
+                owners.erase(owners.begin() + (i - 1));
+            }
+        }
+    }
+
+    std::vector<bool> received(results.size());
+    for (size_t w = 0; w < num_workers; ++w) {
+        if (pids[w] > 0) {
+            int status;
+            while (::waitpid(pids[w], &status, 0) < 0 && errno == EINTR) {}
+        }
+
+        try {
+            Deserializer reader(buffers[w]);
+            while (!reader.finished()) {
+                auto t = reader.get<uint64_t>();
+                if (t >= results.size()) {
+                    throw std::runtime_error("invalid target index from worker process");
+                }
+                auto& current = results[t];
+                current.success = reader.get<uint8_t>();
+                current.seconds = reader.get<double>();
+                current.details.type = static_cast<ArrayType>(reader.get<int32_t>());
+                current.details.dimensions.resize(reader.get<uint64_t>());
+                for (auto& d : current.details.dimensions) {
+                    d = reader.get<uint64_t>();
+                }
+                current.error = reader.get_string(reader.get<uint64_t>());
+                received[t] = true;
+            }
+        } catch (std::exception&) {
+            // Any targets without results are marked below.
+        }
+    }
+
+    for (size_t t = 0; t < results.size(); ++t) {
+        if (!received[t]) {
+            results[t].success = false;
+            results[t].error = "worker process terminated unexpectedly";
+        }
+    }
+}
+#endif
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Validate many groups, possibly across many files.
+ * Targets in the same file are validated with a single file handle, which avoids the overhead of repeatedly opening and closing files.
+ * Each target is validated with `chihaya::validate()`, using a copy of `options.validation` for each worker.
+ * Validation errors are caught and reported in the result for the corresponding target, so a failure in one target does not affect the others.
+ *
+ * @param targets Groups to validate.
+ * @param options Options for batch validation.
+ *
+ * @return Results for each target, along with some aggregate statistics.
+ */
+inline Results validate(const std::vector<Target>& targets, const Options& options) {
+    Results output;
+    output.results.resize(targets.size());
+    auto groups = internal::group_by_file(targets);
+    output.num_files = groups.size();
+
+    output.seconds = internal::time_seconds([&]() -> void {
+        auto mode = options.mode;
+        if (mode == Mode::AUTO) {
+#ifdef H5_HAVE_THREADSAFE
+            mode = Mode::THREADS;
+#else
+            mode = Mode::PROCESSES;
+#endif
+        }
+
+#ifdef CHIHAYA_BATCH_FORK
+        if (mode == Mode::PROCESSES && options.num_workers > 1 && groups.size() > 1) {
+            internal::validate_processes(groups, targets, options, output.results);
+            return;
+        }
+#endif
+        internal::validate_threads(groups, targets, options, output.results);
+    });
+
+    for (const auto& res : output.results) {
+        output.num_failed += !res.success;
+        output.validation_seconds += res.seconds;
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -36,8 +36,9 @@ namespace binary_arithmetic {
  * Otherwise, if the validation failed, an error is raised.
  */
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
-    auto left_details = internal_arithmetic::fetch_seed(handle, "left", version, options);
-    auto right_details = internal_arithmetic::fetch_seed(handle, "right", version, options);
+    internal_misc::DeferredSeeds seeds(handle, { "left", "right" }, "", version, options);
+    auto left_details = internal_arithmetic::check_seed(seeds.get(0), "left");
+    auto right_details = internal_arithmetic::check_seed(seeds.get(1), "right");
 
     if (!options.details_only) {
         if (!internal_misc::are_dimensions_equal(left_details.dimensions, right_details.dimensions)) {
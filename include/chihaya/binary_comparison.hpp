@@ -35,8 +35,9 @@ namespace binary_comparison {
  * Otherwise, if the validation failed, an error is raised.
  */
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
-    auto left_details = internal_misc::load_seed_details(handle, "left", version, options);
-    auto right_details = internal_misc::load_seed_details(handle, "right", version, options);
+    internal_misc::DeferredSeeds seeds(handle, { "left", "right" }, "", version, options);
+    auto left_details = seeds.get(0);
+    auto right_details = seeds.get(1);
 
     if (!options.details_only) {
         if (!internal_misc::are_dimensions_equal(left_details.dimensions, right_details.dimensions)) {
@@ -8,6 +8,9 @@
  */
 
 #include "validate.hpp"
+#include "profile.hpp"
+#include "batch.hpp"
+#include "realize.hpp"
 
 /**
  * @namespace chihaya
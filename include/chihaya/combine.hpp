@@ -62,15 +62,15 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         bool first = true;
         size_t num_strings = 0;
 
+        std::vector<std::string> names;
+        names.reserve(list_params.present.size());
         for (const auto& p : list_params.present) {
-            auto current = ritsuko::hdf5::open_group(shandle, p.second.c_str());
+            names.push_back(p.second);
+        }
+        internal_misc::DeferredSeeds seeds(shandle, std::move(names), "seeds/", version, options);
 
-            ArrayDetails cur_seed;
-            try {
-                cur_seed = ::chihaya::validate(current, version, options);
-            } catch (std::exception& e) {
-                throw std::runtime_error("failed to validate 'seeds/" + p.second + "'; " + std::string(e.what()));
-            }
+        for (size_t i = 0, end = list_params.present.size(); i < end; ++i) {
+            auto cur_seed = seeds.get(i);
 
             if (first) {
                 type = cur_seed.type;
@@ -14,6 +14,8 @@
 #include <cstdint>
 #include <stdexcept>
 
+#include "utils_profile.hpp"
+
 namespace chihaya {
 
 /**
@@ -34,7 +36,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     ArrayDetails output;
 
     {
-        auto dhandle = ritsuko::hdf5::open_dataset(handle, "dimensions");
+        auto dhandle = internal_profile::open_dataset(handle, "dimensions");
         size_t size = ritsuko::hdf5::get_1d_length(dhandle, false);
         if (size == 0) {
             throw std::runtime_error("'dimensions' should have non-zero length");
@@ -46,6 +48,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
             std::vector<int> dims_tmp(size);
             dhandle.read(dims_tmp.data(), H5::PredType::NATIVE_INT);
+            internal_profile::record_read<int>(size);
             for (auto d : dims_tmp) {
                 if (d < 0) {
                     throw std::runtime_error("'dimensions' should contain non-negative values");
@@ -59,12 +62,13 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
             std::vector<uint64_t> dims(size);
             dhandle.read(dims.data(), H5::PredType::NATIVE_UINT64);
+            internal_profile::record_read<uint64_t>(size);
             output.dimensions.insert(output.dimensions.end(), dims.begin(), dims.end());
         }
     }
  
     {
-        auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
+        auto vhandle = internal_profile::open_dataset(handle, "value");
         if (!ritsuko::hdf5::is_scalar(vhandle)) {
             throw std::runtime_error("'value' should be a scalar");
         }
@@ -7,10 +7,14 @@
 
 #include <vector>
 #include <cstdint>
+#include <numeric>
+#include <functional>
 
 #include "utils_public.hpp"
 #include "utils_type.hpp"
 #include "utils_dimnames.hpp"
+#include "utils_buffer.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file dense_array.hpp
@@ -37,7 +41,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     ArrayDetails output;
 
     {
-        auto dhandle = ritsuko::hdf5::open_dataset(handle, "data");
+        auto dhandle = internal_buffer::open_dataset(handle, "data", options);
         auto dspace = dhandle.getSpace();
         auto ndims = dspace.getSimpleExtentNdims();
         if (ndims == 0) {
@@ -65,7 +69,8 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
             if (dhandle.getTypeClass() == H5T_STRING) {
-                ritsuko::hdf5::validate_nd_string_dataset(dhandle, dims, 1000000);
+                ritsuko::hdf5::validate_nd_string_dataset(dhandle, dims, internal_buffer::pick_block_size(dhandle, dims, options));
+                internal_profile::record_read(dhandle, std::accumulate(dims.begin(), dims.end(), static_cast<uint64_t>(1), std::multiplies<uint64_t>()));
             }
 
         } catch (std::exception& e) {
@@ -75,7 +80,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
 
     bool native;
     {
-        auto nhandle = ritsuko::hdf5::open_dataset(handle, "native");
+        auto nhandle = internal_profile::open_dataset(handle, "native");
         if (!ritsuko::hdf5::is_scalar(nhandle)) {
             throw std::runtime_error("'native' should be a scalar");
         }
@@ -96,7 +101,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     // Do this before the 'native' check.
     if (!options.details_only) {
         if (handle.exists("dimnames")) {
-            internal_dimnames::validate(handle, output.dimensions, version);
+            internal_dimnames::validate(handle, output.dimensions, version, options);
         }
     }
 
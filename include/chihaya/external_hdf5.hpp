@@ -6,6 +6,7 @@
 #include "ritsuko/hdf5/hdf5.hpp"
 
 #include "minimal_array.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file external_hdf5.hpp
@@ -32,7 +33,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     auto deets = minimal_array::validate(handle, version, options);
 
     if (!options.details_only) {
-        auto fhandle = ritsuko::hdf5::open_dataset(handle, "file");
+        auto fhandle = internal_profile::open_dataset(handle, "file");
         if (!ritsuko::hdf5::is_scalar(fhandle)) {
             throw std::runtime_error("'file' should be a scalar");
         }
@@ -40,7 +41,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             throw std::runtime_error("'file' should have a datatype that can be represented by a UTF-8 encoded string");
         }
 
-        auto nhandle = ritsuko::hdf5::open_dataset(handle, "name");
+        auto nhandle = internal_profile::open_dataset(handle, "name");
         if (!ritsuko::hdf5::is_scalar(nhandle)) {
             throw std::runtime_error("'name' should be a scalar");
         }
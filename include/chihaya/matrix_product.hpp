@@ -27,9 +27,8 @@ namespace matrix_product {
  */
 namespace internal {
 
-inline std::pair<ArrayDetails, bool> fetch_seed(const H5::Group& handle, const std::string& target, const std::string& orientation, const ritsuko::Version& version, Options& options) {
+inline std::pair<ArrayDetails, bool> fetch_seed(const H5::Group& handle, ArrayDetails seed_details, const std::string& target, const std::string& orientation) {
     // Checking the seed.
-    auto seed_details = internal_misc::load_seed_details(handle, target, version, options);
     if (seed_details.dimensions.size() != 2) {
         throw std::runtime_error("expected '" + target + "' to be a 2-dimensional array for a matrix product");
     }
@@ -60,8 +59,9 @@ inline std::pair<ArrayDetails, bool> fetch_seed(const H5::Group& handle, const s
  * Otherwise, if the validation failed, an error is raised.
  */
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
-    auto left_details = internal::fetch_seed(handle, "left_seed", "left_orientation", version, options);
-    auto right_details = internal::fetch_seed(handle, "right_seed", "right_orientation", version, options);
+    internal_misc::DeferredSeeds seeds(handle, { "left_seed", "right_seed" }, "", version, options);
+    auto left_details = internal::fetch_seed(handle, seeds.get(0), "left_seed", "left_orientation");
+    auto right_details = internal::fetch_seed(handle, seeds.get(1), "right_seed", "right_orientation");
 
     ArrayDetails output;
     output.dimensions.resize(2);
@@ -11,13 +11,14 @@
 #include <algorithm>
 
 #include "utils_misc.hpp"
+#include "utils_profile.hpp"
 
 namespace chihaya {
 
 namespace minimal_array {
 
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, [[maybe_unused]] Options& options) {
-    auto dhandle = ritsuko::hdf5::open_dataset(handle, "dimensions");
+    auto dhandle = internal_profile::open_dataset(handle, "dimensions");
     auto len = ritsuko::hdf5::get_1d_length(dhandle, false);
     std::vector<uint64_t> dimensions(len);
 
@@ -27,6 +28,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         }
         std::vector<int64_t> dimensions_tmp(len);
         dhandle.read(dimensions_tmp.data(), H5::PredType::NATIVE_INT64);
+        internal_profile::record_read<int64_t>(len);
         for (auto d : dimensions_tmp) {
             if (d < 0) {
                 throw std::runtime_error("elements in 'dimensions' should be non-negative");
@@ -38,6 +40,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             throw std::runtime_error("datatype of 'dimensions' should fit in a 64-bit unsigned integer");
         }
         dhandle.read(dimensions.data(), H5::PredType::NATIVE_UINT64);
+        internal_profile::record_read<uint64_t>(len);
     }
 
     ArrayType atype;
@@ -0,0 +1,396 @@
+#ifndef CHIHAYA_PROFILE_HPP
+#define CHIHAYA_PROFILE_HPP
+
+#include "H5Cpp.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+#include "utils_public.hpp"
+
+/**
+ * @file profile.hpp
+ * @brief Collect per-node statistics during validation.
+ */
+
+namespace chihaya {
+
+/**
+ * @brief Collector of per-node validation statistics.
+ *
+ * After calling `attach()` on an `Options` object, each node validated with that `Options` will be recorded by the `Profiler`.
+ * The collected statistics can then be exported as a nested JSON report with `to_json()`,
+ * or as folded stacks with `to_folded()` for use with flame graph tools.
+ * Nodes are nested according to the parent whose validation required them, see `NodeStatistics::parent`,
+ * so separate calls to `validate()` with the same `Options` are reported as separate trees.
+ * A node that is shared between multiple parents (e.g., via hard links) and only validated once due to `Options::deduplicate` is reported under the parent that validated it.
+ *
+ * All methods are thread-safe, so the collected statistics can be inspected while a validation is still in progress;
+ * in such cases, nodes that have not yet finished are not reported and their children are treated as roots.
+ */
+class Profiler {
+public:
+    /**
+     * @brief Statistics for a single node.
+     */
+    struct Entry {
+        /**
+         * Name of the file containing the node.
+         */
+        std::string file;
+
+        /**
+         * Path to the node's group inside the file.
+         */
+        std::string path;
+
+        /**
+         * Array or operation type of the node, possibly empty if it could not be determined.
+         */
+        std::string type;
+
+        /**
+         * Statistics for this node.
+         */
+        NodeStatistics statistics;
+    };
+
+    /**
+     * @brief Aggregated statistics for all nodes of a single type.
+     */
+    struct TypeSummary {
+        /**
+         * Number of nodes of this type.
+         */
+        size_t count = 0;
+
+        /**
+         * Total wall time for nodes of this type, including their children.
+         */
+        double seconds = 0;
+
+        /**
+         * Total wall time for nodes of this type, excluding time spent in their children.
+         */
+        double self_seconds = 0;
+
+        /**
+         * Total number of datasets opened by nodes of this type.
+         */
+        uint64_t datasets_opened = 0;
+
+        /**
+         * Total number of elements read by nodes of this type.
+         */
+        uint64_t elements_read = 0;
+
+        /**
+         * Total number of bytes read by nodes of this type.
+         */
+        uint64_t bytes_read = 0;
+
+        /**
+         * Total time spent reading blocks of datasets for nodes of this type.
+         */
+        double read_seconds = 0;
+
+        /**
+         * Total time spent waiting for blocks of datasets to be read for nodes of this type.
+         */
+        double wait_seconds = 0;
+    };
+
+public:
+    /**
+     * Set `options.exit_callback` so that all nodes are recorded by this `Profiler`.
+     * The `Profiler` should outlive any `validate()` calls with `options`.
+     *
+     * @param options Validation options.
+     */
+    void attach(Options& options) {
+        options.exit_callback = [this](const H5::Group& handle, const std::string& type, const NodeStatistics& stats) -> void {
+            Entry current;
+            current.file = handle.getFileName();
+            current.path = handle.getObjName();
+            current.type = type;
+            current.statistics = stats;
+            std::lock_guard<std::mutex> lck(mut);
+            collected.push_back(std::move(current));
+        };
+    }
+
+    /**
+     * @return Copy of all recorded entries, in the order in which their validation finished.
+     */
+    std::vector<Entry> entries() const {
+        std::lock_guard<std::mutex> lck(mut);
+        return collected;
+    }
+
+    /**
+     * Remove all recorded entries.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lck(mut);
+        collected.clear();
+    }
+
+    /**
+     * @return Statistics aggregated by node type.
+     */
+    std::map<std::string, TypeSummary> summarize() const {
+        return summarize(entries());
+    }
+
+    /**
+     * The report is a JSON object with the same layout as a node in the `d3-flame-graph` format, i.e., with `name`, `value` and `children` properties.
+     * The root node is named `"validate"` and its children are the top-level nodes from each call to `validate()`.
+     * Each node's `value` is its wall time in microseconds, and additional properties contain the other statistics.
+     * The root also contains a `types` property with the statistics aggregated by node type, see `summarize()`.
+     *
+     * @return JSON-formatted report.
+     */
+    std::string to_json() const {
+        auto snapshot = entries();
+        auto tree = build_tree(snapshot);
+        std::string output = "{\"name\":\"validate\",\"value\":";
+
+        double total = 0;
+        for (auto r : tree.roots) {
+            total += snapshot[r].statistics.seconds;
+        }
+        output += std::to_string(to_microseconds(total));
+
+        output += ",\"children\":[";
+        for (size_t r = 0, end = tree.roots.size(); r < end; ++r) {
+            if (r) {
+                output += ",";
+            }
+            append_json(snapshot, tree, tree.roots[r], output);
+        }
+        output += "],\"types\":{";
+
+        bool first = true;
+        for (const auto& s : summarize(snapshot)) {
+            if (!first) {
+                output += ",";
+            }
+            first = false;
+            append_string(s.first, output);
+            output += ":{\"count\":" + std::to_string(s.second.count);
+            output += ",\"seconds\":" + std::to_string(s.second.seconds);
+            output += ",\"self_seconds\":" + std::to_string(s.second.self_seconds);
+            output += ",\"datasets_opened\":" + std::to_string(s.second.datasets_opened);
+            output += ",\"elements_read\":" + std::to_string(s.second.elements_read);
+            output += ",\"bytes_read\":" + std::to_string(s.second.bytes_read);
+            output += ",\"read_seconds\":" + std::to_string(s.second.read_seconds);
+            output += ",\"wait_seconds\":" + std::to_string(s.second.wait_seconds);
+            output += "}";
+        }
+
+        output += "}}";
+        return output;
+    }
+
+    /**
+     * Each line contains a semicolon-separated stack of frames followed by the self time of the last frame, in microseconds.
+     * Each frame is named after the node's path relative to its parent, along with the node type in parentheses.
+     * This can be directly used by `flamegraph.pl` and similar tools.
+     *
+     * @return Folded stacks for all recorded nodes.
+     */
+    std::string to_folded() const {
+        auto snapshot = entries();
+        auto tree = build_tree(snapshot);
+        std::string output;
+        std::vector<std::string> stack;
+        for (auto r : tree.roots) {
+            append_folded(snapshot, tree, r, stack, output);
+        }
+        return output;
+    }
+
+private:
+    std::vector<Entry> collected;
+    mutable std::mutex mut;
+
+    struct Tree {
+        std::vector<size_t> roots;
+        std::vector<size_t> parents;
+        std::vector<std::vector<size_t> > children;
+    };
+
+    static int64_t to_microseconds(double seconds) {
+        return static_cast<int64_t>(seconds * 1000000);
+    }
+
+    static bool is_child_path(const std::string& parent, const std::string& child) {
+        if (parent == "/") {
+            return child.size() > 1 && child[0] == '/';
+        }
+        return child.size() > parent.size() && child.compare(0, parent.size(), parent) == 0 && child[parent.size()] == '/';
+    }
+
+    static bool path_less(const Entry& left, const Entry& right) {
+        if (left.file != right.file) {
+            return left.file < right.file;
+        }
+        // '/' is treated as the lowest character so that "/a/b" comes before "/a-b".
+        return std::lexicographical_compare(left.path.begin(), left.path.end(), right.path.begin(), right.path.end(), [](char l, char r) -> bool {
+            return (l == '/' ? 0 : static_cast<unsigned char>(l)) < (r == '/' ? 0 : static_cast<unsigned char>(r));
+        });
+    }
+
+    static Tree build_tree(const std::vector<Entry>& entries) {
+        size_t n = entries.size();
+        std::unordered_map<uint64_t, size_t> by_id;
+        by_id.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            by_id[entries[i].statistics.id] = i;
+        }
+
+        // Roots are reported in the order in which they finished, i.e., the order of the top-level validate() calls.
+        Tree tree;
+        tree.parents.resize(n, n);
+        tree.children.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& stats = entries[i].statistics;
+            auto it = (stats.parent ? by_id.find(stats.parent) : by_id.end());
+            if (it == by_id.end() || it->second == i) {
+                tree.roots.push_back(i);
+            } else {
+                tree.parents[i] = it->second;
+                tree.children[it->second].push_back(i);
+            }
+        }
+
+        // Sorting children by their paths, as their finishing order depends on the scheduling of the threads.
+        for (auto& children : tree.children) {
+            std::stable_sort(children.begin(), children.end(), [&](size_t left, size_t right) -> bool {
+                return path_less(entries[left], entries[right]);
+            });
+        }
+
+        return tree;
+    }
+
+    static std::map<std::string, TypeSummary> summarize(const std::vector<Entry>& entries) {
+        auto tree = build_tree(entries);
+        std::map<std::string, TypeSummary> output;
+        for (size_t i = 0, end = entries.size(); i < end; ++i) {
+            const auto& entry = entries[i];
+            auto& current = output[entry.type];
+            ++current.count;
+            current.seconds += entry.statistics.seconds;
+            current.self_seconds += self_seconds(entries, tree, i);
+            current.datasets_opened += entry.statistics.datasets_opened;
+            current.elements_read += entry.statistics.elements_read;
+            current.bytes_read += entry.statistics.bytes_read;
+            current.read_seconds += entry.statistics.read_seconds;
+            current.wait_seconds += entry.statistics.wait_seconds;
+        }
+        return output;
+    }
+
+    static double self_seconds(const std::vector<Entry>& entries, const Tree& tree, size_t i) {
+        double output = entries[i].statistics.seconds;
+        for (auto c : tree.children[i]) {
+            output -= entries[c].statistics.seconds;
+        }
+        return std::max(output, 0.0); // children may be validated concurrently.
+    }
+
+    static std::string frame_name(const std::vector<Entry>& entries, const Tree& tree, size_t i) {
+        const auto& entry = entries[i];
+        std::string name = entry.path;
+        auto parent = tree.parents[i];
+        if (parent < entries.size()) {
+            // Children that were reached via links elsewhere in the file are reported with their full paths.
+            const auto& pentry = entries[parent];
+            if (pentry.file == entry.file && is_child_path(pentry.path, entry.path)) {
+                name = name.substr(pentry.path == "/" ? 1 : pentry.path.size() + 1);
+            }
+        }
+        if (!entry.type.empty()) {
+            name += " (" + entry.type + ")";
+        }
+        return name;
+    }
+
+    static void append_string(const std::string& x, std::string& output) {
+        output += '"';
+        for (char c : x) {
+            switch (c) {
+                case '"': output += "\\\""; break;
+                case '\\': output += "\\\\"; break;
+                case '\n': output += "\\n"; break;
+                case '\t': output += "\\t"; break;
+                case '\r': output += "\\r"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        const char* hex = "0123456789abcdef";
+                        output += "\\u00";
+                        output += hex[(c >> 4) & 0xf];
+                        output += hex[c & 0xf];
+                    } else {
+                        output += c;
+                    }
+            }
+        }
+        output += '"';
+    }
+
+    static void append_json(const std::vector<Entry>& entries, const Tree& tree, size_t i, std::string& output) {
+        const auto& entry = entries[i];
+        const auto& stats = entry.statistics;
+        output += "{\"name\":";
+        append_string(entry.path, output);
+        output += ",\"type\":";
+        append_string(entry.type, output);
+        output += ",\"file\":";
+        append_string(entry.file, output);
+        output += ",\"value\":" + std::to_string(to_microseconds(stats.seconds));
+        output += ",\"seconds\":" + std::to_string(stats.seconds);
+        output += ",\"self_seconds\":" + std::to_string(self_seconds(entries, tree, i));
+        output += ",\"datasets_opened\":" + std::to_string(stats.datasets_opened);
+        output += ",\"elements_read\":" + std::to_string(stats.elements_read);
+        output += ",\"bytes_read\":" + std::to_string(stats.bytes_read);
+        output += ",\"read_seconds\":" + std::to_string(stats.read_seconds);
+        output += ",\"wait_seconds\":" + std::to_string(stats.wait_seconds);
+        output += ",\"failed\":" + std::string(stats.failed ? "true" : "false");
+        output += ",\"children\":[";
+        const auto& children = tree.children[i];
+        for (size_t c = 0, end = children.size(); c < end; ++c) {
+            if (c) {
+                output += ",";
+            }
+            append_json(entries, tree, children[c], output);
+        }
+        output += "]}";
+    }
+
+    static void append_folded(const std::vector<Entry>& entries, const Tree& tree, size_t i, std::vector<std::string>& stack, std::string& output) {
+        stack.push_back(frame_name(entries, tree, i));
+        for (size_t s = 0, end = stack.size(); s < end; ++s) {
+            if (s) {
+                output += ';';
+            }
+            output += stack[s];
+        }
+        output += ' ' + std::to_string(to_microseconds(self_seconds(entries, tree, i))) + '\n';
+
+        for (auto c : tree.children[i]) {
+            append_folded(entries, tree, c, stack, output);
+        }
+        stack.pop_back();
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef CHIHAYA_REALIZE_HPP
+#define CHIHAYA_REALIZE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+
+#include "realize_array.hpp"
+#include "realize_arrays.hpp"
+#include "realize_operations.hpp"
+#include "realize_elementwise.hpp"
+#include "realize_matrix_product.hpp"
+#include "realize_multiply.hpp"
+#include "realize_rewrite.hpp"
+#include "utils_realize.hpp"
+#include "validate.hpp"
+
+/**
+ * @file realize.hpp
+ * @brief Realize delayed arrays into memory.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @cond
+ */
+namespace internal {
+
+typedef std::function<std::unique_ptr<Array>(const H5::Group&, const ritsuko::Version&, Options&)> LoadFunction;
+
+inline auto default_operation_registry() {
+    std::unordered_map<std::string, LoadFunction> registry;
+    registry["subset"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_subset(h, v, o); };
+    registry["combine"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new Combine(h, v, o)); };
+    registry["transpose"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_transpose(h, v, o); };
+    registry["dimnames"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return internal_realize::load_seed(h, "seed", v, o); };
+    registry["subset assignment"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new SubsetAssignment(h, v, o)); };
+    registry["unary arithmetic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_scalar_operation(h, v, o, "arithmetic"); };
+    registry["unary comparison"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_scalar_operation(h, v, o, "comparison"); };
+    registry["unary logic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_scalar_operation(h, v, o, "logic"); };
+    registry["unary math"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_unary_math(h, v, o); };
+    registry["unary special check"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_unary_special_check(h, v, o); };
+    registry["binary arithmetic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_binary_operation(h, v, o, "arithmetic"); };
+    registry["binary comparison"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_binary_operation(h, v, o, "comparison"); };
+    registry["binary logic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return load_binary_operation(h, v, o, "logic"); };
+    registry["matrix product"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new MatrixProduct(h, v, o)); };
+    return registry;
+}
+
+inline auto default_array_registry() {
+    std::unordered_map<std::string, LoadFunction> registry;
+    registry["dense array"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new DenseArray(h, v, o)); };
+    registry["sparse matrix"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new SparseMatrix(h, v, o)); };
+    registry["constant array"] = [](const H5::Group& h, const ritsuko::Version& v, Options&) -> std::unique_ptr<Array> { return std::unique_ptr<Array>(new ConstantArray(h, v)); };
+    return registry;
+}
+
+inline std::unique_ptr<Array> dispatch(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto dtype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type");
+
+    if (dtype == "array") {
+        auto atype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_array");
+        const LoadFunction* fun = nullptr;
+
+        const auto& custom = options.array_registry;
+        auto cit = custom.find(atype);
+        if (cit != custom.end()) {
+            fun = &(cit->second);
+        } else {
+            static const auto global = internal::default_array_registry();
+            auto git = global.find(atype);
+            if (git == global.end()) {
+                throw std::runtime_error("no function available to load delayed array of type '" + atype + "'");
+            }
+            fun = &(git->second);
+        }
+
+        try {
+            return (*fun)(handle, version, options);
+        } catch (std::exception& e) {
+            throw std::runtime_error("failed to load delayed array of type '" + atype + "'; " + std::string(e.what()));
+        }
+
+    } else if (dtype == "operation") {
+        auto otype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_operation");
+        const LoadFunction* fun = nullptr;
+
+        const auto& custom = options.operation_registry;
+        auto cit = custom.find(otype);
+        if (cit != custom.end()) {
+            fun = &(cit->second);
+        } else {
+            static const auto global = internal::default_operation_registry();
+            auto git = global.find(otype);
+            if (git == global.end()) {
+                throw std::runtime_error("no function available to load delayed operation of type '" + otype + "'");
+            }
+            fun = &(git->second);
+        }
+
+        try {
+            return (*fun)(handle, version, options);
+        } catch (std::exception& e) {
+            throw std::runtime_error("failed to load delayed operation of type '" + otype + "'; " + std::string(e.what()));
+        }
+    }
+
+    throw std::runtime_error("unknown delayed type '" + dtype + "'");
+}
+
+struct DepthTracker {
+    DepthTracker(Options& options) : options(options) {
+        ++options.depth;
+    }
+    ~DepthTracker() {
+        --options.depth;
+    }
+    Options& options;
+};
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Load a delayed operation/array into a realizable `Array`.
+ * For operations, this function will first search `options.operation_registry` for an available loading function.
+ * For arrays, this function will first search `options.array_registry` for an available loading function.
+ *
+ * If `options.validate = true`, the entire tree is validated with `chihaya::validate()` before it is loaded.
+ * This is only performed once at the top-level call, not for the recursive calls on each child.
+ * Arrays of strings cannot be realized, nor can custom or external arrays unless a loading function is supplied in `options.array_registry`.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param version Version of the **chihaya** specification.
+ * @param options Realization options, possibly containing custom loading functions.
+ *
+ * @return Pointer to a realizable array.
+ */
+inline std::unique_ptr<Array> load(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    if (options.depth == 0 && options.validate) {
+        ::chihaya::validate(handle, version, options.validation);
+    }
+    internal::DepthTracker tracker(options);
+    return internal::dispatch(handle, version, options);
+}
+
+/**
+ * Load a delayed operation/array, where the version is taken from the `delayed_version` attribute of the `handle`.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param options Realization options, see `load()` for details.
+ * @return Pointer to a realizable array.
+ */
+inline std::unique_ptr<Array> load(const H5::Group& handle, Options& options) {
+    return load(handle, extract_version(handle), options);
+}
+
+/**
+ * Load a delayed operation/array from the specified HDF5 group.
+ * The file remains open for as long as the returned array exists.
+ *
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ * @param options Realization options, see `load()` for details.
+ *
+ * @return Pointer to a realizable array.
+ */
+inline std::unique_ptr<Array> load(const std::string& path, const std::string& name, Options& options) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto ghandle = handle.openGroup(name);
+    return load(ghandle, options);
+}
+
+/**
+ * Realize a rectangular block of an array into a caller-supplied buffer.
+ * The block is split into contiguous sub-blocks, each of which is realized directly into the buffer;
+ * the size of each sub-block is chosen so that the workspace of the array does not exceed `options.memory_budget`.
+ *
+ * @param array An array created by `load()`.
+ * @param start Start of the block in each dimension.
+ * @param count Extent of the block in each dimension.
+ * @param[out] buffer Pointer to an array of length equal to the product of `count`.
+ * On output, this is filled with the contents of the block in row-major order.
+ * @param options Realization options.
+ */
+inline void extract(const Array& array, const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer, const Options& options) {
+    const auto& dims = array.dimensions();
+    if (start.size() != dims.size() || count.size() != dims.size()) {
+        throw std::runtime_error("'start' and 'count' should have length equal to the number of dimensions");
+    }
+    for (size_t d = 0; d < dims.size(); ++d) {
+        if (start[d] > dims[d] || count[d] > dims[d] - start[d]) {
+            throw std::runtime_error("requested block is out of range for dimension " + std::to_string(d));
+        }
+    }
+
+    auto max_elements = internal_realize::max_block_elements(array, options.memory_budget);
+    internal_realize::split_block(start, count, max_elements, [&](const std::vector<size_t>& sub_start, const std::vector<size_t>& sub_count, size_t offset) -> void {
+        array.extract(sub_start, sub_count, buffer + offset);
+    });
+}
+
+/**
+ * Realize a rectangular block of a 2-dimensional array in compressed sparse form.
+ * If `Array::sparse()` is true, the sparsity of the seeds is preserved throughout the tree, i.e., only the structural non-zeros are ever computed.
+ * Otherwise, the block is realized in dense form and then compressed, in which case callers should consider using `extract()` instead.
+ *
+ * @param array An array created by `load()`.
+ * @param start Start of the block in each dimension.
+ * @param count Extent of the block in each dimension.
+ * @param by_column Whether to return the block in compressed sparse column form, otherwise compressed sparse row form is used.
+ *
+ * @return Contents of the block in compressed sparse form.
+ */
+inline SparseBlock extract_sparse(const Array& array, const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column) {
+    const auto& dims = array.dimensions();
+    if (dims.size() != 2) {
+        throw std::runtime_error("sparse extraction is only supported for 2-dimensional arrays");
+    }
+    if (start.size() != 2 || count.size() != 2) {
+        throw std::runtime_error("'start' and 'count' should have length equal to the number of dimensions");
+    }
+    for (size_t d = 0; d < 2; ++d) {
+        if (start[d] > dims[d] || count[d] > dims[d] - start[d]) {
+            throw std::runtime_error("requested block is out of range for dimension " + std::to_string(d));
+        }
+    }
+
+    SparseBlock output;
+    array.extract_sparse(start, count, by_column, output);
+    return output;
+}
+
+/**
+ * Map a rectangular block of an array to the regions of the leaf arrays that would be read to realize it, see `Array::regions()` for details.
+ * No data is read from the file.
+ * This is useful for checking that random access only touches the relevant parts of each leaf, or for scheduling reads ahead of the realization.
+ *
+ * @param array An array created by `load()`.
+ * @param start Start of the block in each dimension.
+ * @param count Extent of the block in each dimension.
+ *
+ * @return Regions of the leaf arrays, in the order in which they are read by `Array::extract()`.
+ * The same leaf may be reported multiple times, e.g., for non-contiguous subsets.
+ */
+inline std::vector<Region> regions(const Array& array, const std::vector<size_t>& start, const std::vector<size_t>& count) {
+    const auto& dims = array.dimensions();
+    if (start.size() != dims.size() || count.size() != dims.size()) {
+        throw std::runtime_error("'start' and 'count' should have length equal to the number of dimensions");
+    }
+    for (size_t d = 0; d < dims.size(); ++d) {
+        if (start[d] > dims[d] || count[d] > dims[d] - start[d]) {
+            throw std::runtime_error("requested block is out of range for dimension " + std::to_string(d));
+        }
+    }
+
+    std::vector<Region> output;
+    array.regions(start, count, output);
+    return output;
+}
+
+/**
+ * Iterate over the entire array in contiguous blocks, where the size of each block respects `options.memory_budget`.
+ * This allows callers to process large arrays without realizing them in their entirety.
+ *
+ * @tparam Function_ Function to be called on each block.
+ * @param array An array created by `load()`.
+ * @param options Realization options.
+ * @param fun Function to be called on each block.
+ * This should accept the start and extent of the block in each dimension (both as `const std::vector<size_t>&`)
+ * and a `const double*` pointer to the realized values of the block in row-major order.
+ * Blocks are visited in row-major order.
+ */
+template<class Function_>
+void for_each_block(const Array& array, const Options& options, Function_ fun) {
+    const auto& dims = array.dimensions();
+    std::vector<size_t> start(dims.size());
+    auto max_elements = internal_realize::max_block_elements(array, options.memory_budget);
+
+    std::vector<double> buffer;
+    internal_realize::split_block(start, dims, max_elements, [&](const std::vector<size_t>& sub_start, const std::vector<size_t>& sub_count, size_t) -> void {
+        buffer.resize(internal_realize::product(sub_count));
+        array.extract(sub_start, sub_count, buffer.data());
+        fun(sub_start, sub_count, static_cast<const double*>(buffer.data()));
+    });
+}
+
+}
+
+}
+
+#endif
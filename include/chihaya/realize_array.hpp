@@ -0,0 +1,352 @@
+#ifndef CHIHAYA_REALIZE_ARRAY_HPP
+#define CHIHAYA_REALIZE_ARRAY_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include "utils_public.hpp"
+
+/**
+ * @file realize_array.hpp
+ * @brief Base class for realizable arrays.
+ */
+
+namespace chihaya {
+
+/**
+ * @namespace chihaya::realize
+ * @brief Namespace for realizing delayed arrays into memory.
+ */
+namespace realize {
+
+/**
+ * @brief Block of a matrix in compressed sparse form.
+ *
+ * If `by_column = true`, this is a compressed sparse column (CSC) block where the columns are the primary dimension;
+ * otherwise, it is a compressed sparse row (CSR) block where the rows are the primary dimension.
+ * Structural non-zeros for primary element `i` are stored in `indices` and `values` from `pointers[i]` to `pointers[i + 1]`,
+ * where each index is the position along the secondary dimension, relative to the start of the block.
+ * Indices are strictly increasing within each primary element.
+ */
+struct SparseBlock {
+    /**
+     * Whether the columns are the primary dimension.
+     */
+    bool by_column = true;
+
+    /**
+     * Pointers to the start of each primary element in `indices` and `values`, of length equal to the primary extent of the block plus 1.
+     */
+    std::vector<size_t> pointers;
+
+    /**
+     * Secondary indices of the structural non-zeros.
+     */
+    std::vector<size_t> indices;
+
+    /**
+     * Values of the structural non-zeros.
+     * These may still be zero, e.g., if a zero is explicitly stored in a sparse matrix.
+     */
+    std::vector<double> values;
+};
+
+class Array;
+
+/**
+ * @brief Rectangular region of a leaf array.
+ *
+ * This is reported by `Array::regions()` to describe the hyperslabs that are read from each leaf when realizing a block.
+ */
+struct Region {
+    /**
+     * Pointer to the leaf array.
+     */
+    const Array* leaf = nullptr;
+
+    /**
+     * Start of the region in each dimension of the leaf.
+     */
+    std::vector<size_t> start;
+
+    /**
+     * Extent of the region in each dimension of the leaf.
+     */
+    std::vector<size_t> count;
+};
+
+/**
+ * @brief Realizable array.
+ *
+ * This is an in-memory representation of a delayed operation or array, constructed by `realize::load()`.
+ * Each instance holds the parameters of its node (e.g., subsetting indices, arithmetic values) and owns the instances for its children.
+ * Arrays may then be used to realize any rectangular block of the delayed array into a caller-supplied buffer.
+ *
+ * All values are realized as doubles, regardless of the `ArrayType`.
+ * Booleans are realized as 0 or 1, and missing values are realized as R's `NA_real_`, i.e., a NaN with a payload of 1954; see `is_missing()`.
+ * Blocks are stored in row-major order, i.e., the last dimension is the fastest-changing.
+ */
+class Array {
+public:
+    /**
+     * @param details Type and dimensions of the array.
+     */
+    Array(ArrayDetails details) : array_details(std::move(details)) {}
+
+    /**
+     * @cond
+     */
+    virtual ~Array() = default;
+    Array(const Array&) = delete;
+    Array& operator=(const Array&) = delete;
+    /**
+     * @endcond
+     */
+
+    /**
+     * @return Type and dimensions of the array.
+     */
+    const ArrayDetails& details() const {
+        return array_details;
+    }
+
+    /**
+     * @return Extent of each dimension.
+     */
+    const std::vector<size_t>& dimensions() const {
+        return array_details.dimensions;
+    }
+
+    /**
+     * Realize a rectangular block of the array.
+     * This should be thread-safe, i.e., multiple threads may extract blocks from the same instance concurrently.
+     *
+     * @param start Start of the block in each dimension.
+     * @param count Extent of the block in each dimension.
+     * Each `start[i] + count[i]` should be no greater than `dimensions()[i]`.
+     * @param[out] buffer Pointer to an array of length equal to the product of `count`.
+     * On output, this is filled with the contents of the block in row-major order.
+     */
+    virtual void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const = 0;
+
+    /**
+     * @return Number of additional buffers, each of the same size as the requested block, that are allocated by `extract()` on this array and its children.
+     * This is used to choose a block size that respects the memory budget in `realize::extract()` and `realize::for_each_block()`.
+     */
+    virtual size_t workspace() const {
+        return 0;
+    }
+
+    /**
+     * Whether this array is a sparse matrix that can be efficiently extracted with `extract_sparse()`.
+     * This is true for sparse matrices and for any operation that maps zero to zero when applied to sparse seeds,
+     * e.g., subsetting, transposition, combining, or multiplication by a scalar.
+     * It is determined statically when the array is constructed, without inspecting the values in the file.
+     *
+     * @return Whether the array is sparse.
+     */
+    virtual bool sparse() const {
+        return false;
+    }
+
+    /**
+     * Preferred orientation for `extract_sparse()`, typically the orientation in which the underlying sparse matrix is stored.
+     * Callers iterating over the entire matrix should request blocks in this orientation to avoid repeated reads of the same data.
+     * This is only meaningful if `sparse()` is true.
+     *
+     * @return Whether CSC blocks are preferred, otherwise CSR blocks are preferred.
+     */
+    virtual bool sparse_by_column() const {
+        return true;
+    }
+
+    /**
+     * Realize a rectangular block of a 2-dimensional array in compressed sparse form.
+     * If `sparse()` is true, only the structural non-zeros are ever computed, i.e., the block is never densified.
+     * Otherwise, this falls back to extracting a dense block with `extract()` and compressing it.
+     * This should be thread-safe.
+     *
+     * @param start Start of the block in each dimension.
+     * @param count Extent of the block in each dimension.
+     * @param by_column Whether to return the block in CSC form, otherwise CSR form is used.
+     * @param[out] output On output, the contents of the block in compressed sparse form.
+     */
+    virtual void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        size_t nr = count[0], nc = count[1];
+        std::vector<double> dense(nr * nc);
+        extract(start, count, dense.data());
+
+        size_t np = (by_column ? nc : nr), ns = (by_column ? nr : nc);
+        size_t pstride = (by_column ? 1 : nc), sstride = (by_column ? nc : 1);
+        output.by_column = by_column;
+        output.pointers.assign(1, 0);
+        output.indices.clear();
+        output.values.clear();
+        for (size_t p = 0; p < np; ++p) {
+            for (size_t s = 0; s < ns; ++s) {
+                double x = dense[p * pstride + s * sstride];
+                if (x != 0) {
+                    output.indices.push_back(s);
+                    output.values.push_back(x);
+                }
+            }
+            output.pointers.push_back(output.indices.size());
+        }
+    }
+
+    /**
+     * Propagate a requested block down the tree to the regions of the leaf arrays that are read by `extract()`.
+     * Each operation maps the block into the coordinates of its children, e.g., subsets are mapped to runs of the subset indices, transpositions are mapped by permuting the dimensions,
+     * and combining is mapped to the overlapping ranges of each seed.
+     * This can be used to predict the I/O cost of random access, which should be proportional to the size of the requested block rather than the size of the leaves.
+     *
+     * By default, the array is treated as a leaf and the block itself is reported.
+     * Operations should override this method to forward the mapped blocks to their children.
+     *
+     * @param start Start of the block in each dimension.
+     * @param count Extent of the block in each dimension.
+     * @param[out] output Vector of regions, to which the leaf regions for this block are appended.
+     */
+    virtual void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        output.push_back(Region{ this, start, count });
+    }
+
+private:
+    ArrayDetails array_details;
+};
+
+/**
+ * @brief Options for realization.
+ */
+struct Options {
+    /**
+     * Whether to validate the tree with `chihaya::validate()` before loading.
+     * If false, the tree is assumed to be valid.
+     */
+    bool validate = true;
+
+    /**
+     * Options for validation, only used if `validate = true`.
+     */
+    ::chihaya::Options validation;
+
+    /**
+     * Memory budget, in bytes, for the realization of each block.
+     * This is used by `realize::extract()` and `realize::for_each_block()` to split requests into smaller blocks, accounting for the workspace of each array;
+     * and by the leaf arrays to limit the size of their read buffers, e.g., for the indices of a sparse matrix.
+     */
+    size_t memory_budget = 100000000;
+
+    /**
+     * Whether to fuse chains of unary elementwise operations into a single `FusedOperation`.
+     * This applies all operations in the chain to each cache-sized tile of a block before moving onto the next tile.
+     * If false, each operation is realized by a separate `ScalarOperation` or `UnaryOperation`.
+     */
+    bool fuse_elementwise = true;
+
+    /**
+     * Whether unary math operations should give identical results to the standard library.
+     * By default, the vectorized kernels for `EXP`, `EXPM1`, `LOG`, `LOG1P` and the trigonometric and hyperbolic functions (see `UnaryMethod`) use polynomial approximations.
+     * These are within 3 ULPs of the standard library on both AVX2 and AVX-512, e.g., up to 2 ULPs for `EXP` and 1 ULP for `LOG` with the natural base.
+     * Results may also differ by an ULP between CPUs, as the AVX-512 kernels can use fused multiply-add instructions.
+     * If true, only the exact kernels (`ABS`, `SIGN`, `SQRT`, `CEILING`, `FLOOR`, `TRUNC`, `ROUND` and `SIGNIF`) are used, and all other methods are computed with the standard library.
+     */
+    bool exact_math = false;
+
+    /**
+     * Whether to rewrite subsets so that they are applied before any elementwise operations in their seeds, e.g., `subset(log1p(x / sf))` is realized as `log1p(subset(x) / sf)`.
+     * Any vector of values used by an operation (like `sf`) is subsetted accordingly, and consecutive subsets are composed into a single subset.
+     * This ensures that the operations are only applied to the retained elements.
+     * If false, each subset is realized by a separate `Subset` on its seed.
+     */
+    bool rewrite_subsets = true;
+
+    /**
+     * Whether to rewrite transpositions so that they are applied before any elementwise operations in their seeds.
+     * Consecutive transpositions are composed into a single permutation (which is dropped if it is the identity),
+     * and transpositions of dense arrays are folded into the layout of the dataset, along with any non-native layout.
+     * This avoids repeated rearrangement of each block, such that a physical transposition is only performed once at the leaf or at the first node that cannot absorb it.
+     * If false, each transposition is realized by a separate `Transpose` on its seed.
+     */
+    bool rewrite_transpositions = true;
+
+    /**
+     * Number of threads to use for computationally intensive operations, e.g., matrix products.
+     * Reads from the HDF5 file are always serialized.
+     */
+    int num_threads = 1;
+
+    /**
+     * Whether to memory-map contiguous, unfiltered datasets of native-endian numbers in the leaf arrays, i.e., the `data` of dense arrays and the `indices` and `data` of sparse matrices.
+     * Blocks are then copied directly from the mapped file rather than being read through HDF5.
+     * See `chihaya::Options::memory_map` for the conditions under which a dataset can be mapped.
+     */
+    bool memory_map = true;
+
+    /**
+     * Whether to read the next window of the `indices` and `data` of a sparse matrix in a background thread while the current window is being processed.
+     * This overlaps the I/O with the computation at the cost of an extra pair of buffers, so each window is half the size that it would otherwise be.
+     */
+    bool prefetch = true;
+
+    /**
+     * Custom registry of functions to be used by `realize::load()` on arrays.
+     * If a function is provided for an array type, it is used instead of the default function.
+     * This is required for custom arrays, as these cannot be realized by **chihaya** itself.
+     */
+    std::unordered_map<std::string, std::function<std::unique_ptr<Array>(const H5::Group&, const ritsuko::Version&, Options&)> > array_registry;
+
+    /**
+     * Custom registry of functions to be used by `realize::load()` on operations.
+     * If a function is provided for an operation type, it is used instead of the default function.
+     */
+    std::unordered_map<std::string, std::function<std::unique_ptr<Array>(const H5::Group&, const ritsuko::Version&, Options&)> > operation_registry;
+
+    /**
+     * @cond
+     */
+    // Current depth of the recursive load() calls, used to detect a new top-level call.
+    size_t depth = 0;
+    /**
+     * @endcond
+     */
+};
+
+/**
+ * @return R's `NA_real_`, used to represent missing values in realized blocks.
+ */
+inline double missing_value() {
+    uint64_t bits = 0x7FF00000000007A2ull;
+    double output;
+    std::memcpy(&output, &bits, sizeof(double));
+    return output;
+}
+
+/**
+ * @param x Realized value.
+ * @return Whether `x` is a missing value, i.e., a NaN with R's payload for `NA_real_`.
+ * This is distinguished from other NaNs to match the behavior of R's `is.na()` and `is.nan()`.
+ */
+inline bool is_missing(double x) {
+    if (!std::isnan(x)) {
+        return false;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(double));
+    return (bits & 0xFFFFFFFFull) == 1954;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef CHIHAYA_REALIZE_ARRAYS_HPP
+#define CHIHAYA_REALIZE_ARRAYS_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "realize_array.hpp"
+#include "utils_realize.hpp"
+#include "utils_stream.hpp"
+#include "utils_parallel.hpp"
+#include "utils_profile.hpp"
+#include "dense_array.hpp"
+#include "sparse_matrix.hpp"
+#include "constant_array.hpp"
+
+/**
+ * @file realize_arrays.hpp
+ * @brief Realization of arrays stored inside the file.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @cond
+ */
+namespace internal {
+
+// Leaves are loaded with the existing validators to obtain their details, skipping the expensive checks.
+template<class Function_>
+ArrayDetails leaf_details(Function_ fun) {
+    ::chihaya::Options opt;
+    opt.details_only = true;
+    auto output = fun(opt);
+    if (output.type == STRING) {
+        throw std::runtime_error("arrays of strings cannot be realized");
+    }
+    return output;
+}
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Dense array stored in a HDF5 dataset.
+ *
+ * Blocks are read directly from the `data` dataset with a hyperslab selection, or from the memory-mapped file if `Options::memory_map = true` and the dataset is contiguous.
+ * The dimensions of the array may be a permutation of the dimensions of the dataset, e.g., if the dataset is not in the native layout or if a transposition has been folded into the array.
+ * In such cases, the block is read in the file's layout and then permuted.
+ */
+class DenseArray : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a dense array.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    DenseArray(const H5::Group& handle, const ritsuko::Version& version, const Options& options = Options()) :
+        Array(internal::leaf_details([&](::chihaya::Options& opt) -> ArrayDetails { return dense_array::validate(handle, version, opt); }))
+    {
+        data = internal_profile::open_dataset(handle, "data");
+        mapped = internal_mmap::MappedDataset(data, options.memory_map);
+        bool native = ritsuko::hdf5::load_scalar_numeric_dataset<int>(internal_profile::open_dataset(handle, "native"));
+        placeholder = internal_realize::load_placeholder(data, version);
+
+        size_t ndims = dimensions().size();
+        layout.resize(ndims);
+        for (size_t d = 0; d < ndims; ++d) {
+            layout[d] = (native ? d : ndims - d - 1);
+        }
+        identity = internal_realize::is_identity(layout);
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t ndims = count.size();
+        size_t total = internal_realize::product(count);
+        if (total == 0) {
+            return;
+        }
+
+        std::vector<hsize_t> file_start(ndims), file_count(ndims);
+        for (size_t d = 0; d < ndims; ++d) {
+            file_start[layout[d]] = start[d];
+            file_count[layout[d]] = count[d];
+        }
+
+        std::vector<double> temp;
+        double* target = buffer;
+        if (!identity) {
+            temp.resize(total);
+            target = temp.data();
+        }
+
+        if (mapped.available()) {
+            mapped.read_hyperslab(file_start, file_count, target);
+            internal_profile::record_read(total, total * internal_mmap::stored_size(mapped.type()));
+        } else {
+            internal_parallel::Hdf5Lock lck;
+            auto dspace = data.getSpace();
+            dspace.selectHyperslab(H5S_SELECT_SET, file_count.data(), file_start.data());
+            H5::DataSpace mspace(ndims, file_count.data());
+            data.read(target, H5::PredType::NATIVE_DOUBLE, mspace, dspace);
+            internal_profile::record_read(data, total);
+        }
+
+        if (!identity) {
+            std::vector<size_t> src_count(file_count.begin(), file_count.end());
+            internal_realize::permute(temp.data(), src_count, layout, buffer);
+        }
+
+        internal_realize::replace_placeholder(placeholder, buffer, total);
+    }
+
+    size_t workspace() const {
+        return !identity;
+    }
+
+    /**
+     * @param permutation Permutation of the dimensions, see `Transpose` for details.
+     * @return A new array that reads from the same dataset, where dimension `p` corresponds to dimension `permutation[p]` of this array.
+     * The permutation is folded into the layout so that at most one rearrangement is performed for each block.
+     */
+    std::unique_ptr<Array> transpose(const std::vector<size_t>& permutation) const {
+        ArrayDetails new_details = details();
+        std::vector<size_t> new_layout(permutation.size());
+        for (size_t p = 0, end = permutation.size(); p < end; ++p) {
+            new_details.dimensions[p] = dimensions()[permutation[p]];
+            new_layout[p] = layout[permutation[p]];
+        }
+        return std::unique_ptr<Array>(new DenseArray(std::move(new_details), data, mapped, std::move(new_layout), placeholder));
+    }
+
+    /**
+     * @return Dimension of the dataset corresponding to each dimension of this array.
+     */
+    const std::vector<size_t>& get_layout() const {
+        return layout;
+    }
+
+private:
+    H5::DataSet data;
+    internal_mmap::MappedDataset mapped;
+    std::vector<size_t> layout;
+    bool identity;
+    internal_realize::Placeholder placeholder;
+
+    DenseArray(ArrayDetails details, H5::DataSet data, internal_mmap::MappedDataset mapped, std::vector<size_t> layout, internal_realize::Placeholder placeholder) :
+        Array(std::move(details)),
+        data(std::move(data)),
+        mapped(std::move(mapped)),
+        layout(std::move(layout)),
+        placeholder(std::move(placeholder))
+    {
+        identity = internal_realize::is_identity(this->layout);
+    }
+};
+
+/**
+ * @brief Compressed sparse matrix stored in HDF5 datasets.
+ *
+ * The pointers are held in memory, while the indices and values are read in windows for the requested range of the primary dimension.
+ * If `Options::memory_map = true`, contiguous `indices` and `data` datasets are read from the memory-mapped file instead.
+ * The size of each window is determined from the memory budget in `Options`.
+ * If `Options::prefetch = true`, the next window is read in the background while the current window is being processed.
+ */
+class SparseMatrix : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a sparse matrix.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    SparseMatrix(const H5::Group& handle, const ritsuko::Version& version, const Options& options) :
+        Array(internal::leaf_details([&](::chihaya::Options& opt) -> ArrayDetails { return sparse_matrix::validate(handle, version, opt); }))
+    {
+        if (!version.lt(1, 1, 0)) {
+            csc = (ritsuko::hdf5::load_scalar_numeric_dataset<int8_t>(internal_profile::open_dataset(handle, "by_column")) != 0);
+        }
+
+        data = internal_profile::open_dataset(handle, "data");
+        indices = internal_profile::open_dataset(handle, "indices");
+        placeholder = internal_realize::load_placeholder(data, version);
+        data_mapped = internal_mmap::MappedDataset(data, options.memory_map);
+        indices_mapped = internal_mmap::MappedDataset(indices, options.memory_map);
+
+        auto iphandle = internal_profile::open_dataset(handle, "indptr");
+        indptr.resize(ritsuko::hdf5::get_1d_length(iphandle, false));
+        internal_stream::read_block(iphandle, 0, indptr.size(), indptr.data());
+
+        // Each window element requires an index and a value, and prefetching requires a second window.
+        prefetch = options.prefetch;
+        window = std::max(static_cast<size_t>(1), options.memory_budget / 64 / (sizeof(uint64_t) + sizeof(double)) / (prefetch ? 2 : 1));
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t total = internal_realize::product(count);
+        std::fill_n(buffer, total, 0);
+        if (total == 0) {
+            return;
+        }
+
+        size_t p = (csc ? 1 : 0), s = 1 - p;
+        size_t pstart = start[p], pend = start[p] + count[p];
+        size_t sstart = start[s], send = start[s] + count[s];
+        size_t pstride = (csc ? 1 : count[1]), sstride = (csc ? count[1] : 1);
+
+        size_t current = pstart;
+        for_each_window(indptr[pstart], indptr[pend], [&](uint64_t w, size_t len, const std::vector<uint64_t>& ibuffer, const std::vector<double>& dbuffer) -> void {
+            for (size_t i = 0; i < len; ++i) {
+                uint64_t pos = w + i;
+                while (pos >= indptr[current + 1]) {
+                    ++current;
+                }
+                auto idx = ibuffer[i];
+                if (idx >= sstart && idx < send) {
+                    buffer[(current - pstart) * pstride + (idx - sstart) * sstride] = dbuffer[i];
+                }
+            }
+        });
+    }
+
+    bool sparse() const {
+        return true;
+    }
+
+    bool sparse_by_column() const {
+        return csc;
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        size_t p = (csc ? 1 : 0), s = 1 - p;
+        size_t pstart = start[p], pend = start[p] + count[p];
+        size_t sstart = start[s], send = start[s] + count[s];
+
+        // Filling the block in the file's orientation, and flipping it afterwards if necessary.
+        SparseBlock native;
+        SparseBlock& target = (by_column == csc ? output : native);
+        internal_realize::clear_sparse(target, csc, count[p]);
+        if (count[s] == 0) {
+            pend = pstart;
+        }
+
+        size_t current = pstart;
+        for_each_window(indptr[pstart], indptr[pend], [&](uint64_t w, size_t len, const std::vector<uint64_t>& ibuffer, const std::vector<double>& dbuffer) -> void {
+            for (size_t i = 0; i < len; ++i) {
+                uint64_t pos = w + i;
+                while (pos >= indptr[current + 1]) {
+                    ++current;
+                }
+                auto idx = ibuffer[i];
+                if (idx >= sstart && idx < send) {
+                    target.indices.push_back(idx - sstart);
+                    target.values.push_back(dbuffer[i]);
+                    ++target.pointers[current - pstart + 1];
+                }
+            }
+        });
+
+        for (size_t i = 0; i < count[p]; ++i) {
+            target.pointers[i + 1] += target.pointers[i];
+        }
+        if (by_column != csc) {
+            internal_realize::flip_sparse(native, count[s], output);
+        }
+    }
+
+private:
+    bool csc = true;
+    H5::DataSet data, indices;
+    internal_mmap::MappedDataset data_mapped, indices_mapped;
+    std::vector<uint64_t> indptr;
+    internal_realize::Placeholder placeholder;
+    size_t window;
+    bool prefetch;
+
+    // Calls 'fun(w, len, ibuffer, dbuffer)' for each window of [first, last),
+    // where 'ibuffer' and 'dbuffer' contain the indices and values for the 'len' non-zero elements starting from 'w'.
+    template<class Function_>
+    void for_each_window(uint64_t first, uint64_t last, Function_ fun) const {
+        std::vector<uint64_t> ibuffer, inext;
+        std::vector<double> dbuffer, dnext;
+        auto read = [&](uint64_t w, std::vector<uint64_t>& ib, std::vector<double>& db) -> void {
+            size_t len = std::min(static_cast<uint64_t>(window), last - w);
+            ib.resize(len);
+            db.resize(len);
+            internal_stream::read_block(indices, w, len, ib.data(), &indices_mapped);
+            internal_stream::read_block(data, w, len, db.data(), &data_mapped);
+            internal_realize::replace_placeholder(placeholder, db.data(), len);
+        };
+
+        std::unique_ptr<internal_stream::Prefetcher> prefetcher; // declared after the buffers so that any pending read finishes before they are destroyed.
+        if (prefetch && last - first > window) {
+            prefetcher.reset(new internal_stream::Prefetcher);
+        }
+
+        if (first < last) {
+            read(first, ibuffer, dbuffer);
+        }
+        for (uint64_t w = first; w < last; w += window) {
+            uint64_t next = w + window;
+            if (prefetcher && next < last) {
+                prefetcher->submit([&,next]() -> void { read(next, inext, dnext); });
+            }
+
+            fun(w, ibuffer.size(), ibuffer, dbuffer);
+
+            if (next < last) {
+                if (prefetcher) {
+                    prefetcher->wait();
+                } else {
+                    read(next, inext, dnext);
+                }
+                ibuffer.swap(inext);
+                dbuffer.swap(dnext);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Constant array.
+ */
+class ConstantArray : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a constant array.
+     * @param version Version of the **chihaya** specification.
+     */
+    ConstantArray(const H5::Group& handle, const ritsuko::Version& version) :
+        Array(internal::leaf_details([&](::chihaya::Options& opt) -> ArrayDetails { return constant_array::validate(handle, version, opt); }))
+    {
+        value = internal_realize::load_numeric_values(internal_profile::open_dataset(handle, "value"), version).front();
+    }
+
+    void extract([[maybe_unused]] const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        std::fill_n(buffer, internal_realize::product(count), value);
+    }
+
+    // Nothing is read from the file during extraction.
+    void regions(const std::vector<size_t>&, const std::vector<size_t>&, std::vector<Region>&) const {}
+
+    bool sparse() const {
+        return value == 0 && dimensions().size() == 2;
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        if (!sparse()) {
+            Array::extract_sparse(start, count, by_column, output);
+            return;
+        }
+        internal_realize::clear_sparse(output, by_column, count[by_column ? 1 : 0]);
+    }
+
+private:
+    double value;
+};
+
+}
+
+}
+
+#endif
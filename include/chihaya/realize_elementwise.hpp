@@ -0,0 +1,1144 @@
+#ifndef CHIHAYA_REALIZE_ELEMENTWISE_HPP
+#define CHIHAYA_REALIZE_ELEMENTWISE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <cmath>
+
+#include "realize_array.hpp"
+#include "utils_realize.hpp"
+#include "utils_misc.hpp"
+#include "utils_unary.hpp"
+#include "utils_type.hpp"
+#include "utils_arithmetic.hpp"
+#include "utils_profile.hpp"
+#include "utils_simd_math.hpp"
+
+/**
+ * @file realize_elementwise.hpp
+ * @brief Realization of elementwise operations.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * Operations that combine two values, used for binary operations and unary operations with a `value`.
+ * These follow R's semantics for missing values, i.e., comparisons involving `NA` or `NaN` return `NA`,
+ * while the logical operations use three-valued logic where `NA & FALSE` is `FALSE` and `NA | TRUE` is `TRUE`.
+ */
+enum class BinaryMethod : char {
+    ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, MODULO, INTEGER_DIVIDE,
+    EQUAL, GREATER, LESS, GREATER_EQUAL, LESS_EQUAL, NOT_EQUAL,
+    AND, OR
+};
+
+/**
+ * Operations on a single value, used for unary operations without a `value`.
+ * `NA` and `NaN` are preserved by all operations other than the special checks, which never return `NA`.
+ *
+ * On x86 CPUs with AVX2 or AVX-512 support, all methods other than `IDENTITY`, `NEGATE`, `NOT` and the special checks are evaluated with vectorized kernels, selected at runtime.
+ * `ABS`, `SIGN`, `SQRT`, `CEILING`, `FLOOR`, `TRUNC`, `ROUND` and `SIGNIF` give identical results to the scalar code.
+ * The other kernels use polynomial approximations that may differ from the standard library by a few ULPs, see `realize::Options::exact_math` for details.
+ * Vectorization can be disabled by defining the `CHIHAYA_NO_SIMD` macro.
+ */
+enum class UnaryMethod : char {
+    IDENTITY, NEGATE, NOT,
+    IS_NAN, IS_FINITE, IS_INFINITE,
+    ABS, SIGN, SQRT, EXP, EXPM1, LOG, LOG1P, CEILING, FLOOR, TRUNC, ROUND, SIGNIF,
+    SIN, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH, ASINH, ACOSH, ATANH
+};
+
+/**
+ * @cond
+ */
+namespace internal {
+
+template<BinaryMethod method_>
+double apply(double l, double r) {
+    if constexpr(method_ == BinaryMethod::ADD) {
+        return l + r;
+    } else if constexpr(method_ == BinaryMethod::SUBTRACT) {
+        return l - r;
+    } else if constexpr(method_ == BinaryMethod::MULTIPLY) {
+        return l * r;
+    } else if constexpr(method_ == BinaryMethod::DIVIDE) {
+        return l / r;
+    } else if constexpr(method_ == BinaryMethod::POWER) {
+        return std::pow(l, r);
+    } else if constexpr(method_ == BinaryMethod::MODULO) {
+        // Same as R's myfmod(), where the result has the same sign as the divisor.
+        if (std::isnan(l) || std::isnan(r)) {
+            return l + r;
+        }
+        auto out = std::fmod(l, r);
+        if (out != 0 && ((out < 0) != (r < 0))) {
+            out += r;
+        }
+        return out;
+    } else if constexpr(method_ == BinaryMethod::INTEGER_DIVIDE) {
+        return std::floor(l / r);
+
+    } else if constexpr(method_ == BinaryMethod::AND || method_ == BinaryMethod::OR) {
+        bool lna = std::isnan(l), rna = std::isnan(r);
+        bool ltrue = !lna && l != 0, rtrue = !rna && r != 0;
+        if constexpr(method_ == BinaryMethod::AND) {
+            if ((!lna && !ltrue) || (!rna && !rtrue)) {
+                return 0;
+            }
+            return (lna || rna) ? missing_value() : 1;
+        } else {
+            if (ltrue || rtrue) {
+                return 1;
+            }
+            return (lna || rna) ? missing_value() : 0;
+        }
+
+    } else {
+        if (std::isnan(l) || std::isnan(r)) {
+            return missing_value();
+        }
+        if constexpr(method_ == BinaryMethod::EQUAL) {
+            return l == r;
+        } else if constexpr(method_ == BinaryMethod::GREATER) {
+            return l > r;
+        } else if constexpr(method_ == BinaryMethod::LESS) {
+            return l < r;
+        } else if constexpr(method_ == BinaryMethod::GREATER_EQUAL) {
+            return l >= r;
+        } else if constexpr(method_ == BinaryMethod::LESS_EQUAL) {
+            return l <= r;
+        } else {
+            return l != r;
+        }
+    }
+}
+
+// Calls 'fun' with a std::integral_constant for the method, so that the inner loops are specialized for each method.
+template<class Function_>
+void dispatch(BinaryMethod method, Function_ fun) {
+    switch (method) {
+        case BinaryMethod::ADD: fun(std::integral_constant<BinaryMethod, BinaryMethod::ADD>()); break;
+        case BinaryMethod::SUBTRACT: fun(std::integral_constant<BinaryMethod, BinaryMethod::SUBTRACT>()); break;
+        case BinaryMethod::MULTIPLY: fun(std::integral_constant<BinaryMethod, BinaryMethod::MULTIPLY>()); break;
+        case BinaryMethod::DIVIDE: fun(std::integral_constant<BinaryMethod, BinaryMethod::DIVIDE>()); break;
+        case BinaryMethod::POWER: fun(std::integral_constant<BinaryMethod, BinaryMethod::POWER>()); break;
+        case BinaryMethod::MODULO: fun(std::integral_constant<BinaryMethod, BinaryMethod::MODULO>()); break;
+        case BinaryMethod::INTEGER_DIVIDE: fun(std::integral_constant<BinaryMethod, BinaryMethod::INTEGER_DIVIDE>()); break;
+        case BinaryMethod::EQUAL: fun(std::integral_constant<BinaryMethod, BinaryMethod::EQUAL>()); break;
+        case BinaryMethod::GREATER: fun(std::integral_constant<BinaryMethod, BinaryMethod::GREATER>()); break;
+        case BinaryMethod::LESS: fun(std::integral_constant<BinaryMethod, BinaryMethod::LESS>()); break;
+        case BinaryMethod::GREATER_EQUAL: fun(std::integral_constant<BinaryMethod, BinaryMethod::GREATER_EQUAL>()); break;
+        case BinaryMethod::LESS_EQUAL: fun(std::integral_constant<BinaryMethod, BinaryMethod::LESS_EQUAL>()); break;
+        case BinaryMethod::NOT_EQUAL: fun(std::integral_constant<BinaryMethod, BinaryMethod::NOT_EQUAL>()); break;
+        case BinaryMethod::AND: fun(std::integral_constant<BinaryMethod, BinaryMethod::AND>()); break;
+        case BinaryMethod::OR: fun(std::integral_constant<BinaryMethod, BinaryMethod::OR>()); break;
+    }
+}
+
+// Scaled values at or above 2^52 are already integral, so rounding is a no-op; checking this also avoids overflow of the scaled value, as in R.
+constexpr double max_exact_integer = 4503599627370496.0;
+
+inline double round_digits(double x, double digits) {
+    double scale = std::pow(10.0, digits);
+    if (!std::isfinite(scale) || std::abs(x) * scale >= max_exact_integer) {
+        return x;
+    }
+    if (scale == 0) {
+        return std::copysign(0.0, x);
+    }
+    return std::nearbyint(x * scale) / scale;
+}
+
+template<UnaryMethod method_>
+double apply(double x, double parameter) {
+    if constexpr(method_ == UnaryMethod::IS_NAN) {
+        return std::isnan(x) && !is_missing(x);
+    } else if constexpr(method_ == UnaryMethod::IS_FINITE) {
+        return std::isfinite(x);
+    } else if constexpr(method_ == UnaryMethod::IS_INFINITE) {
+        return std::isinf(x);
+    } else {
+        if (std::isnan(x)) {
+            return x;
+        }
+        if constexpr(method_ == UnaryMethod::IDENTITY) {
+            return x;
+        } else if constexpr(method_ == UnaryMethod::NEGATE) {
+            return -x;
+        } else if constexpr(method_ == UnaryMethod::NOT) {
+            return x == 0;
+        } else if constexpr(method_ == UnaryMethod::ABS) {
+            return std::abs(x);
+        } else if constexpr(method_ == UnaryMethod::SIGN) {
+            return (x > 0) - (x < 0);
+        } else if constexpr(method_ == UnaryMethod::SQRT) {
+            return std::sqrt(x);
+        } else if constexpr(method_ == UnaryMethod::EXP) {
+            return std::exp(x);
+        } else if constexpr(method_ == UnaryMethod::EXPM1) {
+            return std::expm1(x);
+        } else if constexpr(method_ == UnaryMethod::LOG) {
+            return std::log(x) / parameter; // 'parameter' is the log of the base.
+        } else if constexpr(method_ == UnaryMethod::LOG1P) {
+            return std::log1p(x);
+        } else if constexpr(method_ == UnaryMethod::CEILING) {
+            return std::ceil(x);
+        } else if constexpr(method_ == UnaryMethod::FLOOR) {
+            return std::floor(x);
+        } else if constexpr(method_ == UnaryMethod::TRUNC) {
+            return std::trunc(x);
+        } else if constexpr(method_ == UnaryMethod::ROUND) {
+            return round_digits(x, parameter);
+        } else if constexpr(method_ == UnaryMethod::SIGNIF) {
+            if (x == 0 || !std::isfinite(x)) {
+                return x;
+            }
+            return round_digits(x, std::max(parameter, 1.0) - std::ceil(std::log10(std::abs(x))));
+        } else if constexpr(method_ == UnaryMethod::SIN) {
+            return std::sin(x);
+        } else if constexpr(method_ == UnaryMethod::COS) {
+            return std::cos(x);
+        } else if constexpr(method_ == UnaryMethod::TAN) {
+            return std::tan(x);
+        } else if constexpr(method_ == UnaryMethod::ASIN) {
+            return std::asin(x);
+        } else if constexpr(method_ == UnaryMethod::ACOS) {
+            return std::acos(x);
+        } else if constexpr(method_ == UnaryMethod::ATAN) {
+            return std::atan(x);
+        } else if constexpr(method_ == UnaryMethod::SINH) {
+            return std::sinh(x);
+        } else if constexpr(method_ == UnaryMethod::COSH) {
+            return std::cosh(x);
+        } else if constexpr(method_ == UnaryMethod::TANH) {
+            return std::tanh(x);
+        } else if constexpr(method_ == UnaryMethod::ASINH) {
+            return std::asinh(x);
+        } else if constexpr(method_ == UnaryMethod::ACOSH) {
+            return std::acosh(x);
+        } else {
+            return std::atanh(x);
+        }
+    }
+}
+
+template<class Function_>
+void dispatch(UnaryMethod method, Function_ fun) {
+    switch (method) {
+        case UnaryMethod::IDENTITY: fun(std::integral_constant<UnaryMethod, UnaryMethod::IDENTITY>()); break;
+        case UnaryMethod::NEGATE: fun(std::integral_constant<UnaryMethod, UnaryMethod::NEGATE>()); break;
+        case UnaryMethod::NOT: fun(std::integral_constant<UnaryMethod, UnaryMethod::NOT>()); break;
+        case UnaryMethod::IS_NAN: fun(std::integral_constant<UnaryMethod, UnaryMethod::IS_NAN>()); break;
+        case UnaryMethod::IS_FINITE: fun(std::integral_constant<UnaryMethod, UnaryMethod::IS_FINITE>()); break;
+        case UnaryMethod::IS_INFINITE: fun(std::integral_constant<UnaryMethod, UnaryMethod::IS_INFINITE>()); break;
+        case UnaryMethod::ABS: fun(std::integral_constant<UnaryMethod, UnaryMethod::ABS>()); break;
+        case UnaryMethod::SIGN: fun(std::integral_constant<UnaryMethod, UnaryMethod::SIGN>()); break;
+        case UnaryMethod::SQRT: fun(std::integral_constant<UnaryMethod, UnaryMethod::SQRT>()); break;
+        case UnaryMethod::EXP: fun(std::integral_constant<UnaryMethod, UnaryMethod::EXP>()); break;
+        case UnaryMethod::EXPM1: fun(std::integral_constant<UnaryMethod, UnaryMethod::EXPM1>()); break;
+        case UnaryMethod::LOG: fun(std::integral_constant<UnaryMethod, UnaryMethod::LOG>()); break;
+        case UnaryMethod::LOG1P: fun(std::integral_constant<UnaryMethod, UnaryMethod::LOG1P>()); break;
+        case UnaryMethod::CEILING: fun(std::integral_constant<UnaryMethod, UnaryMethod::CEILING>()); break;
+        case UnaryMethod::FLOOR: fun(std::integral_constant<UnaryMethod, UnaryMethod::FLOOR>()); break;
+        case UnaryMethod::TRUNC: fun(std::integral_constant<UnaryMethod, UnaryMethod::TRUNC>()); break;
+        case UnaryMethod::ROUND: fun(std::integral_constant<UnaryMethod, UnaryMethod::ROUND>()); break;
+        case UnaryMethod::SIGNIF: fun(std::integral_constant<UnaryMethod, UnaryMethod::SIGNIF>()); break;
+        case UnaryMethod::SIN: fun(std::integral_constant<UnaryMethod, UnaryMethod::SIN>()); break;
+        case UnaryMethod::COS: fun(std::integral_constant<UnaryMethod, UnaryMethod::COS>()); break;
+        case UnaryMethod::TAN: fun(std::integral_constant<UnaryMethod, UnaryMethod::TAN>()); break;
+        case UnaryMethod::ASIN: fun(std::integral_constant<UnaryMethod, UnaryMethod::ASIN>()); break;
+        case UnaryMethod::ACOS: fun(std::integral_constant<UnaryMethod, UnaryMethod::ACOS>()); break;
+        case UnaryMethod::ATAN: fun(std::integral_constant<UnaryMethod, UnaryMethod::ATAN>()); break;
+        case UnaryMethod::SINH: fun(std::integral_constant<UnaryMethod, UnaryMethod::SINH>()); break;
+        case UnaryMethod::COSH: fun(std::integral_constant<UnaryMethod, UnaryMethod::COSH>()); break;
+        case UnaryMethod::TANH: fun(std::integral_constant<UnaryMethod, UnaryMethod::TANH>()); break;
+        case UnaryMethod::ASINH: fun(std::integral_constant<UnaryMethod, UnaryMethod::ASINH>()); break;
+        case UnaryMethod::ACOSH: fun(std::integral_constant<UnaryMethod, UnaryMethod::ACOSH>()); break;
+        case UnaryMethod::ATANH: fun(std::integral_constant<UnaryMethod, UnaryMethod::ATANH>()); break;
+    }
+}
+
+template<UnaryMethod method_>
+constexpr bool has_math_kernel() {
+    return method_ != UnaryMethod::IDENTITY && method_ != UnaryMethod::NEGATE && method_ != UnaryMethod::NOT &&
+        method_ != UnaryMethod::IS_NAN && method_ != UnaryMethod::IS_FINITE && method_ != UnaryMethod::IS_INFINITE;
+}
+
+template<UnaryMethod method_>
+constexpr internal_simd::MathKernel to_math_kernel() {
+    if constexpr(method_ == UnaryMethod::ABS) {
+        return internal_simd::MathKernel::ABS;
+    } else if constexpr(method_ == UnaryMethod::SIGN) {
+        return internal_simd::MathKernel::SIGN;
+    } else if constexpr(method_ == UnaryMethod::SQRT) {
+        return internal_simd::MathKernel::SQRT;
+    } else if constexpr(method_ == UnaryMethod::CEILING) {
+        return internal_simd::MathKernel::CEILING;
+    } else if constexpr(method_ == UnaryMethod::FLOOR) {
+        return internal_simd::MathKernel::FLOOR;
+    } else if constexpr(method_ == UnaryMethod::TRUNC) {
+        return internal_simd::MathKernel::TRUNC;
+    } else if constexpr(method_ == UnaryMethod::ROUND) {
+        return internal_simd::MathKernel::ROUND;
+    } else if constexpr(method_ == UnaryMethod::SIGNIF) {
+        return internal_simd::MathKernel::SIGNIF;
+    } else if constexpr(method_ == UnaryMethod::EXP) {
+        return internal_simd::MathKernel::EXP;
+    } else if constexpr(method_ == UnaryMethod::EXPM1) {
+        return internal_simd::MathKernel::EXPM1;
+    } else if constexpr(method_ == UnaryMethod::LOG) {
+        return internal_simd::MathKernel::LOG;
+    } else if constexpr(method_ == UnaryMethod::LOG1P) {
+        return internal_simd::MathKernel::LOG1P;
+    } else if constexpr(method_ == UnaryMethod::SIN) {
+        return internal_simd::MathKernel::SIN;
+    } else if constexpr(method_ == UnaryMethod::COS) {
+        return internal_simd::MathKernel::COS;
+    } else if constexpr(method_ == UnaryMethod::TAN) {
+        return internal_simd::MathKernel::TAN;
+    } else if constexpr(method_ == UnaryMethod::ASIN) {
+        return internal_simd::MathKernel::ASIN;
+    } else if constexpr(method_ == UnaryMethod::ACOS) {
+        return internal_simd::MathKernel::ACOS;
+    } else if constexpr(method_ == UnaryMethod::ATAN) {
+        return internal_simd::MathKernel::ATAN;
+    } else if constexpr(method_ == UnaryMethod::SINH) {
+        return internal_simd::MathKernel::SINH;
+    } else if constexpr(method_ == UnaryMethod::COSH) {
+        return internal_simd::MathKernel::COSH;
+    } else if constexpr(method_ == UnaryMethod::TANH) {
+        return internal_simd::MathKernel::TANH;
+    } else if constexpr(method_ == UnaryMethod::ASINH) {
+        return internal_simd::MathKernel::ASINH;
+    } else if constexpr(method_ == UnaryMethod::ACOSH) {
+        return internal_simd::MathKernel::ACOSH;
+    } else {
+        return internal_simd::MathKernel::ATANH;
+    }
+}
+
+// Applies the method to each element, using the vectorized kernels where available and finishing off with the scalar code.
+// If 'exact = true', only the kernels that give identical results to the scalar code are used.
+template<UnaryMethod method_>
+void apply_all(double* ptr, size_t n, double parameter, bool exact = false) {
+    size_t i = 0;
+    if constexpr(has_math_kernel<method_>()) {
+        constexpr auto kernel = to_math_kernel<method_>();
+        if (internal_simd::is_exact(kernel) || !exact) {
+            i = internal_simd::transform_math<kernel>(ptr, n, parameter, [&](double x) -> double { return apply<method_>(x, parameter); });
+        }
+    }
+    for (; i < n; ++i) {
+        ptr[i] = apply<method_>(ptr[i], parameter);
+    }
+}
+
+inline BinaryMethod translate_binary_method(const std::string& method) {
+    if (method == "+") {
+        return BinaryMethod::ADD;
+    } else if (method == "-") {
+        return BinaryMethod::SUBTRACT;
+    } else if (method == "*") {
+        return BinaryMethod::MULTIPLY;
+    } else if (method == "/") {
+        return BinaryMethod::DIVIDE;
+    } else if (method == "^") {
+        return BinaryMethod::POWER;
+    } else if (method == "%%") {
+        return BinaryMethod::MODULO;
+    } else if (method == "%/%") {
+        return BinaryMethod::INTEGER_DIVIDE;
+    } else if (method == "==") {
+        return BinaryMethod::EQUAL;
+    } else if (method == ">") {
+        return BinaryMethod::GREATER;
+    } else if (method == "<") {
+        return BinaryMethod::LESS;
+    } else if (method == ">=") {
+        return BinaryMethod::GREATER_EQUAL;
+    } else if (method == "<=") {
+        return BinaryMethod::LESS_EQUAL;
+    } else if (method == "!=") {
+        return BinaryMethod::NOT_EQUAL;
+    } else if (method == "&&") {
+        return BinaryMethod::AND;
+    } else if (method == "||") {
+        return BinaryMethod::OR;
+    }
+    throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+}
+
+inline UnaryMethod translate_unary_method(const std::string& method) {
+    static const std::unordered_map<std::string, UnaryMethod> mapping {
+        { "!", UnaryMethod::NOT },
+        { "is_nan", UnaryMethod::IS_NAN },
+        { "is_finite", UnaryMethod::IS_FINITE },
+        { "is_infinite", UnaryMethod::IS_INFINITE },
+        { "abs", UnaryMethod::ABS },
+        { "sign", UnaryMethod::SIGN },
+        { "sqrt", UnaryMethod::SQRT },
+        { "exp", UnaryMethod::EXP },
+        { "expm1", UnaryMethod::EXPM1 },
+        { "log", UnaryMethod::LOG },
+        { "log1p", UnaryMethod::LOG1P },
+        { "ceiling", UnaryMethod::CEILING },
+        { "floor", UnaryMethod::FLOOR },
+        { "trunc", UnaryMethod::TRUNC },
+        { "round", UnaryMethod::ROUND },
+        { "signif", UnaryMethod::SIGNIF },
+        { "sin", UnaryMethod::SIN },
+        { "cos", UnaryMethod::COS },
+        { "tan", UnaryMethod::TAN },
+        { "asin", UnaryMethod::ASIN },
+        { "acos", UnaryMethod::ACOS },
+        { "atan", UnaryMethod::ATAN },
+        { "sinh", UnaryMethod::SINH },
+        { "cosh", UnaryMethod::COSH },
+        { "tanh", UnaryMethod::TANH },
+        { "asinh", UnaryMethod::ASINH },
+        { "acosh", UnaryMethod::ACOSH },
+        { "atanh", UnaryMethod::ATANH }
+    };
+    auto it = mapping.find(method);
+    if (it == mapping.end()) {
+        throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+    }
+    return it->second;
+}
+
+inline ArrayType load_value_type(const H5::DataSet& vhandle, const ritsuko::Version& version) {
+    if (version.lt(1, 1, 0)) {
+        return (vhandle.getTypeClass() == H5T_FLOAT ? FLOAT : INTEGER);
+    } else {
+        return internal_type::translate_type_1_1(ritsuko::hdf5::open_and_load_scalar_string_attribute(vhandle, "type"));
+    }
+}
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Elementwise operation between an array and a scalar or vector.
+ *
+ * This is used to realize unary arithmetic, comparison and logical operations that involve a `value`.
+ * If `value` is a vector, each entry is applied to the corresponding position along the `along` dimension.
+ */
+class ScalarOperation : public Array {
+public:
+    /**
+     * @param seed The seed array.
+     * @param type Type of the output array.
+     * @param method Operation to apply.
+     * @param right Whether the value is on the right of the operation, i.e., `seed OP value`.
+     * Otherwise, the operation is performed as `value OP seed`.
+     * @param values Values to use in the operation.
+     * This should be of length 1 or equal to the extent of the `along` dimension.
+     * @param along Dimension of the seed to which `values` is applied, only used if `values` has length greater than 1.
+     */
+    ScalarOperation(std::unique_ptr<Array> seed, ArrayType type, BinaryMethod method, bool right, std::vector<double> values, size_t along) :
+        Array(ArrayDetails(type, seed->dimensions())),
+        seed(std::move(seed)),
+        method(method),
+        right(right),
+        values(std::move(values)),
+        along(along)
+    {}
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        seed->extract(start, count, buffer);
+
+        internal::dispatch(method, [&](auto tag) -> void {
+            constexpr BinaryMethod method_ = decltype(tag)::value;
+            auto run = [&](double v, double* ptr, size_t n) -> void {
+                if (right) {
+                    for (size_t i = 0; i < n; ++i) {
+                        ptr[i] = internal::apply<method_>(ptr[i], v);
+                    }
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        ptr[i] = internal::apply<method_>(v, ptr[i]);
+                    }
+                }
+            };
+
+            if (values.size() == 1) {
+                run(values.front(), buffer, internal_realize::product(count));
+            } else {
+                internal_realize::for_each_run_along(count, along, buffer, [&](size_t a, double* ptr, size_t n) -> void {
+                    run(values[start[along] + a], ptr, n);
+                });
+            }
+        });
+    }
+
+    size_t workspace() const {
+        return seed->workspace();
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        seed->regions(start, count, output);
+    }
+
+    /**
+     * @return The seed array.
+     */
+    const Array& get_seed() const {
+        return *seed;
+    }
+
+    /**
+     * @return Operation to apply.
+     */
+    BinaryMethod get_method() const {
+        return method;
+    }
+
+    /**
+     * @return Whether the value is on the right of the operation.
+     */
+    bool get_right() const {
+        return right;
+    }
+
+    /**
+     * @return Values to use in the operation.
+     */
+    const std::vector<double>& get_values() const {
+        return values;
+    }
+
+    /**
+     * @return Dimension of the seed to which the values are applied.
+     */
+    size_t get_along() const {
+        return along;
+    }
+
+    /**
+     * @cond
+     */
+    // Rewrites a subset of this operation into the same operation on the subsetted seed(s), where 'subset(seed, index)' creates the subset.
+    // This consumes the seed(s) of this instance, which should be discarded afterwards.
+    template<class Subset_>
+    std::unique_ptr<Array> push_subset(const internal_realize::IndexList& index, Subset_ subset) {
+        auto values_copy = internal_realize::subset_along(values, along, index);
+        return std::unique_ptr<Array>(new ScalarOperation(subset(std::move(seed), index), details().type, method, right, std::move(values_copy), along));
+    }
+
+    // Same as push_subset() but for a transposition, where 'transpose(seed, permutation)' creates the transposition.
+    template<class Transpose_>
+    std::unique_ptr<Array> push_transpose(const std::vector<size_t>& permutation, Transpose_ transpose) {
+        auto new_along = internal_realize::permuted_along(along, permutation);
+        return std::unique_ptr<Array>(new ScalarOperation(transpose(std::move(seed), permutation), details().type, method, right, std::move(values), new_along));
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> seed;
+    BinaryMethod method;
+    bool right;
+    std::vector<double> values;
+    size_t along;
+};
+
+/**
+ * @brief Elementwise operation on a single array.
+ *
+ * This is used to realize unary math and special checks, as well as unary arithmetic and logical operations without a `value`.
+ */
+class UnaryOperation : public Array {
+public:
+    /**
+     * @param seed The seed array.
+     * @param type Type of the output array.
+     * @param method Operation to apply.
+     * @param parameter Parameter of the operation, i.e., the natural log of the base for `UnaryMethod::LOG`,
+     * or the number of digits for `UnaryMethod::ROUND` and `UnaryMethod::SIGNIF`.
+     * @param exact_math Whether to only use vectorized kernels that give identical results to the standard library, see `UnaryMethod`.
+     */
+    UnaryOperation(std::unique_ptr<Array> seed, ArrayType type, UnaryMethod method, double parameter = 0, bool exact_math = false) :
+        Array(ArrayDetails(type, seed->dimensions())),
+        seed(std::move(seed)),
+        method(method),
+        parameter(parameter),
+        exact_math(exact_math)
+    {}
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        seed->extract(start, count, buffer);
+        size_t n = internal_realize::product(count);
+        internal::dispatch(method, [&](auto tag) -> void {
+            constexpr UnaryMethod method_ = decltype(tag)::value;
+            internal::apply_all<method_>(buffer, n, parameter, exact_math);
+        });
+    }
+
+    size_t workspace() const {
+        return seed->workspace();
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        seed->regions(start, count, output);
+    }
+
+    /**
+     * @return The seed array.
+     */
+    const Array& get_seed() const {
+        return *seed;
+    }
+
+    /**
+     * @return Operation to apply.
+     */
+    UnaryMethod get_method() const {
+        return method;
+    }
+
+    /**
+     * @return Parameter of the operation.
+     */
+    double get_parameter() const {
+        return parameter;
+    }
+
+    /**
+     * @return Whether to only use vectorized kernels that give identical results to the standard library.
+     */
+    bool get_exact_math() const {
+        return exact_math;
+    }
+
+    /**
+     * @cond
+     */
+    // Rewrites a subset of this operation into the same operation on the subsetted seed(s), where 'subset(seed, index)' creates the subset.
+    // This consumes the seed(s) of this instance, which should be discarded afterwards.
+    template<class Subset_>
+    std::unique_ptr<Array> push_subset(const internal_realize::IndexList& index, Subset_ subset) {
+        return std::unique_ptr<Array>(new UnaryOperation(subset(std::move(seed), index), details().type, method, parameter, exact_math));
+    }
+
+    template<class Transpose_>
+    std::unique_ptr<Array> push_transpose(const std::vector<size_t>& permutation, Transpose_ transpose) {
+        return std::unique_ptr<Array>(new UnaryOperation(transpose(std::move(seed), permutation), details().type, method, parameter, exact_math));
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> seed;
+    UnaryMethod method;
+    double parameter;
+    bool exact_math;
+};
+
+/**
+ * @brief Elementwise operation between two arrays of the same dimensions.
+ */
+class BinaryOperation : public Array {
+public:
+    /**
+     * @param left The left array.
+     * @param right The right array.
+     * @param type Type of the output array.
+     * @param method Operation to apply, i.e., `left OP right`.
+     */
+    BinaryOperation(std::unique_ptr<Array> left, std::unique_ptr<Array> right, ArrayType type, BinaryMethod method) :
+        Array(ArrayDetails(type, left->dimensions())),
+        left(std::move(left)),
+        right(std::move(right)),
+        method(method)
+    {
+        if (!internal_misc::are_dimensions_equal(this->left->dimensions(), this->right->dimensions())) {
+            throw std::runtime_error("'left' and 'right' should have the same dimensions");
+        }
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t n = internal_realize::product(count);
+        left->extract(start, count, buffer);
+        std::vector<double> temp(n);
+        right->extract(start, count, temp.data());
+
+        internal::dispatch(method, [&](auto tag) -> void {
+            constexpr BinaryMethod method_ = decltype(tag)::value;
+            for (size_t i = 0; i < n; ++i) {
+                buffer[i] = internal::apply<method_>(buffer[i], temp[i]);
+            }
+        });
+    }
+
+    size_t workspace() const {
+        return std::max(left->workspace(), 1 + right->workspace());
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        left->regions(start, count, output);
+        right->regions(start, count, output);
+    }
+
+    /**
+     * @cond
+     */
+    // Rewrites a subset of this operation into the same operation on the subsetted seed(s), where 'subset(seed, index)' creates the subset.
+    // This consumes the seed(s) of this instance, which should be discarded afterwards.
+    template<class Subset_>
+    std::unique_ptr<Array> push_subset(const internal_realize::IndexList& index, Subset_ subset) {
+        auto new_left = subset(std::move(left), index);
+        auto new_right = subset(std::move(right), index);
+        return std::unique_ptr<Array>(new BinaryOperation(std::move(new_left), std::move(new_right), details().type, method));
+    }
+
+    template<class Transpose_>
+    std::unique_ptr<Array> push_transpose(const std::vector<size_t>& permutation, Transpose_ transpose) {
+        auto new_left = transpose(std::move(left), permutation);
+        auto new_right = transpose(std::move(right), permutation);
+        return std::unique_ptr<Array>(new BinaryOperation(std::move(new_left), std::move(new_right), details().type, method));
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> left, right;
+    BinaryMethod method;
+};
+
+/**
+ * @brief A single step of a `FusedOperation`.
+ *
+ * If `values` is empty, this applies `unary` with `parameter` to each element, as in `UnaryOperation`.
+ * Otherwise, it applies `binary` between each element and the entries of `values`, as in `ScalarOperation`.
+ */
+struct ElementwiseStep {
+    /**
+     * Operation on a single value, only used if `values` is empty.
+     */
+    UnaryMethod unary = UnaryMethod::IDENTITY;
+
+    /**
+     * Parameter for `unary`, see `UnaryOperation` for details.
+     */
+    double parameter = 0;
+
+    /**
+     * Whether to only use vectorized kernels for `unary` that give identical results to the standard library, see `UnaryMethod`.
+     */
+    bool exact_math = false;
+
+    /**
+     * Operation between each element and the `values`, only used if `values` is not empty.
+     */
+    BinaryMethod binary = BinaryMethod::ADD;
+
+    /**
+     * Whether the values are on the right of `binary`, see `ScalarOperation` for details.
+     */
+    bool right = true;
+
+    /**
+     * Values to use in `binary`, of length 1 or equal to the extent of the `along` dimension.
+     */
+    std::vector<double> values;
+
+    /**
+     * Dimension to which `values` is applied, only used if `values` has length greater than 1.
+     */
+    size_t along = 0;
+};
+
+/**
+ * @brief Fused chain of unary elementwise operations.
+ *
+ * This realizes a contiguous chain of unary arithmetic, comparison, logic, math and special check operations in a single pass over each block.
+ * Specifically, the block is processed in cache-sized tiles, where all steps of the chain are applied to a tile before moving onto the next tile.
+ * This avoids repeatedly streaming the entire block through memory for each operation in the chain.
+ *
+ * If the chain maps zero to zero at every position (e.g., `log1p`, multiplication by a finite scalar) and the seed is sparse,
+ * the chain is only applied to the structural non-zeros of the seed, both in `extract()` and `extract_sparse()`.
+ */
+class FusedOperation : public Array {
+public:
+    /**
+     * @param seed The seed array.
+     * If this is itself a `FusedOperation`, its seed and steps are absorbed into the new instance, so that chains are built up by repeated construction.
+     * @param type Type of the output array.
+     * @param steps Steps to apply to each element of the seed, in order.
+     */
+    FusedOperation(std::unique_ptr<Array> seed, ArrayType type, std::vector<ElementwiseStep> steps) :
+        Array(ArrayDetails(type, seed->dimensions())),
+        seed(std::move(seed))
+    {
+        auto previous = dynamic_cast<FusedOperation*>(this->seed.get());
+        if (previous) {
+            chain = std::move(previous->chain);
+            auto inner = std::move(previous->seed);
+            this->seed = std::move(inner);
+        }
+
+        for (auto& step : steps) {
+            if (step.values.empty() && step.unary == UnaryMethod::IDENTITY) {
+                continue;
+            }
+            chain.push_back(std::move(step));
+        }
+
+        zero_preserving = preserves_zero(chain);
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        // Only computing the structural non-zeros if the seed is sparse.
+        if (sparse()) {
+            SparseBlock block;
+            extract_sparse(start, count, false, block);
+            internal_realize::densify_sparse(block, count, buffer);
+            return;
+        }
+
+        seed->extract(start, count, buffer);
+        size_t n = internal_realize::product(count);
+        for (size_t t0 = 0; t0 < n; t0 += tile_size) {
+            size_t t1 = std::min(n, t0 + tile_size);
+            for (const auto& step : chain) {
+                apply_step(step, start, count, buffer, t0, t1);
+            }
+        }
+    }
+
+    size_t workspace() const {
+        return seed->workspace();
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        seed->regions(start, count, output);
+    }
+
+    bool sparse() const {
+        return zero_preserving && seed->sparse();
+    }
+
+    bool sparse_by_column() const {
+        return seed->sparse_by_column();
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        if (!sparse()) {
+            Array::extract_sparse(start, count, by_column, output);
+            return;
+        }
+        seed->extract_sparse(start, count, by_column, output);
+        for (const auto& step : chain) {
+            apply_step_sparse(step, start, output);
+        }
+    }
+
+    /**
+     * @return Whether the chain maps zero to zero at every position, regardless of the seed.
+     */
+    bool is_zero_preserving() const {
+        return zero_preserving;
+    }
+
+    /**
+     * @return The seed array, i.e., the input to the first step.
+     */
+    const Array& get_seed() const {
+        return *seed;
+    }
+
+    /**
+     * @return Steps of the chain, in the order of application.
+     * Steps that do not modify the values (e.g., unary `+`) are omitted.
+     */
+    const std::vector<ElementwiseStep>& get_steps() const {
+        return chain;
+    }
+
+    /**
+     * @cond
+     */
+    // Rewrites a subset of this operation into the same operation on the subsetted seed(s), where 'subset(seed, index)' creates the subset.
+    // This consumes the seed(s) of this instance, which should be discarded afterwards.
+    template<class Subset_>
+    std::unique_ptr<Array> push_subset(const internal_realize::IndexList& index, Subset_ subset) {
+        for (auto& step : chain) {
+            step.values = internal_realize::subset_along(step.values, step.along, index);
+        }
+        return std::unique_ptr<Array>(new FusedOperation(subset(std::move(seed), index), details().type, std::move(chain)));
+    }
+
+    template<class Transpose_>
+    std::unique_ptr<Array> push_transpose(const std::vector<size_t>& permutation, Transpose_ transpose) {
+        for (auto& step : chain) {
+            step.along = internal_realize::permuted_along(step.along, permutation);
+        }
+        return std::unique_ptr<Array>(new FusedOperation(transpose(std::move(seed), permutation), details().type, std::move(chain)));
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> seed;
+    std::vector<ElementwiseStep> chain;
+    bool zero_preserving;
+
+    // Passing zero through the chain, keeping track of both signed zeros as these may behave differently in later steps, e.g., 1/-0.
+    static bool preserves_zero(const std::vector<ElementwiseStep>& chain) {
+        std::vector<double> current{ 0.0 };
+        std::vector<double> next;
+        for (const auto& step : chain) {
+            next.clear();
+            for (auto x : current) {
+                if (step.values.empty()) {
+                    internal::dispatch(step.unary, [&](auto tag) -> void {
+                        next.push_back(internal::apply<decltype(tag)::value>(x, step.parameter));
+                    });
+                } else {
+                    internal::dispatch(step.binary, [&](auto tag) -> void {
+                        constexpr BinaryMethod method_ = decltype(tag)::value;
+                        for (auto v : step.values) {
+                            next.push_back(step.right ? internal::apply<method_>(x, v) : internal::apply<method_>(v, x));
+                        }
+                    });
+                }
+            }
+
+            bool has_positive = false, has_negative = false;
+            for (auto y : next) {
+                if (y != 0) {
+                    return false;
+                }
+                if (std::signbit(y)) {
+                    has_negative = true;
+                } else {
+                    has_positive = true;
+                }
+            }
+            current.clear();
+            if (has_positive) {
+                current.push_back(0.0);
+            }
+            if (has_negative) {
+                current.push_back(-0.0);
+            }
+        }
+        return true;
+    }
+
+    static void apply_step_sparse(const ElementwiseStep& step, const std::vector<size_t>& start, SparseBlock& block) {
+        double* values = block.values.data();
+        size_t nnz = block.values.size();
+        if (step.values.empty()) {
+            internal::dispatch(step.unary, [&](auto tag) -> void {
+                internal::apply_all<decltype(tag)::value>(values, nnz, step.parameter, step.exact_math);
+            });
+            return;
+        }
+
+        internal::dispatch(step.binary, [&](auto tag) -> void {
+            constexpr BinaryMethod method_ = decltype(tag)::value;
+            auto run = [&](double v, size_t from, size_t to) -> void {
+                if (step.right) {
+                    for (size_t i = from; i < to; ++i) {
+                        values[i] = internal::apply<method_>(values[i], v);
+                    }
+                } else {
+                    for (size_t i = from; i < to; ++i) {
+                        values[i] = internal::apply<method_>(v, values[i]);
+                    }
+                }
+            };
+
+            if (step.values.size() == 1) {
+                run(step.values.front(), 0, nnz);
+            } else if (step.along == (block.by_column ? 1u : 0u)) {
+                for (size_t p = 0, np = block.pointers.size() - 1; p < np; ++p) {
+                    run(step.values[start[step.along] + p], block.pointers[p], block.pointers[p + 1]);
+                }
+            } else {
+                for (size_t k = 0; k < nnz; ++k) {
+                    run(step.values[start[step.along] + block.indices[k]], k, k + 1);
+                }
+            }
+        });
+    }
+
+    // 4096 doubles = 32 kB, which should fit in most L1 caches.
+    static constexpr size_t tile_size = 4096;
+
+    static void apply_step(const ElementwiseStep& step, const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer, size_t t0, size_t t1) {
+        if (step.values.empty()) {
+            internal::dispatch(step.unary, [&](auto tag) -> void {
+                constexpr UnaryMethod method_ = decltype(tag)::value;
+                internal::apply_all<method_>(buffer + t0, t1 - t0, step.parameter, step.exact_math);
+            });
+            return;
+        }
+
+        internal::dispatch(step.binary, [&](auto tag) -> void {
+            constexpr BinaryMethod method_ = decltype(tag)::value;
+            auto run = [&](double v, size_t from, size_t to) -> void {
+                if (step.right) {
+                    for (size_t i = from; i < to; ++i) {
+                        buffer[i] = internal::apply<method_>(buffer[i], v);
+                    }
+                } else {
+                    for (size_t i = from; i < to; ++i) {
+                        buffer[i] = internal::apply<method_>(v, buffer[i]);
+                    }
+                }
+            };
+
+            if (step.values.size() == 1) {
+                run(step.values.front(), t0, t1);
+                return;
+            }
+
+            // Each run of 'inner' consecutive elements shares the same position along the 'along' dimension.
+            size_t inner = 1;
+            for (size_t d = step.along + 1; d < count.size(); ++d) {
+                inner *= count[d];
+            }
+            size_t extent = count[step.along];
+            size_t pos = t0;
+            while (pos < t1) {
+                size_t q = pos / inner;
+                size_t end = std::min(t1, (q + 1) * inner);
+                run(step.values[start[step.along] + q % extent], pos, end);
+                pos = end;
+            }
+        });
+    }
+};
+
+/**
+ * @cond
+ */
+namespace internal {
+
+inline std::unique_ptr<Array> make_unary(std::unique_ptr<Array> seed, ArrayType type, UnaryMethod method, double parameter, const Options& options) {
+    if (options.fuse_elementwise) {
+        ElementwiseStep step;
+        step.unary = method;
+        step.parameter = parameter;
+        step.exact_math = options.exact_math;
+        return std::unique_ptr<Array>(new FusedOperation(std::move(seed), type, { std::move(step) }));
+    }
+    return std::unique_ptr<Array>(new UnaryOperation(std::move(seed), type, method, parameter, options.exact_math));
+}
+
+// For unary arithmetic, comparison and logic operations.
+inline std::unique_ptr<Array> load_scalar_operation(const H5::Group& handle, const ritsuko::Version& version, Options& options, const std::string& kind) {
+    auto seed = internal_realize::load_seed(handle, "seed", version, options);
+    auto method = internal_unary::load_method(handle);
+
+    if (kind == "logic" && method == "!") {
+        return make_unary(std::move(seed), BOOLEAN, UnaryMethod::NOT, 0, options);
+    }
+
+    auto side = internal_unary::load_side(handle);
+    if (side == "none") {
+        auto type = internal_arithmetic::determine_output_type(INTEGER, seed->details().type, method);
+        if (method == "+") {
+            return make_unary(std::move(seed), type, UnaryMethod::IDENTITY, 0, options);
+        } else if (method == "-") {
+            return make_unary(std::move(seed), type, UnaryMethod::NEGATE, 0, options);
+        }
+        throw std::runtime_error("'side' cannot be 'none' for operation '" + method + "'");
+    }
+
+    auto vhandle = internal_profile::open_dataset(handle, "value");
+    ArrayType type = BOOLEAN;
+    if (kind == "arithmetic") {
+        type = internal_arithmetic::determine_output_type(internal::load_value_type(vhandle, version), seed->details().type, method);
+    }
+
+    auto values = internal_realize::load_numeric_values(vhandle, version);
+    size_t along = 0;
+    if (vhandle.getSpace().getSimpleExtentNdims() == 1) {
+        along = internal_misc::load_along(handle, version);
+    }
+
+    auto bmethod = translate_binary_method(method);
+    if (options.fuse_elementwise) {
+        ElementwiseStep step;
+        step.binary = bmethod;
+        step.right = (side == "right");
+        step.values = std::move(values);
+        step.along = along;
+        return std::unique_ptr<Array>(new FusedOperation(std::move(seed), type, { std::move(step) }));
+    }
+    return std::unique_ptr<Array>(new ScalarOperation(std::move(seed), type, bmethod, side == "right", std::move(values), along));
+}
+
+inline std::unique_ptr<Array> load_unary_math(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = internal_realize::load_seed(handle, "seed", version, options);
+    auto method = internal_unary::load_method(handle);
+    auto umethod = translate_unary_method(method);
+
+    ArrayType type = FLOAT;
+    double parameter = 0;
+    if (umethod == UnaryMethod::SIGN) {
+        type = INTEGER;
+    } else if (umethod == UnaryMethod::ABS) {
+        type = std::max(seed->details().type, INTEGER);
+    } else if (umethod == UnaryMethod::LOG) {
+        parameter = 1;
+        if (handle.exists("base")) {
+            parameter = std::log(ritsuko::hdf5::load_scalar_numeric_dataset<double>(internal_profile::open_dataset(handle, "base")));
+        }
+    } else if (umethod == UnaryMethod::ROUND || umethod == UnaryMethod::SIGNIF) {
+        parameter = ritsuko::hdf5::load_scalar_numeric_dataset<int32_t>(internal_profile::open_dataset(handle, "digits"));
+    }
+
+    return make_unary(std::move(seed), type, umethod, parameter, options);
+}
+
+inline std::unique_ptr<Array> load_unary_special_check(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = internal_realize::load_seed(handle, "seed", version, options);
+    auto method = translate_unary_method(internal_unary::load_method(handle));
+    return make_unary(std::move(seed), BOOLEAN, method, 0, options);
+}
+
+// For binary arithmetic, comparison and logic operations.
+inline std::unique_ptr<Array> load_binary_operation(const H5::Group& handle, const ritsuko::Version& version, Options& options, const std::string& kind) {
+    auto left = internal_realize::load_seed(handle, "left", version, options);
+    auto right = internal_realize::load_seed(handle, "right", version, options);
+    auto method = internal_unary::load_method(handle);
+
+    ArrayType type = BOOLEAN;
+    if (kind == "arithmetic") {
+        type = internal_arithmetic::determine_output_type(left->details().type, right->details().type, method);
+    }
+
+    return std::unique_ptr<Array>(new BinaryOperation(std::move(left), std::move(right), type, translate_binary_method(method)));
+}
+
+}
+/**
+ * @endcond
+ */
+
+}
+
+}
+
+#endif
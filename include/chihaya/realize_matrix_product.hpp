@@ -0,0 +1,317 @@
+#ifndef CHIHAYA_REALIZE_MATRIX_PRODUCT_HPP
+#define CHIHAYA_REALIZE_MATRIX_PRODUCT_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "realize_array.hpp"
+#include "utils_realize.hpp"
+#include "utils_misc.hpp"
+#include "utils_parallel.hpp"
+
+/**
+ * @file realize_matrix_product.hpp
+ * @brief Realization of matrix products.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @brief Delayed matrix product.
+ *
+ * Each requested block of the product is computed from the corresponding rows of the left matrix and columns of the right matrix.
+ * These are extracted in chunks of the common dimension, where the chunk size is chosen to respect the memory budget in `Options`.
+ *
+ * If the left matrix is sparse (see `Array::sparse()`), each chunk is extracted in compressed sparse form and multiplied with the dense chunk of the right matrix.
+ * Otherwise, if the right matrix is sparse, the transposed product is computed in the same manner.
+ * Chunks where the dense operand contains non-finite values are always computed with the dense kernel,
+ * so that the NaNs from multiplying structural zeros with NaN or infinity are propagated as if both seeds were dense.
+ * If neither is sparse, a cache-blocked dense kernel is used.
+ * Transposed seeds are extracted in their own layout, with only the chunks being rearranged as required by each kernel.
+ * The computation for each chunk is parallelized across rows (or columns) of the requested block.
+ */
+class MatrixProduct : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a matrix product.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    MatrixProduct(const H5::Group& handle, const ritsuko::Version& version, Options& options) :
+        MatrixProduct(
+            internal_realize::load_seed(handle, "left_seed", version, options),
+            internal_misc::load_scalar_string_dataset(handle, "left_orientation") == "T",
+            internal_realize::load_seed(handle, "right_seed", version, options),
+            internal_misc::load_scalar_string_dataset(handle, "right_orientation") == "T",
+            options.memory_budget,
+            options.num_threads
+        ) {}
+
+    /**
+     * @param left The left matrix.
+     * @param left_transposed Whether the left matrix should be transposed.
+     * @param right The right matrix.
+     * @param right_transposed Whether the right matrix should be transposed.
+     * @param memory_budget Memory budget in bytes, used to choose the size of each chunk of the common dimension.
+     * @param num_threads Number of threads to use for the computation.
+     */
+    MatrixProduct(std::unique_ptr<Array> left, bool left_transposed, std::unique_ptr<Array> right, bool right_transposed, size_t memory_budget, int num_threads = 1) :
+        Array(product_details(*left, left_transposed, *right, right_transposed)),
+        left(std::move(left)),
+        left_transposed(left_transposed),
+        right(std::move(right)),
+        right_transposed(right_transposed),
+        memory_budget(memory_budget),
+        num_threads(num_threads)
+    {
+        common = this->left->dimensions()[left_transposed ? 0 : 1];
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t nr = count[0], nc = count[1];
+        std::fill_n(buffer, nr * nc, 0);
+        if (nr == 0 || nc == 0) {
+            return;
+        }
+
+        // One extra buffer is needed to rearrange the chunks for the kernels.
+        size_t factor = 2 + std::max(left->workspace(), right->workspace());
+        size_t chunk = std::max(static_cast<size_t>(1), memory_budget / (sizeof(double) * factor * (nr + nc)));
+        chunk = std::min(chunk, common);
+
+        bool left_sparse = left->sparse();
+        bool right_sparse = !left_sparse && right->sparse();
+        std::vector<double> lbuffer, rbuffer, temp, wbuffer;
+        SparseBlock sparse;
+        if (right_sparse) {
+            temp.resize(nc * nr);
+        }
+
+        for (size_t k0 = 0; k0 < common; k0 += chunk) {
+            size_t nk = std::min(chunk, common - k0);
+
+            // The sparse kernel skips structural zeros, so it would drop the NaNs from multiplying them with non-finite values in the dense chunk.
+            // Such chunks are computed with the dense kernel instead, to give the same results regardless of how the seeds are stored.
+            if (left_sparse) {
+                extract_right_by_k(start[1], nc, k0, nk, rbuffer, temp);
+                if (all_finite(rbuffer)) {
+                    // Primary dimension of the sparse chunk corresponds to the rows of the output.
+                    if (left_transposed) {
+                        left->extract_sparse({ k0, start[0] }, { nk, nr }, true, sparse);
+                    } else {
+                        left->extract_sparse({ start[0], k0 }, { nr, nk }, false, sparse);
+                    }
+                    parallel_ranges(nr, sparse.values.size() * nc, [&](size_t from, size_t to) -> void {
+                        sparse_dense(sparse, rbuffer.data(), nc, buffer, from, to);
+                    });
+                } else {
+                    extract_left_by_row(start[0], nr, k0, nk, lbuffer, temp);
+                    parallel_ranges(nr, nr * nk * nc, [&](size_t from, size_t to) -> void {
+                        dense_dense(lbuffer.data(), rbuffer.data(), buffer, from, to, nk, nc);
+                    });
+                }
+
+            } else if (right_sparse) {
+                extract_left_by_k(start[0], nr, k0, nk, lbuffer, rbuffer);
+                if (all_finite(lbuffer)) {
+                    // Primary dimension of the sparse chunk corresponds to the columns of the output, so we compute the transposed product.
+                    if (right_transposed) {
+                        right->extract_sparse({ start[1], k0 }, { nc, nk }, false, sparse);
+                    } else {
+                        right->extract_sparse({ k0, start[1] }, { nk, nc }, true, sparse);
+                    }
+                    parallel_ranges(nc, sparse.values.size() * nr, [&](size_t from, size_t to) -> void {
+                        sparse_dense(sparse, lbuffer.data(), nr, temp.data(), from, to);
+                    });
+                } else {
+                    // Also computing the transposed product here, as 'temp' holds the transposed output.
+                    extract_right_by_column(start[1], nc, k0, nk, rbuffer, wbuffer);
+                    parallel_ranges(nc, nr * nk * nc, [&](size_t from, size_t to) -> void {
+                        dense_dense(rbuffer.data(), lbuffer.data(), temp.data(), from, to, nk, nr);
+                    });
+                }
+
+            } else {
+                extract_left_by_row(start[0], nr, k0, nk, lbuffer, temp);
+                extract_right_by_k(start[1], nc, k0, nk, rbuffer, temp);
+                parallel_ranges(nr, nr * nk * nc, [&](size_t from, size_t to) -> void {
+                    dense_dense(lbuffer.data(), rbuffer.data(), buffer, from, to, nk, nc);
+                });
+            }
+        }
+
+        if (right_sparse) {
+            for (size_t i = 0; i < nr; ++i) {
+                auto out = buffer + i * nc;
+                for (size_t j = 0; j < nc; ++j) {
+                    out[j] = temp[j * nr + i];
+                }
+            }
+        }
+    }
+
+    // Chunks of the common dimension are reported as a single region for each seed.
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        if (count[0] == 0 || count[1] == 0) {
+            return;
+        }
+        if (left_transposed) {
+            left->regions({ 0, start[0] }, { common, count[0] }, output);
+        } else {
+            left->regions({ start[0], 0 }, { count[0], common }, output);
+        }
+        if (right_transposed) {
+            right->regions({ start[1], 0 }, { count[1], common }, output);
+        } else {
+            right->regions({ 0, start[1] }, { common, count[1] }, output);
+        }
+    }
+
+private:
+    std::unique_ptr<Array> left;
+    bool left_transposed;
+    std::unique_ptr<Array> right;
+    bool right_transposed;
+    size_t memory_budget;
+    int num_threads;
+    size_t common;
+
+    // Avoid spinning up threads for small blocks.
+    static constexpr size_t min_work_per_thread = 100000;
+
+    template<class Function_>
+    void parallel_ranges(size_t n, size_t work, Function_ fun) const {
+        size_t num_workers = std::min(static_cast<size_t>(std::max(num_threads, 1)), std::max(static_cast<size_t>(1), work / min_work_per_thread));
+        num_workers = std::min(num_workers, n);
+        internal_parallel::parallelize(num_workers, [&](size_t w) -> void {
+            fun((n * w) / num_workers, (n * (w + 1)) / num_workers);
+        });
+    }
+
+    // Fills 'output' with the chunk of the right matrix where the common dimension is the slowest-changing, i.e., a 'nk x nc' row-major matrix.
+    void extract_right_by_k(size_t cstart, size_t nc, size_t k0, size_t nk, std::vector<double>& output, std::vector<double>& workspace) const {
+        output.resize(nk * nc);
+        if (right_transposed) {
+            workspace.resize(std::max(workspace.size(), nk * nc));
+            right->extract({ cstart, k0 }, { nc, nk }, workspace.data());
+            internal_realize::permute(workspace.data(), { nc, nk }, { 1, 0 }, output.data());
+        } else {
+            right->extract({ k0, cstart }, { nk, nc }, output.data());
+        }
+    }
+
+    // Fills 'output' with the chunk of the right matrix as a 'nc x nk' row-major matrix.
+    void extract_right_by_column(size_t cstart, size_t nc, size_t k0, size_t nk, std::vector<double>& output, std::vector<double>& workspace) const {
+        output.resize(nc * nk);
+        if (right_transposed) {
+            right->extract({ cstart, k0 }, { nc, nk }, output.data());
+        } else {
+            workspace.resize(nk * nc);
+            right->extract({ k0, cstart }, { nk, nc }, workspace.data());
+            internal_realize::permute(workspace.data(), { nk, nc }, { 1, 0 }, output.data());
+        }
+    }
+
+    // Fills 'output' with the chunk of the left matrix as a 'nk x nr' row-major matrix.
+    void extract_left_by_k(size_t rstart, size_t nr, size_t k0, size_t nk, std::vector<double>& output, std::vector<double>& workspace) const {
+        output.resize(nk * nr);
+        if (left_transposed) {
+            left->extract({ k0, rstart }, { nk, nr }, output.data());
+        } else {
+            workspace.resize(nr * nk);
+            left->extract({ rstart, k0 }, { nr, nk }, workspace.data());
+            internal_realize::permute(workspace.data(), { nr, nk }, { 1, 0 }, output.data());
+        }
+    }
+
+    // Fills 'output' with the chunk of the left matrix as a 'nr x nk' row-major matrix.
+    void extract_left_by_row(size_t rstart, size_t nr, size_t k0, size_t nk, std::vector<double>& output, std::vector<double>& workspace) const {
+        output.resize(nr * nk);
+        if (left_transposed) {
+            workspace.resize(std::max(workspace.size(), nr * nk));
+            left->extract({ k0, rstart }, { nk, nr }, workspace.data());
+            internal_realize::permute(workspace.data(), { nk, nr }, { 1, 0 }, output.data());
+        } else {
+            left->extract({ rstart, k0 }, { nr, nk }, output.data());
+        }
+    }
+
+    static bool all_finite(const std::vector<double>& values) {
+        for (auto v : values) {
+            if (!std::isfinite(v)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Adds 'sparse %*% dense' to rows [from, to) of 'output', where 'dense' has 'width' columns and each secondary index of 'sparse' refers to a row of 'dense'.
+    static void sparse_dense(const SparseBlock& sparse, const double* dense, size_t width, double* output, size_t from, size_t to) {
+        for (size_t p = from; p < to; ++p) {
+            auto out = output + p * width;
+            for (size_t x = sparse.pointers[p], end = sparse.pointers[p + 1]; x < end; ++x) {
+                double val = sparse.values[x];
+                auto src = dense + sparse.indices[x] * width;
+                for (size_t j = 0; j < width; ++j) {
+                    out[j] += val * src[j];
+                }
+            }
+        }
+    }
+
+    // Adds 'left %*% right' to rows [from, to) of 'output', where 'left' is 'nr x nk' and 'right' is 'nk x nc'.
+    // The common and column dimensions are blocked so that each tile of 'right' stays in cache while it is used for all rows.
+    static void dense_dense(const double* left, const double* right, double* output, size_t from, size_t to, size_t nk, size_t nc) {
+        constexpr size_t ktile = 128, jtile = 256;
+        for (size_t kk = 0; kk < nk; kk += ktile) {
+            size_t kend = std::min(nk, kk + ktile);
+            for (size_t jj = 0; jj < nc; jj += jtile) {
+                size_t jend = std::min(nc, jj + jtile);
+                for (size_t i = from; i < to; ++i) {
+                    auto out = output + i * nc;
+                    auto lrow = left + i * nk;
+                    for (size_t k = kk; k < kend; ++k) {
+                        double l = lrow[k];
+                        auto rrow = right + k * nc;
+                        for (size_t j = jj; j < jend; ++j) {
+                            out[j] += l * rrow[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    static ArrayDetails product_details(const Array& left, bool left_transposed, const Array& right, bool right_transposed) {
+        const auto& ldims = left.dimensions();
+        const auto& rdims = right.dimensions();
+        if (ldims.size() != 2 || rdims.size() != 2) {
+            throw std::runtime_error("expected 2-dimensional arrays for a matrix product");
+        }
+        if (ldims[left_transposed ? 0 : 1] != rdims[right_transposed ? 1 : 0]) {
+            throw std::runtime_error("inconsistent common dimensions for a matrix product");
+        }
+
+        ArrayDetails output;
+        output.dimensions.push_back(ldims[left_transposed ? 1 : 0]);
+        output.dimensions.push_back(rdims[right_transposed ? 0 : 1]);
+        output.type = ((left.details().type == FLOAT || right.details().type == FLOAT) ? FLOAT : INTEGER);
+        return output;
+    }
+};
+
+}
+
+}
+
+#endif
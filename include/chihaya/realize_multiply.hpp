@@ -0,0 +1,359 @@
+#ifndef CHIHAYA_REALIZE_MULTIPLY_HPP
+#define CHIHAYA_REALIZE_MULTIPLY_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cmath>
+
+#include "realize_array.hpp"
+#include "realize_elementwise.hpp"
+#include "utils_realize.hpp"
+
+/**
+ * @file realize_multiply.hpp
+ * @brief Matrix products with realizable arrays.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @cond
+ */
+namespace internal {
+
+/*
+ * Affine decomposition of a chain of unary arithmetic operations on a sparse seed 'X', i.e.,
+ *
+ *     A[i, j] = row_scale[i] * X[i, j] * col_scale[j] + sum_t terms[t].first[i] * terms[t].second[j]
+ *
+ * so that products with 'A' can be computed as a sparse product with 'X' plus a low-rank correction.
+ */
+struct AffinePlan {
+    const Array* seed = nullptr;
+    std::vector<double> row_scale, col_scale;
+    std::vector<std::pair<std::vector<double>, std::vector<double> > > terms;
+};
+
+inline bool plan_affine_step(const ElementwiseStep& step, AffinePlan& plan) {
+    size_t nr = plan.row_scale.size(), nc = plan.col_scale.size();
+    bool is_row = true;
+    std::vector<double> expanded;
+    if (step.values.empty()) {
+        if (step.unary != UnaryMethod::NEGATE) {
+            return false;
+        }
+        expanded.resize(nr, -1);
+    } else if (step.values.size() == 1) {
+        expanded.resize(nr, step.values.front());
+    } else {
+        is_row = (step.along == 0);
+        expanded = step.values;
+    }
+
+    for (auto x : expanded) {
+        if (!std::isfinite(x)) {
+            return false;
+        }
+    }
+
+    auto scale = [&](const std::vector<double>& factors) -> void {
+        auto& target = (is_row ? plan.row_scale : plan.col_scale);
+        for (size_t i = 0, end = target.size(); i < end; ++i) {
+            target[i] *= factors[i];
+        }
+        for (auto& t : plan.terms) {
+            auto& side = (is_row ? t.first : t.second);
+            for (size_t i = 0, end = side.size(); i < end; ++i) {
+                side[i] *= factors[i];
+            }
+        }
+    };
+
+    auto shift = [&](std::vector<double> values) -> void {
+        if (is_row) {
+            plan.terms.emplace_back(std::move(values), std::vector<double>(nc, 1));
+        } else {
+            plan.terms.emplace_back(std::vector<double>(nr, 1), std::move(values));
+        }
+    };
+
+    if (step.values.empty()) {
+        scale(expanded);
+        return true;
+    }
+
+    switch (step.binary) {
+        case BinaryMethod::ADD:
+            shift(std::move(expanded));
+            return true;
+        case BinaryMethod::SUBTRACT:
+            if (step.right) {
+                for (auto& x : expanded) {
+                    x *= -1;
+                }
+            } else {
+                scale(std::vector<double>(expanded.size(), -1));
+            }
+            shift(std::move(expanded));
+            return true;
+        case BinaryMethod::MULTIPLY:
+            scale(expanded);
+            return true;
+        case BinaryMethod::DIVIDE:
+            if (!step.right) {
+                return false;
+            }
+            for (auto& x : expanded) {
+                if (x == 0) {
+                    return false;
+                }
+                x = 1 / x;
+            }
+            scale(expanded);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Collects the steps of a chain of (fused or unfused) unary operations above 'array', from the outermost to the innermost, and returns the seed of the chain.
+inline const Array* collect_steps(const Array& array, std::vector<ElementwiseStep>& steps) {
+    const Array* current = &array;
+    while (true) {
+        auto fused = dynamic_cast<const FusedOperation*>(current);
+        if (fused) {
+            const auto& chain = fused->get_steps();
+            steps.insert(steps.end(), chain.rbegin(), chain.rend());
+            current = &(fused->get_seed());
+            continue;
+        }
+
+        auto scalar = dynamic_cast<const ScalarOperation*>(current);
+        if (scalar) {
+            ElementwiseStep step;
+            step.binary = scalar->get_method();
+            step.right = scalar->get_right();
+            step.values = scalar->get_values();
+            step.along = scalar->get_along();
+            steps.push_back(std::move(step));
+            current = &(scalar->get_seed());
+            continue;
+        }
+
+        auto unary = dynamic_cast<const UnaryOperation*>(current);
+        if (unary) {
+            ElementwiseStep step;
+            step.unary = unary->get_method();
+            step.parameter = unary->get_parameter();
+            if (step.unary != UnaryMethod::IDENTITY) {
+                steps.push_back(std::move(step));
+            }
+            current = &(unary->get_seed());
+            continue;
+        }
+
+        return current;
+    }
+}
+
+inline bool plan_affine(const Array& array, AffinePlan& plan) {
+    const auto& dims = array.dimensions();
+    if (dims.size() != 2) {
+        return false;
+    }
+    plan.row_scale.assign(dims[0], 1);
+    plan.col_scale.assign(dims[1], 1);
+    plan.terms.clear();
+
+    std::vector<ElementwiseStep> steps;
+    auto seed = collect_steps(array, steps);
+    if (!seed->sparse()) {
+        return false;
+    }
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+        if (!plan_affine_step(*it, plan)) {
+            return false;
+        }
+    }
+
+    plan.seed = seed;
+    return true;
+}
+
+// Adds 'X %*% w' (or 't(X) %*% w') to 'out', streaming 'X' in blocks of its preferred orientation.
+inline void sparse_product(const Array& seed, bool transposed, const double* w, size_t k, double* out, size_t memory_budget) {
+    size_t nr = seed.dimensions()[0], nc = seed.dimensions()[1];
+    bool by_column = seed.sparse_by_column();
+    size_t primary = (by_column ? nc : nr), secondary = (by_column ? nr : nc);
+
+    // Assuming the worst case of a dense block, where each element requires an index and a value.
+    size_t chunk = std::max(static_cast<size_t>(1), memory_budget / (std::max(secondary, static_cast<size_t>(1)) * (sizeof(size_t) + sizeof(double))));
+    chunk = std::min(chunk, primary);
+
+    SparseBlock block;
+    for (size_t p0 = 0; p0 < primary; p0 += chunk) {
+        size_t np = std::min(chunk, primary - p0);
+        if (by_column) {
+            seed.extract_sparse({ 0, p0 }, { nr, np }, true, block);
+        } else {
+            seed.extract_sparse({ p0, 0 }, { np, nc }, false, block);
+        }
+
+        for (size_t p = 0; p < np; ++p) {
+            for (size_t x = block.pointers[p], end = block.pointers[p + 1]; x < end; ++x) {
+                size_t r = (by_column ? block.indices[x] : p0 + p);
+                size_t c = (by_column ? p0 + p : block.indices[x]);
+                size_t from = (transposed ? r : c), to = (transposed ? c : r);
+                double val = block.values[x];
+                auto src = w + from * k;
+                auto dest = out + to * k;
+                for (size_t j = 0; j < k; ++j) {
+                    dest[j] += val * src[j];
+                }
+            }
+        }
+    }
+}
+
+// Adds 'A %*% x' (or 't(A) %*% x') to 'out' by realizing 'A' in dense blocks of rows.
+inline void dense_product(const Array& array, bool transposed, const double* x, size_t k, double* out, size_t memory_budget) {
+    size_t nr = array.dimensions()[0], nc = array.dimensions()[1];
+    size_t per_row = std::max(static_cast<size_t>(1), nc * sizeof(double) * (1 + array.workspace()));
+    size_t chunk = std::min(std::max(static_cast<size_t>(1), memory_budget / per_row), nr);
+
+    std::vector<double> buffer;
+    for (size_t r0 = 0; r0 < nr; r0 += chunk) {
+        size_t len = std::min(chunk, nr - r0);
+        buffer.resize(len * nc);
+        array.extract({ r0, 0 }, { len, nc }, buffer.data());
+        for (size_t r = 0; r < len; ++r) {
+            auto row = buffer.data() + r * nc;
+            for (size_t c = 0; c < nc; ++c) {
+                size_t from = (transposed ? r0 + r : c), to = (transposed ? c : r0 + r);
+                auto src = x + from * k;
+                auto dest = out + to * k;
+                for (size_t j = 0; j < k; ++j) {
+                    dest[j] += row[c] * src[j];
+                }
+            }
+        }
+    }
+}
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Multiply a 2-dimensional array by a dense matrix, i.e., compute `A %*% X` or `t(A) %*% X` for an array `A`.
+ *
+ * If `A` is a sparse matrix, or a chain of unary arithmetic operations (addition, subtraction, multiplication, division by a value) on a sparse seed,
+ * whether fused into a `FusedOperation` or left as separate `ScalarOperation` and `UnaryOperation` instances (i.e., with `Options::fuse_elementwise = false`),
+ * `A` is decomposed into `diag(u) %*% S %*% diag(v) + P %*% t(Q)` where `S` is the sparse seed and `P` and `Q` have one column per additive operation.
+ * The product is then computed by streaming `S` in compressed sparse form and adding the low-rank correction,
+ * so that common transformations like centering and scaling do not require densification.
+ * All other arrays are realized in dense blocks of rows, respecting `Options::memory_budget`.
+ *
+ * The decomposition may introduce small floating-point differences compared to a product with the realized `A`.
+ * If any of the values in the chain or in `rhs` are not finite, or a division by zero is involved, the dense path is used to respect IEEE semantics for the structural zeros.
+ *
+ * @param array A 2-dimensional array created by `load()`.
+ * @param transposed Whether to multiply by the transpose of `array`.
+ * @param rhs Pointer to a row-major matrix with `k` columns and number of rows equal to the number of columns of `array` (or rows, if `transposed = true`).
+ * @param k Number of columns of `rhs`, i.e., the number of vectors to multiply with `array`.
+ * @param[out] output Pointer to a row-major matrix with `k` columns and number of rows equal to the number of rows of `array` (or columns, if `transposed = true`).
+ * On output, this is filled with the product.
+ * @param options Realization options.
+ */
+inline void multiply(const Array& array, bool transposed, const double* rhs, size_t k, double* output, const Options& options) {
+    const auto& dims = array.dimensions();
+    if (dims.size() != 2) {
+        throw std::runtime_error("matrix products are only supported for 2-dimensional arrays");
+    }
+    size_t outer = dims[transposed ? 1 : 0], inner = dims[transposed ? 0 : 1];
+    std::fill_n(output, outer * k, 0);
+
+    // Non-finite values in 'rhs' must meet the structural zeros of the seed to give NaNs, so these are handled by the dense path.
+    bool finite = true;
+    for (size_t i = 0, end = inner * k; i < end; ++i) {
+        if (!std::isfinite(rhs[i])) {
+            finite = false;
+            break;
+        }
+    }
+
+    internal::AffinePlan plan;
+    if (!finite || !internal::plan_affine(array, plan)) {
+        internal::dense_product(array, transposed, rhs, k, output, options.memory_budget);
+        return;
+    }
+
+    const auto& inner_scale = (transposed ? plan.row_scale : plan.col_scale);
+    const auto& outer_scale = (transposed ? plan.col_scale : plan.row_scale);
+
+    // Sparse product with the inner scaling applied to 'rhs' and the outer scaling applied to the result.
+    std::vector<double> scaled(rhs, rhs + inner * k);
+    for (size_t i = 0; i < inner; ++i) {
+        for (size_t j = 0; j < k; ++j) {
+            scaled[i * k + j] *= inner_scale[i];
+        }
+    }
+    internal::sparse_product(*plan.seed, transposed, scaled.data(), k, output, options.memory_budget);
+    for (size_t o = 0; o < outer; ++o) {
+        for (size_t j = 0; j < k; ++j) {
+            output[o * k + j] *= outer_scale[o];
+        }
+    }
+
+    // Low-rank correction.
+    std::vector<double> dots(k);
+    for (const auto& t : plan.terms) {
+        const auto& inner_side = (transposed ? t.first : t.second);
+        const auto& outer_side = (transposed ? t.second : t.first);
+        std::fill(dots.begin(), dots.end(), 0);
+        for (size_t i = 0; i < inner; ++i) {
+            for (size_t j = 0; j < k; ++j) {
+                dots[j] += inner_side[i] * rhs[i * k + j];
+            }
+        }
+        for (size_t o = 0; o < outer; ++o) {
+            for (size_t j = 0; j < k; ++j) {
+                output[o * k + j] += outer_side[o] * dots[j];
+            }
+        }
+    }
+}
+
+/**
+ * Multiply a 2-dimensional array by a vector, see `multiply()` for details.
+ *
+ * @param array A 2-dimensional array created by `load()`.
+ * @param transposed Whether to multiply by the transpose of `array`.
+ * @param rhs Vector of length equal to the number of columns of `array` (or rows, if `transposed = true`).
+ * @param options Realization options.
+ *
+ * @return Vector of length equal to the number of rows of `array` (or columns, if `transposed = true`), containing the product.
+ */
+inline std::vector<double> multiply(const Array& array, bool transposed, const std::vector<double>& rhs, const Options& options) {
+    const auto& dims = array.dimensions();
+    if (dims.size() != 2) {
+        throw std::runtime_error("matrix products are only supported for 2-dimensional arrays");
+    }
+    if (rhs.size() != dims[transposed ? 0 : 1]) {
+        throw std::runtime_error("length of 'rhs' should be equal to the common dimension of the product");
+    }
+    std::vector<double> output(dims[transposed ? 1 : 0]);
+    multiply(array, transposed, rhs.data(), 1, output.data(), options);
+    return output;
+}
+
+}
+
+}
+
+#endif
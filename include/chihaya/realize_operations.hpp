@@ -0,0 +1,647 @@
+#ifndef CHIHAYA_REALIZE_OPERATIONS_HPP
+#define CHIHAYA_REALIZE_OPERATIONS_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <limits>
+
+#include "realize_array.hpp"
+#include "utils_realize.hpp"
+#include "utils_misc.hpp"
+#include "utils_profile.hpp"
+
+/**
+ * @file realize_operations.hpp
+ * @brief Realization of structural operations, i.e., subsetting, combining and transposition.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @brief Delayed subset.
+ *
+ * Each requested block is mapped to the corresponding indices of the seed, which are then extracted in runs of nearby positions.
+ */
+class Subset : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a subset operation.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    Subset(const H5::Group& handle, const ritsuko::Version& version, Options& options) :
+        Subset(internal_realize::load_seed(handle, "seed", version, options), internal_realize::load_index_list(ritsuko::hdf5::open_group(handle, "index"), version)) {}
+
+    /**
+     * @param seed The seed array.
+     * @param index Indices to subset each dimension of the seed.
+     */
+    Subset(std::unique_ptr<Array> seed, internal_realize::IndexList index) :
+        Array(subset_details(*seed, index)),
+        seed(std::move(seed)),
+        index(std::move(index))
+    {}
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        internal_realize::gather(*seed, seed_positions(start, count), buffer);
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        internal_realize::gather_regions(*seed, seed_positions(start, count), output);
+    }
+
+    size_t workspace() const {
+        return internal_realize::gather_workspace(*seed);
+    }
+
+    bool sparse() const {
+        return seed->sparse();
+    }
+
+    bool sparse_by_column() const {
+        return seed->sparse_by_column();
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        if (!sparse()) {
+            Array::extract_sparse(start, count, by_column, output);
+            return;
+        }
+
+        size_t p = (by_column ? 1 : 0), s = 1 - p;
+        internal_realize::clear_sparse(output, by_column, count[p]);
+        if (count[0] == 0 || count[1] == 0) {
+            return;
+        }
+
+        // Extracting each combination of runs from the seed, so that the extracted blocks are proportional to the number of requested positions.
+        auto positions = seed_positions(start, count);
+        auto primary_plan = internal_realize::plan_gather(positions[p]);
+        auto secondary_plan = internal_realize::plan_gather(positions[s]);
+
+        // Mapping each offset in each secondary run to its (possibly multiple) positions in the output.
+        size_t nsruns = secondary_plan.runs.size();
+        std::vector<std::vector<size_t> > map_pointers(nsruns), map_targets(nsruns);
+        for (size_t r = 0; r < nsruns; ++r) {
+            const auto& members = secondary_plan.members[r];
+            auto& pointers = map_pointers[r];
+            pointers.resize(secondary_plan.runs[r].second + 1);
+            for (const auto& m : members) {
+                ++pointers[m.second + 1];
+            }
+            for (size_t i = 1, end = pointers.size(); i < end; ++i) {
+                pointers[i] += pointers[i - 1];
+            }
+            auto& targets = map_targets[r];
+            targets.resize(members.size());
+            std::vector<size_t> next(pointers.begin(), pointers.end() - 1);
+            for (const auto& m : members) {
+                targets[next[m.second]++] = m.first;
+            }
+        }
+
+        // Runs are visited in increasing order of the seed's secondary positions, so sorted positions yield sorted output indices.
+        bool sorted = std::is_sorted(positions[s].begin(), positions[s].end());
+
+        std::vector<std::vector<std::pair<size_t, double> > > collected(count[p]);
+        std::vector<size_t> seed_start(2), seed_count(2);
+        SparseBlock contents;
+        for (size_t pr = 0, npruns = primary_plan.runs.size(); pr < npruns; ++pr) {
+            seed_start[p] = primary_plan.runs[pr].first;
+            seed_count[p] = primary_plan.runs[pr].second;
+            const auto& pmembers = primary_plan.members[pr];
+
+            for (size_t sr = 0; sr < nsruns; ++sr) {
+                seed_start[s] = secondary_plan.runs[sr].first;
+                seed_count[s] = secondary_plan.runs[sr].second;
+                seed->extract_sparse(seed_start, seed_count, by_column, contents);
+
+                const auto& pointers = map_pointers[sr];
+                const auto& targets = map_targets[sr];
+                for (const auto& m : pmembers) {
+                    auto& current = collected[m.first];
+                    for (size_t k = contents.pointers[m.second], end = contents.pointers[m.second + 1]; k < end; ++k) {
+                        auto idx = contents.indices[k];
+                        for (size_t t = pointers[idx], tend = pointers[idx + 1]; t < tend; ++t) {
+                            current.emplace_back(targets[t], contents.values[k]);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count[p]; ++i) {
+            auto& current = collected[i];
+            if (!sorted) {
+                std::sort(current.begin(), current.end());
+            }
+            for (const auto& c : current) {
+                output.indices.push_back(c.first);
+                output.values.push_back(c.second);
+            }
+            output.pointers[i + 1] = output.indices.size();
+            std::vector<std::pair<size_t, double> >().swap(current);
+        }
+    }
+
+    /**
+     * @cond
+     */
+    const internal_realize::IndexList& get_index() const {
+        return index;
+    }
+
+    std::unique_ptr<Array> release_seed() {
+        return std::move(seed);
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> seed;
+    internal_realize::IndexList index;
+
+    // Maps a block of the subset to the corresponding positions of the seed in each dimension.
+    std::vector<std::vector<size_t> > seed_positions(const std::vector<size_t>& start, const std::vector<size_t>& count) const {
+        size_t ndims = count.size();
+        std::vector<std::vector<size_t> > positions(ndims);
+        for (size_t d = 0; d < ndims; ++d) {
+            auto& current = positions[d];
+            if (index.present[d]) {
+                auto it = index.indices[d].begin() + start[d];
+                current.insert(current.end(), it, it + count[d]);
+            } else {
+                current.resize(count[d]);
+                for (size_t i = 0; i < count[d]; ++i) {
+                    current[i] = start[d] + i;
+                }
+            }
+        }
+        return positions;
+    }
+
+    static ArrayDetails subset_details(const Array& seed, const internal_realize::IndexList& index) {
+        auto output = seed.details();
+        for (size_t d = 0, end = index.present.size(); d < end; ++d) {
+            if (index.present[d]) {
+                output.dimensions[d] = index.indices[d].size();
+            }
+        }
+        return output;
+    }
+};
+
+/**
+ * @brief Delayed combination.
+ *
+ * Each requested block is assembled from the overlapping blocks of the seeds.
+ * If the seeds are combined along the first dimension, each seed's block is extracted directly into the output buffer.
+ */
+class Combine : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a combining operation.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    Combine(const H5::Group& handle, const ritsuko::Version& version, Options& options) :
+        Combine(load_seeds(handle, version, options), internal_misc::load_along(handle, version)) {}
+
+    /**
+     * @param seeds The seed arrays.
+     * @param along Dimension along which the seeds are combined.
+     */
+    Combine(std::vector<std::unique_ptr<Array> > seeds, size_t along) :
+        Array(combine_details(seeds, along)),
+        seeds(std::move(seeds)),
+        along(along)
+    {
+        offsets.reserve(this->seeds.size() + 1);
+        offsets.push_back(0);
+        for (const auto& s : this->seeds) {
+            offsets.push_back(offsets.back() + s->dimensions()[along]);
+        }
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t ndims = count.size();
+        size_t outer = 1, inner = 1;
+        for (size_t d = 0; d < along; ++d) {
+            outer *= count[d];
+        }
+        for (size_t d = along + 1; d < ndims; ++d) {
+            inner *= count[d];
+        }
+
+        size_t first = start[along], last = start[along] + count[along];
+        size_t s = std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin() - 1;
+        auto sub_start = start;
+        auto sub_count = count;
+        std::vector<double> temp;
+
+        for (; s < seeds.size() && offsets[s] < last; ++s) {
+            size_t from = std::max(first, offsets[s]), to = std::min(last, offsets[s + 1]);
+            if (from >= to) {
+                continue;
+            }
+            sub_start[along] = from - offsets[s];
+            sub_count[along] = to - from;
+            size_t shift = (from - first) * inner;
+
+            if (along == 0) {
+                seeds[s]->extract(sub_start, sub_count, buffer + shift);
+            } else {
+                size_t sub_run = sub_count[along] * inner, full_run = count[along] * inner;
+                temp.resize(outer * sub_run);
+                seeds[s]->extract(sub_start, sub_count, temp.data());
+                for (size_t o = 0; o < outer; ++o) {
+                    std::copy_n(temp.data() + o * sub_run, sub_run, buffer + o * full_run + shift);
+                }
+            }
+        }
+    }
+
+    size_t workspace() const {
+        size_t output = 0;
+        for (const auto& s : seeds) {
+            output = std::max(output, s->workspace());
+        }
+        return output + (along != 0);
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        size_t first = start[along], last = start[along] + count[along];
+        size_t s = std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin() - 1;
+        auto sub_start = start;
+        auto sub_count = count;
+        for (; s < seeds.size() && offsets[s] < last; ++s) {
+            size_t from = std::max(first, offsets[s]), to = std::min(last, offsets[s + 1]);
+            if (from >= to) {
+                continue;
+            }
+            sub_start[along] = from - offsets[s];
+            sub_count[along] = to - from;
+            seeds[s]->regions(sub_start, sub_count, output);
+        }
+    }
+
+    bool sparse() const {
+        for (const auto& s : seeds) {
+            if (!s->sparse()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sparse_by_column() const {
+        return seeds.front()->sparse_by_column();
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        if (!sparse()) {
+            Array::extract_sparse(start, count, by_column, output);
+            return;
+        }
+
+        size_t p = (by_column ? 1 : 0);
+        internal_realize::clear_sparse(output, by_column, count[p]);
+        size_t first = start[along], last = start[along] + count[along];
+        size_t s = std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin() - 1;
+        auto sub_start = start;
+        auto sub_count = count;
+
+        std::vector<SparseBlock> contents;
+        std::vector<size_t> shifts;
+        for (; s < seeds.size() && offsets[s] < last; ++s) {
+            size_t from = std::max(first, offsets[s]), to = std::min(last, offsets[s + 1]);
+            if (from >= to) {
+                continue;
+            }
+            sub_start[along] = from - offsets[s];
+            sub_count[along] = to - from;
+            contents.emplace_back();
+            seeds[s]->extract_sparse(sub_start, sub_count, by_column, contents.back());
+            shifts.push_back(from - first);
+        }
+
+        if (along == p) {
+            // Each seed contributes a contiguous range of primary elements.
+            for (size_t c = 0; c < contents.size(); ++c) {
+                const auto& current = contents[c];
+                for (size_t i = 0, np = current.pointers.size() - 1; i < np; ++i) {
+                    output.indices.insert(output.indices.end(), current.indices.begin() + current.pointers[i], current.indices.begin() + current.pointers[i + 1]);
+                    output.values.insert(output.values.end(), current.values.begin() + current.pointers[i], current.values.begin() + current.pointers[i + 1]);
+                    output.pointers[shifts[c] + i + 1] = output.indices.size();
+                }
+            }
+        } else {
+            // Each seed contributes a contiguous range of secondary indices within each primary element, so concatenation preserves the ordering.
+            for (size_t i = 0; i < count[p]; ++i) {
+                for (size_t c = 0; c < contents.size(); ++c) {
+                    const auto& current = contents[c];
+                    for (size_t k = current.pointers[i], end = current.pointers[i + 1]; k < end; ++k) {
+                        output.indices.push_back(current.indices[k] + shifts[c]);
+                        output.values.push_back(current.values[k]);
+                    }
+                }
+                output.pointers[i + 1] = output.indices.size();
+            }
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Array> > seeds;
+    size_t along;
+    std::vector<size_t> offsets;
+
+    static std::vector<std::unique_ptr<Array> > load_seeds(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+        auto shandle = ritsuko::hdf5::open_group(handle, "seeds");
+        auto list_params = internal_list::validate(shandle, version);
+        std::vector<std::unique_ptr<Array> > output;
+        output.reserve(list_params.length);
+        for (const auto& p : list_params.present) {
+            output.push_back(internal_realize::load_seed(shandle, p.second, version, options));
+        }
+        return output;
+    }
+
+    static ArrayDetails combine_details(const std::vector<std::unique_ptr<Array> >& seeds, size_t along) {
+        if (seeds.empty()) {
+            throw std::runtime_error("expected at least one seed in 'seeds'");
+        }
+        auto output = seeds.front()->details();
+        for (size_t s = 1, end = seeds.size(); s < end; ++s) {
+            const auto& current = seeds[s]->details();
+            output.type = std::max(output.type, current.type);
+            output.dimensions[along] += current.dimensions[along];
+        }
+        return output;
+    }
+};
+
+/**
+ * @brief Delayed transposition.
+ *
+ * Each requested block is extracted from the seed in the seed's layout and then permuted.
+ */
+class Transpose : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a transposition.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    Transpose(const H5::Group& handle, const ritsuko::Version& version, Options& options) :
+        Transpose(internal_realize::load_seed(handle, "seed", version, options), internal_realize::load_indices(internal_profile::open_dataset(handle, "permutation"))) {}
+
+    /**
+     * @param seed The seed array.
+     * @param permutation Permutation of the seed's dimensions, where dimension `p` of the output corresponds to dimension `permutation[p]` of the seed.
+     */
+    Transpose(std::unique_ptr<Array> seed, std::vector<size_t> permutation) :
+        Array(transpose_details(*seed, permutation)),
+        seed(std::move(seed)),
+        permutation(std::move(permutation))
+    {}
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t ndims = count.size();
+        std::vector<size_t> seed_start(ndims), seed_count(ndims);
+        for (size_t p = 0; p < ndims; ++p) {
+            seed_start[permutation[p]] = start[p];
+            seed_count[permutation[p]] = count[p];
+        }
+
+        std::vector<double> temp(internal_realize::product(count));
+        seed->extract(seed_start, seed_count, temp.data());
+        internal_realize::permute(temp.data(), seed_count, permutation, buffer);
+    }
+
+    size_t workspace() const {
+        return 1 + seed->workspace();
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        size_t ndims = count.size();
+        std::vector<size_t> seed_start(ndims), seed_count(ndims);
+        for (size_t p = 0; p < ndims; ++p) {
+            seed_start[permutation[p]] = start[p];
+            seed_count[permutation[p]] = count[p];
+        }
+        seed->regions(seed_start, seed_count, output);
+    }
+
+    bool sparse() const {
+        return seed->sparse();
+    }
+
+    bool sparse_by_column() const {
+        return (permutation[0] == 1 ? !seed->sparse_by_column() : seed->sparse_by_column());
+    }
+
+    void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, SparseBlock& output) const {
+        if (!sparse()) {
+            Array::extract_sparse(start, count, by_column, output);
+            return;
+        }
+
+        // A CSC block of the seed is a CSR block of its transpose, so no rearrangement is required.
+        bool flipped = (permutation[0] == 1);
+        if (flipped) {
+            seed->extract_sparse({ start[1], start[0] }, { count[1], count[0] }, !by_column, output);
+        } else {
+            seed->extract_sparse(start, count, by_column, output);
+        }
+        output.by_column = by_column;
+    }
+
+    /**
+     * @cond
+     */
+    const std::vector<size_t>& get_permutation() const {
+        return permutation;
+    }
+
+    std::unique_ptr<Array> release_seed() {
+        return std::move(seed);
+    }
+    /**
+     * @endcond
+     */
+
+private:
+    std::unique_ptr<Array> seed;
+    std::vector<size_t> permutation;
+
+    static ArrayDetails transpose_details(const Array& seed, const std::vector<size_t>& permutation) {
+        auto output = seed.details();
+        for (size_t p = 0, end = permutation.size(); p < end; ++p) {
+            output.dimensions[p] = seed.dimensions()[permutation[p]];
+        }
+        return output;
+    }
+};
+
+/**
+ * @brief Delayed subset assignment.
+ *
+ * Each requested block is extracted from the seed, after which the assigned positions in the block are replaced with the corresponding values.
+ * If the same position is assigned multiple times, the last assignment is used.
+ */
+class SubsetAssignment : public Array {
+public:
+    /**
+     * @param handle An open handle on a HDF5 group representing a subset assignment.
+     * @param version Version of the **chihaya** specification.
+     * @param options Realization options.
+     */
+    SubsetAssignment(const H5::Group& handle, const ritsuko::Version& version, Options& options) :
+        SubsetAssignment(
+            internal_realize::load_seed(handle, "seed", version, options),
+            internal_realize::load_seed(handle, "value", version, options),
+            internal_realize::load_index_list(ritsuko::hdf5::open_group(handle, "index"), version)
+        ) {}
+
+    /**
+     * @param seed The seed array.
+     * @param value Array of replacement values.
+     * @param index Indices of the seed to be replaced in each dimension.
+     */
+    SubsetAssignment(std::unique_ptr<Array> seed, std::unique_ptr<Array> value, const internal_realize::IndexList& index) :
+        Array(ArrayDetails(std::max(seed->details().type, value->details().type), seed->dimensions())),
+        seed(std::move(seed)),
+        value(std::move(value))
+    {
+        const auto& dims = this->seed->dimensions();
+        size_t ndims = dims.size();
+        assigned.resize(ndims);
+        for (size_t d = 0; d < ndims; ++d) {
+            if (index.present[d]) {
+                auto& current = assigned[d];
+                current.resize(dims[d], unassigned);
+                const auto& indices = index.indices[d];
+                for (size_t i = 0, end = indices.size(); i < end; ++i) {
+                    current[indices[i]] = i;
+                }
+            }
+        }
+    }
+
+    void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+        size_t ndims = count.size();
+        std::vector<std::vector<size_t> > block_positions(ndims), value_positions(ndims);
+        bool any = find_assigned(start, count, block_positions, value_positions);
+
+        // The seed is not read at all if every position in the block is replaced.
+        if (!any || !is_covered(count, block_positions)) {
+            seed->extract(start, count, buffer);
+        }
+        if (!any) {
+            return;
+        }
+
+        size_t total = 1;
+        for (const auto& v : value_positions) {
+            total *= v.size();
+        }
+        std::vector<double> temp(total);
+        internal_realize::gather(*value, value_positions, temp.data());
+
+        auto block_strides = internal_realize::strides(count);
+        size_t counter = 0;
+        auto scatter = [&](auto& self, size_t d, size_t offset) -> void {
+            const auto& bpos = block_positions[d];
+            if (d + 1 == ndims) {
+                for (auto b : bpos) {
+                    buffer[offset + b] = temp[counter];
+                    ++counter;
+                }
+            } else {
+                for (auto b : bpos) {
+                    self(self, d + 1, offset + b * block_strides[d]);
+                }
+            }
+        };
+        scatter(scatter, 0, 0);
+    }
+
+    size_t workspace() const {
+        return std::max(seed->workspace(), 1 + internal_realize::gather_workspace(*value));
+    }
+
+    void regions(const std::vector<size_t>& start, const std::vector<size_t>& count, std::vector<Region>& output) const {
+        size_t ndims = count.size();
+        std::vector<std::vector<size_t> > block_positions(ndims), value_positions(ndims);
+        bool any = find_assigned(start, count, block_positions, value_positions);
+        if (!any || !is_covered(count, block_positions)) {
+            seed->regions(start, count, output);
+        }
+        if (any) {
+            internal_realize::gather_regions(*value, value_positions, output);
+        }
+    }
+
+private:
+    std::unique_ptr<Array> seed, value;
+    std::vector<std::vector<size_t> > assigned;
+    static constexpr size_t unassigned = std::numeric_limits<size_t>::max();
+
+    // Finds the positions in the block that were assigned, and the corresponding positions in 'value'.
+    // Returns false if no positions in the block were assigned.
+    bool find_assigned(
+        const std::vector<size_t>& start,
+        const std::vector<size_t>& count,
+        std::vector<std::vector<size_t> >& block_positions,
+        std::vector<std::vector<size_t> >& value_positions)
+    const {
+        for (size_t d = 0, ndims = count.size(); d < ndims; ++d) {
+            auto& bpos = block_positions[d];
+            auto& vpos = value_positions[d];
+            if (assigned[d].empty()) {
+                for (size_t i = 0; i < count[d]; ++i) {
+                    bpos.push_back(i);
+                    vpos.push_back(start[d] + i);
+                }
+            } else {
+                for (size_t i = 0; i < count[d]; ++i) {
+                    auto j = assigned[d][start[d] + i];
+                    if (j != unassigned) {
+                        bpos.push_back(i);
+                        vpos.push_back(j);
+                    }
+                }
+            }
+            if (bpos.empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool is_covered(const std::vector<size_t>& count, const std::vector<std::vector<size_t> >& block_positions) {
+        for (size_t d = 0, ndims = count.size(); d < ndims; ++d) {
+            if (block_positions[d].size() != count[d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef CHIHAYA_REALIZE_REWRITE_HPP
+#define CHIHAYA_REALIZE_REWRITE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "realize_array.hpp"
+#include "realize_operations.hpp"
+#include "realize_elementwise.hpp"
+#include "realize_arrays.hpp"
+#include "utils_realize.hpp"
+
+/**
+ * @file realize_rewrite.hpp
+ * @brief Rewriting of delayed operations during loading.
+ */
+
+namespace chihaya {
+
+namespace realize {
+
+/**
+ * @cond
+ */
+namespace internal {
+
+// Composes 'outer' on top of 'inner', i.e., subset(subset(x, inner), outer) becomes subset(x, composed).
+inline internal_realize::IndexList compose_subsets(const internal_realize::IndexList& inner, const internal_realize::IndexList& outer) {
+    auto output = inner;
+    for (size_t d = 0, ndims = outer.present.size(); d < ndims; ++d) {
+        if (!outer.present[d]) {
+            continue;
+        }
+        if (inner.present[d]) {
+            auto& current = output.indices[d];
+            current.clear();
+            current.reserve(outer.indices[d].size());
+            for (auto i : outer.indices[d]) {
+                current.push_back(inner.indices[d][i]);
+            }
+        } else {
+            output.present[d] = true;
+            output.indices[d] = outer.indices[d];
+        }
+    }
+    return output;
+}
+
+/*
+ * Creates a subset of 'seed', where the subset is pushed below any elementwise operations and merged with any subsets in the seed.
+ * This ensures that the elementwise operations are only applied to the retained elements, and that consecutive subsets are resolved with a single gather from the leaf.
+ */
+inline std::unique_ptr<Array> make_subset(std::unique_ptr<Array> seed, internal_realize::IndexList index, const Options& options) {
+    if (!options.rewrite_subsets) {
+        return std::unique_ptr<Array>(new Subset(std::move(seed), std::move(index)));
+    }
+
+    // Dropping indices that do not modify their dimension.
+    const auto& dims = seed->dimensions();
+    bool any_present = false, any_empty = false;
+    for (size_t d = 0, ndims = index.present.size(); d < ndims; ++d) {
+        if (!index.present[d]) {
+            continue;
+        }
+        const auto& current = index.indices[d];
+        if (current.size() == dims[d] && internal_realize::is_consecutive(current) && (current.empty() || current.front() == 0)) {
+            index.present[d] = false;
+            index.indices[d].clear();
+        } else {
+            any_present = true;
+            any_empty = any_empty || current.empty();
+        }
+    }
+    if (!any_present) {
+        return seed;
+    }
+
+    // Empty subsets are left alone, as there is nothing to compute anyway and pushing them down would empty the 'along' vectors of the operations.
+    if (!any_empty) {
+        auto recurse = [&](std::unique_ptr<Array> child, const internal_realize::IndexList& child_index) -> std::unique_ptr<Array> {
+            return make_subset(std::move(child), child_index, options);
+        };
+
+        if (auto ptr = dynamic_cast<Subset*>(seed.get())) {
+            auto composed = compose_subsets(ptr->get_index(), index);
+            return make_subset(ptr->release_seed(), std::move(composed), options);
+        } else if (auto ptr = dynamic_cast<FusedOperation*>(seed.get())) {
+            return ptr->push_subset(index, recurse);
+        } else if (auto ptr = dynamic_cast<ScalarOperation*>(seed.get())) {
+            return ptr->push_subset(index, recurse);
+        } else if (auto ptr = dynamic_cast<UnaryOperation*>(seed.get())) {
+            return ptr->push_subset(index, recurse);
+        } else if (auto ptr = dynamic_cast<BinaryOperation*>(seed.get())) {
+            return ptr->push_subset(index, recurse);
+        }
+    }
+
+    return std::unique_ptr<Array>(new Subset(std::move(seed), std::move(index)));
+}
+
+inline std::unique_ptr<Array> load_subset(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = internal_realize::load_seed(handle, "seed", version, options);
+    auto index = internal_realize::load_index_list(ritsuko::hdf5::open_group(handle, "index"), version);
+    return make_subset(std::move(seed), std::move(index), options);
+}
+
+
+/*
+ * Creates a transposition of 'seed', where the transposition is pushed below any elementwise operations and merged with any transpositions in the seed.
+ * Inverse pairs of transpositions cancel out, and a transposition of a dense array is folded into the array's layout,
+ * so that a physical rearrangement is only performed if the permutation cannot be absorbed by a leaf.
+ */
+inline std::unique_ptr<Array> make_transpose(std::unique_ptr<Array> seed, std::vector<size_t> permutation, const Options& options) {
+    if (!options.rewrite_transpositions) {
+        return std::unique_ptr<Array>(new Transpose(std::move(seed), std::move(permutation)));
+    }
+    if (internal_realize::is_identity(permutation)) {
+        return seed;
+    }
+
+    auto recurse = [&](std::unique_ptr<Array> child, const std::vector<size_t>& child_permutation) -> std::unique_ptr<Array> {
+        return make_transpose(std::move(child), child_permutation, options);
+    };
+
+    if (auto ptr = dynamic_cast<Transpose*>(seed.get())) {
+        const auto& inner = ptr->get_permutation();
+        std::vector<size_t> composed(permutation.size());
+        for (size_t p = 0, end = permutation.size(); p < end; ++p) {
+            composed[p] = inner[permutation[p]];
+        }
+        return make_transpose(ptr->release_seed(), std::move(composed), options);
+    } else if (auto ptr = dynamic_cast<DenseArray*>(seed.get())) {
+        return ptr->transpose(permutation);
+    } else if (auto ptr = dynamic_cast<FusedOperation*>(seed.get())) {
+        return ptr->push_transpose(permutation, recurse);
+    } else if (auto ptr = dynamic_cast<ScalarOperation*>(seed.get())) {
+        return ptr->push_transpose(permutation, recurse);
+    } else if (auto ptr = dynamic_cast<UnaryOperation*>(seed.get())) {
+        return ptr->push_transpose(permutation, recurse);
+    } else if (auto ptr = dynamic_cast<BinaryOperation*>(seed.get())) {
+        return ptr->push_transpose(permutation, recurse);
+    }
+
+    return std::unique_ptr<Array>(new Transpose(std::move(seed), std::move(permutation)));
+}
+
+inline std::unique_ptr<Array> load_transpose(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = internal_realize::load_seed(handle, "seed", version, options);
+    auto permutation = internal_realize::load_indices(internal_profile::open_dataset(handle, "permutation"));
+    return make_transpose(std::move(seed), std::move(permutation), options);
+}
+
+}
+/**
+ * @endcond
+ */
+
+}
+
+}
+
+#endif
@@ -6,11 +6,17 @@
 
 #include <vector>
 #include <cstdint>
+#include <algorithm>
 
 #include "utils_public.hpp"
 #include "utils_misc.hpp"
+#include "utils_stream.hpp"
+#include "utils_buffer.hpp"
+#include "utils_parallel.hpp"
+#include "utils_simd.hpp"
 #include "utils_type.hpp"
 #include "utils_dimnames.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file sparse_matrix.hpp
@@ -30,32 +36,104 @@ namespace sparse_matrix {
  */
 namespace internal {
 
-template<typename Index_>
-void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& indptrs, size_t primary, size_t secondary, bool csc) {
-    ritsuko::hdf5::Stream1dNumericDataset<Index_> stream(&ihandle, indptrs.back(), 1000000);
+template<typename Index_, typename Pointer_>
+void validate_indices(const H5::DataSet& ihandle, const internal_mmap::MappedDataset& imapped, const internal_chunk::ChunkedDataset& ichunked, const Pointer_* indptrs, size_t primary, size_t secondary, bool csc, hsize_t block_size, int num_threads, internal_parallel::TaskPool* pool, bool prefetch) {
+    hsize_t nnz = indptrs[primary] - indptrs[0];
 
-    for (size_t p = 0; p < primary; ++p) {
-        auto start = indptrs[p];
-        auto end = indptrs[p + 1];
-        if (start > end) {
-            throw std::runtime_error("entries of 'indptr' must be sorted");
-        }
+    // Splitting the primary dimension into contiguous ranges with roughly equal numbers of non-zero elements.
+    size_t num_workers = 1;
+    if (num_threads > 1 && nnz > block_size) {
+        num_workers = std::min(static_cast<size_t>(num_threads), primary);
+    }
+    std::vector<size_t> boundaries(num_workers + 1);
+    for (size_t w = 1; w < num_workers; ++w) {
+        hsize_t target = indptrs[0] + (nnz / num_workers) * w;
+        boundaries[w] = std::lower_bound(indptrs, indptrs + primary + 1, target) - indptrs;
+    }
+    boundaries[num_workers] = primary;
 
-        // Checking for sortedness and good things.
-        Index_ previous;
-        for (auto x = start; x < end; ++x, stream.next()) {
-            auto i = stream.get();
-            if (i < 0) {
-                throw std::runtime_error("entries of 'indices' should be non-negative");
-            }
-            if (x > start && i <= previous) {
-                throw std::runtime_error("'indices' should be strictly increasing within each " + (csc ? std::string("column") : std::string("row")));
+    // If we're already splitting the primary dimension across threads, each thread decompresses its own chunks.
+    int decompress_threads = (num_workers > 1 ? 1 : num_threads);
+
+    internal_parallel::parallelize(num_workers, [&](size_t w) -> void {
+        auto pstart = boundaries[w], pend = boundaries[w + 1];
+        internal_stream::Stream1dRange<Index_> stream(&ihandle, indptrs[pstart], indptrs[pend], block_size, &imapped, &ichunked, decompress_threads, pool, prefetch);
+
+        for (size_t p = pstart; p < pend; ++p) {
+            uint64_t start = indptrs[p];
+            uint64_t remaining = static_cast<uint64_t>(indptrs[p + 1]) - start;
+
+            // Checking for sortedness and good things, one contiguous block at a time.
+            Index_ previous = 0;
+            bool has_previous = false;
+            while (remaining) {
+                auto block = stream.get_many();
+                size_t n = std::min(static_cast<uint64_t>(block.second), remaining);
+                auto ptr = block.first;
+
+                size_t bad;
+                {
+                    internal_parallel::Hdf5Unlock unlock; // no need to block other HDF5 reads while we're just checking values.
+                    bad = internal_simd::find_invalid(ptr, n, secondary, true, has_previous, previous);
+                }
+                if (bad < n) {
+                    auto i = ptr[bad];
+                    if (internal_simd::is_negative(i)) {
+                        throw std::runtime_error("entries of 'indices' should be non-negative");
+                    }
+                    if ((bad > 0 || has_previous) && i <= (bad > 0 ? ptr[bad - 1] : previous)) {
+                        throw std::runtime_error("'indices' should be strictly increasing within each " + (csc ? std::string("column") : std::string("row")));
+                    }
+                    throw std::runtime_error("entries of 'indices' should be less than the number of " + (csc ? std::string("row") : std::string("column")) + "s");
+                }
+
+                previous = ptr[n - 1];
+                has_previous = true;
+                remaining -= n;
+                stream.next(n);
             }
-            if (static_cast<size_t>(i) >= secondary) {
-                throw std::runtime_error("entries of 'indices' should be less than the number of " + (csc ? std::string("row") : std::string("column")) + "s");
+        }
+    }, pool);
+}
+
+// Streams through 'indptr' in windows, checking the corresponding 'indices' for each window.
+// This ensures that memory usage is bounded by the buffer size rather than the primary dimension extent.
+template<typename Index_, typename Pointer_>
+void validate_compressed(const H5::DataSet& ihandle, const H5::DataSet& iphandle, size_t primary, size_t secondary, uint64_t nnz, bool csc, const Options& options) {
+    // Each thread has its own buffer for 'indices' (doubled if prefetching), in addition to the window for 'indptr'.
+    size_t num_buffers = static_cast<size_t>(std::max(options.num_threads, 1)) * (options.prefetch ? 2 : 1) + 1;
+    hsize_t block_size = internal_buffer::pick_1d_block_size(ihandle, nnz, options, num_buffers);
+    hsize_t window = internal_buffer::pick_1d_block_size(iphandle, primary + 1, options, num_buffers);
+    window = std::max(window, static_cast<hsize_t>(2)) - 1; // each window holds an extra entry for the end of its last interval.
+
+    // Both datasets are read at their stored widths, so the mapped files can be used without any conversion.
+    internal_mmap::MappedDataset imapped(ihandle, options.memory_map), ipmapped(iphandle, options.memory_map);
+    if (ipmapped.type() != internal_mmap::stored_type<Pointer_>()) {
+        ipmapped = internal_mmap::MappedDataset();
+    }
+    internal_chunk::ChunkedDataset ichunked(ihandle, options.direct_chunks), ipchunked(iphandle, options.direct_chunks);
+    if (ipchunked.type() != internal_mmap::stored_type<Pointer_>()) {
+        ipchunked = internal_chunk::ChunkedDataset();
+    }
+
+    std::vector<Pointer_> indptrs;
+    for (size_t p0 = 0; p0 < primary; p0 += window) {
+        size_t plen = std::min(static_cast<size_t>(window), primary - p0);
+        indptrs.resize(plen + 1);
+        internal_stream::read_block(iphandle, p0, plen + 1, indptrs.data(), &ipmapped, &ipchunked, options.num_threads, options.pool.get());
+
+        for (size_t p = 0; p < plen; ++p) {
+            if (indptrs[p] > indptrs[p + 1]) {
+                throw std::runtime_error("entries of 'indptr' must be sorted");
             }
-            previous = i;
         }
+
+        // As the last entry is equal to 'nnz', any larger value implies that 'indptr' is not sorted.
+        if (static_cast<uint64_t>(indptrs[plen]) > nnz) {
+            throw std::runtime_error("entries of 'indptr' must be sorted");
+        }
+
+        validate_indices<Index_>(ihandle, imapped, ichunked, indptrs.data(), plen, secondary, csc, block_size, options.num_threads, options.pool.get(), options.prefetch);
     }
 }
 
@@ -72,12 +150,12 @@ void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& i
  * @return Details of the sparse matrix.
  * Otherwise, if the validation failed, an error is raised.
  */
-inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, [[maybe_unused]] Options& options) {
+inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
     std::vector<uint64_t> dims(2);
     ArrayType array_type;
 
     {
-        auto shandle = ritsuko::hdf5::open_dataset(handle, "shape");
+        auto shandle = internal_profile::open_dataset(handle, "shape");
         auto len = ritsuko::hdf5::get_1d_length(shandle, false);
         if (len != 2) {
             throw std::runtime_error("'shape' should have length 2");
@@ -89,6 +167,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
             std::vector<int> dims_tmp(2);
             shandle.read(dims_tmp.data(), H5::PredType::NATIVE_INT);
+            internal_profile::record_read<int>(2);
             if (dims_tmp[0] < 0 || dims_tmp[1] < 0) {
                 throw std::runtime_error("'shape' should contain non-negative values");
             }
@@ -98,12 +177,13 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                 throw std::runtime_error("'shape' should have a datatype that can fit into a 64-bit unsigned integer");
             }
             shandle.read(dims.data(), H5::PredType::NATIVE_UINT64);
+            internal_profile::record_read<uint64_t>(2);
         }
     }
 
     size_t nnz;
     {
-        auto dhandle = ritsuko::hdf5::open_dataset(handle, "data");
+        auto dhandle = internal_profile::open_dataset(handle, "data");
 
         try {
             nnz = ritsuko::hdf5::get_1d_length(dhandle, false);
@@ -132,7 +212,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     if (!options.details_only) {
         bool csc = true;
         if (!version.lt(1, 1, 0)) {
-            auto bhandle = ritsuko::hdf5::open_dataset(handle, "by_column");
+            auto bhandle = internal_profile::open_dataset(handle, "by_column");
             if (!ritsuko::hdf5::is_scalar(bhandle)) {
                 throw std::runtime_error("'by_column' should be a scalar");
             }
@@ -143,7 +223,8 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         }
 
         {
-            auto ihandle = ritsuko::hdf5::open_dataset(handle, "indices");
+            size_t num_buffers = static_cast<size_t>(std::max(options.num_threads, 1)) * (options.prefetch ? 2 : 1) + 1;
+            auto ihandle = internal_buffer::open_dataset(handle, "indices", options, num_buffers);
 
             if (version.lt(1, 1, 0)) {
                 if (ihandle.getTypeClass() != H5T_INTEGER) {
@@ -159,7 +240,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                 throw std::runtime_error("'indices' and 'data' should have the same length");
             }
 
-            auto iphandle = ritsuko::hdf5::open_dataset(handle, "indptr");
+            auto iphandle = internal_buffer::open_dataset(handle, "indptr", options, num_buffers);
             if (version.lt(1, 1, 0)) {
                 if (iphandle.getTypeClass() != H5T_INTEGER) {
                     throw std::runtime_error("'indptr' should be integer");
@@ -175,25 +256,32 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             if (ritsuko::hdf5::get_1d_length(iphandle, false) != static_cast<size_t>(primary + 1)) {
                 throw std::runtime_error("'indptr' should have length equal to the number of " + (csc ? std::string("columns") : std::string("rows")) + " plus 1");
             }
-            std::vector<uint64_t> indptrs(primary + 1);
-            iphandle.read(indptrs.data(), H5::PredType::NATIVE_UINT64);
-            if (indptrs[0] != 0) {
+
+            uint64_t first_ptr, last_ptr;
+            internal_stream::read_block(iphandle, 0, 1, &first_ptr);
+            if (first_ptr != 0) {
                 throw std::runtime_error("first entry of 'indptr' should be 0 for a sparse matrix");
             }
-            if (indptrs.back() != static_cast<uint64_t>(nnz)) {
+            internal_stream::read_block(iphandle, primary, 1, &last_ptr);
+            if (last_ptr != static_cast<uint64_t>(nnz)) {
                 throw std::runtime_error("last entry of 'indptr' should be equal to the length of 'data'");
             }
 
             if (version.lt(1, 1, 0)) {
-                internal::validate_indices<int>(ihandle, indptrs, primary, secondary, csc);
+                internal::validate_compressed<int, uint64_t>(ihandle, iphandle, primary, secondary, nnz, csc, options);
             } else {
-                internal::validate_indices<uint64_t>(ihandle, indptrs, primary, secondary, csc);
+                // Reading both datasets at their stored widths, to reduce memory usage and skip type conversion.
+                internal_misc::dispatch_unsigned_integer(ihandle, [&](auto index_zero) -> void {
+                    internal_misc::dispatch_unsigned_integer(iphandle, [&](auto pointer_zero) -> void {
+                        internal::validate_compressed<decltype(index_zero), decltype(pointer_zero)>(ihandle, iphandle, primary, secondary, nnz, csc, options);
+                    });
+                });
             }
         }
 
         // Validating dimnames.
         if (handle.exists("dimnames")) {
-            internal_dimnames::validate(handle, dims, version);
+            internal_dimnames::validate(handle, dims, version, options);
         }
     }
 
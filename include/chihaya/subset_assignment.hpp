@@ -35,10 +35,11 @@ namespace subset_assignment {
  * Otherwise, if the validation failed, an error is raised.
  */
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
-    auto seed_details = internal_misc::load_seed_details(handle, "seed", version, options);
+    internal_misc::DeferredSeeds seeds(handle, { "seed", "value" }, "", version, options);
+    auto seed_details = seeds.get(0);
     const auto& seed_dims = seed_details.dimensions;
 
-    auto value_details = internal_misc::load_seed_details(handle, "value", version, options);
+    auto value_details = seeds.get(1);
     if (!options.details_only) {
         if ((value_details.type == STRING) != (seed_details.type == STRING)) {
             throw std::runtime_error("both or neither of the 'seed' and 'value' arrays should contain strings");
@@ -48,7 +49,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         }
 
         auto ihandle = ritsuko::hdf5::open_group(handle, "index");
-        auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version);
+        auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version, options);
         auto expected_dims = seed_dims;
         for (auto p : collected) {
             expected_dims[p.first] = p.second;
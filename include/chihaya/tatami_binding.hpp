@@ -0,0 +1,720 @@
+#ifndef CHIHAYA_TATAMI_BINDING_HPP
+#define CHIHAYA_TATAMI_BINDING_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+#include "tatami/tatami.hpp"
+#include "tatami_hdf5/tatami_hdf5.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include <cmath>
+#include <limits>
+
+#include "validate.hpp"
+#include "realize.hpp"
+#include "utils_realize.hpp"
+#include "utils_unary.hpp"
+#include "utils_misc.hpp"
+#include "utils_profile.hpp"
+
+/**
+ * @file tatami_binding.hpp
+ * @brief Load delayed matrices as **tatami** matrices.
+ *
+ * This header requires the [**tatami**](https://github.com/tatami-inc/tatami) and [**tatami_hdf5**](https://github.com/tatami-inc/tatami_hdf5) libraries.
+ * It is not included by `chihaya.hpp` and should be included directly.
+ * When building with CMake, the `artifactdb::chihaya_tatami` target is only available if both libraries were found, and defines `CHIHAYA_HAS_TATAMI` for its consumers.
+ */
+
+namespace chihaya {
+
+/**
+ * @namespace chihaya::tatami_binding
+ * @brief Namespace for the **tatami** bindings.
+ */
+namespace tatami_binding {
+
+/**
+ * Pointer to a **tatami** matrix of doubles with integer indices.
+ */
+typedef std::shared_ptr<const ::tatami::Matrix<double, int> > MatrixPointer;
+
+/**
+ * @brief Options for loading **tatami** matrices.
+ */
+struct Options {
+    /**
+     * Whether to validate the tree with `chihaya::validate()` before loading.
+     */
+    bool validate = true;
+
+    /**
+     * Options for validation, only used if `validate = true`.
+     */
+    ::chihaya::Options validation;
+
+    /**
+     * Whether to realize nodes into an in-memory matrix if they have no **tatami** equivalent, e.g., matrix products and subset assignments.
+     * This is a compressed sparse matrix if `realize::Array::sparse()` is true for the node, otherwise it is a dense matrix.
+     * This uses the engine in `realize.hpp`, so the node's children are still read from file.
+     * If false, an error is raised for such nodes.
+     */
+    bool realize_unsupported = true;
+
+    /**
+     * Options for realizing unsupported nodes.
+     */
+    realize::Options realize;
+
+    /**
+     * Options for dense arrays stored in the file.
+     */
+    ::tatami_hdf5::DenseMatrixOptions dense;
+
+    /**
+     * Options for sparse matrices stored in the file.
+     */
+    ::tatami_hdf5::CompressedSparseMatrixOptions sparse;
+
+    /**
+     * Custom registry of functions to be used by `load()` on arrays.
+     * If a function is provided for an array type, it is used instead of the default function.
+     */
+    std::unordered_map<std::string, std::function<MatrixPointer(const H5::Group&, const ritsuko::Version&, Options&)> > array_registry;
+
+    /**
+     * Custom registry of functions to be used by `load()` on operations.
+     * If a function is provided for an operation type, it is used instead of the default function.
+     */
+    std::unordered_map<std::string, std::function<MatrixPointer(const H5::Group&, const ritsuko::Version&, Options&)> > operation_registry;
+
+    /**
+     * @cond
+     */
+    size_t depth = 0;
+    /**
+     * @endcond
+     */
+};
+
+/**
+ * @cond
+ */
+MatrixPointer load(const H5::Group&, const ritsuko::Version&, Options&);
+
+namespace internal {
+
+inline MatrixPointer load_seed(const H5::Group& handle, const std::string& name, const ritsuko::Version& version, Options& options) {
+    auto shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+    try {
+        return ::chihaya::tatami_binding::load(shandle, version, options);
+    } catch (std::exception& e) {
+        throw std::runtime_error("failed to load '" + name + "'; " + std::string(e.what()));
+    }
+}
+
+inline void check_matrix(const ArrayDetails& details) {
+    if (details.dimensions.size() != 2) {
+        throw std::runtime_error("only 2-dimensional arrays can be loaded as tatami matrices");
+    }
+    if (details.type == STRING) {
+        throw std::runtime_error("arrays of strings cannot be loaded as tatami matrices");
+    }
+}
+
+// Sparse nodes are realized into a compressed sparse matrix in their preferred orientation, so that only the structural non-zeros are stored.
+inline MatrixPointer realize_in_memory(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto ropt = options.realize;
+    ropt.validate = false;
+    auto arr = realize::load(handle, version, ropt);
+    check_matrix(arr->details());
+
+    size_t nr = arr->dimensions()[0], nc = arr->dimensions()[1];
+    if (arr->sparse()) {
+        auto block = realize::extract_sparse(*arr, { 0, 0 }, { nr, nc }, arr->sparse_by_column());
+        std::vector<int> indices(block.indices.begin(), block.indices.end());
+        return std::make_shared<::tatami::CompressedSparseMatrix<double, int, std::vector<double>, std::vector<int>, std::vector<size_t> > >(
+            nr,
+            nc,
+            std::move(block.values),
+            std::move(indices),
+            std::move(block.pointers),
+            /* csr = */ !block.by_column
+        );
+    }
+
+    std::vector<double> values(nr * nc);
+    realize::extract(*arr, { 0, 0 }, { nr, nc }, values.data(), ropt);
+    return std::make_shared<::tatami::DenseRowMatrix<double, int> >(nr, nc, std::move(values));
+}
+
+// Fallback for nodes without a tatami equivalent.
+inline MatrixPointer realize_node(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    if (!options.realize_unsupported) {
+        throw std::runtime_error("no tatami equivalent is available for this node");
+    }
+    return realize_in_memory(handle, version, options);
+}
+
+inline std::string get_path(const H5::Group& handle, const std::string& name) {
+    return handle.getObjName() + "/" + name;
+}
+
+/*** Arrays ***/
+
+// Replaces the missing placeholder with NaN so that the leaf is still read lazily.
+// A non-zero placeholder leaves zeros unchanged, so sparse leaves remain sparse.
+class DelayedUnaryIsometricMaskPlaceholder {
+public:
+    DelayedUnaryIsometricMaskPlaceholder(double placeholder) : my_placeholder(placeholder) {}
+
+private:
+    double my_placeholder;
+
+    template<typename Index_>
+    void mask(Index_ length, double* buffer) const {
+        for (Index_ i = 0; i < length; ++i) {
+            if (buffer[i] == my_placeholder) {
+                buffer[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+
+public:
+    static constexpr bool is_basic = false;
+
+    bool is_sparse() const {
+        return my_placeholder != 0;
+    }
+
+    bool zero_depends_on_row() const {
+        return false;
+    }
+
+    bool zero_depends_on_column() const {
+        return false;
+    }
+
+    bool non_zero_depends_on_row() const {
+        return false;
+    }
+
+    bool non_zero_depends_on_column() const {
+        return false;
+    }
+
+    template<typename Index_>
+    void dense(bool, Index_, Index_, Index_ length, double* buffer) const {
+        mask(length, buffer);
+    }
+
+    template<typename Index_>
+    void dense(bool, Index_, const std::vector<Index_>& indices, double* buffer) const {
+        mask(static_cast<Index_>(indices.size()), buffer);
+    }
+
+    template<typename Index_>
+    void sparse(bool, Index_, Index_ number, double* buffer, const Index_*) const {
+        mask(number, buffer);
+    }
+
+    template<typename Index_>
+    double fill(bool, Index_) const {
+        return (my_placeholder == 0 ? std::numeric_limits<double>::quiet_NaN() : 0);
+    }
+};
+
+inline MatrixPointer mask_placeholder(MatrixPointer leaf, const internal_realize::Placeholder& placeholder) {
+    return ::tatami::make_DelayedUnaryIsometricOperation(std::move(leaf), DelayedUnaryIsometricMaskPlaceholder(placeholder.value));
+}
+
+inline MatrixPointer load_dense_array(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto details = realize::internal::leaf_details([&](::chihaya::Options& opt) -> ArrayDetails { return dense_array::validate(handle, version, opt); });
+    check_matrix(details);
+
+    // A non-native layout means that the rows of the matrix are the columns of the dataset.
+    bool native = ritsuko::hdf5::load_scalar_numeric_dataset<int>(internal_profile::open_dataset(handle, "native"));
+    MatrixPointer output = std::make_shared<::tatami_hdf5::DenseMatrix<double, int> >(handle.getFileName(), get_path(handle, "data"), !native, options.dense);
+
+    // NaN placeholders are already reported as NaN.
+    auto placeholder = internal_realize::load_placeholder(internal_profile::open_dataset(handle, "data"), version);
+    if (placeholder.present && !std::isnan(placeholder.value)) {
+        output = mask_placeholder(std::move(output), placeholder);
+    }
+    return output;
+}
+
+inline MatrixPointer load_sparse_matrix(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto details = realize::internal::leaf_details([&](::chihaya::Options& opt) -> ArrayDetails { return sparse_matrix::validate(handle, version, opt); });
+    check_matrix(details);
+
+    bool csc = true;
+    if (!version.lt(1, 1, 0)) {
+        csc = (ritsuko::hdf5::load_scalar_numeric_dataset<int8_t>(internal_profile::open_dataset(handle, "by_column")) != 0);
+    }
+
+    // A zero placeholder only applies to the explicitly stored zeros, which cannot be distinguished from the structural zeros after loading.
+    // So, we realize the matrix in memory, where the explicit zeros become NaNs and the structural zeros are still omitted.
+    auto placeholder = internal_realize::load_placeholder(internal_profile::open_dataset(handle, "data"), version);
+    if (placeholder.present && placeholder.value == 0) {
+        return realize_in_memory(handle, version, options);
+    }
+
+    const auto& dims = details.dimensions;
+    MatrixPointer output = std::make_shared<::tatami_hdf5::CompressedSparseMatrix<double, int> >(
+        dims[0],
+        dims[1],
+        handle.getFileName(),
+        get_path(handle, "data"),
+        get_path(handle, "indices"),
+        get_path(handle, "indptr"),
+        !csc,
+        options.sparse
+    );
+
+    if (placeholder.present && !std::isnan(placeholder.value)) {
+        output = mask_placeholder(std::move(output), placeholder);
+    }
+    return output;
+}
+
+inline MatrixPointer load_constant_array(const H5::Group& handle, const ritsuko::Version& version, Options&) {
+    realize::ConstantArray arr(handle, version);
+    check_matrix(arr.details());
+    double value = 0;
+    arr.extract({ 0, 0 }, { 1, 1 }, &value);
+    const auto& dims = arr.dimensions();
+    return std::make_shared<::tatami::ConstantMatrix<double, int> >(dims[0], dims[1], value);
+}
+
+/*** Structural operations ***/
+
+inline MatrixPointer load_subset(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = load_seed(handle, "seed", version, options);
+    auto index = internal_realize::load_index_list(ritsuko::hdf5::open_group(handle, "index"), version);
+    if (index.present.size() != 2) {
+        throw std::runtime_error("only 2-dimensional arrays can be loaded as tatami matrices");
+    }
+
+    for (int d = 0; d < 2; ++d) {
+        if (index.present[d]) {
+            std::vector<int> indices(index.indices[d].begin(), index.indices[d].end());
+            seed = ::tatami::make_DelayedSubset(std::move(seed), std::move(indices), /* row = */ d == 0);
+        }
+    }
+    return seed;
+}
+
+inline MatrixPointer load_combine(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto shandle = ritsuko::hdf5::open_group(handle, "seeds");
+    auto list_params = internal_list::validate(shandle, version);
+    std::vector<MatrixPointer> seeds;
+    seeds.reserve(list_params.length);
+    for (const auto& p : list_params.present) {
+        seeds.push_back(load_seed(shandle, p.second, version, options));
+    }
+
+    auto along = internal_misc::load_along(handle, version);
+    return ::tatami::make_DelayedBind(std::move(seeds), /* row = */ along == 0);
+}
+
+inline MatrixPointer load_transpose(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = load_seed(handle, "seed", version, options);
+    auto perm = internal_realize::load_indices(internal_profile::open_dataset(handle, "permutation"));
+    if (perm.size() == 2 && perm[0] == 1) {
+        return ::tatami::make_DelayedTranspose(std::move(seed));
+    }
+    return seed;
+}
+
+/*** Elementwise operations ***/
+
+template<::tatami::ArithmeticOperation op_>
+MatrixPointer apply_arithmetic(MatrixPointer seed, bool right, std::vector<double> values, bool by_row) {
+    if (values.size() == 1) {
+        if (right) {
+            return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricArithmeticScalar<op_, true>(values.front()));
+        } else {
+            return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricArithmeticScalar<op_, false>(values.front()));
+        }
+    } else {
+        if (right) {
+            return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricArithmeticVector<op_, true>(std::move(values), by_row));
+        } else {
+            return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricArithmeticVector<op_, false>(std::move(values), by_row));
+        }
+    }
+}
+
+template<::tatami::CompareOperation op_>
+MatrixPointer apply_comparison(MatrixPointer seed, std::vector<double> values, bool by_row) {
+    if (values.size() == 1) {
+        return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricCompareScalar<op_>(values.front()));
+    } else {
+        return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricCompareVector<op_>(std::move(values), by_row));
+    }
+}
+
+template<::tatami::BooleanOperation op_>
+MatrixPointer apply_boolean(MatrixPointer seed, const std::vector<double>& values, bool by_row) {
+    if (values.size() == 1) {
+        return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricBooleanScalar<op_>(values.front() != 0));
+    } else {
+        std::vector<char> converted(values.begin(), values.end());
+        for (auto& c : converted) {
+            c = (c != 0);
+        }
+        return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricBooleanVector<op_>(std::move(converted), by_row));
+    }
+}
+
+inline MatrixPointer load_unary_operation(const H5::Group& handle, const ritsuko::Version& version, Options& options, const std::string& kind) {
+    auto seed = load_seed(handle, "seed", version, options);
+    auto method = internal_unary::load_method(handle);
+
+    if (kind == "logic" && method == "!") {
+        return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), ::tatami::make_DelayedUnaryIsometricBooleanNot());
+    }
+
+    auto side = internal_unary::load_side(handle);
+    if (side == "none") {
+        if (method == "+") {
+            return seed;
+        } else if (method == "-") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::SUBTRACT>(std::move(seed), false, { 0 }, true);
+        }
+        throw std::runtime_error("'side' cannot be 'none' for operation '" + method + "'");
+    }
+
+    auto vhandle = internal_profile::open_dataset(handle, "value");
+    auto values = internal_realize::load_numeric_values(vhandle, version);
+    bool by_row = true;
+    if (vhandle.getSpace().getSimpleExtentNdims() == 1) {
+        by_row = (internal_misc::load_along(handle, version) == 0);
+    }
+    bool right = (side == "right");
+
+    if (kind == "arithmetic") {
+        if (method == "+") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::ADD>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "-") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::SUBTRACT>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "*") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::MULTIPLY>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "/") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::DIVIDE>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "^") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::POWER>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "%%") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::MODULO>(std::move(seed), right, std::move(values), by_row);
+        } else if (method == "%/%") {
+            return apply_arithmetic<::tatami::ArithmeticOperation::INTEGER_DIVIDE>(std::move(seed), right, std::move(values), by_row);
+        }
+
+    } else if (kind == "comparison") {
+        // tatami always places the value on the right, so the comparison is flipped for left-sided values.
+        if (method == "==") {
+            return apply_comparison<::tatami::CompareOperation::EQUAL>(std::move(seed), std::move(values), by_row);
+        } else if (method == "!=") {
+            return apply_comparison<::tatami::CompareOperation::NOT_EQUAL>(std::move(seed), std::move(values), by_row);
+        } else if ((method == ">" && right) || (method == "<" && !right)) {
+            return apply_comparison<::tatami::CompareOperation::GREATER_THAN>(std::move(seed), std::move(values), by_row);
+        } else if ((method == "<" && right) || (method == ">" && !right)) {
+            return apply_comparison<::tatami::CompareOperation::LESS_THAN>(std::move(seed), std::move(values), by_row);
+        } else if ((method == ">=" && right) || (method == "<=" && !right)) {
+            return apply_comparison<::tatami::CompareOperation::GREATER_THAN_OR_EQUAL>(std::move(seed), std::move(values), by_row);
+        } else if ((method == "<=" && right) || (method == ">=" && !right)) {
+            return apply_comparison<::tatami::CompareOperation::LESS_THAN_OR_EQUAL>(std::move(seed), std::move(values), by_row);
+        }
+
+    } else {
+        if (method == "&&") {
+            return apply_boolean<::tatami::BooleanOperation::AND>(std::move(seed), values, by_row);
+        } else if (method == "||") {
+            return apply_boolean<::tatami::BooleanOperation::OR>(std::move(seed), values, by_row);
+        }
+    }
+
+    throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+}
+
+template<class Operation_>
+MatrixPointer apply_unary(MatrixPointer seed, Operation_ op) {
+    return ::tatami::make_DelayedUnaryIsometricOperation(std::move(seed), std::move(op));
+}
+
+inline MatrixPointer load_unary_math(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto method = internal_unary::load_method(handle);
+
+    // R's rounding to a non-zero number of digits has no tatami equivalent.
+    if (method == "signif") {
+        return realize_node(handle, version, options);
+    } else if (method == "round") {
+        auto digits = ritsuko::hdf5::load_scalar_numeric_dataset<int32_t>(internal_profile::open_dataset(handle, "digits"));
+        if (digits != 0) {
+            return realize_node(handle, version, options);
+        }
+    }
+
+    auto seed = load_seed(handle, "seed", version, options);
+    if (method == "abs") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAbs<>());
+    } else if (method == "sign") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricSign<>());
+    } else if (method == "sqrt") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricSqrt<>());
+    } else if (method == "exp") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricExp<>());
+    } else if (method == "expm1") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricExpm1<>());
+    } else if (method == "log") {
+        if (handle.exists("base")) {
+            auto base = ritsuko::hdf5::load_scalar_numeric_dataset<double>(internal_profile::open_dataset(handle, "base"));
+            return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricLog<>(base));
+        }
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricLog<>());
+    } else if (method == "log1p") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricLog1p<>());
+    } else if (method == "ceiling") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricCeiling<>());
+    } else if (method == "floor") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricFloor<>());
+    } else if (method == "trunc") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricTrunc<>());
+    } else if (method == "round") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricRound<>());
+    } else if (method == "sin") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricSin<>());
+    } else if (method == "cos") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricCos<>());
+    } else if (method == "tan") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricTan<>());
+    } else if (method == "asin") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAsin<>());
+    } else if (method == "acos") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAcos<>());
+    } else if (method == "atan") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAtan<>());
+    } else if (method == "sinh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricSinh<>());
+    } else if (method == "cosh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricCosh<>());
+    } else if (method == "tanh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricTanh<>());
+    } else if (method == "asinh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAsinh<>());
+    } else if (method == "acosh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAcosh<>());
+    } else if (method == "atanh") {
+        return apply_unary(std::move(seed), ::tatami::DelayedUnaryIsometricAtanh<>());
+    }
+
+    throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+}
+
+inline MatrixPointer load_unary_special_check(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto seed = load_seed(handle, "seed", version, options);
+    auto method = internal_unary::load_method(handle);
+    if (method == "is_nan") {
+        return apply_unary(std::move(seed), ::tatami::make_DelayedUnaryIsometricIsnan());
+    } else if (method == "is_finite") {
+        return apply_unary(std::move(seed), ::tatami::make_DelayedUnaryIsometricIsfinite());
+    } else if (method == "is_infinite") {
+        return apply_unary(std::move(seed), ::tatami::make_DelayedUnaryIsometricIsinf());
+    }
+    throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+}
+
+template<class Operation_>
+MatrixPointer apply_binary(MatrixPointer left, MatrixPointer right, Operation_ op) {
+    return ::tatami::make_DelayedBinaryIsometricOperation(std::move(left), std::move(right), std::move(op));
+}
+
+inline MatrixPointer load_binary_operation(const H5::Group& handle, const ritsuko::Version& version, Options& options, const std::string& kind) {
+    auto left = load_seed(handle, "left", version, options);
+    auto right = load_seed(handle, "right", version, options);
+    auto method = internal_unary::load_method(handle);
+
+    if (kind == "arithmetic") {
+        if (method == "+") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::ADD>());
+        } else if (method == "-") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::SUBTRACT>());
+        } else if (method == "*") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::MULTIPLY>());
+        } else if (method == "/") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::DIVIDE>());
+        } else if (method == "^") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::POWER>());
+        } else if (method == "%%") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::MODULO>());
+        } else if (method == "%/%") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricArithmetic<::tatami::ArithmeticOperation::INTEGER_DIVIDE>());
+        }
+
+    } else if (kind == "comparison") {
+        if (method == "==") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::EQUAL>());
+        } else if (method == "!=") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::NOT_EQUAL>());
+        } else if (method == ">") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::GREATER_THAN>());
+        } else if (method == "<") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::LESS_THAN>());
+        } else if (method == ">=") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::GREATER_THAN_OR_EQUAL>());
+        } else if (method == "<=") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricCompare<::tatami::CompareOperation::LESS_THAN_OR_EQUAL>());
+        }
+
+    } else {
+        if (method == "&&") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricBoolean<::tatami::BooleanOperation::AND>());
+        } else if (method == "||") {
+            return apply_binary(std::move(left), std::move(right), ::tatami::make_DelayedBinaryIsometricBoolean<::tatami::BooleanOperation::OR>());
+        }
+    }
+
+    throw std::runtime_error("unrecognized operation in 'method' (got '" + method + "')");
+}
+
+/*** Dispatch ***/
+
+typedef std::function<MatrixPointer(const H5::Group&, const ritsuko::Version&, Options&)> LoadFunction;
+
+inline auto default_operation_registry() {
+    std::unordered_map<std::string, LoadFunction> registry;
+    registry["subset"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_subset(h, v, o); };
+    registry["combine"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_combine(h, v, o); };
+    registry["transpose"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_transpose(h, v, o); };
+    registry["dimnames"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_seed(h, "seed", v, o); };
+    registry["subset assignment"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return realize_node(h, v, o); };
+    registry["unary arithmetic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_unary_operation(h, v, o, "arithmetic"); };
+    registry["unary comparison"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_unary_operation(h, v, o, "comparison"); };
+    registry["unary logic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_unary_operation(h, v, o, "logic"); };
+    registry["unary math"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_unary_math(h, v, o); };
+    registry["unary special check"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_unary_special_check(h, v, o); };
+    registry["binary arithmetic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_binary_operation(h, v, o, "arithmetic"); };
+    registry["binary comparison"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_binary_operation(h, v, o, "comparison"); };
+    registry["binary logic"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_binary_operation(h, v, o, "logic"); };
+    registry["matrix product"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return realize_node(h, v, o); };
+    return registry;
+}
+
+inline auto default_array_registry() {
+    std::unordered_map<std::string, LoadFunction> registry;
+    registry["dense array"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_dense_array(h, v, o); };
+    registry["sparse matrix"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_sparse_matrix(h, v, o); };
+    registry["constant array"] = [](const H5::Group& h, const ritsuko::Version& v, Options& o) -> MatrixPointer { return load_constant_array(h, v, o); };
+    return registry;
+}
+
+inline MatrixPointer dispatch(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto dtype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type");
+    bool is_array = (dtype == "array");
+    if (!is_array && dtype != "operation") {
+        throw std::runtime_error("unknown delayed type '" + dtype + "'");
+    }
+
+    auto type = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, is_array ? "delayed_array" : "delayed_operation");
+    std::string description = (is_array ? "delayed array" : "delayed operation");
+    const auto& custom = (is_array ? options.array_registry : options.operation_registry);
+    const LoadFunction* fun = nullptr;
+
+    auto cit = custom.find(type);
+    if (cit != custom.end()) {
+        fun = &(cit->second);
+    } else {
+        static const auto global_arrays = default_array_registry();
+        static const auto global_operations = default_operation_registry();
+        const auto& global = (is_array ? global_arrays : global_operations);
+        auto git = global.find(type);
+        if (git == global.end()) {
+            throw std::runtime_error("no function available to load " + description + " of type '" + type + "'");
+        }
+        fun = &(git->second);
+    }
+
+    try {
+        return (*fun)(handle, version, options);
+    } catch (std::exception& e) {
+        throw std::runtime_error("failed to load " + description + " of type '" + type + "'; " + std::string(e.what()));
+    }
+}
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Load a delayed operation/array as a **tatami** matrix.
+ * Each operation is represented by the corresponding delayed **tatami** wrapper, so row/column access is lazy and preserves sparsity where possible.
+ * Dense arrays and sparse matrices are backed by **tatami_hdf5**'s matrices, which read from the file on demand.
+ * Nodes without a **tatami** equivalent are realized into memory, see `Options::realize_unsupported`.
+ *
+ * Only 2-dimensional numeric or boolean arrays are supported.
+ * Values are returned as doubles, and missing values are reported as NaN.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param version Version of the **chihaya** specification.
+ * @param options Loading options, possibly containing custom loading functions.
+ *
+ * @return Pointer to a **tatami** matrix.
+ */
+inline MatrixPointer load(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    if (options.depth == 0 && options.validate) {
+        auto details = ::chihaya::validate(handle, version, options.validation);
+        if (details.dimensions.size() != 2) {
+            throw std::runtime_error("only 2-dimensional arrays can be loaded as tatami matrices");
+        }
+    }
+
+    ++options.depth;
+    try {
+        auto output = internal::dispatch(handle, version, options);
+        --options.depth;
+        return output;
+    } catch (...) {
+        --options.depth;
+        throw;
+    }
+}
+
+/**
+ * Load a delayed operation/array as a **tatami** matrix, where the version is taken from the `delayed_version` attribute of the `handle`.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param options Loading options, see `load()` for details.
+ * @return Pointer to a **tatami** matrix.
+ */
+inline MatrixPointer load(const H5::Group& handle, Options& options) {
+    return load(handle, extract_version(handle), options);
+}
+
+/**
+ * Load a delayed operation/array from the specified HDF5 group as a **tatami** matrix.
+ *
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ * @param options Loading options, see `load()` for details.
+ *
+ * @return Pointer to a **tatami** matrix.
+ */
+inline MatrixPointer load(const std::string& path, const std::string& name, Options& options) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto ghandle = handle.openGroup(name);
+    return load(ghandle, options);
+}
+
+}
+
+}
+
+#endif
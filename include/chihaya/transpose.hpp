@@ -11,6 +11,7 @@
 #include <cstdint>
 
 #include "utils_misc.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file transpose.hpp
@@ -38,6 +39,7 @@ std::vector<size_t> check_permutation(const H5::DataSet& phandle, size_t ndims,
 
     std::vector<Perm_> permutation(ndims);
     phandle.read(permutation.data(), h5type);
+    internal_profile::record_read<Perm_>(ndims);
 
     std::vector<size_t> new_dimensions(ndims);
     for (size_t p = 0; p < ndims; ++p) {
@@ -79,7 +81,7 @@ std::vector<size_t> check_permutation(const H5::DataSet& phandle, size_t ndims,
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
     auto seed_details = internal_misc::load_seed_details(handle, "seed", version, options);
 
-    auto phandle = ritsuko::hdf5::open_dataset(handle, "permutation");
+    auto phandle = internal_profile::open_dataset(handle, "permutation");
     auto ndims = ritsuko::hdf5::get_1d_length(phandle, false);
 
     if (version.lt(1, 1, 0)) {
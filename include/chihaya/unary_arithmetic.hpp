@@ -12,6 +12,7 @@
 #include "utils_type.hpp"
 #include "utils_misc.hpp"
 #include "utils_arithmetic.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file unary_arithmetic.hpp
@@ -59,7 +60,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     ArrayType min_type = INTEGER;
 
     if (side != "none") {
-        auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
+        auto vhandle = internal_profile::open_dataset(handle, "value");
         
         try {
             if (version.lt(1, 1, 0)) {
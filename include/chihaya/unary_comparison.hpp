@@ -12,6 +12,8 @@
 #include "utils_unary.hpp"
 #include "utils_misc.hpp"
 #include "utils_type.hpp"
+#include "utils_profile.hpp"
+#include "utils_buffer.hpp"
 
 /**
  * @file unary_comparison.hpp
@@ -49,7 +51,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         }
 
         // Checking the value.
-        auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
+        auto vhandle = internal_buffer::open_dataset(handle, "value", options);
         try {
             if (version.lt(1, 1, 0)) {
                 if ((seed_details.type == STRING) != (vhandle.getTypeClass() == H5T_STRING)) {
@@ -77,7 +79,8 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                 vhandle.getSpace().getSimpleExtentDims(&extent);
                 internal_unary::check_along(handle, version, seed_details.dimensions, extent);
                 if (vhandle.getTypeClass() == H5T_STRING) {
-                    ritsuko::hdf5::validate_1d_string_dataset(vhandle, extent, 1000000);
+                    ritsuko::hdf5::validate_1d_string_dataset(vhandle, extent, internal_buffer::pick_1d_block_size(vhandle, extent, options));
+                    internal_profile::record_read(vhandle, extent);
                 }
 
             } else { 
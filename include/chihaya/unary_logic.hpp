@@ -11,6 +11,7 @@
 #include "utils_unary.hpp"
 #include "utils_type.hpp"
 #include "utils_misc.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file unary_logic.hpp
@@ -51,7 +52,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
             // Checking the value.
-            auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
+            auto vhandle = internal_profile::open_dataset(handle, "value");
 
             try {
                 if (version.lt(1, 1, 0)) {
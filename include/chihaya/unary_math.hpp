@@ -12,6 +12,7 @@
 #include "utils_unary.hpp"
 #include "utils_misc.hpp"
 #include "utils_public.hpp"
+#include "utils_profile.hpp"
 
 /**
  * @file unary_math.hpp
@@ -97,7 +98,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
 
     } else if (method == "round" || method == "signif") {
         if (!options.details_only) {
-            auto vhandle = ritsuko::hdf5::open_dataset(handle, "digits");
+            auto vhandle = internal_profile::open_dataset(handle, "digits");
             if (!ritsuko::hdf5::is_scalar(vhandle)) {
                 throw std::runtime_error("'digits' should be a scalar");
             }
@@ -15,14 +15,17 @@ namespace chihaya {
 
 namespace internal_arithmetic {
 
-inline ArrayDetails fetch_seed(const H5::Group& handle, const std::string& target, const ritsuko::Version& version, Options& options) {
-    auto output = internal_misc::load_seed_details(handle, target, version, options);
+inline ArrayDetails check_seed(ArrayDetails output, const std::string& target) {
     if (output.type == STRING) {
         throw std::runtime_error("type of '" + target + "' should be integer, float or boolean");
     }
     return output;
 }
 
+inline ArrayDetails fetch_seed(const H5::Group& handle, const std::string& target, const ritsuko::Version& version, Options& options) {
+    return check_seed(internal_misc::load_seed_details(handle, target, version, options), target);
+}
+
 inline bool is_valid_operation(const std::string& method) {
     return (method == "+" ||
         method == "-" ||
@@ -0,0 +1,114 @@
+#ifndef CHIHAYA_UTILS_BUFFER_HPP
+#define CHIHAYA_UTILS_BUFFER_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include "utils_public.hpp"
+#include "utils_profile.hpp"
+
+namespace chihaya {
+
+namespace internal_buffer {
+
+/*
+ * Buffer sizing for streamed datasets, based on the options and the chunk layout of each dataset.
+ * Blocks consist of whole rows of chunks, i.e., the chunk extent along the first dimension multiplied by the full extents of the other dimensions
+ * (for 1-dimensional datasets, this is just a whole number of chunks).
+ * Each read then covers complete chunks, so no chunk is decompressed more than once if the chunk cache can hold a row of chunks.
+ */
+inline hsize_t chunk_row_elements(const H5::DSetCreatPropList& cplist, const std::vector<hsize_t>& dims) {
+    if (cplist.getLayout() != H5D_CHUNKED || dims.empty()) {
+        return 1;
+    }
+    std::vector<hsize_t> chunk(dims.size());
+    cplist.getChunk(chunk.size(), chunk.data());
+    hsize_t output = chunk[0];
+    for (size_t d = 1; d < dims.size(); ++d) {
+        output *= dims[d];
+    }
+    return output;
+}
+
+// Memory available to each buffer, if 'num_buffers' buffers (and their chunk caches) may be alive at the same time.
+inline size_t memory_share(const Options& options, size_t num_buffers) {
+    return std::max(options.buffer_memory / std::max(num_buffers, static_cast<size_t>(1)), static_cast<size_t>(1));
+}
+
+// Number of elements to read at once from a dataset with dimensions 'dims'.
+// This is capped by 'Options::buffer_size' and by each buffer's share of 'Options::buffer_memory',
+// and is rounded down to whole rows of chunks (but never less than one row).
+inline hsize_t pick_block_size(const H5::DataSet& handle, const std::vector<hsize_t>& dims, const Options& options, size_t num_buffers = 1) {
+    hsize_t total = 1;
+    for (auto d : dims) {
+        total *= d;
+    }
+
+    size_t width = std::max(handle.getDataType().getSize(), static_cast<size_t>(1));
+    hsize_t limit = std::max(options.buffer_size, static_cast<size_t>(1));
+    limit = std::min(limit, static_cast<hsize_t>(std::max(memory_share(options, num_buffers) / width, static_cast<size_t>(1))));
+    if (limit >= total) {
+        return total;
+    }
+
+    hsize_t row = chunk_row_elements(handle.getCreatePlist(), dims);
+    limit = std::max(row, (limit / row) * row);
+    return std::min(limit, total);
+}
+
+inline hsize_t pick_1d_block_size(const H5::DataSet& handle, hsize_t len, const Options& options, size_t num_buffers = 1) {
+    return pick_block_size(handle, std::vector<hsize_t>{ len }, options, num_buffers);
+}
+
+// Opens a dataset with a chunk cache that can hold a row of chunks, within each buffer's share of 'Options::buffer_memory'.
+// This ensures that blocks starting or ending partway through a chunk (e.g., for the 'indices' of a subset of columns) do not decompress that chunk twice.
+// Datasets that are contiguous or already fit in the chunk cache are returned as-is.
+inline H5::DataSet open_dataset(const H5::Group& handle, const char* name, const Options& options, size_t num_buffers = 1) {
+    auto output = internal_profile::open_dataset(handle, name);
+    auto cplist = output.getCreatePlist();
+    if (cplist.getLayout() != H5D_CHUNKED) {
+        return output;
+    }
+
+    auto dspace = output.getSpace();
+    size_t ndims = dspace.getSimpleExtentNdims();
+    if (ndims == 0) {
+        return output;
+    }
+    std::vector<hsize_t> dims(ndims), chunk(ndims);
+    dspace.getSimpleExtentDims(dims.data());
+    cplist.getChunk(ndims, chunk.data());
+
+    size_t chunk_bytes = output.getDataType().getSize();
+    size_t nchunks = 1;
+    for (size_t d = 0; d < ndims; ++d) {
+        chunk_bytes *= chunk[d];
+        if (d > 0) {
+            nchunks *= (dims[d] + chunk[d] - 1) / std::max(chunk[d], static_cast<hsize_t>(1));
+        }
+    }
+
+    size_t current_slots, current_bytes;
+    double current_w0;
+    output.getAccessPlist().getChunkCache(current_slots, current_bytes, current_w0);
+    size_t cache_bytes = std::min(chunk_bytes * nchunks, memory_share(options, num_buffers));
+    if (cache_bytes <= current_bytes) {
+        return output;
+    }
+
+    // The cache settings are ignored if the dataset is still open, so we have to close it first.
+    // Fully read chunks are evicted first, which is always the case when streaming.
+    output.close();
+    H5::DSetAccPropList dapl;
+    dapl.setChunkCache(std::max(nchunks * 100 + 1, current_slots), cache_bytes, 1);
+    return handle.openDataSet(name, dapl);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef CHIHAYA_UTILS_CHUNK_HPP
+#define CHIHAYA_UTILS_CHUNK_HPP
+
+#include "H5Cpp.h"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+#include "utils_parallel.hpp"
+#include "utils_profile.hpp"
+#include "utils_mmap.hpp"
+
+#if defined(CHIHAYA_HAS_ZLIB) && H5_VERSION_GE(1, 10, 3)
+#define CHIHAYA_DIRECT_CHUNKS 1
+#include <zlib.h>
+#endif
+
+namespace chihaya {
+
+namespace internal_chunk {
+
+/*
+ * Direct reads of the chunks of 1-dimensional datasets compressed with deflate (and optionally shuffled).
+ * HDF5 decompresses each chunk inside H5Dread() while we hold the global lock, so decompression would otherwise be serialized across all threads.
+ * Instead, we fetch the raw chunks with H5Dread_chunk() under the lock and then reverse the filter pipeline ourselves without the lock.
+ * This is only available if zlib was found at compile time (see CHIHAYA_HAS_ZLIB) and the pipeline has no other filters;
+ * in all other cases, callers should fall back to H5::DataSet::read().
+ */
+class ChunkedDataset {
+public:
+    ChunkedDataset() = default;
+
+    ChunkedDataset([[maybe_unused]] const H5::DataSet& handle, [[maybe_unused]] bool enabled = true) {
+#ifdef CHIHAYA_DIRECT_CHUNKS
+        if (enabled) {
+            internal_parallel::Hdf5Lock lck;
+            try {
+                inspect(handle);
+            } catch (H5::Exception&) {
+                chunk_length = 0;
+            }
+        }
+#endif
+    }
+
+    bool available() const {
+        return chunk_length > 0;
+    }
+
+    internal_mmap::StoredType type() const {
+        return stored;
+    }
+
+    hsize_t chunk() const {
+        return chunk_length;
+    }
+
+    // Copies [start, start + length) into 'buffer', converting to 'Output_' with a static_cast as in MappedDataset::read().
+    // Raw chunks are fetched serially, and then decompressed by up to 'num_threads' workers (using 'pool', if provided) in parallel with other threads' reads.
+    // Returns false if any chunk in the range has not been allocated, in which case the caller should use H5::DataSet::read() to obtain the fill values.
+    template<typename Output_>
+    bool read([[maybe_unused]] const H5::DataSet& handle, [[maybe_unused]] hsize_t start, hsize_t length, [[maybe_unused]] Output_* buffer, [[maybe_unused]] int num_threads = 1, [[maybe_unused]] internal_parallel::TaskPool* pool = nullptr) const {
+        if (length == 0) {
+            return true;
+        }
+#ifdef CHIHAYA_DIRECT_CHUNKS
+        hsize_t first = start / chunk_length, last = (start + length - 1) / chunk_length + 1;
+        size_t nchunks = last - first;
+        std::vector<std::vector<unsigned char> > raw(nchunks);
+        std::vector<uint32_t> masks(nchunks);
+
+        {
+            internal_parallel::Hdf5Lock lck;
+            hid_t did = handle.getId();
+            for (size_t c = 0; c < nchunks; ++c) {
+                hsize_t offset = (first + c) * chunk_length;
+                hsize_t nbytes = 0;
+                herr_t status;
+                H5E_BEGIN_TRY {
+                    status = H5Dget_chunk_storage_size(did, &offset, &nbytes);
+                } H5E_END_TRY;
+                if (status < 0 || nbytes == 0) {
+                    return false;
+                }
+
+                raw[c].resize(nbytes);
+                if (H5Dread_chunk(did, H5P_DEFAULT, &offset, &masks[c], raw[c].data()) < 0) {
+                    throw std::runtime_error("failed to read a chunk of the dataset");
+                }
+            }
+        }
+
+        size_t num_workers = std::min(static_cast<size_t>(std::max(num_threads, 1)), nchunks);
+        internal_parallel::parallelize(num_workers, [&](size_t w) -> void {
+            internal_parallel::Hdf5Unlock unlock;
+            std::vector<unsigned char> scratch;
+            for (size_t c = (nchunks * w) / num_workers, end = (nchunks * (w + 1)) / num_workers; c < end; ++c) {
+                decode(raw[c], masks[c], scratch);
+                hsize_t cstart = (first + c) * chunk_length;
+                hsize_t from = std::max(start, cstart), to = std::min(start + length, cstart + chunk_length);
+                convert(raw[c].data(), from - cstart, to - from, buffer + (from - start));
+                std::vector<unsigned char>().swap(raw[c]); // releasing memory as we go.
+            }
+        }, pool);
+
+        internal_profile::record_read(length, length * internal_mmap::stored_size(stored));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    hsize_t chunk_length = 0;
+    internal_mmap::StoredType stored = internal_mmap::StoredType::NONE;
+    std::vector<H5Z_filter_t> filters;
+
+#ifdef CHIHAYA_DIRECT_CHUNKS
+    void inspect(const H5::DataSet& handle) {
+        auto dcpl = handle.getCreatePlist();
+        if (dcpl.getLayout() != H5D_CHUNKED) {
+            return;
+        }
+
+        auto dspace = handle.getSpace();
+        if (dspace.getSimpleExtentType() != H5S_SIMPLE || dspace.getSimpleExtentNdims() != 1) {
+            return;
+        }
+
+        auto candidate = internal_mmap::identify_stored_type(handle.getDataType());
+        if (candidate == internal_mmap::StoredType::NONE) {
+            return;
+        }
+
+        // Unfiltered chunks are not worth handling ourselves, as there is nothing to parallelize.
+        int nfilters = dcpl.getNfilters();
+        if (nfilters == 0) {
+            return;
+        }
+        std::vector<H5Z_filter_t> pipeline;
+        for (int f = 0; f < nfilters; ++f) {
+            unsigned flags, config;
+            size_t nelmts = 0;
+            auto id = H5Pget_filter2(dcpl.getId(), f, &flags, &nelmts, NULL, 0, NULL, &config);
+            if (id != H5Z_FILTER_DEFLATE && id != H5Z_FILTER_SHUFFLE) {
+                return;
+            }
+            pipeline.push_back(id);
+        }
+
+        hsize_t length;
+        dcpl.getChunk(1, &length);
+        filters.swap(pipeline);
+        stored = candidate;
+        chunk_length = length;
+    }
+
+    // Reverses the filter pipeline in place, skipping any filters that were not applied to this chunk according to its 'mask'.
+    void decode(std::vector<unsigned char>& current, uint32_t mask, std::vector<unsigned char>& scratch) const {
+        size_t width = internal_mmap::stored_size(stored);
+        size_t expected = chunk_length * width;
+
+        for (size_t f = filters.size(); f > 0; --f) {
+            if (mask & (static_cast<uint32_t>(1) << (f - 1))) {
+                continue;
+            }
+
+            if (filters[f - 1] == H5Z_FILTER_DEFLATE) {
+                scratch.resize(expected);
+                uLongf destlen = expected;
+                if (uncompress(scratch.data(), &destlen, current.data(), current.size()) != Z_OK || destlen != expected) {
+                    throw std::runtime_error("failed to decompress a chunk of the dataset");
+                }
+            } else {
+                // Shuffling groups the i-th byte of every element together, so we just transpose the bytes back.
+                size_t nbytes = current.size(), nelements = nbytes / width;
+                scratch.resize(nbytes);
+                for (size_t b = 0; b < width; ++b) {
+                    auto src = current.data() + b * nelements;
+                    for (size_t i = 0; i < nelements; ++i) {
+                        scratch[i * width + b] = src[i];
+                    }
+                }
+                std::copy(current.begin() + nelements * width, current.end(), scratch.begin() + nelements * width);
+            }
+            current.swap(scratch);
+        }
+
+        if (current.size() != expected) {
+            throw std::runtime_error("unexpected size for a decoded chunk of the dataset");
+        }
+    }
+#endif
+
+    template<typename Output_>
+    void convert(const unsigned char* decoded, hsize_t offset, hsize_t length, Output_* buffer) const {
+        internal_mmap::dispatch(stored, [&](auto zero) -> void {
+            typedef decltype(zero) Stored_;
+            if constexpr(std::is_same<Stored_, Output_>::value) {
+                std::memcpy(buffer, decoded + offset * sizeof(Stored_), length * sizeof(Stored_));
+            } else {
+                for (hsize_t i = 0; i < length; ++i) {
+                    Stored_ val;
+                    std::memcpy(&val, decoded + (offset + i) * sizeof(Stored_), sizeof(Stored_));
+                    buffer[i] = static_cast<Output_>(val);
+                }
+            }
+        });
+    }
+};
+
+}
+
+}
+
+#endif
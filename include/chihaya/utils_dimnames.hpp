@@ -6,14 +6,17 @@
 #include "ritsuko/ritsuko.hpp"
 #include <string>
 #include <stdexcept>
+#include "utils_public.hpp"
 #include "utils_list.hpp"
+#include "utils_buffer.hpp"
+#include "utils_profile.hpp"
 
 namespace chihaya {
 
 namespace internal_dimnames {
 
 template<class V>
-void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Version& version) try {
+void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Version& version, const Options& options) try {
     if (handle.childObjType("dimnames") != H5O_TYPE_GROUP) {
         throw std::runtime_error("expected a group at 'dimnames'");
     }
@@ -25,7 +28,7 @@ void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Versi
     }
 
     for (const auto& p : list_params.present) {
-        auto current = ritsuko::hdf5::open_dataset(ghandle, p.second.c_str());
+        auto current = internal_buffer::open_dataset(ghandle, p.second.c_str(), options);
         if (current.getSpace().getSimpleExtentNdims() != 1 || current.getTypeClass() != H5T_STRING) {
             throw std::runtime_error("each entry of 'dimnames' should be a 1-dimensional string dataset");
         }
@@ -35,7 +38,8 @@ void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Versi
             throw std::runtime_error("each entry of 'dimnames' should have length equal to the extent of its corresponding dimension");
         }
 
-        ritsuko::hdf5::validate_1d_string_dataset(current, len, 1000000);
+        ritsuko::hdf5::validate_1d_string_dataset(current, len, internal_buffer::pick_1d_block_size(current, len, options));
+        internal_profile::record_read(current, len);
     }
 } catch (std::exception& e) {
     throw std::runtime_error("failed to validate the 'dimnames'; " + std::string(e.what()));
@@ -0,0 +1,76 @@
+#ifndef CHIHAYA_UTILS_FILE_HPP
+#define CHIHAYA_UTILS_FILE_HPP
+
+#include "H5Cpp.h"
+
+#include <string>
+#include <algorithm>
+
+#include "utils_public.hpp"
+
+namespace chihaya {
+
+namespace internal_file {
+
+/*
+ * File access properties for the path-based entry points, see the file-related fields of 'Options'.
+ * Chihaya trees are mostly made up of small groups, attributes and scalar datasets,
+ * so validation of large trees is dominated by metadata reads and benefits from larger caches on high-latency filesystems.
+ */
+inline H5::FileAccPropList create_access_plist(const Options& options, bool page_buffer = true) {
+    H5::FileAccPropList fapl;
+    hid_t id = fapl.getId();
+
+    if (options.metadata_cache_size) {
+        H5AC_cache_config_t config;
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        H5Pget_mdc_config(id, &config);
+        config.set_initial_size = true;
+        config.initial_size = options.metadata_cache_size;
+        config.max_size = std::max(config.max_size, options.metadata_cache_size);
+        config.min_size = std::min(config.min_size, options.metadata_cache_size);
+        H5Pset_mdc_config(id, &config);
+    }
+
+    if (options.sieve_buffer_size) {
+        fapl.setSieveBufSize(options.sieve_buffer_size);
+    }
+
+#if H5_VERSION_GE(1, 10, 1)
+    if (page_buffer && options.page_buffer_size) {
+        H5Pset_page_buffer_size(id, options.page_buffer_size, 0, 0);
+    }
+#endif
+
+    if (options.core_driver) {
+        // No backing store, as the file is only opened for reading.
+        fapl.setCore(1048576, false);
+    }
+
+    return fapl;
+}
+
+// HDF5 refuses to open files that were not created with the paged file space strategy if a page buffer is requested,
+// so we retry without the page buffer in that case.
+inline void open_file(H5::H5File& handle, const std::string& path, const Options& options) {
+    if (options.page_buffer_size) {
+        bool okay = true;
+        H5E_BEGIN_TRY {
+            try {
+                handle.openFile(path, H5F_ACC_RDONLY, create_access_plist(options));
+            } catch (H5::Exception&) {
+                okay = false;
+            }
+        } H5E_END_TRY;
+        if (okay) {
+            return;
+        }
+    }
+    handle.openFile(path, H5F_ACC_RDONLY, create_access_plist(options, false));
+}
+
+}
+
+}
+
+#endif
@@ -7,6 +7,15 @@
 
 #include <string>
 #include <stdexcept>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <exception>
+
+#include "utils_parallel.hpp"
+#include "utils_profile.hpp"
 
 namespace chihaya {
 
@@ -43,7 +52,7 @@ inline void validate_missing_placeholder(const H5::DataSet& handle, const ritsuk
 }
 
 inline uint64_t load_along(const H5::Group& handle, const ritsuko::Version& version) {
-    auto ahandle = ritsuko::hdf5::open_dataset(handle, "along");
+    auto ahandle = internal_profile::open_dataset(handle, "along");
     if (!ritsuko::hdf5::is_scalar(ahandle)) {
         throw std::runtime_error("'along' should be a scalar dataset");
     }
@@ -67,19 +76,186 @@ inline uint64_t load_along(const H5::Group& handle, const ritsuko::Version& vers
     }
 }
 
+inline std::string get_object_key(const H5::Group& handle) {
+    std::string key;
+
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_info2_t info;
+    if (H5Oget_info3(handle.getId(), &info, H5O_INFO_BASIC) < 0) {
+        return key;
+    }
+    key.append(reinterpret_cast<const char*>(&(info.fileno)), sizeof(info.fileno));
+    key.append(reinterpret_cast<const char*>(&(info.token)), sizeof(info.token));
+#else
+    H5O_info_t info;
+#if H5_VERSION_GE(1, 10, 3)
+    if (H5Oget_info2(handle.getId(), &info, H5O_INFO_BASIC) < 0) {
+#else
+    if (H5Oget_info(handle.getId(), &info) < 0) {
+#endif
+        return key;
+    }
+    key.append(reinterpret_cast<const char*>(&(info.fileno)), sizeof(info.fileno));
+    key.append(reinterpret_cast<const char*>(&(info.addr)), sizeof(info.addr));
+#endif
+
+    return key;
+}
+
+// Identifies a child by the key of the group containing its link and the name of the link.
+inline std::string get_child_key(const std::string& parent_key, const std::string& name) {
+    if (parent_key.empty()) {
+        return parent_key;
+    }
+    return parent_key + "/" + name;
+}
+
+// Returns the outcome for a child that was already validated by the iterative traversal, or null if no such outcome exists.
+inline const std::pair<ArrayDetails, std::exception_ptr>* find_prevalidated(const H5::Group& handle, const std::string& name, const Options& options) {
+    if (options.prevalidated.empty()) {
+        return nullptr;
+    }
+    auto key = get_child_key(get_object_key(handle), name);
+    if (key.empty()) {
+        return nullptr;
+    }
+    auto it = options.prevalidated.find(key);
+    if (it == options.prevalidated.end()) {
+        return nullptr;
+    }
+    return &(it->second);
+}
+
+inline ArrayDetails use_prevalidated(const std::pair<ArrayDetails, std::exception_ptr>& outcome) {
+    if (outcome.second) {
+        std::rethrow_exception(outcome.second);
+    }
+    return outcome.first;
+}
+
 inline ArrayDetails load_seed_details(const H5::Group& handle, const std::string& name, const ritsuko::Version& version, Options& options) {
     ArrayDetails output;
-    auto shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+    auto found = find_prevalidated(handle, name, options);
+    H5::Group shandle;
+    if (!found) {
+        shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+    }
     try {
-        output = ::chihaya::validate(shandle, version, options);
+        if (found) {
+            output = use_prevalidated(*found);
+        } else {
+            output = ::chihaya::validate(shandle, version, options);
+        }
     } catch (std::exception& e) {
         throw std::runtime_error("failed to validate '" + name + "'; " + std::string(e.what()));
     }
     return output;
 }
 
+// Validates a series of children of 'handle'.
+// If a task pool is available, all children are submitted for concurrent validation upon construction;
+// otherwise, each child is only validated when its details are requested.
+// Details should be requested in order with get(), which waits for the corresponding task and rethrows its error in the same form as load_seed_details().
+// This ensures that the first reported error is the same as that of a serial run, even if the parent performs its own checks between children.
+class DeferredSeeds {
+public:
+    DeferredSeeds(const H5::Group& handle, std::vector<std::string> names, std::string prefix, const ritsuko::Version& version, Options& options) :
+        handle(handle),
+        names(std::move(names)),
+        prefix(std::move(prefix)),
+        version(version),
+        options(options)
+    {
+        size_t n = this->names.size();
+        if (options.pool && n > 1) {
+            results.resize(n);
+            states.reserve(n);
+            auto parent = internal_profile::lineage().current; // so that each child reports the correct parent when profiling.
+            for (size_t i = 0; i < n; ++i) {
+                states.push_back(options.pool->submit([this,i,parent]() -> void {
+                    if (!abandoned) {
+                        internal_profile::LineageScope lscope(parent);
+                        results[i] = load(i);
+                    }
+                }, /* hold_hdf5 = */ true));
+            }
+        }
+    }
+
+    ~DeferredSeeds() {
+        // Tasks refer to this object, so we need to wait for them to finish.
+        // Any unstarted tasks are skipped as their results will never be used.
+        abandoned = true;
+        for (const auto& s : states) {
+            options.pool->wait(s);
+        }
+    }
+
+    DeferredSeeds(const DeferredSeeds&) = delete;
+    DeferredSeeds& operator=(const DeferredSeeds&) = delete;
+
+public:
+    ArrayDetails get(size_t i) {
+        if (states.empty()) {
+            return load(i);
+        }
+
+        const auto& current = states[i];
+        options.pool->wait(current);
+        if (current->error) {
+            std::rethrow_exception(current->error);
+        }
+        return results[i];
+    }
+
+private:
+    const H5::Group& handle;
+    std::vector<std::string> names;
+    std::string prefix;
+    const ritsuko::Version& version;
+    Options& options;
+
+    std::vector<ArrayDetails> results;
+    std::vector<std::shared_ptr<internal_parallel::TaskPool::State> > states;
+    std::atomic<bool> abandoned = false;
+
+    ArrayDetails load(size_t i) {
+        const auto& name = names[i];
+        auto found = find_prevalidated(handle, name, options);
+        H5::Group shandle;
+        if (!found) {
+            shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+        }
+        try {
+            if (found) {
+                return use_prevalidated(*found);
+            }
+            return ::chihaya::validate(shandle, version, options);
+        } catch (std::exception& e) {
+            throw std::runtime_error("failed to validate '" + prefix + name + "'; " + std::string(e.what()));
+        }
+    }
+};
+
+// Calls 'fun' with a zero of the narrowest unsigned type that can hold the dataset's integer values.
+// This allows callers to read the dataset at its stored width, avoiding HDF5's type conversion for native layouts.
+// The dataset is assumed to have already been checked against the 64-bit unsigned limit.
+template<class Function_>
+void dispatch_unsigned_integer(const H5::DataSet& handle, Function_ fun) {
+    auto precision = handle.getIntType().getPrecision();
+    if (precision <= 8) {
+        fun(static_cast<uint8_t>(0));
+    } else if (precision <= 16) {
+        fun(static_cast<uint16_t>(0));
+    } else if (precision <= 32) {
+        fun(static_cast<uint32_t>(0));
+    } else {
+        fun(static_cast<uint64_t>(0));
+    }
+}
+
 inline std::string load_scalar_string_dataset(const H5::Group& handle, const std::string& name) {
-    auto shandle = ritsuko::hdf5::open_dataset(handle, name.c_str());
+    auto shandle = internal_profile::open_dataset(handle, name.c_str());
     if (!ritsuko::hdf5::is_scalar(shandle)) {
         throw std::runtime_error("'" + name + "' should be scalar");
     }
@@ -0,0 +1,321 @@
+#ifndef CHIHAYA_UTILS_MMAP_HPP
+#define CHIHAYA_UTILS_MMAP_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "utils_parallel.hpp"
+
+#if !defined(CHIHAYA_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CHIHAYA_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace chihaya {
+
+namespace internal_mmap {
+
+/*
+ * Zero-copy access to contiguous, unfiltered datasets by memory-mapping the file directly.
+ * This skips HDF5's type conversion and buffering for the common case where the dataset is stored as a single block of native-endian numbers.
+ * Mapping is only attempted for files that are opened read-only with the default driver, so that the file contents cannot be changed by HDF5 behind our back.
+ * If any of these conditions are not satisfied, the mapping is not available and callers should fall back to H5::DataSet::read().
+ */
+enum class StoredType : char { NONE, INT8, UINT8, INT16, UINT16, INT32, UINT32, INT64, UINT64, FLOAT, DOUBLE };
+
+template<typename Type_>
+constexpr StoredType stored_type() {
+    if constexpr(std::is_same<Type_, int8_t>::value) {
+        return StoredType::INT8;
+    } else if constexpr(std::is_same<Type_, uint8_t>::value) {
+        return StoredType::UINT8;
+    } else if constexpr(std::is_same<Type_, int16_t>::value) {
+        return StoredType::INT16;
+    } else if constexpr(std::is_same<Type_, uint16_t>::value) {
+        return StoredType::UINT16;
+    } else if constexpr(std::is_same<Type_, int32_t>::value) {
+        return StoredType::INT32;
+    } else if constexpr(std::is_same<Type_, uint32_t>::value) {
+        return StoredType::UINT32;
+    } else if constexpr(std::is_same<Type_, int64_t>::value) {
+        return StoredType::INT64;
+    } else if constexpr(std::is_same<Type_, uint64_t>::value) {
+        return StoredType::UINT64;
+    } else if constexpr(std::is_same<Type_, float>::value) {
+        return StoredType::FLOAT;
+    } else if constexpr(std::is_same<Type_, double>::value) {
+        return StoredType::DOUBLE;
+    } else {
+        return StoredType::NONE;
+    }
+}
+
+template<class Function_>
+void dispatch(StoredType type, Function_ fun) {
+    switch (type) {
+        case StoredType::INT8: fun(static_cast<int8_t>(0)); break;
+        case StoredType::UINT8: fun(static_cast<uint8_t>(0)); break;
+        case StoredType::INT16: fun(static_cast<int16_t>(0)); break;
+        case StoredType::UINT16: fun(static_cast<uint16_t>(0)); break;
+        case StoredType::INT32: fun(static_cast<int32_t>(0)); break;
+        case StoredType::UINT32: fun(static_cast<uint32_t>(0)); break;
+        case StoredType::INT64: fun(static_cast<int64_t>(0)); break;
+        case StoredType::UINT64: fun(static_cast<uint64_t>(0)); break;
+        case StoredType::FLOAT: fun(static_cast<float>(0)); break;
+        case StoredType::DOUBLE: fun(static_cast<double>(0)); break;
+        default: break;
+    }
+}
+
+inline size_t stored_size(StoredType type) {
+    size_t output = 0;
+    dispatch(type, [&](auto zero) -> void {
+        output = sizeof(zero);
+    });
+    return output;
+}
+
+// Identifies the in-memory type that is bitwise identical to the file datatype, if any.
+inline StoredType identify_stored_type(const H5::DataType& dtype) {
+    auto cls = dtype.getClass();
+    if (cls != H5T_INTEGER && cls != H5T_FLOAT) {
+        return StoredType::NONE;
+    }
+
+    StoredType output = StoredType::NONE;
+    auto check = [&](auto zero) -> void {
+        if (output == StoredType::NONE && dtype == ritsuko::hdf5::as_numeric_datatype<decltype(zero)>()) {
+            output = stored_type<decltype(zero)>();
+        }
+    };
+    check(static_cast<int8_t>(0));
+    check(static_cast<uint8_t>(0));
+    check(static_cast<int16_t>(0));
+    check(static_cast<uint16_t>(0));
+    check(static_cast<int32_t>(0));
+    check(static_cast<uint32_t>(0));
+    check(static_cast<int64_t>(0));
+    check(static_cast<uint64_t>(0));
+    check(static_cast<float>(0));
+    check(static_cast<double>(0));
+    return output;
+}
+
+#ifdef CHIHAYA_MMAP
+struct Region {
+    Region(void* base, size_t length) : base(base), length(length) {}
+    ~Region() {
+        munmap(base, length);
+    }
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    void* base;
+    size_t length;
+};
+#endif
+
+class MappedDataset {
+public:
+    MappedDataset() = default;
+
+    MappedDataset([[maybe_unused]] const H5::DataSet& handle, [[maybe_unused]] bool enabled = true) {
+#ifdef CHIHAYA_MMAP
+        if (enabled) {
+            internal_parallel::Hdf5Lock lck;
+            try {
+                map(handle);
+            } catch (H5::Exception&) {
+                region.reset();
+            }
+        }
+#endif
+    }
+
+    bool available() const {
+        return ptr != nullptr;
+    }
+
+    StoredType type() const {
+        return stored;
+    }
+
+    const std::vector<hsize_t>& dimensions() const {
+        return dims;
+    }
+
+    // Returns a pointer to the contents of the dataset if they are stored as 'Type_', otherwise NULL.
+    template<typename Type_>
+    const Type_* span() const {
+        if (!available() || stored != stored_type<Type_>()) {
+            return nullptr;
+        }
+        return reinterpret_cast<const Type_*>(ptr);
+    }
+
+    // Copies [start, start + length) of a 1-dimensional dataset into 'buffer', converting to 'Output_' with a static_cast.
+    // Callers should only use this for conversions that are exact for valid values, e.g., integers to doubles.
+    template<typename Output_>
+    void read(hsize_t start, hsize_t length, Output_* buffer) const {
+        dispatch(stored, [&](auto zero) -> void {
+            typedef decltype(zero) Stored_;
+            auto src = reinterpret_cast<const Stored_*>(ptr) + start;
+            for (hsize_t i = 0; i < length; ++i) {
+                buffer[i] = static_cast<Output_>(src[i]);
+            }
+        });
+    }
+
+    // Copies a hyperslab of an N-dimensional dataset into 'buffer' in row-major order, converting as in read().
+    template<typename Output_>
+    void read_hyperslab(const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, Output_* buffer) const {
+        size_t ndims = dims.size();
+        if (ndims == 0) {
+            read(0, 1, buffer);
+            return;
+        }
+
+        size_t total = 1;
+        for (auto c : count) {
+            total *= c;
+        }
+        if (total == 0) {
+            return;
+        }
+
+        std::vector<hsize_t> strides(ndims, 1);
+        for (size_t d = ndims - 1; d > 0; --d) {
+            strides[d - 1] = strides[d] * dims[d];
+        }
+
+        // Copying one run along the last dimension at a time.
+        std::vector<hsize_t> position(ndims);
+        hsize_t run = count[ndims - 1];
+        for (size_t i = 0; i < total; i += run) {
+            hsize_t offset = 0;
+            for (size_t d = 0; d < ndims; ++d) {
+                offset += (start[d] + position[d]) * strides[d];
+            }
+            read(offset, run, buffer + i);
+
+            for (size_t d = ndims - 1; d > 0; --d) {
+                if (++position[d - 1] < count[d - 1]) {
+                    break;
+                }
+                position[d - 1] = 0;
+            }
+        }
+    }
+
+private:
+#ifdef CHIHAYA_MMAP
+    std::shared_ptr<const Region> region;
+#endif
+    const unsigned char* ptr = nullptr;
+    StoredType stored = StoredType::NONE;
+    std::vector<hsize_t> dims;
+
+#ifdef CHIHAYA_MMAP
+    void map(const H5::DataSet& handle) {
+        auto dcpl = handle.getCreatePlist();
+        if (dcpl.getLayout() != H5D_CONTIGUOUS || dcpl.getNfilters() != 0 || dcpl.getExternalCount() != 0) {
+            return;
+        }
+
+        auto dtype = handle.getDataType();
+        auto candidate = identify_stored_type(dtype);
+        if (candidate == StoredType::NONE) {
+            return;
+        }
+        size_t width = dtype.getSize();
+
+        auto dspace = handle.getSpace();
+        if (dspace.getSimpleExtentType() == H5S_NULL) {
+            return;
+        }
+        int ndims = dspace.getSimpleExtentNdims();
+        std::vector<hsize_t> extents(ndims);
+        dspace.getSimpleExtentDims(extents.data());
+        hsize_t total = 1;
+        for (auto e : extents) {
+            total *= e;
+        }
+        if (total == 0) {
+            return;
+        }
+
+        haddr_t offset = H5Dget_offset(handle.getId());
+        if (offset == HADDR_UNDEF || offset % width != 0 || handle.getStorageSize() != total * width) {
+            return;
+        }
+
+        // Only mapping read-only files with the default driver, as the file offsets are otherwise not meaningful.
+        hid_t fid = H5Iget_file_id(handle.getId());
+        if (fid < 0) {
+            return;
+        }
+        unsigned intent = 0;
+        hid_t fapl = H5Fget_access_plist(fid);
+        bool okay = H5Fget_intent(fid, &intent) >= 0 && intent == H5F_ACC_RDONLY && fapl >= 0 && H5Pget_driver(fapl) == H5FD_SEC2;
+        std::string path;
+        if (okay) {
+            ssize_t len = H5Fget_name(fid, NULL, 0);
+            if (len > 0) {
+                path.resize(len + 1);
+                H5Fget_name(fid, path.data(), path.size());
+                path.resize(len);
+            } else {
+                okay = false;
+            }
+        }
+        if (fapl >= 0) {
+            H5Pclose(fapl);
+        }
+        H5Fclose(fid);
+        if (!okay) {
+            return;
+        }
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        size_t nbytes = total * width;
+        if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < offset + nbytes) {
+            close(fd);
+            return;
+        }
+
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t aligned = (offset / page) * page;
+        size_t length = nbytes + (offset - aligned);
+        void* base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, aligned);
+        close(fd);
+        if (base == MAP_FAILED) {
+            return;
+        }
+
+        region.reset(new Region(base, length));
+        ptr = static_cast<const unsigned char*>(base) + (offset - aligned);
+        stored = candidate;
+        dims = std::move(extents);
+    }
+#endif
+};
+
+}
+
+}
+
+#endif
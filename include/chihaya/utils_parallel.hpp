@@ -0,0 +1,308 @@
+#ifndef CHIHAYA_UTILS_PARALLEL_HPP
+#define CHIHAYA_UTILS_PARALLEL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <utility>
+
+#include "utils_profile.hpp"
+
+namespace chihaya {
+
+namespace internal_parallel {
+
+// We don't assume that the HDF5 library (or its C++ bindings) is thread-safe,
+// so all HDF5 calls in worker threads are serialized through a global mutex.
+inline std::mutex& hdf5_mutex() {
+    static std::mutex mut;
+    return mut;
+}
+
+// Number of nested holds on the global mutex by the current thread.
+inline size_t& hdf5_lock_depth() {
+    thread_local size_t depth = 0;
+    return depth;
+}
+
+// Re-entrant hold on the global mutex, so that code holding the mutex can still call functions that lock it.
+class Hdf5Lock {
+public:
+    Hdf5Lock() {
+        if (hdf5_lock_depth()++ == 0) {
+            hdf5_mutex().lock();
+        }
+    }
+
+    ~Hdf5Lock() {
+        if (--hdf5_lock_depth() == 0) {
+            hdf5_mutex().unlock();
+        }
+    }
+
+    Hdf5Lock(const Hdf5Lock&) = delete;
+    Hdf5Lock& operator=(const Hdf5Lock&) = delete;
+};
+
+// Temporarily releases all of the current thread's holds on the global mutex.
+// This is used around CPU-bound sections (and while waiting for other tasks) so that other threads can perform their reads.
+// No HDF5 calls should be made while this is active, unless they acquire their own Hdf5Lock.
+class Hdf5Unlock {
+public:
+    Hdf5Unlock() : saved(hdf5_lock_depth()) {
+        if (saved) {
+            hdf5_lock_depth() = 0;
+            hdf5_mutex().unlock();
+        }
+    }
+
+    ~Hdf5Unlock() {
+        if (saved) {
+            hdf5_mutex().lock();
+            hdf5_lock_depth() = saved;
+        }
+    }
+
+    Hdf5Unlock(const Hdf5Unlock&) = delete;
+    Hdf5Unlock& operator=(const Hdf5Unlock&) = delete;
+
+private:
+    size_t saved;
+};
+
+class TaskPool;
+
+inline std::pair<const TaskPool*, size_t>& current_worker() {
+    thread_local std::pair<const TaskPool*, size_t> worker(nullptr, 0);
+    return worker;
+}
+
+// Work-stealing pool of threads.
+// Each worker pushes new tasks to the back of its own queue and pops from the back, i.e., depth-first execution of its own subtasks;
+// idle workers steal from the front of other queues, i.e., the oldest and (typically) largest tasks.
+// Threads that wait for a task will execute other pending tasks in the meantime, so nested waits do not deadlock.
+class TaskPool {
+public:
+    struct State {
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    TaskPool(size_t num_workers) : queues(num_workers + 1) {
+        workers.reserve(num_workers);
+        for (size_t w = 0; w < num_workers; ++w) {
+            workers.emplace_back([this](size_t i) -> void { work(i); }, w);
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lck(mut);
+            finished = true;
+        }
+        cv.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+public:
+    size_t num_workers() const {
+        return workers.size();
+    }
+
+    // If 'hold_hdf5 = true', the task holds the global HDF5 mutex for its entire duration, except where it explicitly releases it.
+    // This is intended for tasks that make arbitrary HDF5 calls, e.g., validation of a subtree.
+    std::shared_ptr<State> submit(std::function<void()> fun, bool hold_hdf5) {
+        auto state = std::make_shared<State>();
+        {
+            std::lock_guard<std::mutex> lck(mut);
+            queues[own_queue()].push_back(Task{ std::move(fun), state, hold_hdf5 });
+        }
+        cv.notify_all();
+        return state;
+    }
+
+    // Errors are not rethrown here, the caller should inspect the state instead.
+    void wait(const std::shared_ptr<State>& state) {
+        Hdf5Unlock unlock;
+        std::unique_lock<std::mutex> lck(mut);
+        while (!state->done) {
+            if (!run_one(lck)) {
+                cv.wait(lck);
+            }
+        }
+    }
+
+private:
+    struct Task {
+        std::function<void()> fun;
+        std::shared_ptr<State> state;
+        bool hold_hdf5;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::deque<Task> > queues; // last queue is for tasks submitted by threads outside of the pool.
+    std::mutex mut;
+    std::condition_variable cv;
+    bool finished = false;
+
+    size_t own_queue() const {
+        const auto& current = current_worker();
+        if (current.first == this) {
+            return current.second;
+        } else {
+            return queues.size() - 1;
+        }
+    }
+
+    // Assumes that 'lck' is held on entry; it is released while the task is running.
+    bool run_one(std::unique_lock<std::mutex>& lck) {
+        size_t self = own_queue();
+        Task task;
+
+        if (!queues[self].empty()) {
+            task = std::move(queues[self].back());
+            queues[self].pop_back();
+        } else {
+            size_t nqueues = queues.size();
+            bool found = false;
+            for (size_t i = 1; i < nqueues; ++i) {
+                auto& victim = queues[(self + i) % nqueues];
+                if (!victim.empty()) {
+                    task = std::move(victim.front());
+                    victim.pop_front();
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+        }
+
+        lck.unlock();
+        std::exception_ptr error;
+        auto run = [&]() -> void {
+            try {
+                task.fun();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            task.fun = std::function<void()>(); // destroying any captures before the task is marked as done.
+        };
+        if (task.hold_hdf5) {
+            Hdf5Lock hold;
+            run();
+        } else {
+            run();
+        }
+        lck.lock();
+
+        task.state->error = std::move(error);
+        task.state->done = true;
+        cv.notify_all();
+        return true;
+    }
+
+    void work(size_t i) {
+        current_worker() = std::make_pair(this, i);
+        std::unique_lock<std::mutex> lck(mut);
+        while (true) {
+            if (run_one(lck)) {
+                continue;
+            }
+            if (finished) {
+                break;
+            }
+            cv.wait(lck);
+        }
+    }
+};
+
+// Runs 'fun(w)' for each worker 'w', using the current thread for the first worker.
+// If multiple workers fail, the error from the earliest worker is rethrown,
+// so that the reported error is the same as that from a serial run over ordered jobs.
+// If 'pool' is provided, the other workers are run as tasks in the pool, otherwise new threads are created.
+// Any hold on the global HDF5 mutex is released for the duration, so the workers should lock it for their own HDF5 calls.
+template<class Function_>
+void parallelize(size_t num_workers, Function_ fun, TaskPool* pool = nullptr) {
+    if (num_workers <= 1) {
+        if (num_workers == 1) {
+            fun(0);
+        }
+        return;
+    }
+
+    Hdf5Unlock unlock;
+    std::vector<std::exception_ptr> errors(num_workers);
+    auto counters = internal_profile::current(); // propagating the profiling counters to all workers.
+
+    if (pool) {
+        std::vector<std::shared_ptr<TaskPool::State> > states;
+        states.reserve(num_workers - 1);
+        for (size_t w = 1; w < num_workers; ++w) {
+            states.push_back(pool->submit([&fun,w,counters]() -> void {
+                internal_profile::Scope scope(counters);
+                fun(w);
+            }, false));
+        }
+
+        try {
+            fun(0);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+
+        for (size_t w = 1; w < num_workers; ++w) {
+            const auto& current = states[w - 1];
+            pool->wait(current);
+            errors[w] = current->error;
+        }
+
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(num_workers - 1);
+        for (size_t w = 1; w < num_workers; ++w) {
+            workers.emplace_back([&](size_t i) -> void {
+                internal_profile::Scope scope(counters);
+                try {
+                    fun(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }, w);
+        }
+
+        try {
+            fun(0);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    for (auto& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+}
+
+}
+
+#endif
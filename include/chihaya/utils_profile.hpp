@@ -0,0 +1,155 @@
+#ifndef CHIHAYA_UTILS_PROFILE_HPP
+#define CHIHAYA_UTILS_PROFILE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace chihaya {
+
+namespace internal_profile {
+
+// Counters for the node that is currently being validated by this thread.
+// These are only active if profiling callbacks are present in the Options;
+// otherwise, the current pointer is null and recording is a no-op.
+struct Counters {
+    std::atomic<uint64_t> datasets_opened = 0;
+    std::atomic<uint64_t> elements_read = 0;
+    std::atomic<uint64_t> bytes_read = 0;
+    std::atomic<uint64_t> read_nanoseconds = 0;
+    std::atomic<uint64_t> wait_nanoseconds = 0;
+};
+
+inline Counters*& current() {
+    thread_local Counters* ptr = nullptr;
+    return ptr;
+}
+
+// Sets the current counters for the lifetime of this object, e.g., in worker threads.
+class Scope {
+public:
+    Scope(Counters* counters) : previous(current()) {
+        current() = counters;
+    }
+
+    ~Scope() {
+        current() = previous;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Counters* previous;
+};
+
+// Identifiers for the node that is currently being validated by this thread, used to report each node's parent.
+// 'reserved' is an identifier that was assigned in advance to the next profiled node, see internal_traverse::prevalidate().
+// 'reserved_start' is the time at which the validation of that node's subtree began, which is used as the start of its wall time.
+struct Lineage {
+    uint64_t current = 0;
+    uint64_t reserved = 0;
+    std::chrono::steady_clock::time_point reserved_start;
+};
+
+inline Lineage& lineage() {
+    thread_local Lineage value;
+    return value;
+}
+
+inline uint64_t next_node_id() {
+    static std::atomic<uint64_t> counter(0);
+    return ++counter;
+}
+
+// Serializes the invocation of the profiling callbacks across threads.
+// This is necessary as the callbacks are not always made while holding the global HDF5 lock, e.g., in threaded batches with a thread-safe HDF5 library.
+inline std::mutex& callback_mutex() {
+    static std::mutex mut;
+    return mut;
+}
+
+// Sets the current lineage for the lifetime of this object, e.g., in worker threads.
+class LineageScope {
+public:
+    LineageScope(uint64_t current, uint64_t reserved = 0, std::chrono::steady_clock::time_point reserved_start = {}) : previous(lineage()) {
+        auto& value = lineage();
+        value.current = current;
+        value.reserved = reserved;
+        value.reserved_start = reserved_start;
+    }
+
+    ~LineageScope() {
+        lineage() = previous;
+    }
+
+    LineageScope(const LineageScope&) = delete;
+    LineageScope& operator=(const LineageScope&) = delete;
+
+private:
+    Lineage previous;
+};
+
+inline void record_read(uint64_t elements, uint64_t bytes) {
+    auto ptr = current();
+    if (ptr) {
+        ptr->elements_read += elements;
+        ptr->bytes_read += bytes;
+    }
+}
+
+template<typename Type_>
+void record_read(uint64_t elements) {
+    record_read(elements, elements * sizeof(Type_));
+}
+
+// For datasets that are scanned inside ritsuko, where we only know the number of elements.
+// Bytes are computed from the in-file datatype, so variable-length strings will only count the size of their handles.
+inline void record_read(const H5::DataSet& handle, uint64_t elements) {
+    if (current()) {
+        record_read(elements, elements * handle.getDataType().getSize());
+    }
+}
+
+// Adds the lifetime of this object to one of the timing counters, e.g., 'read_nanoseconds' or 'wait_nanoseconds'.
+class Timer {
+public:
+    Timer(std::atomic<uint64_t> Counters::* field) : ptr(current()), field(field) {
+        if (ptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~Timer() {
+        if (ptr) {
+            (ptr->*field) += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+private:
+    Counters* ptr;
+    std::atomic<uint64_t> Counters::* field;
+    std::chrono::steady_clock::time_point start;
+};
+
+inline H5::DataSet open_dataset(const H5::Group& handle, const char* name) {
+    auto output = ritsuko::hdf5::open_dataset(handle, name);
+    auto ptr = current();
+    if (ptr) {
+        ++(ptr->datasets_opened);
+    }
+    return output;
+}
+
+}
+
+}
+
+#endif
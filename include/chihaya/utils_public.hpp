@@ -8,6 +8,12 @@
 #include <functional>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <utility>
+#include <exception>
+#include <cstdint>
+
+#include "utils_parallel.hpp"
 
 /**
  * @file utils_public.hpp
@@ -56,6 +62,66 @@ struct ArrayDetails {
     std::vector<size_t> dimensions;
 };
 
+/**
+ * @brief Statistics for the validation of a single node.
+ *
+ * This is passed to `Options::exit_callback` after each node has been validated.
+ * Wall time includes the time spent validating the node's children,
+ * while the dataset and read counts only consider the node's own datasets, i.e., excluding those of its children.
+ */
+struct NodeStatistics {
+    /**
+     * Wall time spent validating this node and its children, in seconds.
+     */
+    double seconds = 0;
+
+    /**
+     * Number of datasets opened by this node.
+     */
+    uint64_t datasets_opened = 0;
+
+    /**
+     * Number of elements read by this node.
+     * This only considers non-scalar datasets, e.g., dimensions, indices and strings.
+     */
+    uint64_t elements_read = 0;
+
+    /**
+     * Number of bytes read by this node, in terms of the in-memory representation of the elements.
+     * For variable-length strings, only the size of the string handles is counted.
+     */
+    uint64_t bytes_read = 0;
+
+    /**
+     * Time spent reading blocks of this node's datasets, in seconds.
+     * This includes reads that were performed in the background while the node's checks were running, see `Options::prefetch`.
+     */
+    double read_seconds = 0;
+
+    /**
+     * Time that the validation of this node spent waiting for blocks of its datasets to be read, in seconds.
+     * Subtracting this from `read_seconds` gives the amount of reading that was overlapped with computation,
+     * while the time spent on computation is roughly `seconds - wait_seconds` (excluding the node's children).
+     */
+    double wait_seconds = 0;
+
+    /**
+     * Whether the validation of this node failed.
+     */
+    bool failed = false;
+
+    /**
+     * Identifier for this validation of the node, unique within the process.
+     */
+    uint64_t id = 0;
+
+    /**
+     * Identifier of the parent node's validation, i.e., the node whose validation required this node.
+     * This is zero for the node passed to a top-level call to `validate()`.
+     */
+    uint64_t parent = 0;
+};
+
 /**
  * @brief Validation options.
  *
@@ -70,6 +136,93 @@ struct Options {
      */
     bool details_only = false;
 
+    /**
+     * Number of threads to use for validation.
+     * If greater than 1, a work-stealing thread pool is created for each top-level call to `validate()`.
+     * This is used to validate sibling subtrees concurrently, e.g., the `seeds` of a combining operation or the `left` and `right` of a binary operation;
+     * and to check the `indices` of large sparse matrices, where each thread processes a contiguous range of columns (or rows) with a similar number of non-zero elements.
+     * All HDF5 calls are serialized, so this is safe to use even if the HDF5 library was not built with thread safety;
+     * only CPU-bound checks (e.g., bounds and sortedness of indices) are performed in parallel with other threads' reads.
+     * Results and the first reported error are the same as those from a serial run.
+     *
+     * Custom validation functions in `array_validate_registry` or `operation_validate_registry` may be called from worker threads.
+     * They are called while holding the global HDF5 lock, so they may freely use the HDF5 library, but they should not access any other shared state without synchronization.
+     */
+    int num_threads = 1;
+
+    /**
+     * Buffer size, in terms of the number of elements, to use when streaming through a dataset,
+     * e.g., the `indptr` and `indices` of a sparse matrix, the indices of a subset, or the strings of a dense array or `dimnames`.
+     * Each dataset is read in windows of (at most) this size, so memory usage does not scale with the dimension extents or the number of non-zero elements.
+     * For chunked datasets, windows are rounded down to whole chunks (or whole rows of chunks for N-dimensional datasets) so that each chunk is only decompressed once,
+     * though at least one chunk (row) is always read.
+     * When `num_threads > 1`, each thread allocates its own buffer for `indices`.
+     */
+    size_t buffer_size = 1000000;
+
+    /**
+     * Maximum memory usage, in bytes, of the buffers used to stream through datasets.
+     * This is divided among all buffers that may be alive at the same time, e.g., for each thread that is checking the `indices` of a sparse matrix,
+     * and further limits the number of elements in each buffer below `buffer_size`.
+     * Each buffer's share is also used as the maximum size of the chunk cache for its dataset,
+     * which is enlarged from HDF5's default to hold a row of chunks so that partially-read chunks are not decompressed again.
+     */
+    size_t buffer_memory = 100000000;
+
+    /**
+     * Whether to memory-map contiguous, unfiltered datasets of native-endian numbers, e.g., the `indices` of a sparse matrix or the indices of a subset.
+     * Such datasets are then accessed directly from the mapped file without going through HDF5's type conversion and buffering.
+     * Mapping is only performed for files that are opened read-only with the default file driver,
+     * and all other datasets (or all datasets on platforms without `mmap()`, or if `CHIHAYA_NO_MMAP` is defined) are read with HDF5 as usual.
+     */
+    bool memory_map = true;
+
+    /**
+     * Whether to read the chunks of deflate-compressed (and possibly shuffled) 1-dimensional datasets directly, e.g., the `indices` of a sparse matrix or the indices of a subset.
+     * The raw chunks are read serially and then decompressed on up to `num_threads` threads, whereas HDF5 would decompress each chunk while holding the global lock.
+     * Decoded blocks are still checked in order, so results and errors are unchanged.
+     * This is only performed if zlib was found at compile time (i.e., `CHIHAYA_HAS_ZLIB` is defined), and all other datasets are read with HDF5 as usual.
+     */
+    bool direct_chunks = true;
+
+    /**
+     * Whether to read the next block of a streamed dataset in a background thread while the current block is being checked,
+     * e.g., for the `indices` of a sparse matrix or the indices of a subset.
+     * This overlaps the I/O with the checks at the cost of an extra buffer for each stream, which is accounted for in `buffer_memory`.
+     * Datasets that fit into a single buffer are not affected.
+     */
+    bool prefetch = true;
+
+    /**
+     * Size of HDF5's metadata cache, in bytes, when opening a file by path (i.e., in the `validate()` overload for a file path, or in `batch::validate()`).
+     * Larger caches avoid repeated reads of the object headers, attributes and scalar datasets that make up a deep tree of operations.
+     * If zero, HDF5's default is used.
+     */
+    size_t metadata_cache_size = 0;
+
+    /**
+     * Size of HDF5's page buffer, in bytes, when opening a file by path.
+     * This aggregates small metadata and raw data reads into page-sized requests, which is most helpful on high-latency filesystems.
+     * It is only used for files that were created with the paged file space strategy, and is ignored for all other files.
+     * If zero, no page buffer is used.
+     */
+    size_t page_buffer_size = 0;
+
+    /**
+     * Size of HDF5's sieve buffer, in bytes, when opening a file by path.
+     * This is used to aggregate small reads from contiguous datasets.
+     * If zero, HDF5's default is used.
+     */
+    size_t sieve_buffer_size = 0;
+
+    /**
+     * Whether to read the entire file into memory with HDF5's core driver when opening a file by path.
+     * This replaces all subsequent reads with memory accesses, at the cost of memory usage equal to the file size;
+     * it is most useful for small-to-moderate files on high-latency filesystems.
+     * Note that `memory_map` has no effect with this driver.
+     */
+    bool core_driver = false;
+
     /**
      * Custom registry of functions to be used by `validate()` on arrays.
      * If a custom function is provided for an array type, it is used instead of the default function .
@@ -81,6 +234,66 @@ struct Options {
      * If a custom function is provided for an operation type, it is used instead of the default function .
      */
     std::unordered_map<std::string, std::function<ArrayDetails(const H5::Group&, const ritsuko::Version&, Options&)> > operation_validate_registry;
+
+    /**
+     * Whether to validate each HDF5 object only once per call to `validate()`.
+     * If true, groups that are reachable from multiple parents (e.g., via hard links) are only validated on their first visit,
+     * and the `ArrayDetails` from that visit are re-used for all subsequent visits.
+     * This ensures that the cost of validation scales with the number of unique objects in the file, rather than the number of paths to those objects.
+     */
+    bool deduplicate = true;
+
+    /**
+     * Memo of `ArrayDetails` for groups that have already been validated, keyed by the file number and the object token (or address, for HDF5 1.10).
+     * This is only used if `deduplicate = true`.
+     * It is automatically cleared at the start of each top-level call to `validate()`.
+     */
+    std::unordered_map<std::string, ArrayDetails> validated;
+
+    /**
+     * Function to be called by `validate()` before dispatching to the validation function for each node.
+     * The first argument is the handle to the node's group, and the second argument is the node's array or operation type, e.g., `"sparse matrix"` or `"combine"`.
+     * The type may be empty if the node does not have the expected attributes.
+     * This is not called for nodes that are re-used via `validated`.
+     *
+     * If `num_threads > 1` or in a threaded `batch::validate()`, this may be called from worker threads, but calls to `enter_callback` and `exit_callback` will never overlap as they are serialized by a dedicated mutex.
+     */
+    std::function<void(const H5::Group&, const std::string&)> enter_callback;
+
+    /**
+     * Function to be called by `validate()` after each node has been validated, regardless of whether validation succeeded.
+     * The first two arguments are the same as those of `enter_callback`, while the last argument contains the statistics for this node.
+     * Statistics are only collected if at least one of `enter_callback` or `exit_callback` is provided.
+     * See `Profiler` for a built-in collector.
+     */
+    std::function<void(const H5::Group&, const std::string&, const NodeStatistics&)> exit_callback;
+
+    /**
+     * Depth of the tree at which validation switches to an iterative traversal.
+     * Whenever the recursion reaches a multiple of this depth, all descendants of the current node are validated in post-order with an explicit stack,
+     * so that the native stack depth is bounded for very deep trees, e.g., long chains of unary operations.
+     * Reported errors are the same as those from a fully recursive traversal.
+     * Descendants in this traversal are validated at most once, regardless of `deduplicate`;
+     * and `enter_callback` and `exit_callback` are called on each descendant before its parent.
+     * The wall time reported to `exit_callback` still includes the time spent validating the node's descendants, as in the recursive traversal.
+     * If zero, the iterative traversal is never used.
+     */
+    size_t iterative_depth = 100;
+
+    /**
+     * @cond
+     */
+    // Current depth of the recursive validate() calls, used to detect a new top-level call.
+    size_t depth = 0;
+
+    // Pool for parallel validation, only available during a top-level call with 'num_threads > 1'.
+    std::shared_ptr<internal_parallel::TaskPool> pool;
+
+    // Outcomes of nodes that were validated before their parents by the iterative traversal, keyed in the same manner as 'validated'.
+    std::unordered_map<std::string, std::pair<ArrayDetails, std::exception_ptr> > prevalidated;
+    /**
+     * @endcond
+     */
 };
 
 }
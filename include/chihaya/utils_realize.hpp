@@ -0,0 +1,564 @@
+#ifndef CHIHAYA_UTILS_REALIZE_HPP
+#define CHIHAYA_UTILS_REALIZE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+
+#include "realize_array.hpp"
+#include "utils_list.hpp"
+#include "utils_profile.hpp"
+
+namespace chihaya {
+
+namespace realize {
+
+std::unique_ptr<Array> load(const H5::Group&, const ritsuko::Version&, Options&);
+
+}
+
+namespace internal_realize {
+
+inline size_t product(const std::vector<size_t>& values) {
+    size_t output = 1;
+    for (auto v : values) {
+        output *= v;
+    }
+    return output;
+}
+
+// Strides for a row-major layout with the given extents.
+inline std::vector<size_t> strides(const std::vector<size_t>& count) {
+    std::vector<size_t> output(count.size());
+    size_t current = 1;
+    for (size_t d = count.size(); d > 0; --d) {
+        output[d - 1] = current;
+        current *= count[d - 1];
+    }
+    return output;
+}
+
+inline bool is_identity(const std::vector<size_t>& permutation) {
+    for (size_t p = 0, end = permutation.size(); p < end; ++p) {
+        if (permutation[p] != p) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Permutes a row-major block with extents 'src_count' into 'dst',
+// where dimension 'p' of the destination corresponds to dimension 'perm[p]' of the source.
+inline void permute(const double* src, const std::vector<size_t>& src_count, const std::vector<size_t>& perm, double* dst) {
+    size_t ndims = perm.size();
+    size_t total = product(src_count);
+    if (total == 0) {
+        return;
+    }
+    if (ndims == 0) {
+        dst[0] = src[0];
+        return;
+    }
+
+    auto src_strides = strides(src_count);
+    std::vector<size_t> dst_count(ndims), steps(ndims);
+    for (size_t p = 0; p < ndims; ++p) {
+        dst_count[p] = src_count[perm[p]];
+        steps[p] = src_strides[perm[p]];
+    }
+    auto dst_strides = strides(dst_count);
+
+    // If the last dimension of the source is not the last dimension of the destination, the naive loop reads the source with a large stride.
+    // Instead, we transpose tiles of the destination's last dimension and the dimension 'q' corresponding to the source's last dimension,
+    // so that both the reads and writes for each tile stay in cache.
+    size_t q = ndims - 1;
+    while (perm[q] != ndims - 1) {
+        --q;
+    }
+    size_t last = ndims - 1;
+    bool blocked = (q != last && dst_count[q] > 1 && dst_count[last] > 1);
+    constexpr size_t tile = 32;
+
+    // Iterating over the remaining dimensions of the destination in row-major order while tracking the source offset.
+    std::vector<size_t> position(ndims);
+    size_t src_offset = 0, dst_offset = 0;
+    while (true) {
+        if (blocked) {
+            size_t nq = dst_count[q], nl = dst_count[last], qstride = dst_strides[q], lstep = steps[last];
+            for (size_t i0 = 0; i0 < nq; i0 += tile) {
+                size_t i1 = std::min(nq, i0 + tile);
+                for (size_t j0 = 0; j0 < nl; j0 += tile) {
+                    size_t j1 = std::min(nl, j0 + tile);
+                    for (size_t i = i0; i < i1; ++i) {
+                        auto dst_ptr = dst + dst_offset + i * qstride;
+                        auto src_ptr = src + src_offset + i;
+                        for (size_t j = j0; j < j1; ++j) {
+                            dst_ptr[j] = src_ptr[j * lstep];
+                        }
+                    }
+                }
+            }
+        } else {
+            size_t inner_extent = dst_count[last], inner_step = steps[last];
+            auto src_ptr = src + src_offset;
+            auto dst_ptr = dst + dst_offset;
+            for (size_t j = 0; j < inner_extent; ++j, src_ptr += inner_step) {
+                dst_ptr[j] = *src_ptr;
+            }
+        }
+
+        size_t p = last;
+        for (; p > 0; --p) {
+            if (blocked && p - 1 == q) {
+                continue;
+            }
+            auto& pos = position[p - 1];
+            ++pos;
+            src_offset += steps[p - 1];
+            dst_offset += dst_strides[p - 1];
+            if (pos < dst_count[p - 1]) {
+                break;
+            }
+            src_offset -= pos * steps[p - 1];
+            dst_offset -= pos * dst_strides[p - 1];
+            pos = 0;
+        }
+        if (p == 0) {
+            break;
+        }
+    }
+}
+
+// Calls 'fun(a, ptr, n)' for each contiguous run of 'n' elements of a row-major block that share the same position 'a' along the 'along' dimension.
+template<class Function_>
+void for_each_run_along(const std::vector<size_t>& count, size_t along, double* buffer, Function_ fun) {
+    size_t outer = 1;
+    for (size_t d = 0; d < along; ++d) {
+        outer *= count[d];
+    }
+    size_t inner = 1;
+    for (size_t d = along + 1; d < count.size(); ++d) {
+        inner *= count[d];
+    }
+
+    size_t extent = count[along];
+    for (size_t o = 0; o < outer; ++o) {
+        for (size_t a = 0; a < extent; ++a) {
+            fun(a, buffer, inner);
+            buffer += inner;
+        }
+    }
+}
+
+/*
+ * Splits the 'count' block (offset by 'start') into contiguous sub-blocks of at most 'max_elements' elements.
+ * Each sub-block consists of a single position in dimensions [0, k), a range in dimension k and the full extent of all subsequent dimensions,
+ * such that each sub-block is a contiguous slice of the row-major layout for the full block.
+ * 'fun(sub_start, sub_count, offset)' is called for each sub-block, where 'offset' is its position in the full block.
+ */
+template<class Function_>
+void split_block(const std::vector<size_t>& start, const std::vector<size_t>& count, size_t max_elements, Function_ fun) {
+    size_t ndims = count.size();
+    size_t total = product(count);
+    if (total == 0) {
+        return;
+    }
+    if (ndims == 0 || total <= max_elements) {
+        fun(start, count, static_cast<size_t>(0));
+        return;
+    }
+
+    size_t k = 0, trailing = total;
+    for (; k < ndims; ++k) {
+        trailing /= count[k];
+        if (trailing <= max_elements) {
+            break;
+        }
+    }
+    size_t chunk = std::max(static_cast<size_t>(1), std::min(count[k], max_elements / trailing));
+
+    auto sub_start = start;
+    auto sub_count = count;
+    for (size_t d = 0; d < k; ++d) {
+        sub_count[d] = 1;
+    }
+
+    size_t offset = 0;
+    while (true) {
+        for (size_t j = 0; j < count[k]; j += chunk) {
+            sub_start[k] = start[k] + j;
+            sub_count[k] = std::min(chunk, count[k] - j);
+            fun(sub_start, sub_count, offset);
+            offset += sub_count[k] * trailing;
+        }
+
+        // Advancing the position in the leading dimensions.
+        size_t d = k;
+        for (; d > 0; --d) {
+            auto& pos = sub_start[d - 1];
+            ++pos;
+            if (pos < start[d - 1] + count[d - 1]) {
+                break;
+            }
+            pos = start[d - 1];
+        }
+        if (d == 0) {
+            break;
+        }
+    }
+}
+
+inline size_t max_block_elements(const realize::Array& array, size_t memory_budget) {
+    return std::max(static_cast<size_t>(1), memory_budget / (sizeof(double) * (1 + array.workspace())));
+}
+
+
+/*
+ * Gathering arbitrary positions from an array, e.g., for subsetting.
+ * Along each dimension, the sorted positions are grouped into runs, where nearby positions are merged to reduce the number of extract() calls.
+ * We then extract the block for each combination of runs and scatter its values into the output.
+ * This ensures that the number of extracted elements is proportional to the number of requested positions, rather than the extent of the bounding box.
+ */
+struct GatherRuns {
+    // Start and length of each run in the array.
+    std::vector<std::pair<size_t, size_t> > runs;
+
+    // For each run, the positions in the output and the corresponding offsets in the run.
+    std::vector<std::vector<std::pair<size_t, size_t> > > members;
+};
+
+inline GatherRuns plan_gather(const std::vector<size_t>& positions) {
+    GatherRuns output;
+    size_t n = positions.size();
+    if (n == 0) {
+        return output;
+    }
+
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right) -> bool {
+        return positions[left] < positions[right];
+    });
+
+    // Nearby positions are merged into the same run, as long as the run does not become much larger than the number of positions inside it.
+    // This limits the size of the extracted block to roughly twice the number of requested positions in each dimension.
+    constexpr size_t max_gap = 8;
+    size_t num_members = 0;
+    for (auto o : order) {
+        auto pos = positions[o];
+        if (output.runs.empty() || pos - output.runs.back().first + 1 > 2 * (num_members + 1) + max_gap) {
+            output.runs.emplace_back(pos, 1);
+            output.members.emplace_back();
+            num_members = 0;
+        } else {
+            auto& run = output.runs.back();
+            run.second = std::max(run.second, pos - run.first + 1);
+        }
+        output.members.back().emplace_back(o, pos - output.runs.back().first);
+        ++num_members;
+    }
+
+    return output;
+}
+
+inline bool is_consecutive(const std::vector<size_t>& positions) {
+    for (size_t i = 1, end = positions.size(); i < end; ++i) {
+        if (positions[i] != positions[0] + i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sets the block for the current combination of runs across dimensions.
+inline void set_run_block(const std::vector<GatherRuns>& plans, const std::vector<size_t>& run_index, std::vector<size_t>& start, std::vector<size_t>& count) {
+    for (size_t d = 0, ndims = plans.size(); d < ndims; ++d) {
+        const auto& run = plans[d].runs[run_index[d]];
+        start[d] = run.first;
+        count[d] = run.second;
+    }
+}
+
+// Advances to the next combination of runs in row-major order, returning false once all combinations have been visited.
+inline bool next_run(const std::vector<GatherRuns>& plans, std::vector<size_t>& run_index) {
+    for (size_t d = plans.size(); d > 0; --d) {
+        auto& ri = run_index[d - 1];
+        ++ri;
+        if (ri < plans[d - 1].runs.size()) {
+            return true;
+        }
+        ri = 0;
+    }
+    return false;
+}
+
+// Fills 'buffer' with the values of 'array' at the Cartesian product of 'positions' across dimensions, in row-major order.
+inline void gather(const realize::Array& array, const std::vector<std::vector<size_t> >& positions, double* buffer) {
+    size_t ndims = positions.size();
+    std::vector<size_t> lengths(ndims);
+    bool consecutive = true;
+    for (size_t d = 0; d < ndims; ++d) {
+        lengths[d] = positions[d].size();
+        if (lengths[d] == 0) {
+            return;
+        }
+        consecutive = consecutive && is_consecutive(positions[d]);
+    }
+
+    if (consecutive) {
+        std::vector<size_t> start(ndims);
+        for (size_t d = 0; d < ndims; ++d) {
+            start[d] = positions[d].front();
+        }
+        array.extract(start, lengths, buffer);
+        return;
+    }
+
+    std::vector<GatherRuns> plans;
+    plans.reserve(ndims);
+    for (const auto& p : positions) {
+        plans.push_back(plan_gather(p));
+    }
+    auto out_strides = strides(lengths);
+
+    std::vector<size_t> run_index(ndims), sub_start(ndims), sub_count(ndims), tmp_strides;
+    std::vector<double> temp;
+
+    auto scatter = [&](auto& self, size_t d, size_t out_offset, size_t in_offset) -> void {
+        const auto& members = plans[d].members[run_index[d]];
+        if (d + 1 == ndims) {
+            for (const auto& m : members) {
+                buffer[out_offset + m.first] = temp[in_offset + m.second];
+            }
+        } else {
+            for (const auto& m : members) {
+                self(self, d + 1, out_offset + m.first * out_strides[d], in_offset + m.second * tmp_strides[d]);
+            }
+        }
+    };
+
+    do {
+        set_run_block(plans, run_index, sub_start, sub_count);
+        temp.resize(product(sub_count));
+        array.extract(sub_start, sub_count, temp.data());
+        tmp_strides = strides(sub_count);
+        scatter(scatter, 0, 0, 0);
+    } while (next_run(plans, run_index));
+}
+
+// Appends the regions of the leaves of 'array' that are read by gather() with the same 'positions'.
+inline void gather_regions(const realize::Array& array, const std::vector<std::vector<size_t> >& positions, std::vector<realize::Region>& output) {
+    size_t ndims = positions.size();
+    std::vector<size_t> start(ndims), count(ndims);
+    bool consecutive = true;
+    for (size_t d = 0; d < ndims; ++d) {
+        if (positions[d].empty()) {
+            return;
+        }
+        start[d] = positions[d].front();
+        count[d] = positions[d].size();
+        consecutive = consecutive && is_consecutive(positions[d]);
+    }
+
+    if (consecutive) {
+        array.regions(start, count, output);
+        return;
+    }
+
+    std::vector<GatherRuns> plans;
+    plans.reserve(ndims);
+    for (const auto& p : positions) {
+        plans.push_back(plan_gather(p));
+    }
+    std::vector<size_t> run_index(ndims);
+    do {
+        set_run_block(plans, run_index, start, count);
+        array.regions(start, count, output);
+    } while (next_run(plans, run_index));
+}
+
+// Number of additional buffers used by gather(), as the extracted runs are at most twice as large as the requested positions in each dimension.
+inline size_t gather_workspace(const realize::Array& array) {
+    size_t ndims = std::min(array.dimensions().size(), static_cast<size_t>(16));
+    return (static_cast<size_t>(1) << ndims) * (1 + array.workspace());
+}
+
+/*
+ * Loading utilities.
+ */
+/*** Sparse blocks ***/
+
+inline void clear_sparse(realize::SparseBlock& block, bool by_column, size_t primary) {
+    block.by_column = by_column;
+    block.pointers.assign(primary + 1, 0);
+    block.indices.clear();
+    block.values.clear();
+}
+
+// Converts a CSC block into a CSR block or vice versa, where 'secondary' is the secondary extent of the input.
+inline void flip_sparse(const realize::SparseBlock& input, size_t secondary, realize::SparseBlock& output) {
+    size_t primary = input.pointers.size() - 1;
+    size_t nnz = input.indices.size();
+    output.by_column = !input.by_column;
+    output.pointers.assign(secondary + 1, 0);
+    for (auto i : input.indices) {
+        ++output.pointers[i + 1];
+    }
+    for (size_t s = 0; s < secondary; ++s) {
+        output.pointers[s + 1] += output.pointers[s];
+    }
+
+    // Visiting the input in order of the primary dimension, so the new indices are sorted within each new primary element.
+    output.indices.resize(nnz);
+    output.values.resize(nnz);
+    std::vector<size_t> next(output.pointers.begin(), output.pointers.end() - 1);
+    for (size_t p = 0; p < primary; ++p) {
+        for (size_t k = input.pointers[p], end = input.pointers[p + 1]; k < end; ++k) {
+            auto& dest = next[input.indices[k]];
+            output.indices[dest] = p;
+            output.values[dest] = input.values[k];
+            ++dest;
+        }
+    }
+}
+
+// Fills a row-major dense buffer of 'count' from a sparse block.
+inline void densify_sparse(const realize::SparseBlock& block, const std::vector<size_t>& count, double* buffer) {
+    size_t nc = count[1];
+    std::fill_n(buffer, count[0] * nc, 0);
+    size_t pstride = (block.by_column ? 1 : nc), sstride = (block.by_column ? nc : 1);
+    for (size_t p = 0, np = block.pointers.size() - 1; p < np; ++p) {
+        for (size_t k = block.pointers[p], end = block.pointers[p + 1]; k < end; ++k) {
+            buffer[p * pstride + block.indices[k] * sstride] = block.values[k];
+        }
+    }
+}
+
+inline std::unique_ptr<realize::Array> load_seed(const H5::Group& handle, const std::string& name, const ritsuko::Version& version, realize::Options& options) {
+    auto shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+    try {
+        return realize::load(shandle, version, options);
+    } catch (std::exception& e) {
+        throw std::runtime_error("failed to load '" + name + "'; " + std::string(e.what()));
+    }
+}
+
+struct Placeholder {
+    bool present = false;
+    double value = 0;
+};
+
+inline Placeholder load_placeholder(const H5::DataSet& handle, const ritsuko::Version& version) {
+    Placeholder output;
+    if (version.major == 0 || !handle.attrExists("missing_placeholder")) {
+        return output;
+    }
+    auto ahandle = handle.openAttribute("missing_placeholder");
+    ahandle.read(H5::PredType::NATIVE_DOUBLE, &(output.value));
+    output.present = true;
+    return output;
+}
+
+inline void replace_placeholder(const Placeholder& placeholder, double* ptr, size_t n) {
+    if (!placeholder.present) {
+        return;
+    }
+    auto na = realize::missing_value();
+    if (std::isnan(placeholder.value)) {
+        for (size_t i = 0; i < n; ++i) {
+            if (std::isnan(ptr[i])) {
+                ptr[i] = na;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            if (ptr[i] == placeholder.value) {
+                ptr[i] = na;
+            }
+        }
+    }
+}
+
+// Loads a scalar or 1-dimensional numeric dataset, replacing any missing placeholders.
+inline std::vector<double> load_numeric_values(const H5::DataSet& handle, const ritsuko::Version& version) {
+    auto dspace = handle.getSpace();
+    size_t len = 1;
+    if (dspace.getSimpleExtentNdims() == 1) {
+        hsize_t extent;
+        dspace.getSimpleExtentDims(&extent);
+        len = extent;
+    }
+    std::vector<double> output(len);
+    if (len) {
+        handle.read(output.data(), H5::PredType::NATIVE_DOUBLE);
+    }
+    internal_profile::record_read(handle, len);
+    replace_placeholder(load_placeholder(handle, version), output.data(), output.size());
+    return output;
+}
+
+inline std::vector<size_t> load_indices(const H5::DataSet& handle) {
+    auto len = ritsuko::hdf5::get_1d_length(handle, false);
+    std::vector<uint64_t> tmp(len);
+    if (len) {
+        handle.read(tmp.data(), H5::PredType::NATIVE_UINT64);
+    }
+    internal_profile::record_read<uint64_t>(len);
+    return std::vector<size_t>(tmp.begin(), tmp.end());
+}
+
+struct IndexList {
+    std::vector<bool> present;
+    std::vector<std::vector<size_t> > indices;
+};
+
+inline IndexList load_index_list(const H5::Group& handle, const ritsuko::Version& version) {
+    auto list_params = internal_list::validate(handle, version);
+    IndexList output;
+    output.present.resize(list_params.length);
+    output.indices.resize(list_params.length);
+    for (const auto& p : list_params.present) {
+        output.present[p.first] = true;
+        output.indices[p.first] = load_indices(internal_profile::open_dataset(handle, p.second.c_str()));
+    }
+    return output;
+}
+
+// Position of the 'along' dimension of an elementwise operation after its seed is transposed by 'permutation'.
+inline size_t permuted_along(size_t along, const std::vector<size_t>& permutation) {
+    for (size_t p = 0, end = permutation.size(); p < end; ++p) {
+        if (permutation[p] == along) {
+            return p;
+        }
+    }
+    return along;
+}
+
+// Subsets the values of an elementwise operation that are applied along dimension 'along', so that they match a subset of the seed.
+inline std::vector<double> subset_along(const std::vector<double>& values, size_t along, const IndexList& index) {
+    if (values.size() <= 1 || !index.present[along]) {
+        return values;
+    }
+    std::vector<double> output;
+    output.reserve(index.indices[along].size());
+    for (auto i : index.indices[along]) {
+        output.push_back(values[i]);
+    }
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef CHIHAYA_UTILS_SIMD_HPP
+#define CHIHAYA_UTILS_SIMD_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+
+#if !defined(CHIHAYA_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CHIHAYA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace chihaya {
+
+namespace internal_simd {
+
+/*
+ * Block-wise checks for index vectors, i.e., non-negativity, upper bounds and (optionally) strict monotonicity.
+ * Each function returns the position of the first invalid element in the block, or 'n' if all elements are valid.
+ * The caller is then responsible for inspecting the offending element to report an appropriate error.
+ * 'has_previous' and 'previous' specify the element immediately before the block, if any, for monotonicity checks across blocks.
+ */
+
+template<typename Index_>
+bool is_negative([[maybe_unused]] Index_ x) {
+    if constexpr(std::is_signed<Index_>::value) {
+        return x < 0;
+    } else {
+        return false;
+    }
+}
+
+template<typename Index_>
+bool is_out_of_range(Index_ x, uint64_t extent) {
+    return is_negative(x) || static_cast<uint64_t>(x) >= extent;
+}
+
+template<typename Index_>
+size_t find_invalid_scalar(const Index_* ptr, size_t n, uint64_t extent, bool increasing, bool has_previous, Index_ previous) {
+    for (size_t i = 0; i < n; ++i) {
+        auto x = ptr[i];
+        if (is_out_of_range(x, extent)) {
+            return i;
+        }
+        if (increasing && (i > 0 || has_previous) && x <= previous) {
+            return i;
+        }
+        previous = x;
+    }
+    return n;
+}
+
+#ifdef CHIHAYA_X86_SIMD
+enum class InstructionSet { SCALAR, SSE42, AVX2 };
+
+inline InstructionSet detect_instruction_set() {
+    static const InstructionSet isa = []() -> InstructionSet {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return InstructionSet::AVX2;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            return InstructionSet::SSE42;
+        }
+        return InstructionSet::SCALAR;
+    }();
+    return isa;
+}
+
+// The largest valid value for each type, given the extent; all-ones if the extent is larger than what the type can hold.
+template<typename Index_>
+Index_ compute_cap(uint64_t extent) {
+    constexpr uint64_t maxed = std::numeric_limits<Index_>::max();
+    return (extent - 1 > maxed ? std::numeric_limits<Index_>::max() : static_cast<Index_>(extent - 1));
+}
+
+// Unsigned comparisons are performed by flipping the sign bit (i.e., biasing) and then using signed comparisons.
+template<typename Index_>
+constexpr auto compute_bias() {
+    typedef typename std::make_signed<Index_>::type Signed;
+    return (std::is_signed<Index_>::value ? static_cast<Signed>(0) : std::numeric_limits<Signed>::min());
+}
+
+/*** AVX2 kernels ***/
+
+template<typename Index_, typename Value_>
+__attribute__((target("avx2")))
+__m256i avx2_set1(Value_ x) {
+    if constexpr(sizeof(Index_) == 8) {
+        return _mm256_set1_epi64x(x);
+    } else if constexpr(sizeof(Index_) == 4) {
+        return _mm256_set1_epi32(x);
+    } else if constexpr(sizeof(Index_) == 2) {
+        return _mm256_set1_epi16(x);
+    } else {
+        return _mm256_set1_epi8(x);
+    }
+}
+
+template<typename Index_>
+__attribute__((target("avx2")))
+__m256i avx2_cmpgt(__m256i left, __m256i right) {
+    if constexpr(sizeof(Index_) == 8) {
+        return _mm256_cmpgt_epi64(left, right);
+    } else if constexpr(sizeof(Index_) == 4) {
+        return _mm256_cmpgt_epi32(left, right);
+    } else if constexpr(sizeof(Index_) == 2) {
+        return _mm256_cmpgt_epi16(left, right);
+    } else {
+        return _mm256_cmpgt_epi8(left, right);
+    }
+}
+
+template<typename Index_>
+__attribute__((target("avx2")))
+size_t find_invalid_avx2(const Index_* ptr, size_t n, uint64_t extent, bool increasing) {
+    constexpr size_t width = 32 / sizeof(Index_);
+    const __m256i bias = avx2_set1<Index_>(compute_bias<Index_>());
+    const __m256i cap = _mm256_xor_si256(avx2_set1<Index_>(compute_cap<Index_>(extent)), bias);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(-1);
+
+    size_t i = 1;
+    for (; i + width <= n; i += width) {
+        __m256i cur = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i)), bias);
+        __m256i bad = avx2_cmpgt<Index_>(cur, cap);
+        if constexpr(std::is_signed<Index_>::value) {
+            bad = _mm256_or_si256(bad, avx2_cmpgt<Index_>(zero, cur));
+        }
+
+        if (increasing) {
+            __m256i prev = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i - 1)), bias);
+            bad = _mm256_or_si256(bad, _mm256_xor_si256(avx2_cmpgt<Index_>(cur, prev), ones));
+        }
+
+        if (!_mm256_testz_si256(bad, bad)) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/*** SSE4.2 kernels ***/
+
+template<typename Index_, typename Value_>
+__attribute__((target("sse4.2")))
+__m128i sse42_set1(Value_ x) {
+    if constexpr(sizeof(Index_) == 8) {
+        return _mm_set1_epi64x(x);
+    } else if constexpr(sizeof(Index_) == 4) {
+        return _mm_set1_epi32(x);
+    } else if constexpr(sizeof(Index_) == 2) {
+        return _mm_set1_epi16(x);
+    } else {
+        return _mm_set1_epi8(x);
+    }
+}
+
+template<typename Index_>
+__attribute__((target("sse4.2")))
+__m128i sse42_cmpgt(__m128i left, __m128i right) {
+    if constexpr(sizeof(Index_) == 8) {
+        return _mm_cmpgt_epi64(left, right);
+    } else if constexpr(sizeof(Index_) == 4) {
+        return _mm_cmpgt_epi32(left, right);
+    } else if constexpr(sizeof(Index_) == 2) {
+        return _mm_cmpgt_epi16(left, right);
+    } else {
+        return _mm_cmpgt_epi8(left, right);
+    }
+}
+
+template<typename Index_>
+__attribute__((target("sse4.2")))
+size_t find_invalid_sse42(const Index_* ptr, size_t n, uint64_t extent, bool increasing) {
+    constexpr size_t width = 16 / sizeof(Index_);
+    const __m128i bias = sse42_set1<Index_>(compute_bias<Index_>());
+    const __m128i cap = _mm_xor_si128(sse42_set1<Index_>(compute_cap<Index_>(extent)), bias);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi32(-1);
+
+    size_t i = 1;
+    for (; i + width <= n; i += width) {
+        __m128i cur = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i)), bias);
+        __m128i bad = sse42_cmpgt<Index_>(cur, cap);
+        if constexpr(std::is_signed<Index_>::value) {
+            bad = _mm_or_si128(bad, sse42_cmpgt<Index_>(zero, cur));
+        }
+
+        if (increasing) {
+            __m128i prev = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i - 1)), bias);
+            bad = _mm_or_si128(bad, _mm_xor_si128(sse42_cmpgt<Index_>(cur, prev), ones));
+        }
+
+        if (!_mm_testz_si128(bad, bad)) {
+            break;
+        }
+    }
+
+    return i;
+}
+#endif
+
+template<typename Index_>
+constexpr bool has_simd_kernel() {
+    return std::is_integral<Index_>::value && !std::is_same<Index_, bool>::value && sizeof(Index_) <= 8;
+}
+
+template<typename Index_>
+size_t find_invalid(const Index_* ptr, size_t n, uint64_t extent, bool increasing, bool has_previous, Index_ previous) {
+#ifdef CHIHAYA_X86_SIMD
+    if constexpr(has_simd_kernel<Index_>()) {
+        auto isa = detect_instruction_set();
+        if (isa != InstructionSet::SCALAR && n > 1 && extent > 0) {
+            // Checking the first element in scalar mode, as it needs to be compared to the previous value.
+            if (find_invalid_scalar(ptr, 1, extent, increasing, has_previous, previous) == 0) {
+                return 0;
+            }
+
+            // The vectorized kernels return the position at which to resume the scalar scan,
+            // either because an invalid element was detected or because the remaining elements do not fill a vector.
+            size_t resume = (isa == InstructionSet::AVX2 ? find_invalid_avx2(ptr, n, extent, increasing) : find_invalid_sse42(ptr, n, extent, increasing));
+            return resume + find_invalid_scalar(ptr + resume, n - resume, extent, increasing, true, ptr[resume - 1]);
+        }
+    }
+#endif
+    return find_invalid_scalar(ptr, n, extent, increasing, has_previous, previous);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef CHIHAYA_UTILS_SIMD_MATH_HPP
+#define CHIHAYA_UTILS_SIMD_MATH_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+#include "utils_simd.hpp"
+
+namespace chihaya {
+
+namespace internal_simd {
+
+/*
+ * Vectorized kernels for the unary math methods.
+ * Each kernel transforms a prefix of 'ptr' in place and returns its length, i.e., the position at which the caller should resume with its scalar loop.
+ * This is zero if no vectorized kernel is available on the current CPU.
+ * AVX-512 kernels are used if the CPU supports them, otherwise the AVX2 kernels are used.
+ *
+ * NaNs (including R's missing values) are passed through unchanged, consistent with the scalar implementations.
+ * ABS, SIGN, SQRT, CEILING, FLOOR, TRUNC, ROUND and SIGNIF are exact and give the same results as the scalar code.
+ * All other kernels use polynomial or rational approximations, which are accurate to a few ULPs but may not be bit-identical to libm.
+ * The 'scalar' function is used to compute any elements that cannot be handled by the approximations, e.g., the sine of very large values.
+ *
+ * For LOG, 'parameter' is the natural log of the base; for ROUND and SIGNIF, it is the number of digits; it is ignored for the other kernels.
+ */
+enum class MathKernel {
+    ABS, SIGN, SQRT, CEILING, FLOOR, TRUNC, ROUND, SIGNIF,
+    EXP, EXPM1, LOG, LOG1P,
+    SIN, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH, ASINH, ACOSH, ATANH
+};
+
+constexpr bool is_exact(MathKernel kernel) {
+    return kernel == MathKernel::ABS || kernel == MathKernel::SIGN || kernel == MathKernel::SQRT ||
+        kernel == MathKernel::CEILING || kernel == MathKernel::FLOOR || kernel == MathKernel::TRUNC ||
+        kernel == MathKernel::ROUND || kernel == MathKernel::SIGNIF;
+}
+
+// Powers of 10 for SIGNIF, from 10^-max_power10 to 10^max_power10, computed with std::pow() to match the scalar code.
+// Larger numbers of digits give the same results as the limits, i.e., an infinite or zero scaling factor.
+constexpr int max_power10 = 400;
+
+inline const double* power10_table() {
+    static const auto table = []() -> std::vector<double> {
+        std::vector<double> output;
+        output.reserve(2 * max_power10 + 1);
+        for (int d = -max_power10; d <= max_power10; ++d) {
+            output.push_back(std::pow(10.0, static_cast<double>(d)));
+        }
+        return output;
+    }();
+    return table.data();
+}
+
+#ifdef CHIHAYA_X86_SIMD
+enum class MathInstructionSet { SCALAR, AVX2, AVX512 };
+
+inline MathInstructionSet detect_math_instruction_set() {
+    static const MathInstructionSet isa = []() -> MathInstructionSet {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return MathInstructionSet::AVX512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            return MathInstructionSet::AVX2;
+        }
+        return MathInstructionSet::SCALAR;
+    }();
+    return isa;
+}
+
+// Adding and subtracting 1.5 * 2^52 converts between small integral doubles and 64-bit integers.
+constexpr double conversion_magic = 6755399441055744.0;
+
+/*** AVX2 kernels ***/
+
+namespace math_avx2 {
+
+#define CHIHAYA_SIMD_TARGET __attribute__((target("avx2")))
+
+typedef __m256d Vec;
+typedef __m256d Mask;
+constexpr size_t width = 4;
+
+CHIHAYA_SIMD_TARGET inline Vec set1(double x) { return _mm256_set1_pd(x); }
+CHIHAYA_SIMD_TARGET inline Vec load(const double* ptr) { return _mm256_loadu_pd(ptr); }
+CHIHAYA_SIMD_TARGET inline void store(double* ptr, Vec x) { _mm256_storeu_pd(ptr, x); }
+
+CHIHAYA_SIMD_TARGET inline Vec add(Vec x, Vec y) { return _mm256_add_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec sub(Vec x, Vec y) { return _mm256_sub_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec mul(Vec x, Vec y) { return _mm256_mul_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec div(Vec x, Vec y) { return _mm256_div_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec min(Vec x, Vec y) { return _mm256_min_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec max(Vec x, Vec y) { return _mm256_max_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec sqrt(Vec x) { return _mm256_sqrt_pd(x); }
+
+CHIHAYA_SIMD_TARGET inline Vec floor(Vec x) { return _mm256_round_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec ceil(Vec x) { return _mm256_round_pd(x, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec trunc(Vec x) { return _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec nearbyint(Vec x) { return _mm256_round_pd(x, _MM_FROUND_CUR_DIRECTION | _MM_FROUND_NO_EXC); }
+
+CHIHAYA_SIMD_TARGET inline Vec abs(Vec x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+CHIHAYA_SIMD_TARGET inline Vec sign_bit(Vec x) { return _mm256_and_pd(_mm256_set1_pd(-0.0), x); }
+CHIHAYA_SIMD_TARGET inline Vec xor_bits(Vec x, Vec y) { return _mm256_xor_pd(x, y); }
+
+CHIHAYA_SIMD_TARGET inline Mask lt(Vec x, Vec y) { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask le(Vec x, Vec y) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask gt(Vec x, Vec y) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask ge(Vec x, Vec y) { return _mm256_cmp_pd(x, y, _CMP_GE_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask eq(Vec x, Vec y) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask is_nan(Vec x) { return _mm256_cmp_pd(x, x, _CMP_UNORD_Q); }
+
+CHIHAYA_SIMD_TARGET inline Mask mask_none() { return _mm256_setzero_pd(); }
+CHIHAYA_SIMD_TARGET inline Mask mask_and(Mask x, Mask y) { return _mm256_and_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Mask mask_or(Mask x, Mask y) { return _mm256_or_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Mask mask_not(Mask x) { return _mm256_xor_pd(x, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+CHIHAYA_SIMD_TARGET inline bool mask_any(Mask x) { return _mm256_movemask_pd(x) != 0; }
+CHIHAYA_SIMD_TARGET inline unsigned mask_bits(Mask x) { return _mm256_movemask_pd(x); }
+
+// Returns 'yes' where 'condition' is set, and 'no' otherwise.
+CHIHAYA_SIMD_TARGET inline Vec select(Mask condition, Vec yes, Vec no) { return _mm256_blendv_pd(no, yes, condition); }
+
+// Only valid for integral 'x' in [-2^51, 2^51].
+CHIHAYA_SIMD_TARGET inline __m256i to_integer(Vec x) {
+    const __m256d magic = _mm256_set1_pd(conversion_magic);
+    return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(x, magic)), _mm256_castpd_si256(magic));
+}
+
+// Only valid for integral 'k' in [-1022, 1023].
+CHIHAYA_SIMD_TARGET inline Vec pow2(Vec k) {
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(to_integer(k), _mm256_set1_epi64x(1023)), 52));
+}
+
+// Returns the mantissa in [0.5, 1) and sets 'exponent', as in std::frexp(); only valid for positive normal 'x'.
+CHIHAYA_SIMD_TARGET inline Vec split_exponent(Vec x, Vec& exponent) {
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256i ebits = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1022));
+    const __m256d magic = _mm256_set1_pd(conversion_magic);
+    exponent = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(ebits, _mm256_castpd_si256(magic))), magic);
+    __m256i mbits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL)), _mm256_set1_epi64x(0x3fe0000000000000LL));
+    return _mm256_castsi256_pd(mbits);
+}
+
+// Only valid for integral 'index' that are within the bounds of 'table'.
+CHIHAYA_SIMD_TARGET inline Vec gather(const double* table, Vec index) {
+    return _mm256_i64gather_pd(table, to_integer(index), 8);
+}
+
+#include "utils_simd_math_kernels.hpp"
+
+#undef CHIHAYA_SIMD_TARGET
+
+}
+
+/*** AVX-512 kernels ***/
+
+namespace math_avx512 {
+
+#define CHIHAYA_SIMD_TARGET __attribute__((target("avx512f")))
+
+typedef __m512d Vec;
+typedef __mmask8 Mask;
+constexpr size_t width = 8;
+
+// Some unmasked intrinsics trigger spurious -Wmaybe-uninitialized warnings in older GCCs, so we use the zero-masked versions with all lanes set.
+constexpr __mmask8 all_lanes = 0xff;
+
+CHIHAYA_SIMD_TARGET inline Vec set1(double x) { return _mm512_set1_pd(x); }
+CHIHAYA_SIMD_TARGET inline Vec load(const double* ptr) { return _mm512_loadu_pd(ptr); }
+CHIHAYA_SIMD_TARGET inline void store(double* ptr, Vec x) { _mm512_storeu_pd(ptr, x); }
+
+CHIHAYA_SIMD_TARGET inline Vec add(Vec x, Vec y) { return _mm512_add_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec sub(Vec x, Vec y) { return _mm512_sub_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec mul(Vec x, Vec y) { return _mm512_mul_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec div(Vec x, Vec y) { return _mm512_div_pd(x, y); }
+CHIHAYA_SIMD_TARGET inline Vec min(Vec x, Vec y) { return _mm512_maskz_min_pd(all_lanes, x, y); }
+CHIHAYA_SIMD_TARGET inline Vec max(Vec x, Vec y) { return _mm512_maskz_max_pd(all_lanes, x, y); }
+CHIHAYA_SIMD_TARGET inline Vec sqrt(Vec x) { return _mm512_maskz_sqrt_pd(all_lanes, x); }
+
+CHIHAYA_SIMD_TARGET inline Vec floor(Vec x) { return _mm512_maskz_roundscale_pd(all_lanes, x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec ceil(Vec x) { return _mm512_maskz_roundscale_pd(all_lanes, x, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec trunc(Vec x) { return _mm512_maskz_roundscale_pd(all_lanes, x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+CHIHAYA_SIMD_TARGET inline Vec nearbyint(Vec x) { return _mm512_maskz_roundscale_pd(all_lanes, x, _MM_FROUND_CUR_DIRECTION | _MM_FROUND_NO_EXC); }
+
+CHIHAYA_SIMD_TARGET inline Vec abs(Vec x) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(x), _mm512_set1_epi64(0x7fffffffffffffffLL)));
+}
+CHIHAYA_SIMD_TARGET inline Vec sign_bit(Vec x) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(x), _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ULL))));
+}
+CHIHAYA_SIMD_TARGET inline Vec xor_bits(Vec x, Vec y) {
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(x), _mm512_castpd_si512(y)));
+}
+
+CHIHAYA_SIMD_TARGET inline Mask lt(Vec x, Vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_LT_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask le(Vec x, Vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_LE_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask gt(Vec x, Vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_GT_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask ge(Vec x, Vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_GE_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask eq(Vec x, Vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_EQ_OQ); }
+CHIHAYA_SIMD_TARGET inline Mask is_nan(Vec x) { return _mm512_cmp_pd_mask(x, x, _CMP_UNORD_Q); }
+
+CHIHAYA_SIMD_TARGET inline Mask mask_none() { return 0; }
+CHIHAYA_SIMD_TARGET inline Mask mask_and(Mask x, Mask y) { return x & y; }
+CHIHAYA_SIMD_TARGET inline Mask mask_or(Mask x, Mask y) { return x | y; }
+CHIHAYA_SIMD_TARGET inline Mask mask_not(Mask x) { return ~x; }
+CHIHAYA_SIMD_TARGET inline bool mask_any(Mask x) { return x != 0; }
+CHIHAYA_SIMD_TARGET inline unsigned mask_bits(Mask x) { return x; }
+
+// Returns 'yes' where 'condition' is set, and 'no' otherwise.
+CHIHAYA_SIMD_TARGET inline Vec select(Mask condition, Vec yes, Vec no) { return _mm512_mask_blend_pd(condition, no, yes); }
+
+// Only valid for integral 'x' in [-2^51, 2^51].
+CHIHAYA_SIMD_TARGET inline __m512i to_integer(Vec x) {
+    const __m512d magic = _mm512_set1_pd(conversion_magic);
+    return _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(x, magic)), _mm512_castpd_si512(magic));
+}
+
+// Only valid for integral 'k' in [-1022, 1023].
+CHIHAYA_SIMD_TARGET inline Vec pow2(Vec k) {
+    return _mm512_castsi512_pd(_mm512_maskz_slli_epi64(all_lanes, _mm512_add_epi64(to_integer(k), _mm512_set1_epi64(1023)), 52));
+}
+
+// Returns the mantissa in [0.5, 1) and sets 'exponent', as in std::frexp(); only valid for positive normal 'x'.
+CHIHAYA_SIMD_TARGET inline Vec split_exponent(Vec x, Vec& exponent) {
+    __m512i bits = _mm512_castpd_si512(x);
+    __m512i ebits = _mm512_sub_epi64(_mm512_maskz_srli_epi64(all_lanes, bits, 52), _mm512_set1_epi64(1022));
+    const __m512d magic = _mm512_set1_pd(conversion_magic);
+    exponent = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_add_epi64(ebits, _mm512_castpd_si512(magic))), magic);
+    __m512i mbits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(0x000fffffffffffffLL)), _mm512_set1_epi64(0x3fe0000000000000LL));
+    return _mm512_castsi512_pd(mbits);
+}
+
+// Only valid for integral 'index' that are within the bounds of 'table'.
+CHIHAYA_SIMD_TARGET inline Vec gather(const double* table, Vec index) {
+    return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), all_lanes, to_integer(index), table, 8);
+}
+
+#include "utils_simd_math_kernels.hpp"
+
+#undef CHIHAYA_SIMD_TARGET
+
+}
+#endif
+
+template<MathKernel kernel_, class Scalar_>
+size_t transform_math([[maybe_unused]] double* ptr, [[maybe_unused]] size_t n, [[maybe_unused]] double parameter, [[maybe_unused]] Scalar_ scalar) {
+#ifdef CHIHAYA_X86_SIMD
+    switch (detect_math_instruction_set()) {
+        case MathInstructionSet::AVX512:
+            return math_avx512::transform<kernel_>(ptr, n, parameter, scalar);
+        case MathInstructionSet::AVX2:
+            return math_avx2::transform<kernel_>(ptr, n, parameter, scalar);
+        default:
+            break;
+    }
+#endif
+    return 0;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,492 @@
+// No include guard, as this file is included once for each instruction set, see utils_simd_math.hpp.
+
+/*
+ * Vectorized kernels for the unary math methods, written in terms of the elementwise operations of a single instruction set.
+ * Before inclusion, the enclosing namespace should define:
+ *
+ * - 'Vec', the vector of doubles, and 'Mask', the result of a comparison.
+ * - 'width', the number of doubles in each 'Vec'.
+ * - the operations used below, e.g., 'add()', 'lt()', 'select()'.
+ * - the CHIHAYA_SIMD_TARGET macro, containing the target attribute for all functions.
+ *
+ * Most approximations are taken from Cephes, while the hyperbolic functions and their inverses follow the reductions used by glibc.
+ * Lanes that cannot be computed accurately by the kernel (e.g., trigonometric functions of very large values) are flagged in 'fallback',
+ * to be recomputed by the caller with the scalar code.
+ */
+
+constexpr double exp_p[] = { 1.26177193074810590878E-4, 3.02994407707441961300E-2, 9.99999999999999999910E-1 };
+constexpr double exp_q[] = { 3.00198505138664455042E-6, 2.52448340349684104192E-3, 2.27265548208155028766E-1, 2.00000000000000000009E0 };
+
+constexpr double expm1_p[] = { // 1/13! to 1/3!.
+    1.60590438368216133E-10, 2.08767569878681002E-09, 2.50521083854417202E-08, 2.75573192239858883E-07,
+    2.75573192239858925E-06, 2.48015873015873016E-05, 1.98412698412698413E-04, 1.38888888888888894E-03,
+    8.33333333333333322E-03, 4.16666666666666644E-02, 1.66666666666666657E-01
+};
+
+constexpr double log_p[] = {
+    1.01875663804580931796E-4, 4.97494994976747001425E-1, 4.70579119878881725854E0,
+    1.44989225341610930846E1, 1.79368678507819816313E1, 7.70838733755885391666E0
+};
+constexpr double log_q[] = { // leading coefficient of 1 is implicit.
+    1.12873587189167450590E1, 4.52279145837532221105E1, 8.29875266912776603211E1,
+    7.11544750618563894466E1, 2.31251620126765340583E1
+};
+
+constexpr double log1p_p[] = {
+    4.5270000862445199635215E-5, 4.9854102823193375972212E-1, 6.5787325942061044846969E0, 2.9911919328553073277375E1,
+    6.0949667980987787057556E1, 5.7112963590585538103336E1, 2.0039553499201281259648E1
+};
+constexpr double log1p_q[] = { // leading coefficient of 1 is implicit.
+    1.5062909083469192043167E1, 8.3047565967967209469434E1, 2.2176239823732856465394E2,
+    3.0909872225312059774938E2, 2.1642788614495947685003E2, 6.0118660497603843919306E1
+};
+
+constexpr double sin_p[] = {
+    1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6,
+    -1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1
+};
+constexpr double cos_p[] = {
+    -1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7,
+    2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2
+};
+
+constexpr double atan_p[] = {
+    -8.750608600031904122785E-1, -1.615753718733365076637E1, -7.500855792314704667340E1,
+    -1.228866684490136173410E2, -6.485021904942025371773E1
+};
+constexpr double atan_q[] = { // leading coefficient of 1 is implicit.
+    2.485846490142306297962E1, 1.650270098316988542046E2, 4.328810604912902668951E2,
+    4.853903996359136964868E2, 1.945506571482613964425E2
+};
+
+constexpr double sqrt_half = 0.70710678118654752440;
+constexpr double ln2 = 6.93147180559945286227E-1;
+constexpr double max_log = 709.782712893383996843;
+constexpr double pi_2 = 1.57079632679489661923;
+constexpr double pi_4 = 7.85398163397448309616E-1;
+
+// Beyond this, the reduction to [-pi/4, pi/4] loses too much precision.
+constexpr double max_trig = 1048576;
+
+// Reduced arguments below this multiple of the number of subtracted octants are too close to a zero of sin() or cos() to be accurate.
+constexpr double min_reduced_trig = 1e-13;
+
+// Beyond this, expm1() is computed from exp().
+constexpr double expm1_limit = 40;
+
+// Below and above these, the inverse hyperbolic functions are computed directly.
+constexpr double tiny_arc = 3.7252902984619140625E-9; // 2^-28
+constexpr double huge_arc = 268435456; // 2^28
+
+template<size_t n_>
+CHIHAYA_SIMD_TARGET inline Vec polevl(Vec x, const double (&coef)[n_]) {
+    Vec out = set1(coef[0]);
+    for (size_t i = 1; i < n_; ++i) {
+        out = add(mul(out, x), set1(coef[i]));
+    }
+    return out;
+}
+
+// Same as polevl() but with an implicit leading coefficient of 1.
+template<size_t n_>
+CHIHAYA_SIMD_TARGET inline Vec p1evl(Vec x, const double (&coef)[n_]) {
+    Vec out = add(x, set1(coef[0]));
+    for (size_t i = 1; i < n_; ++i) {
+        out = add(mul(out, x), set1(coef[i]));
+    }
+    return out;
+}
+
+CHIHAYA_SIMD_TARGET inline Vec negate(Vec x) {
+    return xor_bits(x, set1(-0.0));
+}
+
+// Transfers the sign bit of 'sign' to the non-negative 'x'.
+CHIHAYA_SIMD_TARGET inline Vec with_sign(Vec x, Vec sign) {
+    return xor_bits(x, sign_bit(sign));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vexp(Vec x) {
+    Vec xc = min(max(x, set1(-746)), set1(710));
+
+    // exp(x) = 2^n * exp(r), where r = x - n * log(2) is computed in two parts for extra precision.
+    Vec n = floor(add(mul(xc, set1(1.4426950408889634073599)), set1(0.5)));
+    Vec r = sub(xc, mul(n, set1(6.93145751953125E-1)));
+    r = sub(r, mul(n, set1(1.42860682030941723212E-6)));
+
+    Vec rr = mul(r, r);
+    Vec p = mul(polevl(rr, exp_p), r);
+    Vec q = polevl(rr, exp_q);
+    Vec out = div(p, sub(q, p));
+    out = add(set1(1), add(out, out));
+
+    // Scaling in two steps, as 'n' may lie outside of the range of normal exponents.
+    Vec half = floor(mul(n, set1(0.5)));
+    out = mul(mul(out, pow2(half)), pow2(sub(n, half)));
+
+    out = select(gt(x, set1(max_log)), set1(std::numeric_limits<double>::infinity()), out);
+    out = select(lt(x, set1(-745.13321910194110842)), set1(0), out);
+    return out;
+}
+
+// Only valid for |x| <= log(2) / 2.
+// This uses the Taylor series directly, as the rational approximation in vexp() loses a few ULPs when 1 is not added to its result.
+CHIHAYA_SIMD_TARGET inline Vec vexpm1_small(Vec x) {
+    Vec xx = mul(x, x);
+    Vec tail = mul(mul(xx, x), polevl(x, expm1_p));
+    return add(x, add(mul(xx, set1(0.5)), tail));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vexpm1(Vec x) {
+    // expm1(x) = 2^n * expm1(r) + 2^n - 1, where r = x - n * log(2) as in vexp().
+    // Beyond the clamped range, the subtraction of 1 from exp(x) is either exact or negligible.
+    Vec xc = min(max(x, set1(-expm1_limit)), set1(expm1_limit));
+    Vec n = nearbyint(mul(xc, set1(1.4426950408889634073599)));
+    Vec r = sub(xc, mul(n, set1(6.93145751953125E-1)));
+    r = sub(r, mul(n, set1(1.42860682030941723212E-6)));
+    Vec scale = pow2(n);
+    Vec out = add(mul(scale, vexpm1_small(r)), sub(scale, set1(1)));
+    return select(lt(abs(x), set1(expm1_limit)), out, sub(vexp(x), set1(1)));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vlog(Vec x) {
+    // Scaling up subnormals so that the exponent can be extracted from the bits.
+    Mask subnormal = lt(x, set1(std::numeric_limits<double>::min()));
+    Vec xs = select(subnormal, mul(x, set1(18014398509481984.0)), x); // 2^54
+
+    // Splitting into the mantissa in [0.5, 1) and the exponent, i.e., frexp().
+    Vec e;
+    Vec m = split_exponent(xs, e);
+    e = sub(e, select(subnormal, set1(54), set1(0)));
+
+    // Shifting the mantissa into [sqrt(0.5), sqrt(2)) and subtracting 1.
+    Mask below = lt(m, set1(sqrt_half));
+    e = sub(e, select(below, set1(1), set1(0)));
+    m = sub(add(m, select(below, m, set1(0))), set1(1));
+
+    // log(x) = m - m^2 / 2 + m^3 * P(m) / Q(m) + e * log(2), where log(2) is split into two parts for extra precision.
+    Vec z = mul(m, m);
+    Vec y = mul(m, div(mul(z, polevl(m, log_p)), p1evl(m, log_q)));
+    y = sub(y, mul(e, set1(2.121944400546905827679e-4)));
+    y = sub(y, mul(z, set1(0.5)));
+    Vec out = add(m, y);
+    out = add(out, mul(e, set1(0.693359375)));
+
+    Vec zero = set1(0);
+    Vec inf = set1(std::numeric_limits<double>::infinity());
+    out = select(eq(x, inf), inf, out);
+    out = select(eq(x, zero), negate(inf), out);
+    out = select(lt(x, zero), set1(std::numeric_limits<double>::quiet_NaN()), out);
+    return out;
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vlog1p(Vec x) {
+    // Only using the rational approximation if 1 + x lies in [sqrt(0.5), sqrt(2)].
+    Vec z = add(set1(1), x);
+    Mask middle = mask_and(ge(z, set1(sqrt_half)), le(z, set1(1 / sqrt_half)));
+    Vec xx = mul(x, x);
+    Vec y = mul(x, div(mul(xx, polevl(x, log1p_p)), p1evl(x, log1p_q)));
+    y = add(x, add(mul(xx, set1(-0.5)), y));
+    return select(middle, y, vlog(z));
+}
+
+// Reduces the non-negative 'a' to 'z' in [-pi/4, pi/4], where 'a = z + j * pi/4' and 'j' is one of 0, 2, 4 or 6.
+// Lanes that cannot be accurately reduced are flagged in 'fallback'.
+CHIHAYA_SIMD_TARGET inline Vec reduce_trig(Vec a, Vec& j, Mask& fallback) {
+    Vec y = floor(mul(a, set1(1.27323954473516268615))); // 4/pi
+    Vec octant = sub(y, mul(floor(mul(y, set1(0.125))), set1(8)));
+    Vec odd = sub(octant, mul(floor(mul(octant, set1(0.5))), set1(2)));
+    y = add(y, odd);
+    j = add(octant, odd);
+    j = select(eq(j, set1(8)), set1(0), j);
+
+    // Subtracting y * pi/4 in three parts for extra precision.
+    Vec z = sub(a, mul(y, set1(7.85398125648498535156E-1)));
+    z = sub(z, mul(y, set1(3.77489470793079817668E-8)));
+    z = sub(z, mul(y, set1(2.69515142907905952645E-15)));
+
+    // The rounding error of the last subtraction is proportional to 'y', so it dominates if 'z' is very small.
+    fallback = mask_or(fallback, mask_not(le(a, set1(max_trig))));
+    fallback = mask_or(fallback, lt(abs(z), mul(y, set1(min_reduced_trig))));
+    return z;
+}
+
+CHIHAYA_SIMD_TARGET inline Vec sin_poly(Vec z, Vec zz) {
+    return add(z, mul(mul(z, zz), polevl(zz, sin_p)));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec cos_poly(Vec zz) {
+    return add(sub(set1(1), mul(zz, set1(0.5))), mul(mul(zz, zz), polevl(zz, cos_p)));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vsin(Vec x, Mask& fallback) {
+    Vec a = abs(x);
+    Vec j;
+    Vec z = reduce_trig(a, j, fallback);
+    Vec zz = mul(z, z);
+
+    // Octants 4 to 7 are the negation of octants 0 to 3.
+    Mask upper = ge(j, set1(4));
+    j = select(upper, sub(j, set1(4)), j);
+    Vec out = select(eq(j, set1(2)), cos_poly(zz), sin_poly(z, zz));
+    out = select(upper, negate(out), out);
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vcos(Vec x, Mask& fallback) {
+    Vec a = abs(x);
+    Vec j;
+    Vec z = reduce_trig(a, j, fallback);
+    Vec zz = mul(z, z);
+
+    Mask upper = ge(j, set1(4));
+    j = select(upper, sub(j, set1(4)), j);
+    Mask shifted = eq(j, set1(2));
+    Vec out = select(shifted, sin_poly(z, zz), cos_poly(zz));
+    out = select(upper, negate(out), out);
+    return select(shifted, negate(out), out);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vtan(Vec x, Mask& fallback) {
+    Vec a = abs(x);
+    Vec j;
+    Vec z = reduce_trig(a, j, fallback);
+    Vec zz = mul(z, z);
+
+    // tan(z + k * pi/2) is tan(z) for even k and -1/tan(z) for odd k.
+    Vec s = sin_poly(z, zz), c = cos_poly(zz);
+    Mask odd = mask_or(eq(j, set1(2)), eq(j, set1(6)));
+    Vec out = select(odd, negate(div(c, s)), div(s, c));
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vatan(Vec x) {
+    Vec a = abs(x);
+
+    // Reducing to [0, 0.66] with atan(x) = pi/2 - atan(1/x) for x > tan(3pi/8), and atan(x) = pi/4 + atan((x - 1) / (x + 1)) for x > 0.66.
+    Mask large = gt(a, set1(2.41421356237309504880));
+    Mask middle = gt(a, set1(0.66));
+    Vec one = set1(1);
+    Vec r = select(large, div(set1(-1), a), select(middle, div(sub(a, one), add(a, one)), a));
+    Vec offset = select(large, set1(pi_2), select(middle, set1(pi_4), set1(0)));
+    Vec extra = select(large, set1(6.123233995736765886130E-17), select(middle, set1(3.061616997868382943065E-17), set1(0)));
+
+    Vec z = mul(r, r);
+    z = mul(z, div(polevl(z, atan_p), p1evl(z, atan_q)));
+    z = add(mul(r, z), r);
+    Vec out = add(offset, add(z, extra));
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vasin(Vec x) {
+    Vec one = set1(1);
+    return vatan(div(x, sqrt(mul(sub(one, x), add(one, x)))));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vacos(Vec x) {
+    Vec one = set1(1);
+    Vec t = vatan(sqrt(div(sub(one, x), add(one, x))));
+    return add(t, t);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vsinh(Vec x, Mask& fallback) {
+    Vec a = abs(x);
+    fallback = mask_or(fallback, gt(a, set1(max_log))); // may still be finite if exp() overflows.
+    Vec half = set1(0.5), one = set1(1);
+    Vec e = vexp(a);
+    Vec t = vexpm1(a);
+    Vec tp1 = add(t, one);
+
+    Vec small = mul(half, sub(add(t, t), div(mul(t, t), tp1)));
+    Vec medium = mul(half, add(t, div(t, tp1)));
+    Vec out = select(lt(a, one), small, select(lt(a, set1(22)), medium, mul(half, e)));
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vcosh(Vec x, Mask& fallback) {
+    Vec a = abs(x);
+    fallback = mask_or(fallback, gt(a, set1(max_log)));
+    Vec half = set1(0.5), one = set1(1);
+    Vec e = vexp(a);
+    Vec t = vexpm1(min(a, half));
+    Vec w = add(one, t);
+
+    Vec small = add(one, div(mul(t, t), add(w, w)));
+    Vec medium = add(mul(half, e), div(half, e));
+    return select(lt(a, set1(0.5 * ln2)), small, select(lt(a, set1(22)), medium, mul(half, e)));
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vtanh(Vec x) {
+    Vec a = abs(x);
+    Vec one = set1(1), two = set1(2);
+    Mask large = ge(a, one);
+    Vec t = vexpm1(select(large, add(a, a), mul(a, set1(-2))));
+    Vec out = select(large, sub(one, div(two, add(t, two))), div(negate(t), add(t, two)));
+    out = select(ge(a, set1(22)), one, out);
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vasinh(Vec x) {
+    Vec a = abs(x);
+    Vec one = set1(1);
+    Vec aa = mul(a, a);
+
+    Mask huge = gt(a, set1(huge_arc));
+    Vec large = add(add(a, a), div(one, add(sqrt(add(aa, one)), a)));
+    Vec log_out = add(vlog(select(huge, a, large)), select(huge, set1(ln2), set1(0)));
+    Vec log1p_out = vlog1p(add(a, div(aa, add(one, sqrt(add(one, aa))))));
+
+    Vec out = select(gt(a, set1(2)), log_out, log1p_out);
+    out = select(lt(a, set1(tiny_arc)), a, out);
+    return with_sign(out, x);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vacosh(Vec x) {
+    Vec one = set1(1);
+    Mask huge = ge(x, set1(huge_arc));
+    Vec large = sub(add(x, x), div(one, add(x, sqrt(sub(mul(x, x), one)))));
+    Vec log_out = add(vlog(select(huge, x, large)), select(huge, set1(ln2), set1(0)));
+    Vec t = sub(x, one);
+    Vec log1p_out = vlog1p(add(t, sqrt(add(add(t, t), mul(t, t)))));
+
+    Vec out = select(gt(x, set1(2)), log_out, log1p_out);
+    return select(lt(x, one), set1(std::numeric_limits<double>::quiet_NaN()), out);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vatanh(Vec x) {
+    Vec a = abs(x);
+    Vec one = set1(1);
+    Vec aa = add(a, a);
+    Vec arg = select(lt(a, set1(0.5)), add(aa, div(mul(aa, a), sub(one, a))), div(aa, sub(one, a)));
+    Vec out = mul(set1(0.5), vlog1p(arg));
+    out = select(lt(a, set1(tiny_arc)), a, out);
+    out = select(gt(a, one), set1(std::numeric_limits<double>::quiet_NaN()), out);
+    return with_sign(out, x);
+}
+
+// Same as round_digits() for an integral number of 'digits', where 'powers[d]' contains pow(10, d - max_power10).
+CHIHAYA_SIMD_TARGET inline Vec vround_digits(Vec x, Vec digits, const double* powers) {
+    Vec index = add(min(max(digits, set1(-max_power10)), set1(max_power10)), set1(max_power10));
+    Vec scale = gather(powers, index);
+
+    Vec out = div(nearbyint(mul(x, scale)), scale);
+    out = select(eq(scale, set1(0)), sign_bit(x), out);
+
+    // Checking the scale's finiteness with 'scale - scale', which is NaN for infinite scales.
+    Mask keep = mask_or(mask_not(eq(sub(scale, scale), set1(0))), ge(mul(abs(x), scale), set1(4503599627370496.0)));
+    return select(keep, x, out);
+}
+
+CHIHAYA_SIMD_TARGET inline Vec vsignif(Vec x, Vec max_digits, const double* powers, Mask& fallback) {
+    Vec a = abs(x);
+    Vec magnitude = mul(vlog(a), set1(4.34294481903251827651E-1)); // 1/log(10)
+
+    // Leaving values whose log10 is close to an integer to the scalar code, as its rounding may differ from that of std::log10.
+    Vec nearest = nearbyint(magnitude);
+    fallback = mask_or(fallback, lt(abs(sub(magnitude, nearest)), set1(1e-8)));
+
+    Vec out = vround_digits(x, sub(max_digits, ceil(magnitude)), powers);
+    Mask special = mask_or(eq(x, set1(0)), mask_not(eq(sub(x, x), set1(0))));
+    return select(special, x, out);
+}
+
+template<MathKernel kernel_, class Scalar_>
+CHIHAYA_SIMD_TARGET size_t transform(double* ptr, size_t n, double parameter, Scalar_ scalar) {
+    double extra = 0;
+    if constexpr(kernel_ == MathKernel::ROUND) {
+        // Leaving degenerate scaling factors to the scalar code.
+        extra = std::pow(10.0, parameter);
+        if (!std::isfinite(extra) || extra == 0) {
+            return 0;
+        }
+    } else if constexpr(kernel_ == MathKernel::SIGNIF) {
+        // Leaving non-integer numbers of digits to the scalar code, as the powers of 10 are only tabulated for integers.
+        extra = std::max(parameter, 1.0);
+        if (!std::isfinite(extra) || extra != std::floor(extra)) {
+            return 0;
+        }
+    }
+
+    const Vec zero = set1(0);
+    const Vec one = set1(1);
+    const Vec param = set1(kernel_ == MathKernel::LOG ? parameter : extra);
+    const double* powers = (kernel_ == MathKernel::SIGNIF ? power10_table() : nullptr);
+
+    size_t i = 0;
+    for (; i + width <= n; i += width) {
+        Vec x = load(ptr + i);
+        Mask fallback = mask_none();
+        Vec out;
+
+        if constexpr(kernel_ == MathKernel::ABS) {
+            out = abs(x);
+        } else if constexpr(kernel_ == MathKernel::SIGN) {
+            out = sub(select(gt(x, zero), one, zero), select(lt(x, zero), one, zero));
+        } else if constexpr(kernel_ == MathKernel::SQRT) {
+            out = sqrt(x);
+        } else if constexpr(kernel_ == MathKernel::CEILING) {
+            out = ceil(x);
+        } else if constexpr(kernel_ == MathKernel::FLOOR) {
+            out = floor(x);
+        } else if constexpr(kernel_ == MathKernel::TRUNC) {
+            out = trunc(x);
+        } else if constexpr(kernel_ == MathKernel::ROUND) {
+            // Same as std::nearbyint(), which uses the current rounding mode.
+            Vec scaled = mul(x, param);
+            out = div(nearbyint(scaled), param);
+
+            // Large values are returned unchanged, consistent with the scalar code.
+            out = select(ge(abs(scaled), set1(4503599627370496.0)), x, out);
+        } else if constexpr(kernel_ == MathKernel::SIGNIF) {
+            out = vsignif(x, param, powers, fallback);
+        } else if constexpr(kernel_ == MathKernel::EXP) {
+            out = vexp(x);
+        } else if constexpr(kernel_ == MathKernel::EXPM1) {
+            out = vexpm1(x);
+        } else if constexpr(kernel_ == MathKernel::LOG) {
+            out = div(vlog(x), param);
+        } else if constexpr(kernel_ == MathKernel::LOG1P) {
+            out = vlog1p(x);
+        } else if constexpr(kernel_ == MathKernel::SIN) {
+            out = vsin(x, fallback);
+        } else if constexpr(kernel_ == MathKernel::COS) {
+            out = vcos(x, fallback);
+        } else if constexpr(kernel_ == MathKernel::TAN) {
+            out = vtan(x, fallback);
+        } else if constexpr(kernel_ == MathKernel::ASIN) {
+            out = vasin(x);
+        } else if constexpr(kernel_ == MathKernel::ACOS) {
+            out = vacos(x);
+        } else if constexpr(kernel_ == MathKernel::ATAN) {
+            out = vatan(x);
+        } else if constexpr(kernel_ == MathKernel::SINH) {
+            out = vsinh(x, fallback);
+        } else if constexpr(kernel_ == MathKernel::COSH) {
+            out = vcosh(x, fallback);
+        } else if constexpr(kernel_ == MathKernel::TANH) {
+            out = vtanh(x);
+        } else if constexpr(kernel_ == MathKernel::ASINH) {
+            out = vasinh(x);
+        } else if constexpr(kernel_ == MathKernel::ACOSH) {
+            out = vacosh(x);
+        } else {
+            out = vatanh(x);
+        }
+
+        out = select(is_nan(x), x, out);
+        store(ptr + i, out);
+
+        if (mask_any(fallback)) {
+            double original[width];
+            store(original, x);
+            auto flagged = mask_bits(fallback);
+            for (size_t l = 0; l < width; ++l) {
+                if (flagged & (1u << l)) {
+                    ptr[i + l] = scalar(original[l]);
+                }
+            }
+        }
+    }
+
+    return i;
+}
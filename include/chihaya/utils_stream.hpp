@@ -0,0 +1,254 @@
+#ifndef CHIHAYA_UTILS_STREAM_HPP
+#define CHIHAYA_UTILS_STREAM_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+
+#include "utils_parallel.hpp"
+#include "utils_profile.hpp"
+#include "utils_mmap.hpp"
+#include "utils_chunk.hpp"
+
+namespace chihaya {
+
+namespace internal_stream {
+
+// If 'mapped' is available, the block is copied directly from the mapped file instead of going through HDF5.
+// If 'chunked' is available, the raw chunks are read directly and decompressed on up to 'num_threads' threads.
+template<typename Type_>
+void read_block(
+    const H5::DataSet& handle,
+    hsize_t start,
+    hsize_t length,
+    Type_* buffer,
+    const internal_mmap::MappedDataset* mapped = nullptr,
+    const internal_chunk::ChunkedDataset* chunked = nullptr,
+    int num_threads = 1,
+    internal_parallel::TaskPool* pool = nullptr)
+{
+    internal_profile::Timer timer(&internal_profile::Counters::read_nanoseconds);
+    if (mapped && mapped->available()) {
+        mapped->read(start, length, buffer);
+        internal_profile::record_read<Type_>(length);
+        return;
+    }
+    if (chunked && chunked->available() && chunked->read(handle, start, length, buffer, num_threads, pool)) {
+        return;
+    }
+
+    internal_parallel::Hdf5Lock lck;
+    H5::DataSpace dspace = handle.getSpace();
+    dspace.selectHyperslab(H5S_SELECT_SET, &length, &start);
+    H5::DataSpace mspace(1, &length);
+    handle.read(buffer, ritsuko::hdf5::as_numeric_datatype<Type_>(), mspace, dspace);
+    internal_profile::record_read<Type_>(length);
+}
+
+// Background thread that performs reads on behalf of a stream, so that the next block can be loaded while the caller checks the current block.
+// Only one job can be pending at any time, and any error from the job is rethrown by wait().
+// The job runs with the profiling counters of the thread that created this object.
+class Prefetcher {
+public:
+    Prefetcher() : counters(internal_profile::current()), worker([this]() -> void { run(); }) {}
+
+    ~Prefetcher() {
+        {
+            std::lock_guard<std::mutex> lck(mut);
+            finished = true;
+        }
+        cv.notify_all();
+        internal_parallel::Hdf5Unlock unlock; // the worker may need the HDF5 lock to finish its current job.
+        worker.join();
+    }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    void submit(std::function<void()> fun) {
+        {
+            std::lock_guard<std::mutex> lck(mut);
+            job = std::move(fun);
+            busy = true;
+        }
+        cv.notify_all();
+    }
+
+    // Releases the HDF5 lock while waiting, so that the worker can perform its read.
+    void wait() {
+        internal_parallel::Hdf5Unlock unlock;
+        std::unique_lock<std::mutex> lck(mut);
+        cv.wait(lck, [&]() -> bool { return !busy; });
+        if (error) {
+            auto copy = error;
+            error = nullptr;
+            std::rethrow_exception(copy);
+        }
+    }
+
+private:
+    internal_profile::Counters* counters;
+    std::mutex mut;
+    std::condition_variable cv;
+    std::function<void()> job;
+    bool busy = false, finished = false;
+    std::exception_ptr error;
+    std::thread worker; // declared last so that everything else is initialized before the thread starts.
+
+    void run() {
+        internal_profile::Scope scope(counters);
+        std::unique_lock<std::mutex> lck(mut);
+        while (true) {
+            cv.wait(lck, [&]() -> bool { return finished || job; });
+            if (!job) {
+                break;
+            }
+
+            auto current = std::move(job);
+            job = std::function<void()>();
+            lck.unlock();
+            std::exception_ptr err;
+            try {
+                current();
+            } catch (...) {
+                err = std::current_exception();
+            }
+            lck.lock();
+
+            error = err;
+            busy = false;
+            cv.notify_all();
+        }
+    }
+};
+
+// Stream through the [start, end) interval of a 1-dimensional dataset.
+// This is safe to use in worker threads as all reads are serialized.
+// If 'mapped' holds the dataset as 'Type_', the stream hands out pointers into the mapped file without any copying.
+// Otherwise, if 'chunked' holds the dataset as 'Type_', each block is decompressed from the raw chunks on up to 'num_threads' threads.
+// If 'prefetch = true' and the range does not fit in a single block, the next block is read in the background while the caller processes the current block.
+template<typename Type_>
+class Stream1dRange {
+public:
+    Stream1dRange(
+        const H5::DataSet* ptr,
+        hsize_t start,
+        hsize_t end,
+        hsize_t block_size,
+        const internal_mmap::MappedDataset* mapped = nullptr,
+        const internal_chunk::ChunkedDataset* chunked = nullptr,
+        int num_threads = 1,
+        internal_parallel::TaskPool* pool = nullptr,
+        bool prefetch = false) :
+        ptr(ptr), 
+        position(start), 
+        end(end),
+        span(mapped ? mapped->span<Type_>() : nullptr),
+        chunked(chunked && chunked->available() && chunked->type() == internal_mmap::stored_type<Type_>() ? chunked : nullptr),
+        num_threads(num_threads),
+        pool(pool)
+    {
+        if (!span) {
+            buffer.resize(std::min(block_size, end - start));
+            if (prefetch && buffer.size() < end - start) {
+                next_buffer.resize(buffer.size());
+                prefetcher.reset(new Prefetcher);
+            }
+        }
+    }
+
+    Type_ get() {
+        if (consumed == available) {
+            load();
+        }
+        return current[consumed];
+    }
+
+    // Returns a pointer to the next contiguous run of loaded elements, along with the length of the run.
+    std::pair<const Type_*, size_t> get_many() {
+        if (consumed == available) {
+            load();
+        }
+        return std::make_pair(current + consumed, static_cast<size_t>(available - consumed));
+    }
+
+    void next(size_t jump = 1) {
+        consumed += jump;
+    }
+
+private:
+    const H5::DataSet* ptr;
+    hsize_t position, end;
+    const Type_* span;
+    const internal_chunk::ChunkedDataset* chunked;
+    int num_threads;
+    internal_parallel::TaskPool* pool;
+    std::vector<Type_> buffer, next_buffer;
+    const Type_* current = nullptr;
+    hsize_t consumed = 0, available = 0;
+    hsize_t next_available = 0;
+    std::unique_ptr<Prefetcher> prefetcher; // declared after the buffers so that any pending read finishes before they are destroyed.
+
+    hsize_t pick_length(hsize_t from) const {
+        hsize_t len = std::min(end - from, static_cast<hsize_t>(buffer.size()));
+        if (chunked && from + len < end) {
+            // Ending each block at a chunk boundary, so that no chunk is decompressed twice.
+            hsize_t chunk = chunked->chunk();
+            hsize_t limit = ((from + len) / chunk) * chunk;
+            if (limit > from) {
+                len = limit - from;
+            }
+        }
+        return len;
+    }
+
+    void load() {
+        if (position >= end) {
+            throw std::runtime_error("requesting data beyond the end of the range");
+        }
+
+        if (span) {
+            available = end - position;
+            current = span + position;
+            internal_profile::record_read<Type_>(available);
+        } else {
+            internal_profile::Timer timer(&internal_profile::Counters::wait_nanoseconds);
+            if (next_available) {
+                prefetcher->wait();
+                buffer.swap(next_buffer);
+                available = next_available;
+                next_available = 0;
+            } else {
+                available = pick_length(position);
+                read_block(*ptr, position, available, buffer.data(), nullptr, chunked, num_threads, pool);
+            }
+            current = buffer.data();
+        }
+
+        position += available;
+        consumed = 0;
+
+        // The background read doesn't use the pool, as waiting on the pool might run unrelated tasks on the prefetching thread.
+        if (prefetcher && position < end) {
+            next_available = pick_length(position);
+            prefetcher->submit([this,from=position,len=next_available]() -> void {
+                read_block(*ptr, from, len, next_buffer.data(), nullptr, chunked, num_threads);
+            });
+        }
+    }
+};
+}
+
+}
+
+#endif
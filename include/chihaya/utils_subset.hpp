@@ -7,28 +7,50 @@
 #include <vector>
 #include <stdexcept>
 
+#include "utils_public.hpp"
 #include "utils_list.hpp"
 #include "utils_misc.hpp"
+#include "utils_stream.hpp"
+#include "utils_buffer.hpp"
+#include "utils_parallel.hpp"
+#include "utils_simd.hpp"
+#include "utils_profile.hpp"
 
 namespace chihaya {
 
 namespace internal_subset {
 
 template<typename Index_>
-void validate_indices(const H5::DataSet& dhandle, size_t len, size_t extent) {
-    ritsuko::hdf5::Stream1dNumericDataset<Index_> stream(&dhandle, len, 1000000);
-    for (size_t i = 0; i < len; ++i, stream.next()) {
-        auto b = stream.get();
-        if (b < 0) {
-            throw std::runtime_error("indices should be non-negative");
+void validate_indices(const H5::DataSet& dhandle, size_t len, size_t extent, const Options& options) {
+    hsize_t block_size = internal_buffer::pick_1d_block_size(dhandle, len, options, options.prefetch ? 2 : 1);
+    internal_mmap::MappedDataset mapped(dhandle, options.memory_map);
+    internal_chunk::ChunkedDataset chunked(dhandle, options.direct_chunks);
+    internal_stream::Stream1dRange<Index_> stream(&dhandle, 0, len, block_size, &mapped, &chunked, options.num_threads, options.pool.get(), options.prefetch);
+
+    size_t remaining = len;
+    while (remaining) {
+        auto block = stream.get_many();
+        auto ptr = block.first;
+        size_t n = block.second;
+
+        size_t bad;
+        {
+            internal_parallel::Hdf5Unlock unlock;
+            bad = internal_simd::find_invalid(ptr, n, extent, false, false, static_cast<Index_>(0));
         }
-        if (static_cast<size_t>(b) >= extent) {
+        if (bad < n) {
+            if (internal_simd::is_negative(ptr[bad])) {
+                throw std::runtime_error("indices should be non-negative");
+            }
             throw std::runtime_error("indices out of range");
         }
+
+        remaining -= n;
+        stream.next(n);
     }
 }
 
-inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Group& ihandle, const std::vector<size_t>& seed_dims, const ritsuko::Version& version) {
+inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Group& ihandle, const std::vector<size_t>& seed_dims, const ritsuko::Version& version, const Options& options) {
     internal_list::ListDetails list_params;
     try {
         list_params = internal_list::validate(ihandle, version);
@@ -44,19 +66,21 @@ inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Gro
 
     for (const auto& p : list_params.present) {
         try {
-            auto dhandle = ritsuko::hdf5::open_dataset(ihandle, p.second.c_str());
+            auto dhandle = internal_buffer::open_dataset(ihandle, p.second.c_str(), options, options.prefetch ? 2 : 1);
             auto len = ritsuko::hdf5::get_1d_length(dhandle, false);
 
             if (version.lt(1, 1, 0)) {
                 if (dhandle.getTypeClass() != H5T_INTEGER) {
                     throw std::runtime_error("expected an integer dataset");
                 }
-                validate_indices<int>(dhandle, len, seed_dims[p.first]);
+                validate_indices<int>(dhandle, len, seed_dims[p.first], options);
             } else {
                 if (ritsuko::hdf5::exceeds_integer_limit(dhandle, 64, false)) {
                     throw std::runtime_error("datatype should be exactly represented by a 64-bit unsigned integer");
                 }
-                validate_indices<uint64_t>(dhandle, len, seed_dims[p.first]);
+                internal_misc::dispatch_unsigned_integer(dhandle, [&](auto zero) -> void {
+                    validate_indices<decltype(zero)>(dhandle, len, seed_dims[p.first], options);
+                });
             }
 
             collected.emplace_back(p.first, len);
@@ -0,0 +1,199 @@
+#ifndef CHIHAYA_UTILS_TRAVERSE_HPP
+#define CHIHAYA_UTILS_TRAVERSE_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <exception>
+#include <chrono>
+
+#include "utils_public.hpp"
+#include "utils_misc.hpp"
+#include "utils_profile.hpp"
+
+namespace chihaya {
+
+ArrayDetails validate(const H5::Group&, const ritsuko::Version&, Options&);
+
+namespace internal_traverse {
+
+inline bool is_group(const H5::Group& handle, const std::string& name) {
+    return handle.exists(name) && handle.childObjType(name) == H5O_TYPE_GROUP;
+}
+
+struct Child {
+    std::string name;
+    std::string alias;
+};
+
+// Appends the child groups of a built-in operation to 'children'.
+// Arrays, custom operations and anything that fails to parse are treated as leaves, to be handled by the usual recursion.
+inline void list_children(const H5::Group& handle, const Options& options, std::vector<Child>& children) {
+    try {
+        if (!handle.attrExists("delayed_type") || ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type") != "operation") {
+            return;
+        }
+        if (!handle.attrExists("delayed_operation")) {
+            return;
+        }
+        auto otype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_operation");
+        if (options.operation_validate_registry.find(otype) != options.operation_validate_registry.end()) {
+            return;
+        }
+
+        if (otype == "combine") {
+            if (!is_group(handle, "seeds")) {
+                return;
+            }
+            auto lhandle = handle.openGroup("seeds");
+            auto lkey = internal_misc::get_object_key(lhandle);
+            for (hsize_t i = 0, end = lhandle.getNumObjs(); i < end; ++i) {
+                auto name = std::to_string(i);
+                if (is_group(lhandle, name)) {
+                    children.push_back(Child{ "seeds/" + name, internal_misc::get_child_key(lkey, name) });
+                }
+            }
+            return;
+        }
+
+        static const std::unordered_map<std::string, std::vector<std::string> > known {
+            { "subset", { "seed" } },
+            { "transpose", { "seed" } },
+            { "dimnames", { "seed" } },
+            { "unary arithmetic", { "seed" } },
+            { "unary comparison", { "seed" } },
+            { "unary logic", { "seed" } },
+            { "unary math", { "seed" } },
+            { "unary special check", { "seed" } },
+            { "subset assignment", { "seed", "value" } },
+            { "binary arithmetic", { "left", "right" } },
+            { "binary comparison", { "left", "right" } },
+            { "binary logic", { "left", "right" } },
+            { "matrix product", { "left_seed", "right_seed" } }
+        };
+
+        auto it = known.find(otype);
+        if (it != known.end()) {
+            auto key = internal_misc::get_object_key(handle);
+            for (const auto& name : it->second) {
+                if (is_group(handle, name)) {
+                    children.push_back(Child{ name, internal_misc::get_child_key(key, name) });
+                }
+            }
+        }
+
+    } catch (...) {
+        return;
+    }
+}
+
+/*
+ * Validates all descendants of 'handle' in post-order with an explicit stack, storing each outcome in 'options.prevalidated'.
+ * Each outcome is stored under the child's object key as well as under an alias formed from the key of the group containing the link and the link name.
+ * When a parent is subsequently validated, its request for each child's details returns (or rethrows) the stored outcome via the alias without even opening the child,
+ * so the native recursion never goes deeper than the node being validated.
+ * As the parents' validation functions are unchanged, the reported errors are the same as those from a fully recursive traversal.
+ *
+ * All children are stored in a single vector, with each frame referring to its own range at the end of that vector;
+ * this avoids allocations for each level of the tree.
+ *
+ * If profiling, each frame is assigned its profiling identifier in advance, so that its descendants can report it as their parent before it is validated.
+ * Each frame also records the time at which it was pushed, so that its reported wall time includes that of its (already validated) descendants.
+ * The identifier and start time of 'handle' itself are left in the lineage's reserved slot for the subsequent validation of 'handle'.
+ */
+inline void prevalidate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    struct Frame {
+        Frame(H5::Group handle, std::string key, std::string alias, size_t start, uint64_t id, std::chrono::steady_clock::time_point started) : 
+            handle(std::move(handle)), key(std::move(key)), alias(std::move(alias)), start(start), next(start), id(id), started(started) {}
+        H5::Group handle;
+        std::string key, alias;
+        size_t start, next;
+        uint64_t id;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    std::vector<Frame> stack;
+    std::vector<Child> children;
+    std::unordered_set<std::string> seen;
+
+    bool profiling = (options.enter_callback || options.exit_callback);
+    uint64_t root_id = 0;
+    std::chrono::steady_clock::time_point root_started;
+    if (profiling) {
+        auto& lineage = internal_profile::lineage();
+        if (!lineage.reserved) {
+            lineage.reserved = internal_profile::next_node_id();
+            lineage.reserved_start = std::chrono::steady_clock::now();
+        }
+        root_id = lineage.reserved;
+        root_started = lineage.reserved_start;
+    }
+
+    stack.emplace_back(handle, std::string(), std::string(), 0, root_id, root_started);
+    list_children(handle, options, children);
+
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.next < children.size()) {
+            auto& current = children[top.next];
+            auto child = top.handle.openGroup(current.name);
+            auto alias = std::move(current.alias);
+            ++top.next;
+
+            // Skipping nodes without keys (these are left to the usual recursion) or those that were already visited.
+            auto key = internal_misc::get_object_key(child);
+            if (key.empty()) {
+                continue;
+            }
+            auto pit = options.prevalidated.find(key);
+            if (pit != options.prevalidated.end()) {
+                if (!alias.empty()) {
+                    auto copy = pit->second;
+                    options.prevalidated[std::move(alias)] = std::move(copy);
+                }
+                continue;
+            }
+            if (!seen.insert(key).second) {
+                continue;
+            }
+
+            std::chrono::steady_clock::time_point started;
+            if (profiling) {
+                started = std::chrono::steady_clock::now();
+            }
+            size_t start = children.size();
+            list_children(child, options, children);
+            stack.emplace_back(std::move(child), std::move(key), std::move(alias), start, profiling ? internal_profile::next_node_id() : 0, started);
+            continue;
+        }
+
+        // All children are now finished, so we can validate this node.
+        if (stack.size() > 1) {
+            std::pair<ArrayDetails, std::exception_ptr> outcome;
+            try {
+                internal_profile::LineageScope lscope(stack[stack.size() - 2].id, top.id, top.started);
+                outcome.first = ::chihaya::validate(top.handle, version, options);
+            } catch (...) {
+                outcome.second = std::current_exception();
+            }
+            if (!top.alias.empty()) {
+                options.prevalidated[std::move(top.alias)] = outcome;
+            }
+            options.prevalidated[std::move(top.key)] = std::move(outcome);
+        }
+
+        children.resize(top.start);
+        stack.pop_back();
+    }
+}
+
+}
+
+}
+
+#endif
@@ -31,9 +31,15 @@
 #include "matrix_product.hpp"
 
 #include "utils_public.hpp"
+#include "utils_profile.hpp"
+#include "utils_traverse.hpp"
+#include "utils_file.hpp"
 
 #include <string>
 #include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <chrono>
 
 /**
  * @file validate.hpp
@@ -74,22 +80,7 @@ inline auto default_array_registry() {
     return registry;
 }
 
-}
-/**
- * @endcond
- */
-
-/**
- * For operations, this function will first search `options.custom_operation_validate_registry` for an available validation function.
- * For arrays, this function will first search `options.custom_array_validate_registry` for an available validation function.
- *
- * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
- * @param version Version of the **chihaya** specification.
- * @param options Validation options, possibly containing custom validation functions.
- *
- * @return Details of the array after all delayed operations in `handle` (and its children) have been applied.
- */
-inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+inline ArrayDetails dispatch(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
     auto dtype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type");
     ArrayDetails output;
 
@@ -164,6 +155,171 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     return output;
 }
 
+// Identifies the node type for profiling, without any validation.
+inline std::string get_node_type(const H5::Group& handle) {
+    for (auto attr : { "delayed_array", "delayed_operation" }) {
+        if (handle.attrExists(attr)) {
+            try {
+                return ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, attr);
+            } catch (std::exception&) {
+                break;
+            }
+        }
+    }
+    return "";
+}
+
+inline ArrayDetails profiled_dispatch(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    auto type = get_node_type(handle);
+    if (options.enter_callback) {
+        std::lock_guard<std::mutex> guard(internal_profile::callback_mutex());
+        options.enter_callback(handle, type);
+    }
+
+    // Using the identifier that was reserved for this node by the iterative traversal, if any.
+    // In that case, the node's children were already validated, so its wall time starts from the beginning of its subtree.
+    auto& lineage = internal_profile::lineage();
+    uint64_t parent = lineage.current;
+    uint64_t id;
+    std::chrono::steady_clock::time_point start;
+    if (lineage.reserved) {
+        id = lineage.reserved;
+        start = lineage.reserved_start;
+    } else {
+        id = internal_profile::next_node_id();
+        start = std::chrono::steady_clock::now();
+    }
+    lineage.reserved = 0;
+    internal_profile::LineageScope lscope(id);
+
+    internal_profile::Counters counters;
+    auto finish = [&](bool failed) -> void {
+        if (options.exit_callback) {
+            NodeStatistics stats;
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.datasets_opened = counters.datasets_opened;
+            stats.elements_read = counters.elements_read;
+            stats.bytes_read = counters.bytes_read;
+            stats.read_seconds = counters.read_nanoseconds / 1e9;
+            stats.wait_seconds = counters.wait_nanoseconds / 1e9;
+            stats.failed = failed;
+            stats.id = id;
+            stats.parent = parent;
+            std::lock_guard<std::mutex> guard(internal_profile::callback_mutex());
+            options.exit_callback(handle, type, stats);
+        }
+    };
+
+    ArrayDetails output;
+    try {
+        internal_profile::Scope scope(&counters);
+        output = dispatch(handle, version, options);
+    } catch (...) {
+        finish(true);
+        throw;
+    }
+
+    finish(false);
+    return output;
+}
+
+struct DepthTracker {
+    DepthTracker(Options& options) : options(options) {
+        if (options.depth == 0) {
+            options.validated.clear();
+            options.prevalidated.clear();
+
+            // Each top-level call gets its own pool. The calling thread holds the HDF5 lock throughout,
+            // only releasing it while waiting on other tasks or performing CPU-bound checks.
+            if (options.num_threads > 1 && !options.pool) {
+                hold.reset(new internal_parallel::Hdf5Lock);
+                options.pool.reset(new internal_parallel::TaskPool(options.num_threads - 1));
+                owns_pool = true;
+            }
+        }
+        ++options.depth;
+    }
+
+    ~DepthTracker() {
+        --options.depth;
+        if (options.depth == 0) {
+            options.prevalidated.clear();
+        }
+        if (owns_pool) {
+            options.pool.reset();
+            hold.reset();
+        }
+    }
+
+    Options& options;
+    bool owns_pool = false;
+    std::unique_ptr<internal_parallel::Hdf5Lock> hold;
+};
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * For operations, this function will first search `options.custom_operation_validate_registry` for an available validation function.
+ * For arrays, this function will first search `options.custom_array_validate_registry` for an available validation function.
+ *
+ * If `options.deduplicate = true`, the `ArrayDetails` for each validated group are stored in `options.validated`.
+ * Any subsequent visit to the same HDF5 object (e.g., via a hard link) will return the stored `ArrayDetails` without repeating the validation.
+ * The memo is cleared at the start of each top-level call, i.e., when `validate()` is not being called from within another `validate()`.
+ *
+ * If `options.enter_callback` or `options.exit_callback` are provided, they are called before and after the validation of each node, respectively.
+ *
+ * Deep trees are validated with an explicit stack once the recursion reaches `options.iterative_depth`, see `Options` for details.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param version Version of the **chihaya** specification.
+ * @param options Validation options, possibly containing custom validation functions.
+ *
+ * @return Details of the array after all delayed operations in `handle` (and its children) have been applied.
+ */
+inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    internal::DepthTracker tracker(options);
+
+    std::string key;
+    if (options.deduplicate || !options.prevalidated.empty()) {
+        key = internal_misc::get_object_key(handle);
+    }
+
+    if (!key.empty()) {
+        if (options.deduplicate) {
+            auto it = options.validated.find(key);
+            if (it != options.validated.end()) {
+                return it->second;
+            }
+        }
+
+        auto pit = options.prevalidated.find(key);
+        if (pit != options.prevalidated.end()) {
+            if (pit->second.second) {
+                std::rethrow_exception(pit->second.second);
+            }
+            return pit->second.first;
+        }
+    }
+
+    if (options.iterative_depth && options.depth % options.iterative_depth == 0) {
+        internal_traverse::prevalidate(handle, version, options);
+    }
+
+    ArrayDetails output;
+    if (options.enter_callback || options.exit_callback) {
+        output = internal::profiled_dispatch(handle, version, options);
+    } else {
+        output = internal::dispatch(handle, version, options);
+    }
+    if (!key.empty() && options.deduplicate) {
+        options.validated[key] = output;
+    }
+    return output;
+}
+
 /**
  * The version is taken from the `delayed_version` attribute of the `handle`.
  * This should be a version string of the form `<MAJOR>.<MINOR>`.
@@ -209,6 +365,7 @@ inline ArrayDetails validate(const H5::Group& handle, Options& options) {
 /**
  * Validate a delayed operation/array at the specified HDF5 group.
  * This simply calls the `validate()` overload for a `H5::Group`.
+ * The file is opened with the file access properties in `options`, e.g., `Options::metadata_cache_size`.
  * 
  * @param path Path to a HDF5 file.
  * @param name Name of the group inside the file.
@@ -217,7 +374,8 @@ inline ArrayDetails validate(const H5::Group& handle, Options& options) {
  * @return Details of the array after all delayed operations have been applied.
  */
 inline ArrayDetails validate(const std::string& path, const std::string& name, Options& options) {
-    H5::H5File handle(path, H5F_ACC_RDONLY);
+    H5::H5File handle;
+    internal_file::open_file(handle, path, options);
     auto ghandle = handle.openGroup(name);
     return validate(ghandle, options);
 }
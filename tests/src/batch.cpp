@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "chihaya/chihaya.hpp"
+#include "utils.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+class BatchTest : public ::testing::TestWithParam<chihaya::batch::Mode> {
+protected:
+    static void create(const std::string& path, int offset) {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        for (int i = 0; i < 5; ++i) {
+            auto name = "good" + std::to_string(i);
+            auto ghandle = mock_array_opener(fhandle, name, { 10 + offset, i + 1 }, 1100000, (i % 2 == 0 ? "INTEGER" : "FLOAT"));
+            add_version_string(ghandle, 1100000);
+        }
+
+        auto bhandle = operation_opener(fhandle, "bad", "transpose");
+        add_version_string(bhandle, 1100000);
+        add_numeric_vector<int>(bhandle, "permutation", { 0, 0 }, H5::PredType::NATIVE_UINT32);
+        mock_array_opener(bhandle, "seed", { 10, 20 }, 1100000, "FLOAT");
+    }
+
+    static std::vector<chihaya::batch::Target> targets() {
+        std::vector<chihaya::batch::Target> output;
+        for (int i = 0; i < 5; ++i) {
+            output.emplace_back("Test_batch1.h5", "good" + std::to_string(i));
+            output.emplace_back("Test_batch2.h5", "good" + std::to_string(4 - i));
+            output.emplace_back("Test_batch3.h5", "good" + std::to_string(i));
+        }
+        output.emplace_back("Test_batch2.h5", "bad");
+        output.emplace_back("Test_batch1.h5", "missing");
+        output.emplace_back("Test_batch_missing.h5", "good0");
+        return output;
+    }
+};
+
+TEST_P(BatchTest, Basic) {
+    create("Test_batch1.h5", 0);
+    create("Test_batch2.h5", 1);
+    create("Test_batch3.h5", 2);
+    auto all_targets = targets();
+
+    for (int nworkers : { 1, 3 }) {
+        chihaya::batch::Options opts;
+        opts.num_workers = nworkers;
+        opts.mode = GetParam();
+        auto res = chihaya::batch::validate(all_targets, opts);
+
+        ASSERT_EQ(res.results.size(), all_targets.size());
+        EXPECT_EQ(res.num_files, 4);
+        EXPECT_EQ(res.num_failed, 3);
+        EXPECT_GE(res.seconds, 0);
+        EXPECT_GE(res.validation_seconds, 0);
+
+        // Results should match those from validate() on each target.
+        for (size_t t = 0; t < all_targets.size(); ++t) {
+            const auto& target = all_targets[t];
+            const auto& current = res.results[t];
+            try {
+                auto expected = chihaya::validate(target.path, target.name);
+                EXPECT_TRUE(current.success);
+                EXPECT_EQ(current.details.type, expected.type);
+                EXPECT_EQ(current.details.dimensions, expected.dimensions);
+            } catch (...) {
+                EXPECT_FALSE(current.success);
+                EXPECT_FALSE(current.error.empty());
+            }
+        }
+
+        EXPECT_NE(res.results[all_targets.size() - 3].error.find("permutation"), std::string::npos);
+        EXPECT_NE(res.results[all_targets.size() - 1].error.find("failed to open"), std::string::npos);
+    }
+}
+
+TEST_P(BatchTest, Empty) {
+    chihaya::batch::Options opts;
+    opts.num_workers = 2;
+    opts.mode = GetParam();
+    auto res = chihaya::batch::validate({}, opts);
+    EXPECT_TRUE(res.results.empty());
+    EXPECT_EQ(res.num_files, 0);
+    EXPECT_EQ(res.num_failed, 0);
+}
+
+TEST_F(BatchTest, Locking) {
+    create("Test_batch1.h5", 0);
+    create("Test_batch2.h5", 1);
+
+    std::vector<chihaya::batch::Target> all_targets;
+    for (int i = 0; i < 5; ++i) {
+        all_targets.emplace_back("Test_batch1.h5", "good" + std::to_string(i));
+        all_targets.emplace_back("Test_batch2.h5", "good" + std::to_string(i));
+    }
+
+    chihaya::batch::Options opts;
+    opts.num_workers = 2;
+    opts.mode = chihaya::batch::Mode::THREADS;
+    std::atomic<size_t> locked(0);
+    opts.validation.enter_callback = [&](const H5::Group&, const std::string&) -> void {
+        if (chihaya::internal_parallel::hdf5_lock_depth()) {
+            ++locked;
+        }
+    };
+
+    auto res = chihaya::batch::validate(all_targets, opts);
+    EXPECT_EQ(res.num_failed, 0);
+
+    // The whole-file lock is only needed if HDF5 does not serialize its own calls.
+#ifdef H5_HAVE_THREADSAFE
+    EXPECT_EQ(locked.load(), 0);
+#else
+    EXPECT_EQ(locked.load(), all_targets.size());
+#endif
+}
+
+TEST_F(BatchTest, CallbackOverlap) {
+    create("Test_batch1.h5", 0);
+    create("Test_batch2.h5", 1);
+    create("Test_batch3.h5", 2);
+
+    chihaya::batch::Options opts;
+    opts.num_workers = 3;
+    opts.mode = chihaya::batch::Mode::THREADS;
+
+    // Callbacks should never run concurrently, even if the HDF5 lock is not held.
+    std::atomic<int> active(0);
+    std::atomic<bool> overlapped(false);
+    auto check = [&]() -> void {
+        if (++active > 1) {
+            overlapped = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        --active;
+    };
+    opts.validation.enter_callback = [&](const H5::Group&, const std::string&) -> void { check(); };
+    opts.validation.exit_callback = [&](const H5::Group&, const std::string&, const chihaya::NodeStatistics&) -> void { check(); };
+
+    auto res = chihaya::batch::validate(targets(), opts);
+    EXPECT_EQ(res.num_failed, 3);
+    EXPECT_FALSE(overlapped.load());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Batch,
+    BatchTest,
+    ::testing::Values(chihaya::batch::Mode::AUTO, chihaya::batch::Mode::THREADS, chihaya::batch::Mode::PROCESSES)
+);
@@ -2,6 +2,9 @@
 #include "chihaya/chihaya.hpp"
 #include "utils.h"
 
+#include <algorithm>
+#include <string>
+
 class CombineTest : public ::testing::TestWithParam<int> {
 public:
     CombineTest() : path("Test_combine.h5") {}
@@ -181,6 +184,40 @@ TEST_P(CombineTest, SeedErrors) {
     expect_error(path, "hello", "contain strings");
 }
 
+TEST_P(CombineTest, Parallel) {
+    auto version = GetParam();
+
+    auto create = [&](std::vector<int> broken) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = combine_opener(fhandle, "hello", 1, version);
+        auto lhandle = list_opener(ghandle, "seeds", 50, version);
+        for (int s = 0; s < 50; ++s) {
+            auto name = std::to_string(s);
+            if (std::find(broken.begin(), broken.end(), s) != broken.end()) {
+                lhandle.createGroup(name);
+            } else {
+                mock_array_opener(lhandle, name, { 13, s + 1 }, version, (s % 2 == 0 ? "INTEGER" : "FLOAT"));
+            }
+        }
+    };
+
+    chihaya::Options opts;
+    opts.num_threads = 4;
+
+    create({});
+    {
+        auto output = chihaya::validate(path, "hello", opts);
+        EXPECT_EQ(output.type, chihaya::FLOAT);
+        EXPECT_EQ(output.dimensions[0], 13);
+        EXPECT_EQ(output.dimensions[1], 50 * 51 / 2);
+        EXPECT_FALSE(opts.pool); // pool is only kept for the duration of the call.
+    }
+
+    // The first reported error is the same as that of the serial run.
+    create({ 37, 12, 45 });
+    expect_error([&]() -> void { chihaya::validate(path, "hello", opts); }, "failed to validate 'seeds/12'");
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Combine,
     CombineTest,
@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+#include "chihaya/chihaya.hpp"
+#include "utils.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class ProfileTest : public ::testing::Test {
+protected:
+    std::string path = "Test_profile.h5";
+
+    static void add_sparse_matrix(const H5::Group& handle, const std::string& name, std::vector<int> indices) {
+        auto ghandle = array_opener(handle, name, "sparse matrix");
+        auto dhandle = add_numeric_vector<double>(ghandle, "data", { 1, 2, 3, 4, 5, 6 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { 10, 3 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indices", indices, H5::PredType::NATIVE_UINT16);
+        add_numeric_vector<int>(ghandle, "indptr", { 0, 2, 4, 6 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_scalar(ghandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+    }
+
+    void create(std::vector<int> second_indices) const {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto thandle = operation_opener(fhandle, "hello", "transpose");
+        add_version_string(thandle, 1100000);
+        add_numeric_vector<int>(thandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto chandle = operation_opener(thandle, "seed", "combine");
+        add_numeric_scalar(chandle, "along", 1, H5::PredType::NATIVE_UINT32);
+        auto lhandle = list_opener(chandle, "seeds", 2, 1100000);
+        add_sparse_matrix(lhandle, "0", { 0, 5, 1, 2, 8, 9 });
+        add_sparse_matrix(lhandle, "1", std::move(second_indices));
+    }
+};
+
+TEST_F(ProfileTest, Callbacks) {
+    create({ 0, 5, 1, 2, 8, 9 });
+
+    chihaya::Options opts;
+    std::vector<std::string> entered, exited;
+    opts.enter_callback = [&](const H5::Group&, const std::string& type) -> void {
+        entered.push_back(type);
+    };
+    opts.exit_callback = [&](const H5::Group&, const std::string& type, const chihaya::NodeStatistics& stats) -> void {
+        exited.push_back(type);
+        EXPECT_FALSE(stats.failed);
+        EXPECT_GE(stats.seconds, 0);
+    };
+
+    chihaya::validate(path, "hello", opts);
+    std::vector<std::string> expected_enter { "transpose", "combine", "sparse matrix", "sparse matrix" };
+    EXPECT_EQ(entered, expected_enter);
+    std::vector<std::string> expected_exit { "sparse matrix", "sparse matrix", "combine", "transpose" };
+    EXPECT_EQ(exited, expected_exit);
+}
+
+TEST_F(ProfileTest, Profiler) {
+    create({ 0, 5, 1, 2, 8, 9 });
+
+    for (int nthreads : { 1, 3 }) {
+        chihaya::Options opts;
+        opts.num_threads = nthreads;
+        chihaya::Profiler prof;
+        prof.attach(opts);
+        chihaya::validate(path, "hello", opts);
+
+        const auto& entries = prof.entries();
+        ASSERT_EQ(entries.size(), 4);
+
+        for (const auto& e : entries) {
+            EXPECT_EQ(e.file, path);
+            EXPECT_FALSE(e.statistics.failed);
+            if (e.type == "sparse matrix") {
+                EXPECT_EQ(e.statistics.datasets_opened, 5); // shape, data, by_column, indices, indptr.
+                EXPECT_GE(e.statistics.elements_read, 2 + 4 + 6); // shape, indptr, indices.
+                EXPECT_GE(e.statistics.bytes_read, 2 * 8 + 4 * 4 + 6 * 2);
+            } else if (e.type == "combine") {
+                EXPECT_EQ(e.path, "/hello/seed");
+                EXPECT_EQ(e.statistics.datasets_opened, 1); // along
+                EXPECT_EQ(e.statistics.elements_read, 0); // scalars are ignored.
+            } else {
+                EXPECT_EQ(e.type, "transpose");
+                EXPECT_EQ(e.path, "/hello");
+                EXPECT_EQ(e.statistics.datasets_opened, 1);
+                EXPECT_EQ(e.statistics.elements_read, 2);
+            }
+        }
+
+        auto summary = prof.summarize();
+        EXPECT_EQ(summary.size(), 3);
+        EXPECT_EQ(summary["sparse matrix"].count, 2);
+        EXPECT_EQ(summary["sparse matrix"].datasets_opened, 10);
+        EXPECT_EQ(summary["combine"].count, 1);
+
+        auto folded = prof.to_folded();
+        EXPECT_NE(folded.find("/hello (transpose);seed (combine);seeds/0 (sparse matrix) "), std::string::npos);
+        EXPECT_NE(folded.find("/hello (transpose);seed (combine);seeds/1 (sparse matrix) "), std::string::npos);
+
+        auto json = prof.to_json();
+        EXPECT_EQ(json.rfind("{\"name\":\"validate\"", 0), 0);
+        EXPECT_NE(json.find("\"children\":[{\"name\":\"/hello/seed/seeds/0\""), std::string::npos);
+        EXPECT_NE(json.find("\"types\":{\"combine\":{\"count\":1"), std::string::npos);
+    }
+}
+
+TEST_F(ProfileTest, Timing) {
+    create({ 0, 5, 1, 2, 8, 9 });
+
+    for (bool prefetch : { false, true }) {
+        chihaya::Options opts;
+        opts.buffer_size = 1; // forcing multiple reads for each column's indices.
+        opts.prefetch = prefetch;
+        chihaya::Profiler prof;
+        prof.attach(opts);
+        chihaya::validate(path, "hello", opts);
+
+        for (const auto& e : prof.entries()) {
+            EXPECT_GE(e.statistics.wait_seconds, 0);
+            if (e.type == "sparse matrix") {
+                EXPECT_GT(e.statistics.read_seconds, 0);
+                EXPECT_LE(e.statistics.wait_seconds, e.statistics.seconds);
+            } else {
+                EXPECT_EQ(e.statistics.read_seconds, 0);
+            }
+        }
+
+        auto summary = prof.summarize();
+        EXPECT_GT(summary["sparse matrix"].read_seconds, 0);
+        auto json = prof.to_json();
+        EXPECT_NE(json.find("\"read_seconds\":"), std::string::npos);
+        EXPECT_NE(json.find("\"wait_seconds\":"), std::string::npos);
+    }
+}
+
+TEST_F(ProfileTest, Failure) {
+    create({ 0, 5, 1, 2, 8, 10 });
+
+    chihaya::Options opts;
+    chihaya::Profiler prof;
+    prof.attach(opts);
+    expect_error([&]() -> void { chihaya::validate(path, "hello", opts); }, "less than the number of rows");
+
+    const auto& entries = prof.entries();
+    ASSERT_EQ(entries.size(), 4);
+    for (const auto& e : entries) {
+        EXPECT_EQ(e.statistics.failed, e.path != "/hello/seed/seeds/0");
+    }
+
+    EXPECT_NE(prof.to_json().find("\"failed\":true"), std::string::npos);
+    prof.clear();
+    EXPECT_TRUE(prof.entries().empty());
+}
+
+TEST_F(ProfileTest, Lineage) {
+    create({ 0, 5, 1, 2, 8, 9 });
+
+    for (size_t iterative_depth : { 0, 1, 2 }) {
+        for (int nthreads : { 1, 3 }) {
+            chihaya::Options opts;
+            opts.num_threads = nthreads;
+            opts.iterative_depth = iterative_depth;
+            chihaya::Profiler prof;
+            prof.attach(opts);
+
+            // Repeated top-level calls should be reported as separate trees.
+            chihaya::validate(path, "hello", opts);
+            chihaya::validate(path, "hello", opts);
+
+            auto entries = prof.entries();
+            ASSERT_EQ(entries.size(), 8);
+            std::unordered_map<uint64_t, const chihaya::Profiler::Entry*> by_id;
+            for (const auto& e : entries) {
+                EXPECT_NE(e.statistics.id, 0);
+                by_id[e.statistics.id] = &e;
+            }
+            EXPECT_EQ(by_id.size(), 8);
+
+            size_t roots = 0;
+            for (const auto& e : entries) {
+                if (e.type == "transpose") {
+                    EXPECT_EQ(e.statistics.parent, 0);
+                    ++roots;
+                    continue;
+                }
+                auto it = by_id.find(e.statistics.parent);
+                ASSERT_TRUE(it != by_id.end());
+                EXPECT_EQ(it->second->type, (e.type == "combine" ? "transpose" : "combine"));
+            }
+            EXPECT_EQ(roots, 2);
+
+            auto json = prof.to_json();
+            size_t count = 0;
+            for (size_t pos = json.find("\"name\":\"/hello\""); pos != std::string::npos; pos = json.find("\"name\":\"/hello\"", pos + 1)) {
+                ++count;
+            }
+            EXPECT_EQ(count, 2);
+
+            auto folded = prof.to_folded();
+            std::string stack = "/hello (transpose);seed (combine);seeds/1 (sparse matrix) ";
+            auto first = folded.find(stack);
+            ASSERT_NE(first, std::string::npos);
+            EXPECT_NE(folded.find(stack, first + 1), std::string::npos);
+        }
+    }
+}
+
+TEST_F(ProfileTest, SharedNode) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto bhandle = operation_opener(fhandle, "hello", "binary arithmetic");
+        add_version_string(bhandle, 1100000);
+        add_string_scalar(bhandle, "method", "+");
+        auto lhandle = operation_opener(bhandle, "left", "transpose");
+        add_numeric_vector<int>(lhandle, "permutation", { 0, 1 }, H5::PredType::NATIVE_UINT32);
+        add_sparse_matrix(lhandle, "seed", { 0, 5, 1, 2, 8, 9 });
+        auto rhandle = operation_opener(bhandle, "right", "transpose");
+        add_numeric_vector<int>(rhandle, "permutation", { 0, 1 }, H5::PredType::NATIVE_UINT32);
+        H5Lcreate_hard(lhandle.getId(), "seed", rhandle.getId(), "seed", H5P_DEFAULT, H5P_DEFAULT);
+    }
+
+    chihaya::Options opts;
+    chihaya::Profiler prof;
+    prof.attach(opts);
+    chihaya::validate(path, "hello", opts);
+
+    // The shared sparse matrix is only validated once, under the transposition that validated it first.
+    auto entries = prof.entries();
+    ASSERT_EQ(entries.size(), 4);
+    auto folded = prof.to_folded();
+    EXPECT_NE(folded.find("/hello (binary arithmetic);left (transpose);seed (sparse matrix) "), std::string::npos);
+    EXPECT_EQ(folded.find("right (transpose);"), std::string::npos);
+}
+
+TEST_F(ProfileTest, IterativeTiming) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        H5::Group current = operation_opener(fhandle, "hello", "unary arithmetic");
+        add_version_string(current, 1100000);
+        for (size_t d = 0; d < 30; ++d) {
+            add_string_scalar(current, "method", "+");
+            add_string_scalar(current, "side", "right");
+            auto vhandle = add_numeric_scalar(current, "value", 1, H5::PredType::NATIVE_INT32);
+            add_string_attribute(vhandle, "type", "INTEGER");
+            if (d + 1 < 30) {
+                current = operation_opener(current, "seed", "unary arithmetic");
+            }
+        }
+        add_sparse_matrix(current, "seed", { 0, 5, 1, 2, 8, 9 });
+    }
+
+    // Chain is deeper than the iterative depth, so some nodes are validated after their descendants.
+    for (size_t iterative_depth : { 0, 1, 10 }) {
+        chihaya::Options opts;
+        opts.iterative_depth = iterative_depth;
+        chihaya::Profiler prof;
+        prof.attach(opts);
+        chihaya::validate(path, "hello", opts);
+
+        auto entries = prof.entries();
+        ASSERT_EQ(entries.size(), 31);
+        std::unordered_map<uint64_t, const chihaya::Profiler::Entry*> by_id;
+        for (const auto& e : entries) {
+            by_id[e.statistics.id] = &e;
+        }
+
+        // Each node's wall time should include that of its child.
+        for (const auto& e : entries) {
+            if (e.statistics.parent == 0) {
+                EXPECT_EQ(e.path, "/hello");
+                continue;
+            }
+            auto it = by_id.find(e.statistics.parent);
+            ASSERT_TRUE(it != by_id.end());
+            EXPECT_GE(it->second->statistics.seconds, e.statistics.seconds) << "for '" << e.path << "' with iterative depth " << iterative_depth;
+        }
+    }
+}
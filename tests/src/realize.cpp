@@ -0,0 +1,1413 @@
+#include <gtest/gtest.h>
+#include "chihaya/chihaya.hpp"
+#include "utils.h"
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <numeric>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+class RealizeTest : public ::testing::Test {
+protected:
+    std::string path = "Test_realize.h5";
+
+    // Reference array in row-major order.
+    struct Reference {
+        std::vector<size_t> dims;
+        std::vector<double> values;
+    };
+
+    static Reference simulate(std::vector<size_t> dims, int seed, double sparsity = 0) {
+        Reference output;
+        output.dims = std::move(dims);
+        size_t n = 1;
+        for (auto d : output.dims) {
+            n *= d;
+        }
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> dist(-5, 5);
+        output.values.resize(n);
+        for (auto& v : output.values) {
+            v = std::round(dist(rng) * 100) / 100;
+            if (sparsity && std::abs(v) < 5 * sparsity) {
+                v = 0;
+            }
+        }
+        return output;
+    }
+
+    static std::vector<size_t> strides(const std::vector<size_t>& dims) {
+        std::vector<size_t> output(dims.size());
+        size_t current = 1;
+        for (size_t d = dims.size(); d > 0; --d) {
+            output[d - 1] = current;
+            current *= dims[d - 1];
+        }
+        return output;
+    }
+
+    // Applies 'fun(position, offset)' to each element of the array, in row-major order.
+    template<class Function_>
+    static void loop(const std::vector<size_t>& dims, Function_ fun) {
+        size_t n = 1;
+        for (auto d : dims) {
+            n *= d;
+        }
+        std::vector<size_t> position(dims.size());
+        for (size_t i = 0; i < n; ++i) {
+            fun(position, i);
+            for (size_t d = dims.size(); d > 0; --d) {
+                if (++position[d - 1] < dims[d - 1]) {
+                    break;
+                }
+                position[d - 1] = 0;
+            }
+        }
+    }
+
+    static Reference transform(const Reference& ref, double (*fun)(double)) {
+        auto output = ref;
+        for (auto& v : output.values) {
+            v = fun(v);
+        }
+        return output;
+    }
+
+    static H5::DataSet add_dense(const H5::Group& parent, const std::string& name, const Reference& ref, bool native = true) {
+        auto ghandle = array_opener(parent, name, "dense array");
+        add_version_string(ghandle, 1100000);
+
+        std::vector<hsize_t> fdims(ref.dims.begin(), ref.dims.end());
+        std::vector<double> fvalues = ref.values;
+        if (!native) {
+            std::reverse(fdims.begin(), fdims.end());
+            std::vector<size_t> rdims(fdims.begin(), fdims.end());
+            auto rstrides = strides(rdims);
+            loop(ref.dims, [&](const std::vector<size_t>& pos, size_t i) -> void {
+                size_t offset = 0;
+                for (size_t d = 0; d < pos.size(); ++d) {
+                    offset += pos[d] * rstrides[pos.size() - d - 1];
+                }
+                fvalues[offset] = ref.values[i];
+            });
+        }
+
+        H5::DataSpace dspace(fdims.size(), fdims.data());
+        auto dhandle = ghandle.createDataSet("data", H5::PredType::NATIVE_DOUBLE, dspace);
+        dhandle.write(fvalues.data(), H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_scalar<int>(ghandle, "native", native, H5::PredType::NATIVE_INT8);
+        return dhandle;
+    }
+
+    static void add_sparse(const H5::Group& parent, const std::string& name, const Reference& ref, bool csc) {
+        auto ghandle = array_opener(parent, name, "sparse matrix");
+        add_version_string(ghandle, 1100000);
+
+        size_t nr = ref.dims[0], nc = ref.dims[1];
+        size_t primary = (csc ? nc : nr), secondary = (csc ? nr : nc);
+        std::vector<double> data;
+        std::vector<int> indices, indptr(1);
+        for (size_t p = 0; p < primary; ++p) {
+            for (size_t s = 0; s < secondary; ++s) {
+                double v = (csc ? ref.values[s * nc + p] : ref.values[p * nc + s]);
+                if (v != 0) {
+                    data.push_back(v);
+                    indices.push_back(s);
+                }
+            }
+            indptr.push_back(data.size());
+        }
+
+        auto dhandle = add_numeric_vector(ghandle, "data", data, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { static_cast<int>(nr), static_cast<int>(nc) }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indices", indices, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indptr", indptr, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(ghandle, "by_column", static_cast<int>(csc), H5::PredType::NATIVE_INT8);
+    }
+
+    static void add_index_list(const H5::Group& parent, const std::string& name, const std::vector<std::vector<int> >& indices, size_t ndims) {
+        auto lhandle = list_opener(parent, name, ndims, 1100000);
+        for (size_t d = 0; d < indices.size(); ++d) {
+            if (!indices[d].empty()) {
+                add_numeric_vector(lhandle, std::to_string(d), indices[d], H5::PredType::NATIVE_UINT32);
+            }
+        }
+    }
+
+    static void compare(double expected, double observed) {
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(observed));
+            EXPECT_EQ(chihaya::realize::is_missing(expected), chihaya::realize::is_missing(observed));
+        } else {
+            EXPECT_NEAR(expected, observed, 1e-8 * std::max(1.0, std::abs(expected)));
+        }
+    }
+
+    // Checks the full array and a variety of sub-blocks against the reference.
+    static void check(const std::string& path, const std::string& name, const Reference& ref, size_t budget = 100000000) {
+        chihaya::realize::Options opt;
+        opt.memory_budget = budget;
+        auto arr = chihaya::realize::load(path, name, opt);
+        ASSERT_EQ(arr->dimensions(), ref.dims);
+
+        std::vector<double> full(ref.values.size());
+        chihaya::realize::extract(*arr, std::vector<size_t>(ref.dims.size()), ref.dims, full.data(), opt);
+        for (size_t i = 0; i < full.size(); ++i) {
+            compare(ref.values[i], full[i]);
+        }
+
+        auto rstrides = strides(ref.dims);
+        for (size_t trial = 0; trial < 3; ++trial) {
+            std::vector<size_t> start(ref.dims.size()), count(ref.dims.size());
+            for (size_t d = 0; d < ref.dims.size(); ++d) {
+                start[d] = std::min(ref.dims[d], (trial * ref.dims[d]) / 4);
+                count[d] = std::min(ref.dims[d] - start[d], ref.dims[d] / 2 + 1);
+            }
+            std::vector<double> block(std::accumulate(count.begin(), count.end(), static_cast<size_t>(1), std::multiplies<size_t>()));
+            chihaya::realize::extract(*arr, start, count, block.data(), opt);
+            loop(count, [&](const std::vector<size_t>& pos, size_t i) -> void {
+                size_t offset = 0;
+                for (size_t d = 0; d < pos.size(); ++d) {
+                    offset += (start[d] + pos[d]) * rstrides[d];
+                }
+                compare(ref.values[offset], block[i]);
+            });
+        }
+    }
+};
+
+TEST_F(RealizeTest, DenseArray) {
+    auto ref = simulate({ 7, 11, 13 }, 1);
+    ref.values[5] = 999;
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_dense(fhandle, "native", ref, true);
+        add_dense(fhandle, "transposed", ref, false);
+        auto dhandle = add_dense(fhandle, "placeholder", ref, false);
+        add_numeric_missing_placeholder<double>(dhandle, 999, H5::PredType::NATIVE_DOUBLE);
+    }
+
+    check(path, "native", ref);
+    check(path, "native", ref, 800); // forcing multiple blocks.
+    check(path, "transposed", ref);
+    check(path, "transposed", ref, 800);
+
+    auto expected = ref;
+    expected.values[5] = chihaya::realize::missing_value();
+    check(path, "placeholder", expected);
+
+    chihaya::realize::Options opt;
+    auto arr = chihaya::realize::load(path, "native", opt);
+    EXPECT_EQ(arr->details().type, chihaya::FLOAT);
+    std::vector<double> buffer(10);
+    expect_error([&]() { chihaya::realize::extract(*arr, { 0, 0, 0 }, { 8, 1, 1 }, buffer.data(), opt); }, "out of range");
+}
+
+TEST_F(RealizeTest, SparseMatrix) {
+    auto ref = simulate({ 37, 23 }, 2, 0.8);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_sparse(fhandle, "csc", ref, true);
+        add_sparse(fhandle, "csr", ref, false);
+    }
+
+    check(path, "csc", ref);
+    check(path, "csr", ref);
+    check(path, "csc", ref, 1000); // forcing small read windows and multiple blocks.
+    check(path, "csr", ref, 1000);
+}
+
+TEST_F(RealizeTest, ConstantArray) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = array_opener(fhandle, "const", "constant array");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "dimensions", { 4, 9 }, H5::PredType::NATIVE_UINT32);
+        auto vhandle = add_numeric_scalar<double>(ghandle, "value", 2.5, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+    }
+
+    Reference ref;
+    ref.dims = { 4, 9 };
+    ref.values.resize(36, 2.5);
+    check(path, "const", ref);
+}
+
+TEST_F(RealizeTest, Subset) {
+    auto ref = simulate({ 13, 17, 5 }, 3);
+    std::vector<std::vector<int> > indices{ { 3, 1, 1, 12, 0, 7 }, {}, { 4, 0, 2 } };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "sub", "subset");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", ref);
+        add_index_list(ghandle, "index", indices, 3);
+
+        // Sparse indices that are split into multiple runs.
+        auto ghandle2 = operation_opener(fhandle, "sparse_sub", "subset");
+        add_version_string(ghandle2, 1100000);
+        add_dense(ghandle2, "seed", simulate({ 100, 60 }, 4));
+        add_index_list(ghandle2, "index", { { 99, 0, 50, 51, 52, 3, 98 }, { 59, 1, 30 } }, 2);
+    }
+
+    Reference expected;
+    expected.dims = { 6, 17, 3 };
+    auto rstrides = strides(ref.dims);
+    loop(expected.dims, [&](const std::vector<size_t>& pos, size_t) -> void {
+        expected.values.push_back(ref.values[indices[0][pos[0]] * rstrides[0] + pos[1] * rstrides[1] + indices[2][pos[2]]]);
+    });
+    check(path, "sub", expected);
+    check(path, "sub", expected, 1000);
+
+    auto ref2 = simulate({ 100, 60 }, 4);
+    Reference expected2;
+    expected2.dims = { 7, 3 };
+    std::vector<int> rows{ 99, 0, 50, 51, 52, 3, 98 }, cols{ 59, 1, 30 };
+    for (auto r : rows) {
+        for (auto c : cols) {
+            expected2.values.push_back(ref2.values[r * 60 + c]);
+        }
+    }
+    check(path, "sparse_sub", expected2);
+}
+
+TEST_F(RealizeTest, SubsetSparse) {
+    auto ref = simulate({ 100, 40 }, 5, 0.7);
+    for (bool csc : { true, false }) {
+        {
+            H5::H5File fhandle(path, H5F_ACC_TRUNC);
+            add_sparse(fhandle, "leaf", ref, csc);
+        }
+
+        // Wrapper that records the largest sparse block requested from the seed.
+        struct Recorder : public chihaya::realize::Array {
+            Recorder(std::unique_ptr<chihaya::realize::Array> s, size_t& m) : chihaya::realize::Array(s->details()), seed(std::move(s)), largest(m) {}
+            void extract(const std::vector<size_t>& start, const std::vector<size_t>& count, double* buffer) const {
+                seed->extract(start, count, buffer);
+            }
+            bool sparse() const {
+                return true;
+            }
+            bool sparse_by_column() const {
+                return seed->sparse_by_column();
+            }
+            void extract_sparse(const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column, chihaya::realize::SparseBlock& output) const {
+                largest = std::max(largest, count[0] * count[1]);
+                seed->extract_sparse(start, count, by_column, output);
+            }
+            std::unique_ptr<chihaya::realize::Array> seed;
+            size_t& largest;
+        };
+
+        // Duplicated and unsorted indices that are split into multiple runs.
+        std::vector<size_t> rows{ 99, 0, 50, 50, 3, 98 }, cols{ 38, 1, 2, 1 };
+        chihaya::realize::Options opt;
+        size_t largest = 0;
+        chihaya::internal_realize::IndexList index;
+        index.present = { true, true };
+        index.indices = { rows, cols };
+        chihaya::realize::Subset sub(std::make_unique<Recorder>(chihaya::realize::load(path, "leaf", opt), largest), index);
+        EXPECT_TRUE(sub.sparse());
+
+        for (bool by_column : { true, false }) {
+            largest = 0;
+            auto block = chihaya::realize::extract_sparse(sub, { 0, 0 }, { rows.size(), cols.size() }, by_column);
+            EXPECT_LE(largest, 8); // rows are grouped into {0, 3}, {50}, {98, 99}, columns into {1, 2}, {38}.
+
+            size_t np = (by_column ? cols.size() : rows.size()), ns = (by_column ? rows.size() : cols.size());
+            ASSERT_EQ(block.pointers.size(), np + 1);
+            std::vector<double> dense(np * ns);
+            for (size_t p = 0; p < np; ++p) {
+                for (size_t k = block.pointers[p]; k < block.pointers[p + 1]; ++k) {
+                    if (k > block.pointers[p]) {
+                        EXPECT_LT(block.indices[k - 1], block.indices[k]);
+                    }
+                    dense[p * ns + block.indices[k]] = block.values[k];
+                }
+            }
+            for (size_t p = 0; p < np; ++p) {
+                for (size_t s = 0; s < ns; ++s) {
+                    size_t r = rows[by_column ? s : p], c = cols[by_column ? p : s];
+                    EXPECT_EQ(ref.values[r * 40 + c], dense[p * ns + s]);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(RealizeTest, Combine) {
+    auto first = simulate({ 5, 8 }, 5), second = simulate({ 3, 8 }, 6), third = simulate({ 5, 4 }, 7);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "rows", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 0, H5::PredType::NATIVE_UINT8);
+        auto shandle = list_opener(ghandle, "seeds", 2, 1100000);
+        add_dense(shandle, "0", first);
+        add_sparse(shandle, "1", second, true);
+
+        auto ghandle2 = operation_opener(fhandle, "cols", "combine");
+        add_version_string(ghandle2, 1100000);
+        add_numeric_scalar(ghandle2, "along", 1, H5::PredType::NATIVE_UINT8);
+        auto shandle2 = list_opener(ghandle2, "seeds", 2, 1100000);
+        add_dense(shandle2, "0", first);
+        add_dense(shandle2, "1", third, false);
+    }
+
+    Reference rows;
+    rows.dims = { 8, 8 };
+    rows.values = first.values;
+    rows.values.insert(rows.values.end(), second.values.begin(), second.values.end());
+    check(path, "rows", rows);
+    check(path, "rows", rows, 200);
+
+    Reference cols;
+    cols.dims = { 5, 12 };
+    for (size_t r = 0; r < 5; ++r) {
+        cols.values.insert(cols.values.end(), first.values.begin() + r * 8, first.values.begin() + (r + 1) * 8);
+        cols.values.insert(cols.values.end(), third.values.begin() + r * 4, third.values.begin() + (r + 1) * 4);
+    }
+    check(path, "cols", cols);
+    check(path, "cols", cols, 200);
+}
+
+TEST_F(RealizeTest, Transpose) {
+    auto ref = simulate({ 4, 6, 9 }, 8);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "trans", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", ref);
+        add_numeric_vector<int>(ghandle, "permutation", { 2, 0, 1 }, H5::PredType::NATIVE_UINT32);
+    }
+
+    Reference expected;
+    expected.dims = { 9, 4, 6 };
+    loop(expected.dims, [&](const std::vector<size_t>& pos, size_t) -> void {
+        expected.values.push_back(ref.values[pos[1] * 54 + pos[2] * 9 + pos[0]]);
+    });
+    check(path, "trans", expected);
+    check(path, "trans", expected, 500);
+}
+
+TEST_F(RealizeTest, SubsetAssignment) {
+    auto ref = simulate({ 10, 7 }, 9), value = simulate({ 3, 7 }, 10);
+    std::vector<int> rows{ 8, 2, 8 };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "assign", "subset assignment");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", ref);
+        add_dense(ghandle, "value", value);
+        add_index_list(ghandle, "index", { rows, {} }, 2);
+    }
+
+    // Later assignments take precedence.
+    auto expected = ref;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        std::copy_n(value.values.begin() + i * 7, 7, expected.values.begin() + rows[i] * 7);
+    }
+    check(path, "assign", expected);
+    check(path, "assign", expected, 100);
+}
+
+TEST_F(RealizeTest, UnaryOperations) {
+    auto ref = simulate({ 6, 5 }, 11);
+    ref.values[3] = chihaya::realize::missing_value();
+    ref.values[4] = std::numeric_limits<double>::quiet_NaN();
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        auto ghandle = operation_opener(fhandle, "arith", "unary arithmetic");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", ref);
+        add_string_scalar(ghandle, "method", "%%");
+        add_string_scalar(ghandle, "side", "right");
+        auto vhandle = add_numeric_vector<double>(ghandle, "value", { 1, 2, -3, 4, 5 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(ghandle, "along", 1, H5::PredType::NATIVE_UINT8);
+
+        auto ghandle2 = operation_opener(fhandle, "negate", "unary arithmetic");
+        add_version_string(ghandle2, 1100000);
+        add_dense(ghandle2, "seed", ref);
+        add_string_scalar(ghandle2, "method", "-");
+        add_string_scalar(ghandle2, "side", "none");
+
+        auto ghandle3 = operation_opener(fhandle, "compare", "unary comparison");
+        add_version_string(ghandle3, 1100000);
+        add_dense(ghandle3, "seed", ref);
+        add_string_scalar(ghandle3, "method", ">");
+        add_string_scalar(ghandle3, "side", "left");
+        auto vhandle3 = add_numeric_scalar<double>(ghandle3, "value", 1, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle3, "type", "FLOAT");
+
+        auto ghandle4 = operation_opener(fhandle, "log", "unary math");
+        add_version_string(ghandle4, 1100000);
+        add_dense(ghandle4, "seed", ref);
+        add_string_scalar(ghandle4, "method", "log");
+        add_numeric_scalar<double>(ghandle4, "base", 2, H5::PredType::NATIVE_DOUBLE);
+
+        auto ghandle5 = operation_opener(fhandle, "isnan", "unary special check");
+        add_version_string(ghandle5, 1100000);
+        add_dense(ghandle5, "seed", ref);
+        add_string_scalar(ghandle5, "method", "is_nan");
+
+        auto ghandle6 = operation_opener(fhandle, "not", "unary logic");
+        add_version_string(ghandle6, 1100000);
+        add_dense(ghandle6, "seed", ref);
+        add_string_scalar(ghandle6, "method", "!");
+    }
+
+    {
+        std::vector<double> values{ 1, 2, -3, 4, 5 };
+        auto expected = ref;
+        loop(ref.dims, [&](const std::vector<size_t>& pos, size_t i) -> void {
+            double x = ref.values[i], v = values[pos[1]];
+            if (!std::isnan(x)) {
+                auto out = std::fmod(x, v);
+                if (out != 0 && ((out < 0) != (v < 0))) {
+                    out += v;
+                }
+                expected.values[i] = out;
+            }
+        });
+        check(path, "arith", expected);
+
+        chihaya::realize::Options opt;
+        EXPECT_EQ(chihaya::realize::load(path, "arith", opt)->details().type, chihaya::FLOAT);
+    }
+
+    check(path, "negate", transform(ref, [](double x) -> double { return -x; }));
+
+    {
+        auto expected = transform(ref, [](double x) -> double { return std::isnan(x) ? chihaya::realize::missing_value() : (1 > x); });
+        check(path, "compare", expected);
+        chihaya::realize::Options opt;
+        EXPECT_EQ(chihaya::realize::load(path, "compare", opt)->details().type, chihaya::BOOLEAN);
+    }
+
+    check(path, "log", transform(ref, [](double x) -> double { return std::isnan(x) ? x : std::log2(x); }));
+    check(path, "isnan", transform(ref, [](double x) -> double { return std::isnan(x) && !chihaya::realize::is_missing(x); }));
+    check(path, "not", transform(ref, [](double x) -> double { return std::isnan(x) ? x : (x == 0); }));
+}
+
+TEST_F(RealizeTest, FusedOperations) {
+    auto ref = simulate({ 40, 150 }, 12);
+    for (auto& x : ref.values) {
+        x = std::abs(x);
+    }
+    ref.values[7] = chihaya::realize::missing_value();
+    std::vector<double> factors(150);
+    for (size_t c = 0; c < factors.size(); ++c) {
+        factors[c] = 0.5 + c / 100.0;
+    }
+
+    // Mimicking a typical normalization: log(x / size factor + 1) * 10 > 5.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        auto ghandle = operation_opener(fhandle, "fused", "unary comparison");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", ">");
+        add_string_scalar(ghandle, "side", "right");
+        auto vhandle = add_numeric_scalar<double>(ghandle, "value", 5, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+
+        auto shandle = operation_opener(ghandle, "seed", "unary arithmetic");
+        add_version_string(shandle, 1100000);
+        add_string_scalar(shandle, "method", "*");
+        add_string_scalar(shandle, "side", "left");
+        vhandle = add_numeric_scalar<double>(shandle, "value", 10, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+
+        shandle = operation_opener(shandle, "seed", "unary math");
+        add_version_string(shandle, 1100000);
+        add_string_scalar(shandle, "method", "log");
+
+        shandle = operation_opener(shandle, "seed", "unary arithmetic");
+        add_version_string(shandle, 1100000);
+        add_string_scalar(shandle, "method", "+");
+        add_string_scalar(shandle, "side", "right");
+        vhandle = add_numeric_scalar<double>(shandle, "value", 1, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+
+        shandle = operation_opener(shandle, "seed", "unary arithmetic");
+        add_version_string(shandle, 1100000);
+        add_string_scalar(shandle, "method", "/");
+        add_string_scalar(shandle, "side", "right");
+        vhandle = add_numeric_vector<double>(shandle, "value", factors, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(shandle, "along", 1, H5::PredType::NATIVE_UINT8);
+
+        add_dense(shandle, "seed", ref);
+    }
+
+    auto expected = ref;
+    loop(ref.dims, [&](const std::vector<size_t>& pos, size_t i) -> void {
+        double x = ref.values[i];
+        expected.values[i] = (std::isnan(x) ? chihaya::realize::missing_value() : (std::log(x / factors[pos[1]] + 1) * 10 > 5));
+    });
+    check(path, "fused", expected);
+    check(path, "fused", expected, 5000); // forcing multiple blocks.
+
+    chihaya::realize::Options opt;
+    auto arr = chihaya::realize::load(path, "fused", opt);
+    EXPECT_EQ(arr->details().type, chihaya::BOOLEAN);
+    auto fused = dynamic_cast<const chihaya::realize::FusedOperation*>(arr.get());
+    ASSERT_TRUE(fused != NULL);
+    EXPECT_EQ(fused->get_steps().size(), 5);
+    EXPECT_EQ(fused->get_seed().dimensions(), ref.dims);
+
+    // Same results without fusion.
+    opt.fuse_elementwise = false;
+    auto unfused = chihaya::realize::load(path, "fused", opt);
+    EXPECT_TRUE(dynamic_cast<const chihaya::realize::FusedOperation*>(unfused.get()) == NULL);
+    std::vector<double> observed(ref.values.size()), alternative(ref.values.size());
+    chihaya::realize::extract(*arr, { 3, 10 }, { 30, 120 }, observed.data(), opt);
+    chihaya::realize::extract(*unfused, { 3, 10 }, { 30, 120 }, alternative.data(), opt);
+    for (size_t i = 0; i < 30 * 120; ++i) {
+        compare(alternative[i], observed[i]);
+    }
+
+    // Results are identical to the standard library with exact math.
+    for (int fuse = 0; fuse < 2; ++fuse) {
+        chihaya::realize::Options eopt;
+        eopt.exact_math = true;
+        eopt.fuse_elementwise = fuse;
+        auto exact = chihaya::realize::load(path, "fused", eopt);
+        if (fuse) {
+            auto efused = dynamic_cast<const chihaya::realize::FusedOperation*>(exact.get());
+            ASSERT_TRUE(efused != NULL);
+            for (const auto& step : efused->get_steps()) {
+                if (step.values.empty()) {
+                    EXPECT_TRUE(step.exact_math);
+                }
+            }
+        }
+
+        std::vector<double> buffer(ref.values.size());
+        chihaya::realize::extract(*exact, { 0, 0 }, ref.dims, buffer.data(), eopt);
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            double e = expected.values[i];
+            if (std::isnan(e)) {
+                EXPECT_TRUE(chihaya::realize::is_missing(buffer[i]));
+            } else {
+                EXPECT_EQ(e, buffer[i]);
+            }
+        }
+    }
+}
+
+TEST_F(RealizeTest, SparsityPreservation) {
+    auto left = simulate({ 20, 15 }, 13, 0.8);
+    auto right = simulate({ 20, 10 }, 14, 0.8);
+    std::vector<int> rows{ 24, 3, 3, 0, 10, 7 }, cols{ 19, 0, 5, 5, 2, 11, 12, 13 };
+    std::vector<double> factors{ 1, 2, 3, 4, 5, 6 };
+
+    // Building the expected result of multiplying log1p(abs(t(cbind(left, right))[rows, cols])) by 'factors' along the rows.
+    Reference expected;
+    expected.dims = { rows.size(), cols.size() };
+    for (size_t r = 0; r < rows.size(); ++r) {
+        for (size_t c = 0; c < cols.size(); ++c) {
+            size_t i = cols[c], j = rows[r];
+            double x = (j < 15 ? left.values[i * 15 + j] : right.values[i * 10 + j - 15]);
+            expected.values.push_back(std::log1p(std::abs(x)) * factors[r]);
+        }
+    }
+
+    auto add_tree = [&](const H5::Group& parent, const std::string& name, bool shift) -> void {
+        auto ghandle = operation_opener(parent, name, "unary arithmetic");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", "*");
+        add_string_scalar(ghandle, "side", "right");
+        auto vhandle = add_numeric_vector<double>(ghandle, "value", factors, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(ghandle, "along", 0, H5::PredType::NATIVE_UINT8);
+
+        if (shift) {
+            ghandle = operation_opener(ghandle, "seed", "unary arithmetic");
+            add_version_string(ghandle, 1100000);
+            add_string_scalar(ghandle, "method", "+");
+            add_string_scalar(ghandle, "side", "right");
+            vhandle = add_numeric_scalar<double>(ghandle, "value", 1, H5::PredType::NATIVE_DOUBLE);
+            add_string_attribute(vhandle, "type", "FLOAT");
+        }
+
+        ghandle = operation_opener(ghandle, "seed", "unary math");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", "log1p");
+
+        ghandle = operation_opener(ghandle, "seed", "unary math");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", "abs");
+
+        ghandle = operation_opener(ghandle, "seed", "subset");
+        add_version_string(ghandle, 1100000);
+        add_index_list(ghandle, "index", { rows, cols }, 2);
+
+        ghandle = operation_opener(ghandle, "seed", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        ghandle = operation_opener(ghandle, "seed", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 1, H5::PredType::NATIVE_UINT8);
+        auto shandle = list_opener(ghandle, "seeds", 2, 1100000);
+        add_sparse(shandle, "0", left, true);
+        add_sparse(shandle, "1", right, false);
+    };
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_tree(fhandle, "sparse", false);
+        add_tree(fhandle, "dense", true);
+    }
+
+    check(path, "sparse", expected);
+    check(path, "sparse", expected, 1000);
+
+    // Checks a sparse block against the reference.
+    auto check_sparse = [&](const chihaya::realize::Array& arr, const Reference& ref, const std::vector<size_t>& start, const std::vector<size_t>& count, bool by_column) -> void {
+        auto block = chihaya::realize::extract_sparse(arr, start, count, by_column);
+        EXPECT_EQ(block.by_column, by_column);
+        size_t np = count[by_column ? 1 : 0], ns = count[by_column ? 0 : 1];
+        ASSERT_EQ(block.pointers.size(), np + 1);
+        std::vector<double> dense(np * ns);
+        for (size_t p = 0; p < np; ++p) {
+            for (size_t k = block.pointers[p]; k < block.pointers[p + 1]; ++k) {
+                if (k > block.pointers[p]) {
+                    EXPECT_LT(block.indices[k - 1], block.indices[k]);
+                }
+                dense[p * ns + block.indices[k]] = block.values[k];
+            }
+        }
+        for (size_t p = 0; p < np; ++p) {
+            for (size_t s = 0; s < ns; ++s) {
+                size_t r = start[0] + (by_column ? s : p), c = start[1] + (by_column ? p : s);
+                compare(ref.values[r * ref.dims[1] + c], dense[p * ns + s]);
+            }
+        }
+    };
+
+    chihaya::realize::Options opt;
+    auto arr = chihaya::realize::load(path, "sparse", opt);
+    EXPECT_TRUE(arr->sparse());
+    for (bool by_column : { true, false }) {
+        check_sparse(*arr, expected, { 0, 0 }, expected.dims, by_column);
+        check_sparse(*arr, expected, { 1, 2 }, { 4, 5 }, by_column);
+    }
+
+    // Adding one is not zero-preserving, so the sparse extraction falls back to compressing a dense block.
+    auto arr2 = chihaya::realize::load(path, "dense", opt);
+    EXPECT_FALSE(arr2->sparse());
+    auto fused = dynamic_cast<const chihaya::realize::FusedOperation*>(arr2.get());
+    ASSERT_TRUE(fused != NULL);
+    EXPECT_FALSE(fused->is_zero_preserving());
+    EXPECT_TRUE(fused->get_seed().sparse());
+
+    auto shifted = expected;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        for (size_t c = 0; c < cols.size(); ++c) {
+            shifted.values[r * cols.size() + c] += factors[r];
+        }
+    }
+    check(path, "dense", shifted);
+    for (bool by_column : { true, false }) {
+        check_sparse(*arr2, shifted, { 2, 1 }, { 3, 6 }, by_column);
+    }
+
+    expect_error([&]() -> void { chihaya::realize::extract_sparse(*arr, { 0, 0 }, { 7, 1 }, true); }, "out of range");
+}
+
+TEST_F(RealizeTest, Multiply) {
+    auto ref = simulate({ 30, 20 }, 15, 0.9);
+    std::vector<double> centers(20), scales(30);
+    for (size_t c = 0; c < centers.size(); ++c) {
+        centers[c] = c * 0.1 - 1;
+    }
+    for (size_t r = 0; r < scales.size(); ++r) {
+        scales[r] = 1 + r * 0.05;
+    }
+
+    auto add_scalar = [&](const H5::Group& parent, const std::string& name, const std::string& method, const std::string& side, const std::vector<double>& values, int along) -> H5::Group {
+        auto ghandle = operation_opener(parent, name, "unary arithmetic");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", method);
+        add_string_scalar(ghandle, "side", side);
+        H5::DataSet vhandle;
+        if (values.size() == 1) {
+            vhandle = add_numeric_scalar<double>(ghandle, "value", values.front(), H5::PredType::NATIVE_DOUBLE);
+        } else {
+            vhandle = add_numeric_vector<double>(ghandle, "value", values, H5::PredType::NATIVE_DOUBLE);
+            add_numeric_scalar(ghandle, "along", along, H5::PredType::NATIVE_UINT8);
+        }
+        add_string_attribute(vhandle, "type", "FLOAT");
+        return ghandle;
+    };
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        // (X - centers) / scales, i.e., centering and scaling.
+        for (bool csc : { true, false }) {
+            auto ghandle = add_scalar(fhandle, csc ? "scaled_csc" : "scaled_csr", "/", "right", scales, 0);
+            ghandle = add_scalar(ghandle, "seed", "-", "right", centers, 1);
+            add_sparse(ghandle, "seed", ref, csc);
+        }
+
+        // 2 * (10 - t(X)) + 1
+        {
+            auto ghandle = add_scalar(fhandle, "mixed", "+", "right", { 1 }, 0);
+            ghandle = add_scalar(ghandle, "seed", "*", "left", { 2 }, 0);
+            ghandle = add_scalar(ghandle, "seed", "-", "left", { 10 }, 0);
+            ghandle = operation_opener(ghandle, "seed", "transpose");
+            add_version_string(ghandle, 1100000);
+            add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+            add_sparse(ghandle, "seed", ref, true);
+        }
+
+        // log1p(X) - 1, where the log1p() cannot be decomposed.
+        {
+            auto ghandle = add_scalar(fhandle, "log", "-", "right", { 1 }, 0);
+            ghandle = operation_opener(ghandle, "seed", "unary math");
+            add_version_string(ghandle, 1100000);
+            add_string_scalar(ghandle, "method", "log1p");
+            add_dense(ghandle, "seed", ref);
+        }
+
+        add_sparse(fhandle, "plain", ref, false);
+    }
+
+    auto verify = [&](const std::string& name, bool affine, bool fuse) -> void {
+        chihaya::realize::Options opt;
+        opt.fuse_elementwise = fuse;
+        auto arr = chihaya::realize::load(path, name, opt);
+        size_t nr = arr->dimensions()[0], nc = arr->dimensions()[1];
+        std::vector<double> full(nr * nc);
+        chihaya::realize::extract(*arr, { 0, 0 }, { nr, nc }, full.data(), opt);
+
+        chihaya::realize::internal::AffinePlan plan;
+        EXPECT_EQ(chihaya::realize::internal::plan_affine(*arr, plan), affine);
+
+        for (bool transposed : { false, true }) {
+            size_t inner = (transposed ? nr : nc), outer = (transposed ? nc : nr);
+            size_t k = 3;
+            std::vector<double> rhs(inner * k);
+            for (size_t i = 0; i < rhs.size(); ++i) {
+                rhs[i] = std::sin(i * 0.7);
+            }
+
+            auto naive = [&](const std::vector<double>& x) -> std::vector<double> {
+                std::vector<double> expected(outer * k);
+                for (size_t r = 0; r < nr; ++r) {
+                    for (size_t c = 0; c < nc; ++c) {
+                        size_t from = (transposed ? r : c), to = (transposed ? c : r);
+                        for (size_t j = 0; j < k; ++j) {
+                            expected[to * k + j] += full[r * nc + c] * x[from * k + j];
+                        }
+                    }
+                }
+                return expected;
+            };
+            auto expected = naive(rhs);
+
+            for (size_t budget : { 100000000, 500 }) {
+                opt.memory_budget = budget;
+                std::vector<double> observed(outer * k);
+                chihaya::realize::multiply(*arr, transposed, rhs.data(), k, observed.data(), opt);
+                for (size_t i = 0; i < observed.size(); ++i) {
+                    compare(expected[i], observed[i]);
+                }
+            }
+
+            // Non-finite values in 'rhs' propagate through the structural zeros.
+            {
+                auto special = rhs;
+                special[0] = std::numeric_limits<double>::quiet_NaN();
+                special[k + 1] = std::numeric_limits<double>::infinity();
+                auto sexpected = naive(special);
+                std::vector<double> observed(outer * k);
+                chihaya::realize::multiply(*arr, transposed, special.data(), k, observed.data(), opt);
+                for (size_t i = 0; i < observed.size(); ++i) {
+                    if (std::isinf(sexpected[i])) {
+                        EXPECT_EQ(sexpected[i], observed[i]);
+                    } else {
+                        compare(sexpected[i], observed[i]);
+                    }
+                }
+            }
+
+            // Checking the vector overload.
+            std::vector<double> vec(inner), vexpected(outer);
+            for (size_t i = 0; i < inner; ++i) {
+                vec[i] = rhs[i * k];
+            }
+            for (size_t o = 0; o < outer; ++o) {
+                vexpected[o] = expected[o * k];
+            }
+            auto vobserved = chihaya::realize::multiply(*arr, transposed, vec, opt);
+            ASSERT_EQ(vobserved.size(), outer);
+            for (size_t o = 0; o < outer; ++o) {
+                compare(vexpected[o], vobserved[o]);
+            }
+        }
+    };
+
+    // Unfused chains are also decomposed.
+    for (bool fuse : { true, false }) {
+        verify("scaled_csc", true, fuse);
+        verify("scaled_csr", true, fuse);
+        verify("mixed", true, fuse);
+        verify("plain", true, fuse);
+        verify("log", false, fuse);
+    }
+
+    chihaya::realize::Options opt;
+    auto arr = chihaya::realize::load(path, "plain", opt);
+    expect_error([&]() -> void { chihaya::realize::multiply(*arr, false, std::vector<double>(5), opt); }, "common dimension");
+}
+
+TEST_F(RealizeTest, BinaryOperations) {
+    auto left = simulate({ 8, 9 }, 12), right = simulate({ 8, 9 }, 13, 0.5);
+    left.values[0] = chihaya::realize::missing_value();
+    right.values[1] = chihaya::realize::missing_value();
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        for (auto x : std::vector<std::pair<std::string, std::string> >{ { "arithmetic", "*" }, { "comparison", "<=" }, { "logic", "||" } }) {
+            auto ghandle = operation_opener(fhandle, x.first, "binary " + x.first);
+            add_version_string(ghandle, 1100000);
+            add_dense(ghandle, "left", left);
+            add_sparse(ghandle, "right", right, false);
+            add_string_scalar(ghandle, "method", x.second);
+        }
+    }
+
+    auto na = chihaya::realize::missing_value();
+    Reference arith = left, comp = left, logic = left;
+    for (size_t i = 0; i < left.values.size(); ++i) {
+        double l = left.values[i], r = right.values[i];
+        arith.values[i] = l * r;
+        comp.values[i] = (std::isnan(l) || std::isnan(r) ? na : (l <= r));
+        if ((!std::isnan(l) && l != 0) || (!std::isnan(r) && r != 0)) {
+            logic.values[i] = 1;
+        } else {
+            logic.values[i] = (std::isnan(l) || std::isnan(r) ? na : 0);
+        }
+    }
+
+    check(path, "arithmetic", arith);
+    check(path, "comparison", comp);
+    check(path, "logic", logic);
+    check(path, "logic", logic, 300);
+}
+
+TEST_F(RealizeTest, MatrixProduct) {
+    auto left = simulate({ 15, 12 }, 14), right = simulate({ 9, 12 }, 15);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "prod", "matrix product");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "left_seed", left);
+        add_string_scalar(ghandle, "left_orientation", "N");
+        add_dense(ghandle, "right_seed", right);
+        add_string_scalar(ghandle, "right_orientation", "T");
+    }
+
+    Reference expected;
+    expected.dims = { 15, 9 };
+    for (size_t i = 0; i < 15; ++i) {
+        for (size_t j = 0; j < 9; ++j) {
+            double sum = 0;
+            for (size_t k = 0; k < 12; ++k) {
+                sum += left.values[i * 12 + k] * right.values[j * 12 + k];
+            }
+            expected.values.push_back(sum);
+        }
+    }
+
+    check(path, "prod", expected);
+    check(path, "prod", expected, 200); // forcing multiple chunks of the common dimension.
+}
+
+TEST_F(RealizeTest, MatrixProductKernels) {
+    size_t nr = 120, nc = 100, nk = 40;
+    auto left = simulate({ nr, nk }, 17, 0.7), right = simulate({ nk, nc }, 18, 0.7);
+
+    auto transpose = [](const Reference& ref) -> Reference {
+        Reference output;
+        output.dims = { ref.dims[1], ref.dims[0] };
+        output.values.resize(ref.values.size());
+        for (size_t i = 0; i < ref.dims[0]; ++i) {
+            for (size_t j = 0; j < ref.dims[1]; ++j) {
+                output.values[j * ref.dims[0] + i] = ref.values[i * ref.dims[1] + j];
+            }
+        }
+        return output;
+    };
+
+    auto add_seed = [&](const H5::Group& parent, const std::string& name, const Reference& ref, const std::string& kind) -> void {
+        if (kind == "dense") {
+            add_dense(parent, name, ref);
+        } else {
+            add_sparse(parent, name, ref, kind == "csc");
+        }
+    };
+
+    std::vector<std::string> names;
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        for (std::string lkind : { "dense", "csc", "csr" }) {
+            for (bool ltrans : { false, true }) {
+                for (std::string rkind : { "dense", "csc", "csr" }) {
+                    for (bool rtrans : { false, true }) {
+                        std::string name = lkind + (ltrans ? "T" : "N") + "_" + rkind + (rtrans ? "T" : "N");
+                        auto ghandle = operation_opener(fhandle, name, "matrix product");
+                        add_version_string(ghandle, 1100000);
+                        add_seed(ghandle, "left_seed", (ltrans ? transpose(left) : left), lkind);
+                        add_string_scalar(ghandle, "left_orientation", ltrans ? "T" : "N");
+                        add_seed(ghandle, "right_seed", (rtrans ? transpose(right) : right), rkind);
+                        add_string_scalar(ghandle, "right_orientation", rtrans ? "T" : "N");
+                        names.push_back(name);
+                    }
+                }
+            }
+        }
+    }
+
+    Reference expected;
+    expected.dims = { nr, nc };
+    expected.values.resize(nr * nc);
+    for (size_t i = 0; i < nr; ++i) {
+        for (size_t k = 0; k < nk; ++k) {
+            for (size_t j = 0; j < nc; ++j) {
+                expected.values[i * nc + j] += left.values[i * nk + k] * right.values[k * nc + j];
+            }
+        }
+    }
+
+    for (const auto& name : names) {
+        SCOPED_TRACE(name);
+        check(path, name, expected, 20000); // forcing multiple chunks of the common dimension.
+
+        for (int threads : { 1, 3 }) {
+            chihaya::realize::Options opt;
+            opt.num_threads = threads;
+            auto arr = chihaya::realize::load(path, name, opt);
+            std::vector<double> full(nr * nc);
+            chihaya::realize::extract(*arr, { 0, 0 }, { nr, nc }, full.data(), opt);
+            for (size_t i = 0; i < full.size(); ++i) {
+                compare(expected.values[i], full[i]);
+            }
+        }
+    }
+}
+
+TEST_F(RealizeTest, MatrixProductNonFinite) {
+    // Structural zeros in one seed meet NaN or infinity in the other, which should give the same results as a dense product.
+    double inf = std::numeric_limits<double>::infinity(), nan = std::numeric_limits<double>::quiet_NaN();
+    Reference zeroes, special;
+    zeroes.dims = { 2, 2 };
+    zeroes.values = { 1, 0, 0, 0 };
+    special.dims = { 2, 2 };
+    special.values = { 2, inf, nan, 1 };
+
+    auto naive = [](const Reference& left, const Reference& right) -> Reference {
+        Reference output;
+        output.dims = { 2, 2 };
+        output.values.resize(4);
+        for (size_t i = 0; i < 2; ++i) {
+            for (size_t j = 0; j < 2; ++j) {
+                for (size_t k = 0; k < 2; ++k) {
+                    output.values[i * 2 + j] += left.values[i * 2 + k] * right.values[k * 2 + j];
+                }
+            }
+        }
+        return output;
+    };
+
+    for (bool zeroes_left : { true, false }) {
+        const auto& left = (zeroes_left ? zeroes : special);
+        const auto& right = (zeroes_left ? special : zeroes);
+        auto expected = naive(left, right);
+
+        for (std::string kind : { "dense", "csc", "csr" }) {
+            SCOPED_TRACE(kind + (zeroes_left ? " on the left" : " on the right"));
+            {
+                H5::H5File fhandle(path, H5F_ACC_TRUNC);
+                auto ghandle = operation_opener(fhandle, "prod", "matrix product");
+                add_version_string(ghandle, 1100000);
+                const auto& sparse_seed = (zeroes_left ? "left_seed" : "right_seed");
+                const auto& dense_seed = (zeroes_left ? "right_seed" : "left_seed");
+                if (kind == "dense") {
+                    add_dense(ghandle, sparse_seed, zeroes);
+                } else {
+                    add_sparse(ghandle, sparse_seed, zeroes, kind == "csc");
+                }
+                add_dense(ghandle, dense_seed, special);
+                add_string_scalar(ghandle, "left_orientation", "N");
+                add_string_scalar(ghandle, "right_orientation", "N");
+            }
+
+            chihaya::realize::Options opt;
+            auto arr = chihaya::realize::load(path, "prod", opt);
+            EXPECT_EQ(arr->details().type, chihaya::FLOAT);
+            std::vector<double> full(4);
+            chihaya::realize::extract(*arr, { 0, 0 }, { 2, 2 }, full.data(), opt);
+            for (size_t i = 0; i < 4; ++i) {
+                if (std::isinf(expected.values[i])) {
+                    EXPECT_EQ(expected.values[i], full[i]);
+                } else {
+                    compare(expected.values[i], full[i]);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(RealizeTest, SubsetRewrite) {
+    auto ref = simulate({ 10, 8 }, 70, 0.3), other = simulate({ 10, 8 }, 71);
+    std::vector<double> sf{ 1, 2, 3, 4, 5, 6, 7, 8 };
+    std::vector<int> rows{ 9, 2, 2, 5 }, cols{ 0, 7, 3 }, outer_cols{ 2, 0 };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        // subset(log1p(x / sf)).
+        auto ghandle = operation_opener(fhandle, "pushdown", "subset");
+        add_version_string(ghandle, 1100000);
+        add_index_list(ghandle, "index", { rows, cols }, 2);
+        auto mhandle = operation_opener(ghandle, "seed", "unary math");
+        add_version_string(mhandle, 1100000);
+        add_string_scalar(mhandle, "method", "log1p");
+        auto ahandle = operation_opener(mhandle, "seed", "unary arithmetic");
+        add_version_string(ahandle, 1100000);
+        add_sparse(ahandle, "seed", ref, true);
+        add_string_scalar(ahandle, "method", "/");
+        add_string_scalar(ahandle, "side", "right");
+        auto vhandle = add_numeric_vector<double>(ahandle, "value", sf, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(ahandle, "along", 1, H5::PredType::NATIVE_UINT8);
+
+        // subset(subset(x + y)).
+        auto ghandle2 = operation_opener(fhandle, "nested", "subset");
+        add_version_string(ghandle2, 1100000);
+        add_index_list(ghandle2, "index", { {}, outer_cols }, 2);
+        auto shandle = operation_opener(ghandle2, "seed", "subset");
+        add_version_string(shandle, 1100000);
+        add_index_list(shandle, "index", { rows, cols }, 2);
+        auto bhandle = operation_opener(shandle, "seed", "binary arithmetic");
+        add_version_string(bhandle, 1100000);
+        add_dense(bhandle, "left", ref);
+        add_dense(bhandle, "right", other);
+        add_string_scalar(bhandle, "method", "+");
+    }
+
+    Reference pushdown, nested;
+    pushdown.dims = { 4, 3 };
+    for (auto r : rows) {
+        for (auto c : cols) {
+            pushdown.values.push_back(std::log1p(ref.values[r * 8 + c] / sf[c]));
+        }
+    }
+    nested.dims = { 4, 2 };
+    for (auto r : rows) {
+        for (auto oc : outer_cols) {
+            auto c = cols[oc];
+            nested.values.push_back(ref.values[r * 8 + c] + other.values[r * 8 + c]);
+        }
+    }
+
+    for (int rewrite = 0; rewrite < 2; ++rewrite) {
+        for (int fuse = 0; fuse < 2; ++fuse) {
+            chihaya::realize::Options opt;
+            opt.rewrite_subsets = rewrite;
+            opt.fuse_elementwise = fuse;
+
+            auto arr = chihaya::realize::load(path, "pushdown", opt);
+            std::vector<double> buffer(12);
+            chihaya::realize::extract(*arr, { 0, 0 }, { 4, 3 }, buffer.data(), opt);
+            for (size_t i = 0; i < 12; ++i) {
+                compare(pushdown.values[i], buffer[i]);
+            }
+
+            auto arr2 = chihaya::realize::load(path, "nested", opt);
+            std::vector<double> buffer2(8);
+            chihaya::realize::extract(*arr2, { 0, 0 }, { 4, 2 }, buffer2.data(), opt);
+            EXPECT_EQ(buffer2, nested.values);
+
+            if (rewrite) {
+                // Subsets are applied directly to the leaves.
+                if (fuse) {
+                    auto fused = dynamic_cast<const chihaya::realize::FusedOperation*>(arr.get());
+                    ASSERT_TRUE(fused != NULL);
+                    EXPECT_TRUE(dynamic_cast<const chihaya::realize::Subset*>(&(fused->get_seed())) != NULL);
+                    EXPECT_EQ(fused->get_steps().size(), 2);
+                    EXPECT_EQ(fused->get_steps()[0].values, std::vector<double>({ 1, 8, 4 }));
+                    EXPECT_TRUE(arr->sparse());
+                } else {
+                    EXPECT_TRUE(dynamic_cast<const chihaya::realize::UnaryOperation*>(arr.get()) != NULL);
+                }
+                EXPECT_TRUE(dynamic_cast<const chihaya::realize::BinaryOperation*>(arr2.get()) != NULL);
+
+                // Consecutive subsets are composed, so each leaf is read once for the composed indices.
+                auto regions = chihaya::realize::regions(*arr2, { 0, 0 }, { 4, 2 });
+                ASSERT_EQ(regions.size(), 2);
+                for (const auto& reg : regions) {
+                    EXPECT_EQ(reg.start, std::vector<size_t>({ 2, 0 }));
+                    EXPECT_EQ(reg.count, std::vector<size_t>({ 8, 4 }));
+                }
+            } else {
+                EXPECT_TRUE(dynamic_cast<const chihaya::realize::Subset*>(arr.get()) != NULL);
+                EXPECT_TRUE(dynamic_cast<const chihaya::realize::Subset*>(arr2.get()) != NULL);
+            }
+        }
+    }
+}
+
+TEST_F(RealizeTest, TransposeRewrite) {
+    auto ref = simulate({ 70, 90 }, 80), ref3 = simulate({ 40, 6, 50 }, 81);
+    std::vector<double> shift(90);
+    std::iota(shift.begin(), shift.end(), 0);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        // Inverse pair of transpositions.
+        auto ghandle = operation_opener(fhandle, "cancel", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+        auto thandle = operation_opener(ghandle, "seed", "transpose");
+        add_version_string(thandle, 1100000);
+        add_numeric_vector<int>(thandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+        add_dense(thandle, "seed", ref);
+
+        // Transposition of a non-native dense array, below an elementwise operation.
+        auto ghandle2 = operation_opener(fhandle, "fold", "transpose");
+        add_version_string(ghandle2, 1100000);
+        add_numeric_vector<int>(ghandle2, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+        auto ahandle = operation_opener(ghandle2, "seed", "unary arithmetic");
+        add_version_string(ahandle, 1100000);
+        add_dense(ahandle, "seed", ref, false);
+        add_string_scalar(ahandle, "method", "-");
+        add_string_scalar(ahandle, "side", "right");
+        auto vhandle = add_numeric_vector<double>(ahandle, "value", shift, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(ahandle, "along", 1, H5::PredType::NATIVE_UINT8);
+
+        // Transposition that cannot be absorbed by its seed.
+        auto ghandle3 = operation_opener(fhandle, "physical", "transpose");
+        add_version_string(ghandle3, 1100000);
+        add_numeric_vector<int>(ghandle3, "permutation", { 2, 0, 1 }, H5::PredType::NATIVE_UINT32);
+        auto chandle = operation_opener(ghandle3, "seed", "combine");
+        add_version_string(chandle, 1100000);
+        add_numeric_scalar(chandle, "along", 0, H5::PredType::NATIVE_UINT8);
+        auto shandle = list_opener(chandle, "seeds", 1, 1100000);
+        add_dense(shandle, "0", ref3);
+    }
+
+    Reference fold;
+    fold.dims = { 90, 70 };
+    for (size_t c = 0; c < 90; ++c) {
+        for (size_t r = 0; r < 70; ++r) {
+            fold.values.push_back(ref.values[r * 90 + c] - shift[c]);
+        }
+    }
+
+    Reference physical;
+    physical.dims = { 50, 40, 6 };
+    loop(physical.dims, [&](const std::vector<size_t>& pos, size_t) -> void {
+        physical.values.push_back(ref3.values[pos[1] * 300 + pos[2] * 50 + pos[0]]);
+    });
+
+    check(path, "cancel", ref);
+    check(path, "fold", fold);
+    check(path, "fold", fold, 1000);
+    check(path, "physical", physical);
+    check(path, "physical", physical, 1000);
+
+    for (int rewrite = 0; rewrite < 2; ++rewrite) {
+        chihaya::realize::Options opt;
+        opt.rewrite_transpositions = rewrite;
+
+        auto arr = chihaya::realize::load(path, "cancel", opt);
+        auto arr2 = chihaya::realize::load(path, "fold", opt);
+        auto arr3 = chihaya::realize::load(path, "physical", opt);
+        EXPECT_TRUE(dynamic_cast<const chihaya::realize::Transpose*>(arr3.get()) != NULL);
+
+        std::vector<double> buffer(fold.values.size());
+        chihaya::realize::extract(*arr2, { 0, 0 }, fold.dims, buffer.data(), opt);
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            compare(fold.values[i], buffer[i]);
+        }
+
+        if (rewrite) {
+            auto dense = dynamic_cast<const chihaya::realize::DenseArray*>(arr.get());
+            ASSERT_TRUE(dense != NULL);
+            EXPECT_EQ(dense->get_layout(), std::vector<size_t>({ 0, 1 }));
+            EXPECT_EQ(arr->workspace(), 0);
+
+            // The transposition cancels out the non-native layout, so no rearrangement is required.
+            auto fused = dynamic_cast<const chihaya::realize::FusedOperation*>(arr2.get());
+            ASSERT_TRUE(fused != NULL);
+            EXPECT_EQ(fused->get_steps().front().along, 0);
+            auto dense2 = dynamic_cast<const chihaya::realize::DenseArray*>(&(fused->get_seed()));
+            ASSERT_TRUE(dense2 != NULL);
+            EXPECT_EQ(dense2->get_layout(), std::vector<size_t>({ 0, 1 }));
+            EXPECT_EQ(arr2->workspace(), 0);
+        } else {
+            EXPECT_TRUE(dynamic_cast<const chihaya::realize::Transpose*>(arr.get()) != NULL);
+            EXPECT_TRUE(dynamic_cast<const chihaya::realize::Transpose*>(arr2.get()) != NULL);
+        }
+    }
+}
+
+TEST_F(RealizeTest, Regions) {
+    auto first = simulate({ 100, 40 }, 60), second = simulate({ 100, 60 }, 61);
+    auto value = simulate({ 3, 7 }, 62);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        // Subset of a unary operation on the transpose of a combined array.
+        auto ghandle = operation_opener(fhandle, "sub", "subset");
+        add_version_string(ghandle, 1100000);
+        add_index_list(ghandle, "index", { { 5, 6, 7, 70 }, {} }, 2);
+
+        auto uhandle = operation_opener(ghandle, "seed", "unary arithmetic");
+        add_version_string(uhandle, 1100000);
+        add_string_scalar(uhandle, "method", "-");
+        add_string_scalar(uhandle, "side", "none");
+
+        auto thandle = operation_opener(uhandle, "seed", "transpose");
+        add_version_string(thandle, 1100000);
+        add_numeric_vector<int>(thandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto chandle = operation_opener(thandle, "seed", "combine");
+        add_version_string(chandle, 1100000);
+        add_numeric_scalar(chandle, "along", 1, H5::PredType::NATIVE_UINT8);
+        auto shandle = list_opener(chandle, "seeds", 2, 1100000);
+        add_dense(shandle, "0", first);
+        add_dense(shandle, "1", second);
+
+        auto ghandle2 = operation_opener(fhandle, "assign", "subset assignment");
+        add_version_string(ghandle2, 1100000);
+        add_dense(ghandle2, "seed", simulate({ 10, 7 }, 63));
+        add_dense(ghandle2, "value", value);
+        add_index_list(ghandle2, "index", { { 8, 2, 8 }, {} }, 2);
+    }
+
+    chihaya::realize::Options opt;
+    {
+        auto arr = chihaya::realize::load(path, "sub", opt);
+        auto regions = chihaya::realize::regions(*arr, { 0, 10 }, { 4, 10 });
+        ASSERT_EQ(regions.size(), 2);
+        EXPECT_EQ(regions[0].leaf->dimensions(), std::vector<size_t>({ 100, 40 }));
+        EXPECT_EQ(regions[0].start, std::vector<size_t>({ 10, 5 }));
+        EXPECT_EQ(regions[0].count, std::vector<size_t>({ 10, 3 }));
+        EXPECT_EQ(regions[1].leaf->dimensions(), std::vector<size_t>({ 100, 60 }));
+        EXPECT_EQ(regions[1].start, std::vector<size_t>({ 10, 30 }));
+        EXPECT_EQ(regions[1].count, std::vector<size_t>({ 10, 1 }));
+
+        std::vector<double> buffer(40);
+        chihaya::realize::extract(*arr, { 0, 10 }, { 4, 10 }, buffer.data(), opt);
+        for (size_t r = 0; r < 4; ++r) {
+            for (size_t c = 0; c < 10; ++c) {
+                double expected = (r < 3 ? first.values[(10 + c) * 40 + 5 + r] : second.values[(10 + c) * 60 + 30]);
+                EXPECT_EQ(buffer[r * 10 + c], -expected);
+            }
+        }
+
+        EXPECT_ANY_THROW(chihaya::realize::regions(*arr, { 0, 10 }, { 5, 10 }));
+    }
+
+    {
+        auto arr = chihaya::realize::load(path, "assign", opt);
+
+        // Seed is not read if the block is fully assigned.
+        auto regions = chihaya::realize::regions(*arr, { 8, 2 }, { 1, 3 });
+        ASSERT_EQ(regions.size(), 1);
+        EXPECT_EQ(regions[0].leaf->dimensions(), std::vector<size_t>({ 3, 7 }));
+        EXPECT_EQ(regions[0].start, std::vector<size_t>({ 2, 2 }));
+        EXPECT_EQ(regions[0].count, std::vector<size_t>({ 1, 3 }));
+
+        std::vector<double> buffer(3);
+        chihaya::realize::extract(*arr, { 8, 2 }, { 1, 3 }, buffer.data(), opt);
+        EXPECT_EQ(buffer, std::vector<double>(value.values.begin() + 16, value.values.begin() + 19));
+
+        regions = chihaya::realize::regions(*arr, { 0, 0 }, { 4, 7 });
+        ASSERT_EQ(regions.size(), 2);
+        EXPECT_EQ(regions[0].leaf->dimensions(), std::vector<size_t>({ 10, 7 }));
+        EXPECT_EQ(regions[0].count, std::vector<size_t>({ 4, 7 }));
+        EXPECT_EQ(regions[1].start, std::vector<size_t>({ 1, 0 }));
+        EXPECT_EQ(regions[1].count, std::vector<size_t>({ 1, 7 }));
+
+        // Only the seed is read if nothing in the block is assigned.
+        regions = chihaya::realize::regions(*arr, { 0, 0 }, { 2, 7 });
+        ASSERT_EQ(regions.size(), 1);
+        EXPECT_EQ(regions[0].leaf->dimensions(), std::vector<size_t>({ 10, 7 }));
+    }
+}
+
+TEST_F(RealizeTest, ForEachBlock) {
+    auto ref = simulate({ 20, 30 }, 16);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_dense(fhandle, "dense", ref);
+    }
+
+    chihaya::realize::Options opt;
+    opt.memory_budget = 1000;
+    auto arr = chihaya::realize::load(path, "dense", opt);
+
+    std::vector<double> collected;
+    size_t num_blocks = 0;
+    chihaya::realize::for_each_block(*arr, opt, [&](const std::vector<size_t>& start, const std::vector<size_t>& count, const double* ptr) -> void {
+        EXPECT_EQ(start[0] * 30 + start[1], collected.size());
+        size_t n = count[0] * count[1];
+        EXPECT_LE(n * sizeof(double), opt.memory_budget);
+        collected.insert(collected.end(), ptr, ptr + n);
+        ++num_blocks;
+    });
+
+    EXPECT_EQ(collected, ref.values);
+    EXPECT_GT(num_blocks, 1);
+}
+
+TEST_F(RealizeTest, Errors) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        mock_array_opener(fhandle, "mock", { 5, 4 }, 1100000, "FLOAT");
+
+        auto ghandle = operation_opener(fhandle, "bad", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", simulate({ 4, 3 }, 17));
+        add_numeric_vector<int>(ghandle, "permutation", { 0, 0 }, H5::PredType::NATIVE_UINT32);
+    }
+
+    chihaya::realize::Options opt;
+    expect_error([&]() { chihaya::realize::load(path, "mock", opt); }, "no function available");
+    expect_error([&]() { chihaya::realize::load(path, "bad", opt); }, "permutation");
+
+    // Custom arrays can be realized via the registry.
+    opt.array_registry["custom mock"] = [](const H5::Group&, const ritsuko::Version&, chihaya::realize::Options&) -> std::unique_ptr<chihaya::realize::Array> {
+        struct Mock : public chihaya::realize::Array {
+            Mock() : chihaya::realize::Array(chihaya::ArrayDetails(chihaya::FLOAT, { 5, 4 })) {}
+            void extract(const std::vector<size_t>&, const std::vector<size_t>& count, double* buffer) const {
+                std::fill_n(buffer, count[0] * count[1], 1.5);
+            }
+        };
+        return std::unique_ptr<chihaya::realize::Array>(new Mock);
+    };
+
+    Reference expected;
+    expected.dims = { 5, 4 };
+    expected.values.resize(20, 1.5);
+    auto arr = chihaya::realize::load(path, "mock", opt);
+    std::vector<double> buffer(20);
+    chihaya::realize::extract(*arr, { 0, 0 }, { 5, 4 }, buffer.data(), opt);
+    EXPECT_EQ(buffer, expected.values);
+}
@@ -337,6 +337,42 @@ TEST_P(SparseMatrixTest, ComplexIndexErrors) {
     expect_error(path, "foobar", "strictly increasing");
 }
 
+TEST_P(SparseMatrixTest, Buffered) {
+    auto version = GetParam();
+    chihaya::Options opt;
+    opt.buffer_size = 3;
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        sparse_matrix_opener(fhandle, version);
+    }
+    auto output = chihaya::validate(path, "foobar", opt);
+    EXPECT_EQ(output.dimensions[0], nr);
+    EXPECT_EQ(output.dimensions[1], nc);
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto ghandle = fhandle.openGroup("foobar");
+        ghandle.unlink("indices");
+        auto copy = indices;
+        copy[8] = nr; // in the last window.
+        add_numeric_vector<int>(ghandle, "indices", copy, H5::PredType::NATIVE_UINT16);
+    }
+    expect_error([&]() { chihaya::validate(path, "foobar", opt); }, "number of rows");
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto ghandle = fhandle.openGroup("foobar");
+        ghandle.unlink("indices");
+        add_numeric_vector<int>(ghandle, "indices", indices, H5::PredType::NATIVE_UINT16);
+        ghandle.unlink("indptr");
+        auto copy = indptr;
+        copy[1] = data.size() + 10; // exceeds the number of non-zero elements in the first window.
+        add_numeric_vector<int>(ghandle, "indptr", copy, H5::PredType::NATIVE_UINT16);
+    }
+    expect_error([&]() { chihaya::validate(path, "foobar", opt); }, "sorted");
+}
+
 TEST_P(SparseMatrixTest, MissingErrors) {
     auto version = GetParam();
 
@@ -365,6 +401,120 @@ TEST_P(SparseMatrixTest, MissingErrors) {
     }
 }
 
+TEST(SparseMatrix, Parallel) {
+    const std::string path = "Test_sparse_matrix.h5";
+    int nr = 1000, nc = 3000, per_column = 500;
+
+    std::vector<int> indices, indptr{ 0 };
+    for (int c = 0; c < nc; ++c) {
+        for (int i = 0; i < per_column; ++i) {
+            indices.push_back(i * 2 + (c % 2));
+        }
+        indptr.push_back(indices.size());
+    }
+
+    auto create = [&](const std::vector<int>& idx) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = array_opener(fhandle, "foobar", "sparse matrix");
+        add_version_string(ghandle, 1100000);
+
+        std::vector<double> data(idx.size());
+        auto dhandle = add_numeric_vector(ghandle, "data", data, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { nr, nc }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indices", idx, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indptr", indptr, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(ghandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+    };
+
+    chihaya::Options opt;
+    opt.num_threads = 3;
+
+    create(indices);
+    auto output = chihaya::validate(path, "foobar", opt);
+    EXPECT_EQ(output.dimensions[0], nr);
+    EXPECT_EQ(output.dimensions[1], nc);
+
+    // The earliest error is always reported, regardless of which thread finds it.
+    {
+        auto copy = indices;
+        copy[indptr[2500] + 10] = nr; 
+        copy[indptr[2900] + 10] = 0;
+        create(copy);
+    }
+    expect_error([&]() { chihaya::validate(path, "foobar", opt); }, "number of rows");
+
+    {
+        auto copy = indices;
+        copy[indptr[100] + 10] = 0;
+        copy[indptr[2900] + 10] = nr; 
+        create(copy);
+    }
+    expect_error([&]() { chihaya::validate(path, "foobar", opt); }, "strictly increasing");
+}
+
+TEST(SparseMatrix, Compressed) {
+    const std::string path = "Test_sparse_matrix.h5";
+    int nr = 1000, nc = 200, per_column = 300;
+
+    std::vector<int> indices, indptr{ 0 };
+    for (int c = 0; c < nc; ++c) {
+        for (int i = 0; i < per_column; ++i) {
+            indices.push_back(i * 3 + (c % 3));
+        }
+        indptr.push_back(indices.size());
+    }
+
+    auto create = [&](const std::vector<int>& idx) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = array_opener(fhandle, "foobar", "sparse matrix");
+        add_version_string(ghandle, 1100000);
+
+        std::vector<double> data(idx.size());
+        auto dhandle = add_numeric_vector(ghandle, "data", data, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { nr, nc }, H5::PredType::NATIVE_UINT32);
+        add_numeric_scalar(ghandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+
+        H5::DSetCreatPropList cplist;
+        hsize_t chunk = 1000;
+        cplist.setChunk(1, &chunk);
+        cplist.setShuffle();
+        cplist.setDeflate(6);
+        hsize_t n = idx.size();
+        H5::DataSpace ispace(1, &n);
+        ghandle.createDataSet("indices", H5::PredType::NATIVE_UINT16, ispace, cplist).write(idx.data(), H5::PredType::NATIVE_INT);
+        chunk = 50;
+        cplist.setChunk(1, &chunk);
+        n = indptr.size();
+        H5::DataSpace pspace(1, &n);
+        ghandle.createDataSet("indptr", H5::PredType::NATIVE_UINT64, pspace, cplist).write(indptr.data(), H5::PredType::NATIVE_INT);
+    };
+
+    // Same results with and without direct chunk reads.
+    for (bool direct : { false, true }) {
+        for (int threads : { 1, 4 }) {
+            chihaya::Options opt;
+            opt.num_threads = threads;
+            opt.buffer_size = 5000;
+            opt.direct_chunks = direct;
+
+            create(indices);
+            auto output = chihaya::validate(path, "foobar", opt);
+            EXPECT_EQ(output.dimensions[0], nr);
+            EXPECT_EQ(output.dimensions[1], nc);
+
+            {
+                auto copy = indices;
+                copy[indptr[50] + 10] = 0;
+                copy[indptr[150] + 10] = nr;
+                create(copy);
+            }
+            expect_error([&]() { chihaya::validate(path, "foobar", opt); }, "strictly increasing");
+        }
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     SparseMatrix,
     SparseMatrixTest,
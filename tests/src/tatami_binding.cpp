@@ -0,0 +1,340 @@
+#include <gtest/gtest.h>
+#include "chihaya/chihaya.hpp"
+#include "chihaya/tatami_binding.hpp"
+#include "utils.h"
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+
+class TatamiBindingTest : public ::testing::Test {
+protected:
+    std::string path = "Test_tatami_binding.h5";
+
+    static std::vector<double> simulate(size_t n, int offset) {
+        std::vector<double> output(n);
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = ((i * 7 + offset) % 11 == 0 ? 0 : static_cast<double>((i * 13 + offset) % 17) - 8);
+        }
+        return output;
+    }
+
+    static void add_dense(const H5::Group& parent, const std::string& name, size_t nr, size_t nc, int offset, bool native = true) {
+        auto ghandle = array_opener(parent, name, "dense array");
+        add_version_string(ghandle, 1100000);
+        std::vector<hsize_t> dims{ nr, nc };
+        if (!native) {
+            std::swap(dims[0], dims[1]);
+        }
+        H5::DataSpace dspace(2, dims.data());
+        auto dhandle = ghandle.createDataSet("data", H5::PredType::NATIVE_DOUBLE, dspace);
+        auto values = simulate(nr * nc, offset);
+        dhandle.write(values.data(), H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_scalar<int>(ghandle, "native", native, H5::PredType::NATIVE_INT8);
+    }
+
+    static H5::DataSet add_dense(const H5::Group& parent, const std::string& name, size_t nr, size_t nc, const std::vector<double>& values) {
+        auto ghandle = array_opener(parent, name, "dense array");
+        add_version_string(ghandle, 1100000);
+        std::vector<hsize_t> dims{ nr, nc };
+        H5::DataSpace dspace(2, dims.data());
+        auto dhandle = ghandle.createDataSet("data", H5::PredType::NATIVE_DOUBLE, dspace);
+        dhandle.write(values.data(), H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_scalar<int>(ghandle, "native", 1, H5::PredType::NATIVE_INT8);
+        return dhandle;
+    }
+
+    static H5::DataSet add_sparse(const H5::Group& parent, const std::string& name, size_t nr, size_t nc, const std::vector<double>& values, bool csc) {
+        auto ghandle = array_opener(parent, name, "sparse matrix");
+        add_version_string(ghandle, 1100000);
+
+        size_t primary = (csc ? nc : nr), secondary = (csc ? nr : nc);
+        std::vector<double> data;
+        std::vector<int> indices, indptr(1);
+        for (size_t p = 0; p < primary; ++p) {
+            for (size_t s = 0; s < secondary; ++s) {
+                double v = (csc ? values[s * nc + p] : values[p * nc + s]);
+                if (v != 0) {
+                    data.push_back(v);
+                    indices.push_back(s);
+                }
+            }
+            indptr.push_back(data.size());
+        }
+
+        auto dhandle = add_numeric_vector(ghandle, "data", data, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { static_cast<int>(nr), static_cast<int>(nc) }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indices", indices, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector(ghandle, "indptr", indptr, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(ghandle, "by_column", static_cast<int>(csc), H5::PredType::NATIVE_INT8);
+        return dhandle;
+    }
+
+    static H5::Group add_unary(const H5::Group& parent, const std::string& name, const std::string& operation, const std::string& method, const std::vector<double>& seed) {
+        auto ghandle = operation_opener(parent, name, operation);
+        add_version_string(ghandle, 1100000);
+        add_dense(ghandle, "seed", 2, 3, seed);
+        add_string_scalar(ghandle, "method", method);
+        return ghandle;
+    }
+
+    static void add_unary_value(const H5::Group& handle, const std::string& side, const std::vector<double>& value, int along = 0) {
+        add_string_scalar(handle, "side", side);
+        H5::DataSet vhandle;
+        if (value.size() == 1) {
+            vhandle = add_numeric_scalar<double>(handle, "value", value.front(), H5::PredType::NATIVE_DOUBLE);
+        } else {
+            vhandle = add_numeric_vector<double>(handle, "value", value, H5::PredType::NATIVE_DOUBLE);
+            add_numeric_scalar(handle, "along", along, H5::PredType::NATIVE_UINT8);
+        }
+        add_string_attribute(vhandle, "type", "FLOAT");
+    }
+
+    static void expect_same(double expected, double observed) {
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(observed));
+        } else {
+            EXPECT_DOUBLE_EQ(expected, observed);
+        }
+    }
+
+    // Compares every row and column of the tatami matrix to the row-major 'expected' values.
+    void check(const std::string& name, size_t nr, size_t nc, const std::vector<double>& expected) {
+        chihaya::tatami_binding::Options topt;
+        auto mat = chihaya::tatami_binding::load(path, name, topt);
+        ASSERT_EQ(mat->nrow(), static_cast<int>(nr));
+        ASSERT_EQ(mat->ncol(), static_cast<int>(nc));
+
+        auto rext = mat->dense_row();
+        std::vector<double> rbuffer(nc);
+        for (size_t r = 0; r < nr; ++r) {
+            auto ptr = rext->fetch(r, rbuffer.data());
+            for (size_t c = 0; c < nc; ++c) {
+                expect_same(expected[r * nc + c], ptr[c]);
+            }
+        }
+
+        auto cext = mat->dense_column();
+        std::vector<double> cbuffer(nr);
+        for (size_t c = 0; c < nc; ++c) {
+            auto ptr = cext->fetch(c, cbuffer.data());
+            for (size_t r = 0; r < nr; ++r) {
+                expect_same(expected[r * nc + c], ptr[r]);
+            }
+        }
+    }
+
+    // Compares every row of the tatami matrix to the realized array.
+    void compare(const std::string& name) {
+        chihaya::realize::Options ropt;
+        auto arr = chihaya::realize::load(path, name, ropt);
+        size_t nr = arr->dimensions()[0], nc = arr->dimensions()[1];
+        std::vector<double> expected(nr * nc);
+        chihaya::realize::extract(*arr, { 0, 0 }, { nr, nc }, expected.data(), ropt);
+
+        chihaya::tatami_binding::Options topt;
+        auto mat = chihaya::tatami_binding::load(path, name, topt);
+        ASSERT_EQ(mat->nrow(), static_cast<int>(nr));
+        ASSERT_EQ(mat->ncol(), static_cast<int>(nc));
+
+        auto ext = mat->dense_row();
+        std::vector<double> buffer(nc);
+        for (size_t r = 0; r < nr; ++r) {
+            auto ptr = ext->fetch(r, buffer.data());
+            for (size_t c = 0; c < nc; ++c) {
+                expect_same(expected[r * nc + c], ptr[c]);
+            }
+        }
+    }
+};
+
+TEST_F(TatamiBindingTest, Arrays) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_dense(fhandle, "native", 10, 7, 0);
+        add_dense(fhandle, "transposed", 10, 7, 1, false);
+    }
+    compare("native");
+    compare("transposed");
+}
+
+TEST_F(TatamiBindingTest, Operations) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        auto shandle = operation_opener(fhandle, "subset", "subset");
+        add_version_string(shandle, 1100000);
+        add_dense(shandle, "seed", 10, 7, 2);
+        auto lhandle = list_opener(shandle, "index", 2, 1100000);
+        add_numeric_vector<int>(lhandle, "0", { 5, 1, 1, 9 }, H5::PredType::NATIVE_UINT32);
+
+        auto chandle = operation_opener(fhandle, "combine", "combine");
+        add_version_string(chandle, 1100000);
+        add_numeric_scalar(chandle, "along", 1, H5::PredType::NATIVE_UINT8);
+        auto slist = list_opener(chandle, "seeds", 2, 1100000);
+        add_dense(slist, "0", 6, 3, 3);
+        add_dense(slist, "1", 6, 5, 4);
+
+        auto thandle = operation_opener(fhandle, "transpose", "transpose");
+        add_version_string(thandle, 1100000);
+        add_dense(thandle, "seed", 4, 9, 5);
+        add_numeric_vector<int>(thandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto ahandle = operation_opener(fhandle, "arith", "unary arithmetic");
+        add_version_string(ahandle, 1100000);
+        add_dense(ahandle, "seed", 5, 6, 6);
+        add_string_scalar(ahandle, "method", "/");
+        add_string_scalar(ahandle, "side", "right");
+        auto vhandle = add_numeric_vector<double>(ahandle, "value", { 1, 2, 3, 4, 5, 6 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+        add_numeric_scalar(ahandle, "along", 1, H5::PredType::NATIVE_UINT8);
+
+        auto mhandle = operation_opener(fhandle, "math", "unary math");
+        add_version_string(mhandle, 1100000);
+        add_dense(mhandle, "seed", 5, 6, 7);
+        add_string_scalar(mhandle, "method", "abs");
+
+        auto bhandle = operation_opener(fhandle, "binary", "binary comparison");
+        add_version_string(bhandle, 1100000);
+        add_dense(bhandle, "left", 5, 6, 8);
+        add_dense(bhandle, "right", 5, 6, 9);
+        add_string_scalar(bhandle, "method", ">=");
+
+        // Matrix products have no tatami equivalent and are realized in memory.
+        auto phandle = operation_opener(fhandle, "product", "matrix product");
+        add_version_string(phandle, 1100000);
+        add_dense(phandle, "left_seed", 5, 3, 10);
+        add_string_scalar(phandle, "left_orientation", "N");
+        add_dense(phandle, "right_seed", 4, 3, 11);
+        add_string_scalar(phandle, "right_orientation", "T");
+    }
+
+    for (auto name : { "subset", "combine", "transpose", "arith", "math", "binary", "product" }) {
+        compare(name);
+    }
+
+    chihaya::tatami_binding::Options topt;
+    topt.realize_unsupported = false;
+    expect_error([&]() { chihaya::tatami_binding::load(path, "product", topt); }, "no tatami equivalent");
+}
+
+TEST_F(TatamiBindingTest, SparseMatrix) {
+    std::vector<double> values {
+        0, 1.5, 0, 0,
+        2, 0, 0, -3,
+        0, 0, 4, 0
+    };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_sparse(fhandle, "csc", 3, 4, values, true);
+        add_sparse(fhandle, "csr", 3, 4, values, false);
+    }
+    check("csc", 3, 4, values);
+    check("csr", 3, 4, values);
+}
+
+TEST_F(TatamiBindingTest, ConstantArray) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = array_opener(fhandle, "const", "constant array");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "dimensions", { 3, 4 }, H5::PredType::NATIVE_UINT32);
+        auto vhandle = add_numeric_scalar<double>(ghandle, "value", 2.5, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(vhandle, "type", "FLOAT");
+    }
+    check("const", 3, 4, std::vector<double>(12, 2.5));
+}
+
+TEST_F(TatamiBindingTest, Placeholder) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto dhandle = add_dense(fhandle, "dense", 2, 3, { 1, 999, 3, 999, 0, 6 });
+        add_numeric_missing_placeholder<double>(dhandle, 999, H5::PredType::NATIVE_DOUBLE);
+
+        auto shandle = add_sparse(fhandle, "sparse", 2, 3, { 0, 7, 2, 7, 0, 0 }, true);
+        add_numeric_missing_placeholder<double>(shandle, 7, H5::PredType::NATIVE_DOUBLE);
+
+        // Only the explicitly stored zero in the first row is missing.
+        auto ghandle = array_opener(fhandle, "zero", "sparse matrix");
+        add_version_string(ghandle, 1100000);
+        auto zhandle = add_numeric_vector<double>(ghandle, "data", { 0, 5 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(zhandle, "type", "FLOAT");
+        add_numeric_missing_placeholder<double>(zhandle, 0, H5::PredType::NATIVE_DOUBLE);
+        add_numeric_vector<int>(ghandle, "shape", { 2, 3 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(ghandle, "indices", { 0, 1 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(ghandle, "indptr", { 0, 2, 2 }, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(ghandle, "by_column", 0, H5::PredType::NATIVE_INT8);
+    }
+
+    check("dense", 2, 3, { 1, nan, 3, nan, 0, 6 });
+    check("sparse", 2, 3, { 0, nan, 2, nan, 0, 0 });
+    check("zero", 2, 3, { nan, 5, 0, 0, 0, 0 });
+
+    // Sparse matrices remain sparse after masking.
+    chihaya::tatami_binding::Options topt;
+    EXPECT_FALSE(chihaya::tatami_binding::load(path, "dense", topt)->is_sparse());
+    EXPECT_TRUE(chihaya::tatami_binding::load(path, "sparse", topt)->is_sparse());
+    EXPECT_TRUE(chihaya::tatami_binding::load(path, "zero", topt)->is_sparse());
+}
+
+TEST_F(TatamiBindingTest, UnaryComparison) {
+    std::vector<double> seed { 1, 2, 3, 4, 0, -1 };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = add_unary(fhandle, "right_gt", "unary comparison", ">", seed);
+        add_unary_value(ghandle, "right", { 2 });
+
+        // Left-sided values flip the comparison, e.g., '2 > x' is 'x < 2'.
+        ghandle = add_unary(fhandle, "left_gt", "unary comparison", ">", seed);
+        add_unary_value(ghandle, "left", { 2 });
+        ghandle = add_unary(fhandle, "left_lt", "unary comparison", "<", seed);
+        add_unary_value(ghandle, "left", { 2 });
+        ghandle = add_unary(fhandle, "left_ge", "unary comparison", ">=", seed);
+        add_unary_value(ghandle, "left", { 1, 3, 0 }, 1);
+        ghandle = add_unary(fhandle, "left_le", "unary comparison", "<=", seed);
+        add_unary_value(ghandle, "left", { 3, 0 }, 0);
+    }
+
+    check("right_gt", 2, 3, { 0, 0, 1, 1, 0, 0 });
+    check("left_gt", 2, 3, { 1, 0, 0, 0, 1, 1 });
+    check("left_lt", 2, 3, { 0, 0, 1, 1, 0, 0 });
+    check("left_ge", 2, 3, { 1, 1, 0, 0, 1, 1 });
+    check("left_le", 2, 3, { 0, 0, 1, 1, 1, 0 });
+}
+
+TEST_F(TatamiBindingTest, UnaryLogic) {
+    std::vector<double> seed { 1, 0, 3, 0, 0, -1 };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_unary(fhandle, "not", "unary logic", "!", seed);
+        auto ghandle = add_unary(fhandle, "and", "unary logic", "&&", seed);
+        add_unary_value(ghandle, "right", { 1 });
+        ghandle = add_unary(fhandle, "or", "unary logic", "||", seed);
+        add_unary_value(ghandle, "left", { 0, 1 }, 0);
+    }
+
+    check("not", 2, 3, { 0, 1, 0, 1, 1, 0 });
+    check("and", 2, 3, { 1, 0, 1, 0, 0, 1 });
+    check("or", 2, 3, { 1, 0, 1, 1, 1, 1 });
+}
+
+TEST_F(TatamiBindingTest, UnarySpecialCheck) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> seed { 1, nan, inf, -inf, 0, -2 };
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_unary(fhandle, "is_nan", "unary special check", "is_nan", seed);
+        add_unary(fhandle, "is_finite", "unary special check", "is_finite", seed);
+        add_unary(fhandle, "is_infinite", "unary special check", "is_infinite", seed);
+    }
+
+    check("is_nan", 2, 3, { 0, 1, 0, 0, 0, 0 });
+    check("is_finite", 2, 3, { 1, 0, 0, 0, 1, 1 });
+    check("is_infinite", 2, 3, { 0, 0, 1, 1, 0, 0 });
+}
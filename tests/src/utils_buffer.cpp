@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_buffer.hpp"
+
+#include <vector>
+#include <string>
+
+class BufferTest : public ::testing::Test {
+protected:
+    std::string path = "Test_buffer.h5";
+
+    void SetUp() {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        hsize_t len = 100000;
+        H5::DataSpace space(1, &len);
+        fhandle.createDataSet("contiguous", H5::PredType::NATIVE_INT32, space);
+
+        H5::DSetCreatPropList cplist;
+        hsize_t chunk = 3000;
+        cplist.setChunk(1, &chunk);
+        cplist.setDeflate(6);
+        fhandle.createDataSet("chunked", H5::PredType::NATIVE_INT32, space, cplist);
+
+        H5::DSetCreatPropList cplist2;
+        hsize_t chunk2[2] = { 10, 5000 };
+        cplist2.setChunk(2, chunk2);
+        hsize_t dims[2] = { 200, 30000 };
+        H5::DataSpace space2(2, dims);
+        fhandle.createDataSet("matrix", H5::PredType::NATIVE_DOUBLE, space2, cplist2);
+    }
+};
+
+TEST_F(BufferTest, BlockSize) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    chihaya::Options opt;
+
+    // Contiguous datasets are limited by the element count or memory.
+    auto contiguous = fhandle.openDataSet("contiguous");
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(contiguous, 100000, opt), 100000);
+    opt.buffer_size = 12345;
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(contiguous, 100000, opt), 12345);
+    opt.buffer_memory = 4000;
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(contiguous, 100000, opt), 1000);
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(contiguous, 100000, opt, 4), 250);
+
+    // Chunked datasets are rounded down to whole chunks, but at least one chunk is always read.
+    opt = chihaya::Options();
+    opt.buffer_size = 10000;
+    auto chunked = fhandle.openDataSet("chunked");
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(chunked, 100000, opt), 9000);
+    opt.buffer_memory = 4000;
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(chunked, 100000, opt), 3000);
+    EXPECT_EQ(chihaya::internal_buffer::pick_1d_block_size(chunked, 2000, opt), 2000);
+
+    // N-dimensional datasets are rounded down to whole rows of chunks.
+    opt = chihaya::Options();
+    auto matrix = fhandle.openDataSet("matrix");
+    EXPECT_EQ(chihaya::internal_buffer::pick_block_size(matrix, { 200, 30000 }, opt), 900000);
+    opt.buffer_size = 100;
+    EXPECT_EQ(chihaya::internal_buffer::pick_block_size(matrix, { 200, 30000 }, opt), 300000);
+}
+
+TEST_F(BufferTest, ChunkCache) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    chihaya::Options opt;
+    size_t nslots, nbytes;
+    double w0;
+
+    // Small chunks fit in the default cache.
+    {
+        int mdc_nelmts;
+        size_t default_nbytes;
+        fhandle.getAccessPlist().getCache(mdc_nelmts, nslots, default_nbytes, w0);
+        auto handle = chihaya::internal_buffer::open_dataset(fhandle, "chunked", opt);
+        handle.getAccessPlist().getChunkCache(nslots, nbytes, w0);
+        EXPECT_EQ(nbytes, default_nbytes);
+    }
+
+    // A row of chunks is 10 x 30000 doubles, which is larger than the default.
+    {
+        auto handle = chihaya::internal_buffer::open_dataset(fhandle, "matrix", opt);
+        handle.getAccessPlist().getChunkCache(nslots, nbytes, w0);
+        EXPECT_EQ(nbytes, 2400000);
+        EXPECT_EQ(w0, 1);
+    }
+
+    // Unless the memory limit is smaller.
+    {
+        opt.buffer_memory = 4000000;
+        auto handle = chihaya::internal_buffer::open_dataset(fhandle, "matrix", opt, 2);
+        handle.getAccessPlist().getChunkCache(nslots, nbytes, w0);
+        EXPECT_EQ(nbytes, 2000000);
+    }
+}
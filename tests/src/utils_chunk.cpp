@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_chunk.hpp"
+#include "chihaya/utils_stream.hpp"
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <cstdint>
+
+class ChunkTest : public ::testing::Test {
+protected:
+    std::string path = "Test_chunk.h5";
+
+    void SetUp() {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        std::vector<int32_t> ints(1050);
+        std::iota(ints.begin(), ints.end(), -10);
+        hsize_t len = ints.size();
+        H5::DataSpace space(1, &len);
+
+        H5::DSetCreatPropList deflated;
+        hsize_t chunk = 100;
+        deflated.setChunk(1, &chunk);
+        deflated.setDeflate(6);
+        fhandle.createDataSet("deflate", H5::PredType::NATIVE_INT32, space, deflated).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        H5::DSetCreatPropList shuffled;
+        hsize_t chunk2 = 64;
+        shuffled.setChunk(1, &chunk2);
+        shuffled.setShuffle();
+        shuffled.setDeflate(3);
+        std::vector<uint64_t> longs(ints.size());
+        for (size_t i = 0; i < longs.size(); ++i) {
+            longs[i] = i * 1000003;
+        }
+        fhandle.createDataSet("shuffle", H5::PredType::NATIVE_UINT64, space, shuffled).write(longs.data(), H5::PredType::NATIVE_UINT64);
+
+        H5::DSetCreatPropList checksummed;
+        checksummed.setChunk(1, &chunk);
+        checksummed.setDeflate(6);
+        checksummed.setFletcher32();
+        fhandle.createDataSet("fletcher", H5::PredType::NATIVE_INT32, space, checksummed).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        fhandle.createDataSet("contiguous", H5::PredType::NATIVE_INT32, space).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        // Only writing the first few chunks, so that the rest are unallocated.
+        auto partial = fhandle.createDataSet("partial", H5::PredType::NATIVE_INT32, space, deflated);
+        hsize_t start = 0, count = 250;
+        space.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        H5::DataSpace mspace(1, &count);
+        partial.write(ints.data(), H5::PredType::NATIVE_INT32, mspace, space);
+    }
+};
+
+TEST_F(ChunkTest, Decompress) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+
+    for (auto name : { "deflate", "shuffle" }) {
+        auto dhandle = fhandle.openDataSet(name);
+        chihaya::internal_chunk::ChunkedDataset chunked(dhandle);
+#ifdef CHIHAYA_DIRECT_CHUNKS
+        ASSERT_TRUE(chunked.available());
+#else
+        EXPECT_FALSE(chunked.available());
+#endif
+
+        std::vector<std::pair<hsize_t, hsize_t> > ranges{ { 0, 1050 }, { 10, 20 }, { 95, 300 }, { 1000, 50 }, { 640, 64 } };
+        for (const auto& r : ranges) {
+            std::vector<double> expected(r.second);
+            chihaya::internal_stream::read_block(dhandle, r.first, r.second, expected.data());
+
+            for (int threads : { 1, 4 }) {
+                std::vector<double> observed(r.second);
+                chihaya::internal_stream::read_block(dhandle, r.first, r.second, observed.data(), nullptr, &chunked, threads);
+                EXPECT_EQ(expected, observed);
+            }
+        }
+    }
+}
+
+TEST_F(ChunkTest, Stream) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto dhandle = fhandle.openDataSet("shuffle");
+    chihaya::internal_chunk::ChunkedDataset chunked(dhandle);
+
+    std::vector<uint64_t> expected(1000);
+    chihaya::internal_stream::read_block(dhandle, 30, expected.size(), expected.data());
+
+    for (int threads : { 1, 3 }) {
+        chihaya::internal_stream::Stream1dRange<uint64_t> stream(&dhandle, 30, 1030, 150, nullptr, &chunked, threads);
+        std::vector<uint64_t> observed;
+        while (observed.size() < expected.size()) {
+            auto block = stream.get_many();
+#ifdef CHIHAYA_DIRECT_CHUNKS
+            // Each block ends on a chunk boundary, except for the last.
+            size_t end = 30 + observed.size() + block.second;
+            if (end < 1030) {
+                EXPECT_EQ(end % 64, 0);
+            }
+#endif
+            observed.insert(observed.end(), block.first, block.first + block.second);
+            stream.next(block.second);
+        }
+        EXPECT_EQ(expected, observed);
+    }
+}
+
+TEST_F(ChunkTest, Fallback) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    EXPECT_FALSE(chihaya::internal_chunk::ChunkedDataset(fhandle.openDataSet("fletcher")).available());
+    EXPECT_FALSE(chihaya::internal_chunk::ChunkedDataset(fhandle.openDataSet("contiguous")).available());
+    EXPECT_FALSE(chihaya::internal_chunk::ChunkedDataset(fhandle.openDataSet("deflate"), false).available());
+
+    // Unallocated chunks are filled in by HDF5.
+    auto dhandle = fhandle.openDataSet("partial");
+    chihaya::internal_chunk::ChunkedDataset chunked(dhandle);
+    std::vector<int32_t> buffer(150);
+#ifdef CHIHAYA_DIRECT_CHUNKS
+    EXPECT_TRUE(chunked.read(dhandle, 200, 50, buffer.data()));
+#endif
+    EXPECT_FALSE(chunked.read(dhandle, 200, 150, buffer.data()));
+
+    chihaya::internal_stream::read_block(dhandle, 200, 150, buffer.data(), nullptr, &chunked);
+    for (size_t i = 0; i < 150; ++i) {
+        EXPECT_EQ(buffer[i], (i < 50 ? static_cast<int32_t>(i + 190) : 0));
+    }
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "chihaya/validate.hpp"
+#include "chihaya/utils_file.hpp"
+#include "utils.h"
+
+#include <vector>
+#include <string>
+
+class FileTest : public ::testing::Test {
+protected:
+    std::string path = "Test_file.h5";
+
+    void create(const H5::FileCreatPropList& fcpl) {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC, fcpl);
+        H5::Group current = operation_opener(fhandle, "WHEE", "unary arithmetic");
+        add_version_string(current, 1100000);
+        for (size_t d = 0; d < 50; ++d) {
+            add_string_scalar(current, "method", "*");
+            add_string_scalar(current, "side", "left");
+            auto vhandle = add_numeric_scalar(current, "value", 2.5, H5::PredType::NATIVE_DOUBLE);
+            add_string_attribute(vhandle, "type", "FLOAT");
+            current = operation_opener(current, "seed", "unary arithmetic");
+        }
+        add_string_scalar(current, "method", "+");
+        add_string_scalar(current, "side", "right");
+        auto vhandle = add_numeric_vector<int>(current, "value", { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, H5::PredType::NATIVE_INT32);
+        add_string_attribute(vhandle, "type", "INTEGER");
+        add_numeric_scalar<int>(current, "along", 0, H5::PredType::NATIVE_UINT32);
+        mock_array_opener(current, "seed", { 10, 17 }, 1100000, "INTEGER");
+    }
+
+    static std::vector<chihaya::Options> all_options() {
+        std::vector<chihaya::Options> output(5);
+        output[1].metadata_cache_size = 8000000;
+        output[2].page_buffer_size = 1048576;
+        output[3].sieve_buffer_size = 1048576;
+        output[4].core_driver = true;
+        return output;
+    }
+};
+
+TEST_F(FileTest, AccessPlist) {
+    chihaya::Options opt;
+    opt.metadata_cache_size = 12345678;
+    opt.sieve_buffer_size = 4321;
+    opt.core_driver = true;
+    auto fapl = chihaya::internal_file::create_access_plist(opt);
+
+    H5AC_cache_config_t config;
+    config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    H5Pget_mdc_config(fapl.getId(), &config);
+    EXPECT_TRUE(config.set_initial_size);
+    EXPECT_EQ(config.initial_size, 12345678);
+    EXPECT_GE(config.max_size, 12345678);
+    EXPECT_LE(config.min_size, 12345678);
+
+    EXPECT_EQ(fapl.getSieveBufSize(), 4321);
+    EXPECT_EQ(fapl.getDriver(), H5FD_CORE);
+
+    // Defaults are left untouched.
+    auto default_fapl = chihaya::internal_file::create_access_plist(chihaya::Options());
+    EXPECT_EQ(default_fapl.getSieveBufSize(), H5::FileAccPropList().getSieveBufSize());
+    EXPECT_NE(default_fapl.getDriver(), H5FD_CORE);
+}
+
+TEST_F(FileTest, Validate) {
+    H5::FileCreatPropList paged;
+    H5Pset_file_space_strategy(paged.getId(), H5F_FSPACE_STRATEGY_PAGE, false, 1);
+    H5Pset_file_space_page_size(paged.getId(), 4096);
+
+    // Page buffers are ignored for files that weren't created with paging.
+    for (const auto& fcpl : { H5::FileCreatPropList(), paged }) {
+        create(fcpl);
+        for (auto opt : all_options()) {
+            auto output = chihaya::validate(path, "WHEE", opt);
+            EXPECT_EQ(output.type, chihaya::FLOAT);
+            EXPECT_EQ(output.dimensions[0], 10);
+            EXPECT_EQ(output.dimensions[1], 17);
+        }
+
+#if H5_VERSION_GE(1, 10, 1)
+        // Checking that the page buffer is actually used if the file supports it.
+        chihaya::Options opt;
+        opt.page_buffer_size = 1048576;
+        H5::H5File fhandle;
+        chihaya::internal_file::open_file(fhandle, path, opt);
+        hid_t fapl = H5Fget_access_plist(fhandle.getId());
+        size_t buffer_size = 0;
+        unsigned min_meta = 0, min_raw = 0;
+        H5Pget_page_buffer_size(fapl, &buffer_size, &min_meta, &min_raw);
+        H5Pclose(fapl);
+        EXPECT_EQ(buffer_size, (fcpl.getId() == paged.getId() ? 1048576 : 0));
+#endif
+    }
+
+    // Errors in opening the file are still reported.
+    chihaya::Options opt;
+    opt.page_buffer_size = 1048576;
+    EXPECT_ANY_THROW(chihaya::validate("Test_file_missing.h5", "WHEE", opt));
+}
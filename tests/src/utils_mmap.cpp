@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_mmap.hpp"
+#include "chihaya/utils_stream.hpp"
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <cstdint>
+
+class MmapTest : public ::testing::Test {
+protected:
+    std::string path = "Test_mmap.h5";
+
+    void SetUp() {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        std::vector<int32_t> ints(1000);
+        std::iota(ints.begin(), ints.end(), -10);
+        hsize_t len = ints.size();
+        H5::DataSpace space(1, &len);
+        fhandle.createDataSet("contiguous", H5::PredType::NATIVE_INT32, space).write(ints.data(), H5::PredType::NATIVE_INT32);
+        fhandle.createDataSet("big_endian", H5::PredType::STD_I32BE, space).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        H5::DSetCreatPropList cplist;
+        hsize_t chunk = 100;
+        cplist.setChunk(1, &chunk);
+        cplist.setDeflate(6);
+        fhandle.createDataSet("compressed", H5::PredType::NATIVE_INT32, space, cplist).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        std::vector<double> values(12 * 7);
+        std::iota(values.begin(), values.end(), 0.5);
+        hsize_t dims[2] = { 12, 7 };
+        H5::DataSpace space2(2, dims);
+        fhandle.createDataSet("matrix", H5::PredType::NATIVE_DOUBLE, space2).write(values.data(), H5::PredType::NATIVE_DOUBLE);
+    }
+};
+
+TEST_F(MmapTest, Contiguous) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto dhandle = fhandle.openDataSet("contiguous");
+    chihaya::internal_mmap::MappedDataset mapped(dhandle);
+
+#ifdef CHIHAYA_MMAP
+    ASSERT_TRUE(mapped.available());
+    EXPECT_EQ(mapped.type(), chihaya::internal_mmap::StoredType::INT32);
+    EXPECT_EQ(mapped.dimensions(), std::vector<hsize_t>{ 1000 });
+
+    auto span = mapped.span<int32_t>();
+    ASSERT_TRUE(span != NULL);
+    EXPECT_EQ(span[0], -10);
+    EXPECT_EQ(span[999], 989);
+    EXPECT_TRUE(mapped.span<uint32_t>() == NULL);
+
+    std::vector<double> converted(5);
+    mapped.read(8, 5, converted.data());
+    EXPECT_EQ(converted, std::vector<double>({ -2, -1, 0, 1, 2 }));
+
+    // Streams hand out the entire range at once.
+    chihaya::internal_stream::Stream1dRange<int32_t> stream(&dhandle, 100, 400, 50, &mapped);
+    auto block = stream.get_many();
+    EXPECT_EQ(block.first, span + 100);
+    EXPECT_EQ(block.second, 300);
+#else
+    EXPECT_FALSE(mapped.available());
+#endif
+
+    chihaya::internal_mmap::MappedDataset disabled(dhandle, false);
+    EXPECT_FALSE(disabled.available());
+
+    // Reads are the same with or without mapping.
+    std::vector<int32_t> expected(20), observed(20);
+    chihaya::internal_stream::read_block(dhandle, 500, 20, expected.data());
+    chihaya::internal_stream::read_block(dhandle, 500, 20, observed.data(), &mapped);
+    EXPECT_EQ(expected, observed);
+}
+
+TEST_F(MmapTest, Hyperslab) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto dhandle = fhandle.openDataSet("matrix");
+    chihaya::internal_mmap::MappedDataset mapped(dhandle);
+#ifdef CHIHAYA_MMAP
+    ASSERT_TRUE(mapped.available());
+    std::vector<double> buffer(3 * 4);
+    mapped.read_hyperslab({ 2, 1 }, { 3, 4 }, buffer.data());
+    for (size_t r = 0; r < 3; ++r) {
+        for (size_t c = 0; c < 4; ++c) {
+            EXPECT_EQ(buffer[r * 4 + c], (2 + r) * 7 + (1 + c) + 0.5);
+        }
+    }
+#else
+    EXPECT_FALSE(mapped.available());
+#endif
+}
+
+TEST_F(MmapTest, Fallback) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        EXPECT_FALSE(chihaya::internal_mmap::MappedDataset(fhandle.openDataSet("compressed")).available());
+        EXPECT_FALSE(chihaya::internal_mmap::MappedDataset(fhandle.openDataSet("big_endian")).available());
+    }
+
+    // Files that can be modified are never mapped.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        EXPECT_FALSE(chihaya::internal_mmap::MappedDataset(fhandle.openDataSet("contiguous")).available());
+    }
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_simd.hpp"
+
+#include <vector>
+#include <random>
+#include <cstdint>
+
+template<typename Index_>
+void compare_kernels(std::mt19937_64& rng, size_t n, uint64_t extent, bool increasing) {
+    std::vector<Index_> values(n);
+    Index_ current = 0;
+    for (auto& v : values) {
+        current += 1 + rng() % 3;
+        v = current;
+    }
+
+    auto check = [&](bool has_previous, Index_ previous) -> void {
+        auto expected = chihaya::internal_simd::find_invalid_scalar(values.data(), n, extent, increasing, has_previous, previous);
+        auto observed = chihaya::internal_simd::find_invalid(values.data(), n, extent, increasing, has_previous, previous);
+        EXPECT_EQ(expected, observed);
+
+#ifdef CHIHAYA_X86_SIMD
+        // Also checking each kernel directly, regardless of what is picked by the runtime dispatch.
+        if constexpr(chihaya::internal_simd::has_simd_kernel<Index_>()) {
+            if (n > 1 && expected > 0) {
+                auto isa = chihaya::internal_simd::detect_instruction_set();
+                if (isa == chihaya::internal_simd::InstructionSet::AVX2) {
+                    auto resume = chihaya::internal_simd::find_invalid_avx2(values.data(), n, extent, increasing);
+                    EXPECT_LE(resume, expected);
+                }
+                if (isa != chihaya::internal_simd::InstructionSet::SCALAR) {
+                    auto resume = chihaya::internal_simd::find_invalid_sse42(values.data(), n, extent, increasing);
+                    EXPECT_LE(resume, expected);
+                }
+            }
+        }
+#endif
+    };
+
+    check(false, 0);
+    if (n) {
+        check(true, values.front()); // failing on the first element, if 'increasing = true'.
+    }
+
+    // Injecting errors at random positions.
+    for (size_t r = 0; r < 20 && n; ++r) {
+        auto copy = values;
+        auto pos = rng() % n;
+        auto choice = rng() % 3;
+        if (choice == 0) {
+            values[pos] = static_cast<Index_>(extent); // out of range.
+        } else if (choice == 1 && pos > 0) {
+            values[pos] = values[pos - 1]; // not strictly increasing.
+        } else if constexpr(std::is_signed<Index_>::value) {
+            values[pos] = -1;
+        }
+        check(false, 0);
+        values.swap(copy);
+    }
+}
+
+TEST(UtilsSimd, FindInvalid) {
+    std::mt19937_64 rng(42);
+    for (size_t n : { 0, 1, 2, 3, 5, 8, 9, 16, 17, 33, 100, 1001 }) {
+        for (bool increasing : { false, true }) {
+            compare_kernels<uint64_t>(rng, n, 2 * n + 10, increasing);
+            compare_kernels<uint64_t>(rng, n, std::numeric_limits<uint64_t>::max(), increasing);
+            compare_kernels<uint32_t>(rng, n, 2 * n + 10, increasing);
+            compare_kernels<uint32_t>(rng, n, static_cast<uint64_t>(1) << 40, increasing);
+            compare_kernels<int32_t>(rng, n, 2 * n + 10, increasing);
+            compare_kernels<int32_t>(rng, n, static_cast<uint64_t>(1) << 40, increasing);
+            compare_kernels<int64_t>(rng, n, 2 * n + 10, increasing);
+            compare_kernels<uint16_t>(rng, n, n + 10, increasing);
+            compare_kernels<uint16_t>(rng, n, 100000, increasing);
+            compare_kernels<int16_t>(rng, n, n + 10, increasing);
+            compare_kernels<uint8_t>(rng, n, n + 10, increasing); // wraps around for large 'n', which is fine as we only compare kernels.
+            compare_kernels<uint8_t>(rng, n, 1000, increasing);
+            compare_kernels<int8_t>(rng, n, 50, increasing);
+        }
+    }
+}
+
+TEST(UtilsSimd, Unsorted) {
+    // Checking that the bounds are correctly enforced for large unsigned values.
+    std::vector<uint64_t> values { 1, 2, 3, 4, 5, 6, 7, 8, static_cast<uint64_t>(1) << 63, 10, 11 };
+    EXPECT_EQ(chihaya::internal_simd::find_invalid(values.data(), values.size(), 100, false, false, static_cast<uint64_t>(0)), 8);
+    EXPECT_EQ(chihaya::internal_simd::find_invalid(values.data(), values.size(), 0, false, false, static_cast<uint64_t>(0)), 0);
+
+    std::vector<int32_t> signed_values { 1, 2, 3, 4, 5, 6, 7, 8, 9, -10, 11 };
+    EXPECT_EQ(chihaya::internal_simd::find_invalid(signed_values.data(), signed_values.size(), 100, false, false, 0), 9);
+
+    // Narrow unsigned types need the same care with the sign bit.
+    std::vector<uint8_t> narrow_values(40, 1);
+    narrow_values[35] = 200;
+    EXPECT_EQ(chihaya::internal_simd::find_invalid(narrow_values.data(), narrow_values.size(), 100, false, false, static_cast<uint8_t>(0)), 35);
+    EXPECT_EQ(chihaya::internal_simd::find_invalid(narrow_values.data(), narrow_values.size(), 300, false, false, static_cast<uint8_t>(0)), 40);
+}
@@ -0,0 +1,275 @@
+#include <gtest/gtest.h>
+#include "chihaya/realize.hpp"
+#include "chihaya/utils_simd_math.hpp"
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+
+// Number of representable doubles between 'x' and 'y', for comparing the approximate kernels to the standard library.
+static double ulp_distance(double x, double y) {
+    auto order = [](double v) -> int64_t {
+        int64_t i;
+        std::memcpy(&i, &v, sizeof(double));
+        return (i < 0 ? std::numeric_limits<int64_t>::min() - i : i);
+    };
+    return std::abs(static_cast<double>(order(x) - order(y)));
+}
+
+static bool is_exact_method(chihaya::realize::UnaryMethod method) {
+    bool exact = true;
+    chihaya::realize::internal::dispatch(method, [&](auto tag) -> void {
+        constexpr chihaya::realize::UnaryMethod method_ = decltype(tag)::value;
+        if constexpr(chihaya::realize::internal::has_math_kernel<method_>()) {
+            exact = chihaya::internal_simd::is_exact(chihaya::realize::internal::to_math_kernel<method_>());
+        }
+    });
+    return exact;
+}
+
+class SimdMathTest : public ::testing::TestWithParam<chihaya::realize::UnaryMethod> {
+protected:
+    // Covering a wide range of magnitudes, along with all the special values.
+    static std::vector<double> simulate() {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> mantissa(-1, 1);
+        std::uniform_int_distribution<int> exponent(-60, 60);
+        std::vector<double> output;
+        for (size_t i = 0; i < 2000; ++i) {
+            output.push_back(std::ldexp(mantissa(rng), exponent(rng)));
+        }
+        for (double x = -800; x <= 800; x += 0.37) {
+            output.push_back(x);
+        }
+        for (double x = -1.1; x <= 1.1; x += 0.013) {
+            output.push_back(x);
+        }
+        for (double x : { 0.0, -0.0, 0.5, -0.5, 1.0, -1.0, 1.5, 2.5, -2.5, 709.78, 709.79, -745.1, -745.2, 3.141592653589793, 1.5707963267948966, 1e6, 2e6, 1e300 }) {
+            output.push_back(x);
+        }
+        output.push_back(std::numeric_limits<double>::infinity());
+        output.push_back(-std::numeric_limits<double>::infinity());
+        output.push_back(std::numeric_limits<double>::quiet_NaN());
+        output.push_back(chihaya::realize::missing_value());
+        output.push_back(std::numeric_limits<double>::min());
+        output.push_back(std::numeric_limits<double>::denorm_min() * 12345);
+        output.push_back(std::numeric_limits<double>::max());
+        return output;
+    }
+};
+
+TEST_P(SimdMathTest, Consistency) {
+    auto method = GetParam();
+    auto input = simulate();
+
+    bool exact = is_exact_method(method);
+    for (double parameter : { 0.0, 1.0, 2.0 }) {
+        if (method == chihaya::realize::UnaryMethod::LOG) {
+            if (parameter == 0) {
+                continue;
+            }
+            parameter = std::log(parameter + 1);
+        }
+
+        auto expected = input;
+        auto observed = input;
+        chihaya::realize::internal::dispatch(method, [&](auto tag) -> void {
+            constexpr chihaya::realize::UnaryMethod method_ = decltype(tag)::value;
+            for (auto& x : expected) {
+                x = chihaya::realize::internal::apply<method_>(x, parameter);
+            }
+            chihaya::realize::internal::apply_all<method_>(observed.data(), observed.size(), parameter);
+        });
+
+        for (size_t i = 0; i < input.size(); ++i) {
+            double e = expected[i], o = observed[i];
+            if (std::isnan(e)) {
+                EXPECT_TRUE(std::isnan(o)) << "input is " << input[i];
+                EXPECT_EQ(chihaya::realize::is_missing(e), chihaya::realize::is_missing(o));
+            } else if (!exact) {
+                if (std::isinf(e) || e == 0) {
+                    EXPECT_EQ(e, o) << "input is " << input[i];
+                } else {
+                    EXPECT_LE(ulp_distance(e, o), 3) << "input is " << input[i] << ", expected " << e << ", observed " << o;
+                }
+            } else {
+                EXPECT_EQ(e, o) << "input is " << input[i];
+                EXPECT_EQ(std::signbit(e), std::signbit(o)) << "input is " << input[i];
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    SimdMath,
+    SimdMathTest,
+    ::testing::Values(
+        chihaya::realize::UnaryMethod::ABS,
+        chihaya::realize::UnaryMethod::SIGN,
+        chihaya::realize::UnaryMethod::SQRT,
+        chihaya::realize::UnaryMethod::CEILING,
+        chihaya::realize::UnaryMethod::FLOOR,
+        chihaya::realize::UnaryMethod::TRUNC,
+        chihaya::realize::UnaryMethod::ROUND,
+        chihaya::realize::UnaryMethod::SIGNIF,
+        chihaya::realize::UnaryMethod::EXP,
+        chihaya::realize::UnaryMethod::EXPM1,
+        chihaya::realize::UnaryMethod::LOG,
+        chihaya::realize::UnaryMethod::LOG1P,
+        chihaya::realize::UnaryMethod::SIN,
+        chihaya::realize::UnaryMethod::COS,
+        chihaya::realize::UnaryMethod::TAN,
+        chihaya::realize::UnaryMethod::ASIN,
+        chihaya::realize::UnaryMethod::ACOS,
+        chihaya::realize::UnaryMethod::ATAN,
+        chihaya::realize::UnaryMethod::SINH,
+        chihaya::realize::UnaryMethod::COSH,
+        chihaya::realize::UnaryMethod::TANH,
+        chihaya::realize::UnaryMethod::ASINH,
+        chihaya::realize::UnaryMethod::ACOSH,
+        chihaya::realize::UnaryMethod::ATANH
+    )
+);
+
+TEST_P(SimdMathTest, Exact) {
+    auto method = GetParam();
+    auto input = simulate();
+    double parameter = (method == chihaya::realize::UnaryMethod::LOG ? std::log(10.0) : 2);
+
+    // In exact mode, all methods give the same results as the standard library.
+    auto expected = input;
+    auto observed = input;
+    chihaya::realize::internal::dispatch(method, [&](auto tag) -> void {
+        constexpr chihaya::realize::UnaryMethod method_ = decltype(tag)::value;
+        for (auto& x : expected) {
+            x = chihaya::realize::internal::apply<method_>(x, parameter);
+        }
+        chihaya::realize::internal::apply_all<method_>(observed.data(), observed.size(), parameter, true);
+    });
+
+    for (size_t i = 0; i < input.size(); ++i) {
+        double e = expected[i], o = observed[i];
+        if (std::isnan(e)) {
+            EXPECT_TRUE(std::isnan(o)) << "input is " << input[i];
+        } else {
+            EXPECT_EQ(e, o) << "input is " << input[i];
+            EXPECT_EQ(std::signbit(e), std::signbit(o)) << "input is " << input[i];
+        }
+    }
+}
+
+TEST(SimdMath, Coverage) {
+    std::vector<double> values(10, 2.0);
+    auto scalar = [](double x) -> double { return std::sqrt(x); };
+    size_t resume = chihaya::internal_simd::transform_math<chihaya::internal_simd::MathKernel::SQRT>(values.data(), values.size(), 0, scalar);
+    EXPECT_LE(resume, values.size());
+#ifdef CHIHAYA_X86_SIMD
+    auto isa = chihaya::internal_simd::detect_math_instruction_set();
+    if (isa != chihaya::internal_simd::MathInstructionSet::SCALAR) {
+        EXPECT_EQ(resume, 8);
+        EXPECT_EQ(values[0], std::sqrt(2.0));
+        EXPECT_EQ(values[9], 2.0); // remainder is left to the caller.
+    }
+#endif
+}
+
+#ifdef CHIHAYA_X86_SIMD
+TEST(SimdMath, InstructionSets) {
+    // Checking the AVX2 kernels directly, as these would not be used on CPUs with AVX-512.
+    if (!__builtin_cpu_supports("avx2")) {
+        return;
+    }
+    bool has_avx512 = __builtin_cpu_supports("avx512f");
+
+    std::mt19937_64 rng(999);
+    std::uniform_real_distribution<double> dist(-20, 20);
+    std::vector<double> input(1003);
+    for (auto& x : input) {
+        x = dist(rng);
+    }
+
+    auto check = [&](auto kernel, double (*fun)(double)) -> void {
+        constexpr auto kernel_ = decltype(kernel)::value;
+        auto scalar = [&](double x) -> double { return fun(x); };
+        auto compare = [&](const std::vector<double>& observed, size_t resume) -> void {
+            EXPECT_EQ(resume, 1000);
+            for (size_t i = 0; i < resume; ++i) {
+                double e = fun(input[i]);
+                if (std::isnan(e)) {
+                    EXPECT_TRUE(std::isnan(observed[i])) << "input is " << input[i];
+                } else {
+                    EXPECT_LE(ulp_distance(e, observed[i]), (chihaya::internal_simd::is_exact(kernel_) ? 0 : 3)) << "input is " << input[i];
+                }
+            }
+        };
+
+        auto observed = input;
+        compare(observed, chihaya::internal_simd::math_avx2::transform<kernel_>(observed.data(), observed.size(), 0, scalar));
+        if (has_avx512) {
+            observed = input;
+            compare(observed, chihaya::internal_simd::math_avx512::transform<kernel_>(observed.data(), observed.size(), 0, scalar));
+        }
+    };
+
+    typedef chihaya::internal_simd::MathKernel MK;
+    check(std::integral_constant<MK, MK::ABS>(), [](double x) -> double { return std::abs(x); });
+    check(std::integral_constant<MK, MK::FLOOR>(), [](double x) -> double { return std::floor(x); });
+    check(std::integral_constant<MK, MK::EXP>(), [](double x) -> double { return std::exp(x); });
+    check(std::integral_constant<MK, MK::EXPM1>(), [](double x) -> double { return std::expm1(x); });
+    check(std::integral_constant<MK, MK::LOG1P>(), [](double x) -> double { return std::log1p(x); });
+    check(std::integral_constant<MK, MK::SIN>(), [](double x) -> double { return std::sin(x); });
+    check(std::integral_constant<MK, MK::COS>(), [](double x) -> double { return std::cos(x); });
+    check(std::integral_constant<MK, MK::TAN>(), [](double x) -> double { return std::tan(x); });
+    check(std::integral_constant<MK, MK::ATAN>(), [](double x) -> double { return std::atan(x); });
+    check(std::integral_constant<MK, MK::SINH>(), [](double x) -> double { return std::sinh(x); });
+    check(std::integral_constant<MK, MK::COSH>(), [](double x) -> double { return std::cosh(x); });
+    check(std::integral_constant<MK, MK::TANH>(), [](double x) -> double { return std::tanh(x); });
+    check(std::integral_constant<MK, MK::ASINH>(), [](double x) -> double { return std::asinh(x); });
+}
+#endif
+
+TEST(SimdMath, TrigFallback) {
+    using chihaya::realize::UnaryMethod;
+    using chihaya::realize::internal::apply;
+
+    // Large values and those close to the zeros are computed by the scalar code.
+    std::vector<double> input { 1e10, -1e10, 3.141592653589793, 6.283185307179586, 1.5707963267948966, 4.71238898038469, -3.141592653589793, 2e6 };
+    auto observed = input;
+    chihaya::realize::internal::apply_all<UnaryMethod::SIN>(observed.data(), observed.size(), 0);
+    for (size_t i = 0; i < input.size(); ++i) {
+        EXPECT_EQ(observed[i], apply<UnaryMethod::SIN>(input[i], 0)) << "input is " << input[i];
+    }
+
+    observed = input;
+    chihaya::realize::internal::apply_all<UnaryMethod::COS>(observed.data(), observed.size(), 0);
+    for (size_t i = 0; i < input.size(); ++i) {
+        EXPECT_EQ(observed[i], apply<UnaryMethod::COS>(input[i], 0)) << "input is " << input[i];
+    }
+}
+
+TEST(SimdMath, RoundOverflow) {
+    using chihaya::realize::UnaryMethod;
+    using chihaya::realize::internal::apply;
+
+    // Values that cannot be scaled without overflow are returned unchanged, as in R.
+    EXPECT_EQ(apply<UnaryMethod::ROUND>(1e300, 10), 1e300);
+    EXPECT_EQ(apply<UnaryMethod::ROUND>(-1e300, 10), -1e300);
+    EXPECT_EQ(apply<UnaryMethod::ROUND>(1.2345, 400), 1.2345);
+    EXPECT_EQ(apply<UnaryMethod::SIGNIF>(1e-300, 22), 1e-300);
+    EXPECT_EQ(apply<UnaryMethod::ROUND>(1.2345, 2), 1.23);
+    EXPECT_EQ(apply<UnaryMethod::ROUND>(123.45, -400), 0);
+
+    // Same results for the vectorized kernel.
+    for (double digits : { 10.0, 400.0, -400.0 }) {
+        std::vector<double> input { 1e300, -1e300, 1.2345, 4.5e15, 1e-300, -2.5, 123.45, 1e16 };
+        auto observed = input;
+        chihaya::realize::internal::apply_all<UnaryMethod::ROUND>(observed.data(), observed.size(), digits);
+        for (size_t i = 0; i < input.size(); ++i) {
+            EXPECT_EQ(observed[i], apply<UnaryMethod::ROUND>(input[i], digits)) << "input is " << input[i];
+            EXPECT_FALSE(std::isnan(observed[i]));
+        }
+    }
+}
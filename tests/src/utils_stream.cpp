@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_stream.hpp"
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <cstdint>
+#include <stdexcept>
+
+class StreamTest : public ::testing::Test {
+protected:
+    std::string path = "Test_stream.h5";
+    std::vector<int32_t> ints;
+
+    void SetUp() {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+
+        ints.resize(1234);
+        std::iota(ints.begin(), ints.end(), -100);
+        hsize_t len = ints.size();
+        H5::DataSpace space(1, &len);
+        fhandle.createDataSet("contiguous", H5::PredType::NATIVE_INT32, space).write(ints.data(), H5::PredType::NATIVE_INT32);
+
+        H5::DSetCreatPropList cplist;
+        hsize_t chunk = 100;
+        cplist.setChunk(1, &chunk);
+        cplist.setDeflate(6);
+        fhandle.createDataSet("compressed", H5::PredType::NATIVE_INT32, space, cplist).write(ints.data(), H5::PredType::NATIVE_INT32);
+    }
+
+    static std::vector<int32_t> consume(chihaya::internal_stream::Stream1dRange<int32_t>& stream, size_t n) {
+        std::vector<int32_t> output;
+        while (output.size() < n) {
+            auto block = stream.get_many();
+            output.insert(output.end(), block.first, block.first + block.second);
+            stream.next(block.second);
+        }
+        return output;
+    }
+};
+
+TEST_F(StreamTest, Prefetch) {
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+
+    for (auto name : { "contiguous", "compressed" }) {
+        auto dhandle = fhandle.openDataSet(name);
+        chihaya::internal_chunk::ChunkedDataset chunked(dhandle);
+        std::vector<int32_t> expected(ints.begin() + 17, ints.begin() + 1200);
+
+        for (hsize_t block_size : { 1, 50, 250, 5000 }) {
+            for (bool prefetch : { false, true }) {
+                chihaya::internal_stream::Stream1dRange<int32_t> stream(&dhandle, 17, 1200, block_size, nullptr, &chunked, 2, nullptr, prefetch);
+                EXPECT_EQ(consume(stream, expected.size()), expected);
+
+                // Partially consuming the stream is fine, as any pending read is finished on destruction.
+                chihaya::internal_stream::Stream1dRange<int32_t> partial(&dhandle, 0, 1000, block_size, nullptr, &chunked, 1, nullptr, prefetch);
+                partial.get();
+            }
+        }
+    }
+}
+
+TEST_F(StreamTest, Prefetcher) {
+    chihaya::internal_stream::Prefetcher prefetcher;
+
+    int counter = 0;
+    for (int i = 0; i < 10; ++i) {
+        prefetcher.submit([&]() -> void { ++counter; });
+        prefetcher.wait();
+    }
+    EXPECT_EQ(counter, 10);
+
+    // Errors are rethrown by the caller.
+    prefetcher.submit([&]() -> void { throw std::runtime_error("foobar"); });
+    EXPECT_THROW(prefetcher.wait(), std::runtime_error);
+
+    prefetcher.submit([&]() -> void { ++counter; });
+    prefetcher.wait();
+    EXPECT_EQ(counter, 11);
+}
@@ -1,5 +1,10 @@
 #include "utils.h"
 
+#include <string>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+
 chihaya::ArrayDetails test_validate(const std::string& path, const std::string& name) {
     return chihaya::validate(path, name);
 }
@@ -79,3 +84,230 @@ TEST(Validate, Errors) {
     }
     expect_error(path, "seed", "unknown object type 'YAY'");
 }
+
+TEST(Validate, Deduplicate) {
+    const char* path = "Test_validate.h5";
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 0, H5::PredType::NATIVE_UINT32);
+
+        auto lhandle = list_opener(ghandle, "seeds", 3, 1100000);
+        auto shandle = array_opener(lhandle, "0", "constant array");
+        add_numeric_vector<int>(shandle, "dimensions", { 20, 17 }, H5::PredType::NATIVE_UINT32);
+        auto dhandle = add_numeric_scalar(shandle, "value", 1, H5::PredType::NATIVE_INT32);
+        add_string_attribute(dhandle, "type", "INTEGER");
+
+        // Hard-linking the same seed multiple times.
+        H5Lcreate_hard(lhandle.getId(), "0", lhandle.getId(), "1", H5P_DEFAULT, H5P_DEFAULT);
+        H5Lcreate_hard(lhandle.getId(), "0", lhandle.getId(), "2", H5P_DEFAULT, H5P_DEFAULT);
+    }
+
+    chihaya::Options options;
+    size_t count = 0;
+    options.array_validate_registry["constant array"] = [&](const H5::Group& h, const ritsuko::Version& v, chihaya::Options& o) -> chihaya::ArrayDetails {
+        ++count;
+        return chihaya::constant_array::validate(h, v, o);
+    }; 
+
+    auto output = chihaya::validate(path, "WHEE", options);
+    EXPECT_EQ(output.dimensions[0], 60);
+    EXPECT_EQ(output.dimensions[1], 17);
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(options.validated.size(), 2); // the combine and the seed.
+
+    // Memo is reset for each top-level call.
+    chihaya::validate(path, "WHEE", options);
+    EXPECT_EQ(count, 2);
+
+    // Turning off deduplication.
+    options.deduplicate = false;
+    auto output2 = chihaya::validate(path, "WHEE", options);
+    EXPECT_EQ(count, 5);
+    EXPECT_EQ(output2.dimensions, output.dimensions);
+}
+
+TEST(Validate, Iterative) {
+    const char* path = "Test_validate.h5";
+
+    auto create = [&](size_t depth, bool broken) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        H5::Group current = operation_opener(fhandle, "WHEE", "unary arithmetic");
+        add_version_string(current, 1100000);
+        for (size_t d = 0; d < depth; ++d) {
+            add_string_scalar(current, "method", "+");
+            add_string_scalar(current, "side", "right");
+            auto vhandle = add_numeric_scalar(current, "value", 1, H5::PredType::NATIVE_INT32);
+            add_string_attribute(vhandle, "type", "INTEGER");
+            if (d + 1 < depth) {
+                current = operation_opener(current, "seed", "unary arithmetic");
+            }
+        }
+        if (broken) {
+            mock_array_opener(current, "seed", { 20, 17 }, 1100000, "FOOBAR");
+        } else {
+            mock_array_opener(current, "seed", { 20, 17 }, 1100000, "BOOLEAN");
+        }
+    };
+
+    // Very deep chains are validated without deep recursion.
+    create(1000, false);
+    {
+        chihaya::Options options;
+        auto output = chihaya::validate(path, "WHEE", options);
+        EXPECT_EQ(output.type, chihaya::INTEGER);
+        EXPECT_EQ(output.dimensions[0], 20);
+        EXPECT_EQ(output.dimensions[1], 17);
+        EXPECT_TRUE(options.prevalidated.empty()); // cleared after each top-level call.
+    }
+
+    // Errors are the same as those from the fully recursive traversal.
+    create(250, true);
+    std::string expected;
+    try {
+        chihaya::Options options;
+        options.iterative_depth = 0;
+        chihaya::validate(path, "WHEE", options);
+    } catch (std::exception& e) {
+        expected = e.what();
+    }
+    EXPECT_NE(expected.find("failed to validate 'seed'"), std::string::npos);
+
+    for (size_t depth : { 1, 7, 100 }) {
+        chihaya::Options options;
+        options.iterative_depth = depth;
+        std::string observed;
+        try {
+            chihaya::validate(path, "WHEE", options);
+        } catch (std::exception& e) {
+            observed = e.what();
+        }
+        EXPECT_EQ(observed, expected);
+    }
+}
+
+/*
+ * Checking that the parallel and iterative traversals give the same results and errors as the fully recursive serial traversal.
+ * Each parameter is a combination of the number of threads and the iterative depth.
+ */
+class ValidateModeTest : public ::testing::TestWithParam<std::tuple<int, size_t> > {
+protected:
+    std::string path = "Test_validate.h5";
+
+    static void add_combine(const H5::Group& parent, const std::string& name, const std::vector<int>& broken) {
+        auto ghandle = operation_opener(parent, name, "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 1, H5::PredType::NATIVE_UINT32);
+        auto lhandle = list_opener(ghandle, "seeds", 20, 1100000);
+        for (int s = 0; s < 19; ++s) {
+            auto sname = std::to_string(s);
+            if (std::find(broken.begin(), broken.end(), s) != broken.end()) {
+                lhandle.createGroup(sname);
+            } else {
+                mock_array_opener(lhandle, sname, { 13, s + 1 }, 1100000, (s % 2 == 0 ? "INTEGER" : "FLOAT"));
+            }
+        }
+        H5Lcreate_hard(lhandle.getId(), "0", lhandle.getId(), "19", H5P_DEFAULT, H5P_DEFAULT); // shared seed.
+    }
+
+    static void add_chain(const H5::Group& parent, const std::string& name, size_t depth, const std::vector<int>& dimensions, const std::string& type) {
+        H5::Group current = operation_opener(parent, name, "unary arithmetic");
+        add_version_string(current, 1100000);
+        for (size_t d = 0; d < depth; ++d) {
+            add_string_scalar(current, "method", "+");
+            add_string_scalar(current, "side", "right");
+            auto vhandle = add_numeric_scalar(current, "value", 1, H5::PredType::NATIVE_INT32);
+            add_string_attribute(vhandle, "type", "INTEGER");
+            if (d + 1 < depth) {
+                current = operation_opener(current, "seed", "unary arithmetic");
+            }
+        }
+        mock_array_opener(current, "seed", dimensions, 1100000, type);
+    }
+
+    static void add_binary(const H5::Group& parent, const std::string& name, bool broken) {
+        auto ghandle = operation_opener(parent, name, "binary arithmetic");
+        add_version_string(ghandle, 1100000);
+        add_string_scalar(ghandle, "method", "*");
+
+        auto thandle = operation_opener(ghandle, "left", "transpose");
+        add_numeric_vector<int>(thandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+        add_chain(thandle, "seed", 5, { 20, 13 }, "FLOAT");
+
+        auto shandle = operation_opener(ghandle, "right", "subset");
+        auto lhandle = list_opener(shandle, "index", 2, 1100000);
+        add_numeric_vector<int>(lhandle, "0", { 12, 0, 5, 5, 3, 7, 1, 2, 0, 4, 6, 8, 9 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(lhandle, "1", { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, (broken ? 1000 : 19) }, H5::PredType::NATIVE_UINT32);
+        add_chain(shandle, "seed", 3, { 13, 20 }, "INTEGER");
+    }
+
+    // Validates 'name' with the current mode and with the fully recursive serial traversal, and compares the results or errors.
+    // Returns the error message from the serial traversal, or an empty string if it succeeded.
+    std::string compare(const std::string& name) const {
+        chihaya::Options ref_opts;
+        ref_opts.iterative_depth = 0;
+        chihaya::ArrayDetails expected;
+        std::string expected_error;
+        try {
+            expected = chihaya::validate(path, name, ref_opts);
+        } catch (std::exception& e) {
+            expected_error = e.what();
+        }
+
+        chihaya::Options opts;
+        opts.num_threads = std::get<0>(GetParam());
+        opts.iterative_depth = std::get<1>(GetParam());
+        chihaya::ArrayDetails observed;
+        std::string observed_error;
+        try {
+            observed = chihaya::validate(path, name, opts);
+        } catch (std::exception& e) {
+            observed_error = e.what();
+        }
+
+        EXPECT_EQ(observed_error, expected_error) << "for '" << name << "'";
+        if (expected_error.empty()) {
+            EXPECT_EQ(observed.type, expected.type);
+            EXPECT_EQ(observed.dimensions, expected.dimensions);
+        }
+        EXPECT_FALSE(opts.pool); // pool is only kept for the duration of the call.
+        return expected_error;
+    }
+};
+
+TEST_P(ValidateModeTest, Success) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_combine(fhandle, "combine", {});
+        add_chain(fhandle, "chain", 250, { 13, 20 }, "BOOLEAN");
+        add_binary(fhandle, "binary", false);
+    }
+
+    for (const auto& name : { "combine", "chain", "binary" }) {
+        EXPECT_EQ(compare(name), "");
+    }
+}
+
+TEST_P(ValidateModeTest, Errors) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_combine(fhandle, "combine", { 13, 4, 17 });
+        add_chain(fhandle, "chain", 250, { 13, 20 }, "FOOBAR");
+        add_binary(fhandle, "binary", true);
+    }
+
+    EXPECT_NE(compare("combine").find("failed to validate 'seeds/4'"), std::string::npos);
+    EXPECT_NE(compare("chain").find("failed to validate 'seed'"), std::string::npos);
+    EXPECT_NE(compare("binary").find("failed to validate 'right'"), std::string::npos);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Validate,
+    ValidateModeTest,
+    ::testing::Combine(
+        ::testing::Values(1, 3), // number of threads
+        ::testing::Values(0, 1, 100) // iterative depth
+    )
+);